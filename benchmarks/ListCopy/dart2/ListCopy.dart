@@ -93,6 +93,25 @@ class Benchmark extends BenchmarkBase {
   }
 }
 
+// Benchmark for growing a large list one element at a time. Each time the
+// capacity is exhausted, the backing store is either copied to a new one or,
+// once it is large enough to have its own page, extended in place.
+class GrowBenchmark extends BenchmarkBase {
+  final int length;
+
+  GrowBenchmark(this.length) : super('ListCopy.grow.$length');
+
+  @override
+  void run() {
+    final list = <num>[];
+    for (var i = 0; i < length; i++) {
+      list.add(i);
+    }
+    output = list;
+    if (output.length != length) throw 'Bad result: $output';
+  }
+}
+
 // All the 'copy' methods use [input] and [output] rather than a parameter and
 // return value to avoid any possibility of type check in the call sequence.
 Iterable<num> input = const [];
@@ -147,7 +166,11 @@ List<Benchmark> makeBenchmarks(int length) => [
     ];
 
 void main() {
-  final benchmarks = [...makeBenchmarks(2), ...makeBenchmarks(100)];
+  final benchmarks = <BenchmarkBase>[
+    ...makeBenchmarks(2),
+    ...makeBenchmarks(100),
+    GrowBenchmark(1000000),
+  ];
 
   // Warmup all benchmarks to ensure JIT compilers see full polymorphism.
   for (var benchmark in benchmarks) {
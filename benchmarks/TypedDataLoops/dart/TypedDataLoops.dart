@@ -0,0 +1,284 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+// Micro-benchmarks for element-wise loops over typed data.
+//
+// The loops have the shapes of the inner loops of SkeletalAnimation (scaled
+// sums of Float32List/Float64List elements), MD5 and SHA (mixing of 32-bit
+// words) and FfiMemory (byte loops), without the surrounding work, so that
+// changes to how the VM compiles them show up directly. Each benchmark is run
+// for a short list, where the scalar remainder of a vectorized loop matters,
+// and a long one.
+
+import 'dart:typed_data';
+
+import 'package:benchmark_harness/benchmark_harness.dart';
+
+abstract class TypedDataLoopBenchmark extends BenchmarkBase {
+  final int size;
+
+  TypedDataLoopBenchmark(String type, String operation, this.size)
+      : super('TypedDataLoops.$type.$operation.$size');
+
+  // Computes the expected value of each element without going through the
+  // loop under test.
+  num expected(int i);
+
+  num actual(int i);
+
+  @override
+  void warmup() {
+    for (var i = 0; i < 100; ++i) {
+      run();
+    }
+  }
+
+  @override
+  void teardown() {
+    for (var i = 0; i < size; ++i) {
+      if (actual(i) != expected(i)) {
+        throw 'Unexpected result at $i: ${actual(i)} != ${expected(i)}';
+      }
+    }
+  }
+}
+
+abstract class Float64ListBenchmark extends TypedDataLoopBenchmark {
+  late Float64List a;
+  late Float64List b;
+  late Float64List result;
+
+  Float64ListBenchmark(String operation, int size)
+      : super('Float64List', operation, size);
+
+  double inputA(int i) => (i - 7) * 0.25;
+  double inputB(int i) => (i % 13) * 1.5;
+
+  @override
+  void setup() {
+    a = Float64List(size);
+    b = Float64List(size);
+    result = Float64List(size);
+    for (var i = 0; i < size; ++i) {
+      a[i] = inputA(i);
+      b[i] = inputB(i);
+    }
+  }
+
+  @override
+  num actual(int i) => result[i];
+}
+
+class Float64ListAddBenchmark extends Float64ListBenchmark {
+  Float64ListAddBenchmark(int size) : super('add', size);
+
+  @override
+  void run() {
+    final a = this.a;
+    final b = this.b;
+    final result = this.result;
+    for (var i = 0; i < result.length; i++) {
+      result[i] = a[i] + b[i];
+    }
+  }
+
+  @override
+  num expected(int i) => inputA(i) + inputB(i);
+}
+
+class Float64ListScaleAddBenchmark extends Float64ListBenchmark {
+  static const double scale = 0.75;
+
+  Float64ListScaleAddBenchmark(int size) : super('scaleAdd', size);
+
+  @override
+  void run() {
+    final a = this.a;
+    final b = this.b;
+    final result = this.result;
+    for (var i = 0; i < result.length; i++) {
+      result[i] = a[i] * scale + b[i];
+    }
+  }
+
+  @override
+  num expected(int i) => inputA(i) * scale + inputB(i);
+}
+
+abstract class Float32ListBenchmark extends TypedDataLoopBenchmark {
+  late Float32List a;
+  late Float32List b;
+  late Float32List result;
+
+  Float32ListBenchmark(String operation, int size)
+      : super('Float32List', operation, size);
+
+  // Exactly representable as floats.
+  double inputA(int i) => (i - 7) * 0.25;
+  double inputB(int i) => (i % 13) * 1.5;
+
+  @override
+  void setup() {
+    a = Float32List(size);
+    b = Float32List(size);
+    result = Float32List(size);
+    for (var i = 0; i < size; ++i) {
+      a[i] = inputA(i);
+      b[i] = inputB(i);
+    }
+  }
+
+  @override
+  num actual(int i) => result[i];
+}
+
+class Float32ListAddBenchmark extends Float32ListBenchmark {
+  Float32ListAddBenchmark(int size) : super('add', size);
+
+  @override
+  void run() {
+    final a = this.a;
+    final b = this.b;
+    final result = this.result;
+    for (var i = 0; i < result.length; i++) {
+      result[i] = a[i] + b[i];
+    }
+  }
+
+  @override
+  num expected(int i) => inputA(i) + inputB(i);
+}
+
+class Float32ListMulBenchmark extends Float32ListBenchmark {
+  Float32ListMulBenchmark(int size) : super('mul', size);
+
+  @override
+  void run() {
+    final a = this.a;
+    final b = this.b;
+    final result = this.result;
+    for (var i = 0; i < result.length; i++) {
+      result[i] = a[i] * b[i];
+    }
+  }
+
+  @override
+  num expected(int i) => inputA(i) * inputB(i);
+}
+
+abstract class Int32ListBenchmark extends TypedDataLoopBenchmark {
+  late Int32List a;
+  late Int32List b;
+  late Int32List result;
+
+  Int32ListBenchmark(String operation, int size)
+      : super('Int32List', operation, size);
+
+  int inputA(int i) => (i * 0x9E3779B9).toSigned(32);
+  int inputB(int i) => (i * 0x7FEB352D + 0x5BD1E995).toSigned(32);
+
+  @override
+  void setup() {
+    a = Int32List(size);
+    b = Int32List(size);
+    result = Int32List(size);
+    for (var i = 0; i < size; ++i) {
+      a[i] = inputA(i);
+      b[i] = inputB(i);
+    }
+  }
+
+  @override
+  num actual(int i) => result[i];
+}
+
+class Int32ListAddBenchmark extends Int32ListBenchmark {
+  Int32ListAddBenchmark(int size) : super('add', size);
+
+  @override
+  void run() {
+    final a = this.a;
+    final b = this.b;
+    final result = this.result;
+    for (var i = 0; i < result.length; i++) {
+      result[i] = a[i] + b[i];
+    }
+  }
+
+  @override
+  num expected(int i) => (inputA(i) + inputB(i)).toSigned(32);
+}
+
+class Int32ListXorBenchmark extends Int32ListBenchmark {
+  Int32ListXorBenchmark(int size) : super('xor', size);
+
+  @override
+  void run() {
+    final a = this.a;
+    final b = this.b;
+    final result = this.result;
+    for (var i = 0; i < result.length; i++) {
+      result[i] = a[i] ^ b[i];
+    }
+  }
+
+  @override
+  num expected(int i) => inputA(i) ^ inputB(i);
+}
+
+class Uint8ListXorBenchmark extends TypedDataLoopBenchmark {
+  late Uint8List a;
+  late Uint8List b;
+  late Uint8List result;
+
+  Uint8ListXorBenchmark(int size) : super('Uint8List', 'xor', size);
+
+  int inputA(int i) => (i + 3) & 0xff;
+  int inputB(int i) => (i * 7) & 0xff;
+
+  @override
+  void setup() {
+    a = Uint8List(size);
+    b = Uint8List(size);
+    result = Uint8List(size);
+    for (var i = 0; i < size; ++i) {
+      a[i] = inputA(i);
+      b[i] = inputB(i);
+    }
+  }
+
+  @override
+  void run() {
+    final a = this.a;
+    final b = this.b;
+    final result = this.result;
+    for (var i = 0; i < result.length; i++) {
+      result[i] = a[i] ^ b[i];
+    }
+  }
+
+  @override
+  num expected(int i) => inputA(i) ^ inputB(i);
+
+  @override
+  num actual(int i) => result[i];
+}
+
+void main() {
+  final sizes = [13, 4096];
+  final benchmarks = [
+    for (int size in sizes) ...[
+      Float64ListAddBenchmark(size),
+      Float64ListScaleAddBenchmark(size),
+      Float32ListAddBenchmark(size),
+      Float32ListMulBenchmark(size),
+      Int32ListAddBenchmark(size),
+      Int32ListXorBenchmark(size),
+      Uint8ListXorBenchmark(size),
+    ],
+  ];
+  for (var bench in benchmarks) {
+    bench.report();
+  }
+}
@@ -281,6 +281,19 @@ typedef struct {
   double avg_collection_period;
 } Dart_GCStats;
 
+/**
+ * Time spent in one phase of a garbage collection pause.
+ *
+ * \param wall Elapsed time, in microseconds.
+ *
+ * \param cpu CPU time of the thread that ran the pause, in microseconds.
+ *   Excludes helper threads used by parallel phases.
+ */
+typedef struct {
+  int64_t wall;
+  int64_t cpu;
+} Dart_GCPhaseTime;
+
 /**
  * A Garbage Collection event with memory usage statistics.
  *
@@ -291,6 +304,27 @@ typedef struct {
  * \param new_space Data for New Space.
  *
  * \param old_space Data for Old Space.
+ *
+ * \param time_to_safepoint Time taken to stop all threads of the isolate
+ *   group before the collection started, in microseconds.
+ *
+ * \param pause Duration of the collection once threads were stopped, in
+ *   microseconds.
+ *
+ * \param roots Time spent visiting roots outside the heap.
+ *
+ * \param marking Time spent marking, or copying survivors in a scavenge.
+ *
+ * \param weak Time spent processing weak references and finalizers.
+ *
+ * \param sweeping Time spent sweeping during the pause. Concurrent sweeping
+ *   after the pause is not included.
+ *
+ * \param compaction Time spent compacting or evacuating pages.
+ *
+ * \param promoted Bytes promoted to Old Space by a scavenge.
+ *
+ * \param freed Bytes no longer in use after the collection.
  */
 typedef struct {
   const char* type;
@@ -300,6 +334,16 @@ typedef struct {
 
   Dart_GCStats new_space;
   Dart_GCStats old_space;
+
+  int64_t time_to_safepoint;
+  int64_t pause;
+  Dart_GCPhaseTime roots;
+  Dart_GCPhaseTime marking;
+  Dart_GCPhaseTime weak;
+  Dart_GCPhaseTime sweeping;
+  Dart_GCPhaseTime compaction;
+  intptr_t promoted;
+  intptr_t freed;
 } Dart_GCEvent;
 
 /**
@@ -665,4 +709,34 @@ DART_EXPORT char* Dart_WriteHeapSnapshot(
     Dart_HeapSnapshotWriteChunkCallback write,
     void* context);
 
+/*
+ * =======
+ * Heap Profile
+ * =======
+ */
+
+/**
+ * Writes the sampled heap profile of the current isolate group in the pprof
+ * format (an uncompressed profile.proto message).
+ *
+ * The profile holds the allocations sampled while heap sampling is enabled
+ * (see `Dart_EnableHeapSampling` and `Dart_SetHeapSamplingPeriod`), grouped by
+ * the Dart stack that made them. Its sample types are alloc_objects and
+ * alloc_space, which count every sampled allocation, and inuse_objects and
+ * inuse_space, which only count the sampled objects that have not been
+ * collected yet.
+ *
+ * The isolate group will be paused for the duration of this operation.
+ *
+ * \param buffer Set to a buffer holding the profile. The caller owns the
+ *   buffer and needs to `free` it.
+ *
+ * \param buffer_size Set to the length of the profile in bytes.
+ *
+ * \returns `nullptr` if the operation is successful otherwise error message.
+ *   Caller owns error message string and needs to `free` it.
+ */
+DART_EXPORT char* Dart_WriteHeapProfile(uint8_t** buffer,
+                                        intptr_t* buffer_size);
+
 #endif  // RUNTIME_INCLUDE_DART_TOOLS_API_H_
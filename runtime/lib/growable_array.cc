@@ -81,6 +81,17 @@ DEFINE_NATIVE_ENTRY(GrowableList_setData, 0, 2) {
   return Object::null();
 }
 
+DEFINE_NATIVE_ENTRY(GrowableList_tryGrowInPlace, 0, 2) {
+  const GrowableObjectArray& array =
+      GrowableObjectArray::CheckedHandle(zone, arguments->NativeArgAt(0));
+  GET_NON_NULL_NATIVE_ARGUMENT(Smi, capacity, arguments->NativeArgAt(1));
+  const Array& data = Array::Handle(zone, array.data());
+  if (capacity.Value() <= data.Length()) {
+    return Bool::False().ptr();
+  }
+  return Bool::Get(data.TryGrowInPlace(capacity.Value())).ptr();
+}
+
 DEFINE_NATIVE_ENTRY(Internal_makeListFixedLength, 0, 1) {
   GET_NON_NULL_NATIVE_ARGUMENT(GrowableObjectArray, array,
                                arguments->NativeArgAt(0));
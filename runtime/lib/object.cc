@@ -340,7 +340,8 @@ DEFINE_NATIVE_ENTRY(Internal_writeHeapSnapshotToFile, 0, 1) {
       String::CheckedHandle(zone, arguments->NativeArgAt(0));
   {
     FileHeapSnapshotWriter file_writer(thread, filename.ToCString());
-    HeapSnapshotWriter writer(thread, &file_writer);
+    HeapSnapshotWriter writer(thread, &file_writer,
+                              FLAG_heap_snapshot_gzip_level);
     writer.Write();
   }
 #else
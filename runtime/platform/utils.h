@@ -501,6 +501,8 @@ class Utils {
   static int Close(int fildes);
   static size_t Read(int filedes, void* buf, size_t nbyte);
   static int Unlink(const char* path);
+  // Renames [old_path] to [new_path], replacing [new_path] if it exists.
+  static int Rename(const char* old_path, const char* new_path);
 
   // Print formatted output info a buffer.
   //
@@ -47,6 +47,9 @@ size_t Utils::Read(int filedes, void* buf, size_t nbyte) {
 int Utils::Unlink(const char* path) {
   return unlink(path);
 }
+int Utils::Rename(const char* old_path, const char* new_path) {
+  return rename(old_path, new_path);
+}
 
 }  // namespace dart
 
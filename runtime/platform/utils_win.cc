@@ -85,6 +85,9 @@ size_t Utils::Read(int filedes, void* buf, size_t nbyte) {
 int Utils::Unlink(const char* path) {
   return _unlink(path);
 }
+int Utils::Rename(const char* old_path, const char* new_path) {
+  return MoveFileExA(old_path, new_path, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+}
 
 }  // namespace dart
 
@@ -0,0 +1,144 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+// This test ensures that the flow graphs cached with --precompiler-cache-dir
+// produce the same snapshot as compiling them anew, that a cached flow graph
+// is not used once a function inlined into it changes but is replaced, and
+// that truncated or corrupted entries are ignored.
+
+import "dart:io";
+import "dart:typed_data";
+
+import 'package:expect/expect.dart';
+import 'package:path/path.dart' as path;
+
+import 'use_flag_test_helper.dart';
+
+// [callee] is inlined into [caller], so changing its body must invalidate
+// the cached flow graph of [caller] although [caller] itself is unchanged.
+String program(int factor) => '''
+@pragma('vm:prefer-inline')
+int callee(int x) => x * $factor;
+
+@pragma('vm:never-inline')
+int caller(int x) => callee(x) + 1;
+
+void main(List<String> args) {
+  print(caller(args.length + 20));
+}
+''';
+
+main(List<String> args) async {
+  if (!isAOTRuntime) {
+    return; // Running in JIT: AOT binaries not available.
+  }
+
+  if (Platform.isAndroid) {
+    return; // SDK tree and dart_bootstrap not available on the test device.
+  }
+
+  // These are the tools we need to be available to run on a given platform:
+  if (!await testExecutable(genSnapshot)) {
+    throw "Cannot run test as $genSnapshot not available";
+  }
+  if (!await testExecutable(aotRuntime)) {
+    throw "Cannot run test as $aotRuntime not available";
+  }
+  if (!File(platformDill).existsSync()) {
+    throw "Cannot run test as $platformDill does not exist";
+  }
+
+  await withTempDir('precompiler-cache-test', (String tempDir) async {
+    final cacheDir = path.join(tempDir, 'cache');
+    Directory(cacheDir).createSync();
+
+    final dill2 = await compileProgram(tempDir, 2);
+    final dill3 = await compileProgram(tempDir, 3);
+
+    // A run which fills the cache and a run which reads it produce the same
+    // snapshot.
+    final cold = await precompile(tempDir, dill2, cacheDir: cacheDir);
+    final entries = cacheEntries(cacheDir);
+    Expect.isTrue(entries.isNotEmpty, 'no flow graphs were cached');
+    final warm = await precompile(tempDir, dill2, cacheDir: cacheDir);
+    Expect.listEquals(cold, warm);
+    Expect.listEquals(entries, cacheEntries(cacheDir));
+    Expect.equals('41', await runSnapshot(tempDir, warm));
+
+    // After [callee] changed, the entry of [caller] is not used.
+    final emptyCacheDir = path.join(tempDir, 'empty_cache');
+    Directory(emptyCacheDir).createSync();
+    final fresh = await precompile(tempDir, dill3, cacheDir: emptyCacheDir);
+    final stale = await precompile(tempDir, dill3, cacheDir: cacheDir);
+    Expect.listEquals(fresh, stale);
+    Expect.equals('61', await runSnapshot(tempDir, stale));
+    // The entries were rewritten in place, without temporary files left.
+    Expect.listEquals(entries, cacheEntries(cacheDir));
+    Expect.listEquals(
+        entries,
+        Directory(cacheDir)
+            .listSync()
+            .map((file) => path.basename(file.path))
+            .toList()
+          ..sort());
+
+    // Truncated and corrupted entries are ignored.
+    for (final corrupt in <Uint8List Function(Uint8List)>[
+      (bytes) => Uint8List.sublistView(bytes, 0, bytes.length ~/ 2),
+      (bytes) => Uint8List.fromList(bytes)..[bytes.length ~/ 2] ^= 0xff,
+      (bytes) => Uint8List.fromList(bytes)..[bytes.length - 1] ^= 0xff,
+    ]) {
+      for (final entry in cacheEntries(emptyCacheDir)) {
+        final file = File(path.join(emptyCacheDir, entry));
+        file.writeAsBytesSync(corrupt(file.readAsBytesSync()));
+      }
+      final recompiled =
+          await precompile(tempDir, dill3, cacheDir: emptyCacheDir);
+      Expect.listEquals(fresh, recompiled);
+    }
+  });
+}
+
+Future<String> compileProgram(String tempDir, int factor) async {
+  // Both versions have the same URI, so that they share cache entries.
+  final script = path.join(tempDir, 'program.dart');
+  final scriptDill = path.join(tempDir, 'program_$factor.dill');
+  File(script).writeAsStringSync(program(factor));
+  await run(genKernel, <String>[
+    '--aot',
+    '--platform=$platformDill',
+    '-o',
+    scriptDill,
+    script,
+  ]);
+  return scriptDill;
+}
+
+Future<Uint8List> precompile(String tempDir, String scriptDill,
+    {required String cacheDir}) async {
+  final snapshot = path.join(tempDir, 'snapshot.so');
+  await run(genSnapshot, <String>[
+    '--deterministic',
+    '--precompiler-cache-dir=$cacheDir',
+    '--snapshot-kind=app-aot-elf',
+    '--elf=$snapshot',
+    scriptDill,
+  ]);
+  return File(snapshot).readAsBytesSync();
+}
+
+Future<String> runSnapshot(String tempDir, Uint8List bytes) async {
+  final snapshot = path.join(tempDir, 'run.so');
+  File(snapshot).writeAsBytesSync(bytes);
+  final output = await runOutput(aotRuntime, <String>[snapshot]);
+  return output.single;
+}
+
+List<String> cacheEntries(String cacheDir) => Directory(cacheDir)
+    .listSync()
+    .whereType<File>()
+    .map((file) => path.basename(file.path))
+    .where((name) => name.endsWith('.il'))
+    .toList()
+  ..sort();
@@ -0,0 +1,140 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+// This test ensures that the snapshot produced with
+// --precompiler-compile-threads doesn't depend on the number of threads,
+// including the closures, dispatchers and constants which are created while
+// functions are compiled in parallel, and that it is the same as the one
+// compiled on the main thread with --precompiler-compile-threads=0.
+
+import "dart:io";
+
+import 'package:expect/expect.dart';
+import 'package:path/path.dart' as path;
+
+import 'use_flag_test_helper.dart';
+
+const program = r'''
+class Point {
+  final double x;
+  final double y;
+  const Point(this.x, this.y);
+  Point operator +(Point other) => Point(x + other.x, y + other.y);
+  double get length => x * x + y * y;
+  String toString() => 'Point($x, $y)';
+}
+
+class Shape {
+  String describe() => 'shape';
+}
+
+class Circle extends Shape {
+  final double radius;
+  Circle(this.radius);
+  String describe() => 'circle ${radius * 2.5}';
+}
+
+class Square extends Shape {
+  final int side;
+  Square(this.side);
+  String describe() => 'square ${side << 3}';
+}
+
+const origin = Point(0.5, 1.5);
+const points = [Point(1.25, 2.25), Point(3.75, 4.75), origin];
+
+(int, {String name}) record(int i) => (i * 7, name: 'r$i');
+
+int apply(int Function(int) f, int x) => f(x);
+
+int twice(int x) => 2 * x;
+
+void main(List<String> args) {
+  final shapes = <Shape>[Circle(1.5), Square(3), Shape()];
+  for (final shape in shapes) {
+    print(shape.describe());
+  }
+  final dynamic d = args.isEmpty ? Circle(4.5) : Square(9);
+  print(d.describe());
+  final describe = shapes.first.describe;
+  print(describe());
+  var sum = origin;
+  for (final p in points) {
+    sum = sum + p;
+  }
+  print('$sum ${sum.length}');
+  final offset = args.length + 3;
+  print([1, 2, 3].map((x) => x + offset).map(twice).toList());
+  print(apply((x) => x * offset, 11));
+  final (value, :name) = record(args.length + 6);
+  print('$value $name');
+}
+''';
+
+main(List<String> args) async {
+  if (!isAOTRuntime) {
+    return; // Running in JIT: AOT binaries not available.
+  }
+
+  if (Platform.isAndroid) {
+    return; // SDK tree and dart_bootstrap not available on the test device.
+  }
+
+  // These are the tools we need to be available to run on a given platform:
+  if (!await testExecutable(genSnapshot)) {
+    throw "Cannot run test as $genSnapshot not available";
+  }
+  if (!await testExecutable(aotRuntime)) {
+    throw "Cannot run test as $aotRuntime not available";
+  }
+  if (!File(platformDill).existsSync()) {
+    throw "Cannot run test as $platformDill does not exist";
+  }
+
+  await withTempDir('precompiler-compile-threads-test', (String tempDir) async {
+    final script = path.join(tempDir, 'program.dart');
+    final scriptDill = path.join(tempDir, 'program.dill');
+    File(script).writeAsStringSync(program);
+    await run(genKernel, <String>[
+      '--aot',
+      '--platform=$platformDill',
+      '-o',
+      scriptDill,
+      script,
+    ]);
+
+    final serial = await precompile(tempDir, scriptDill, 0);
+    for (final threads in [1, 2, 4, 8]) {
+      Expect.listEquals(serial, await precompile(tempDir, scriptDill, threads),
+          'snapshot with $threads threads differs');
+    }
+
+    final output = await runOutput(
+        aotRuntime, <String>[path.join(tempDir, 'snapshot_0.so')]);
+    Expect.listEquals(<String>[
+      'circle 3.75',
+      'square 24',
+      'shape',
+      'circle 11.25',
+      'circle 3.75',
+      'Point(6.0, 10.0) 136.0',
+      '[8, 10, 12]',
+      '33',
+      '42 r6',
+    ], output);
+  });
+}
+
+Future<List<int>> precompile(
+    String tempDir, String scriptDill, int threads) async {
+  final snapshot = path.join(tempDir, 'snapshot_$threads.so');
+  await run(genSnapshot, <String>[
+    '--deterministic',
+    '--precompiler-compile-threads=$threads',
+    '--snapshot-kind=app-aot-elf',
+    '--elf=$snapshot',
+    scriptDill,
+  ]);
+  return File(snapshot).readAsBytesSync();
+}
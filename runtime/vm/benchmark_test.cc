@@ -21,11 +21,14 @@
 #include "vm/message_snapshot.h"
 #include "vm/stack_frame.h"
 #include "vm/timer.h"
+#include "vm/virtual_memory.h"
 
 using dart::bin::File;
 
 namespace dart {
 
+DECLARE_FLAG(bool, marker_work_stealing);
+
 Benchmark* Benchmark::first_ = NULL;
 Benchmark* Benchmark::tail_ = NULL;
 const char* Benchmark::executable_ = NULL;
@@ -606,6 +609,147 @@ BENCHMARK(LargeMap) {
   benchmark->set_score(elapsed_time);
 }
 
+// Measures old-space marking over a heap of a few hundred MB of small,
+// pointer-rich objects, where marking time is dominated by TLB misses.
+static void MarkLargeOldSpace(Benchmark* benchmark, Thread* thread) {
+  const char* kScript =
+      "makeHeap() {\n"
+      "  final roots = List<dynamic>.filled(1 << 12, null);\n"
+      "  for (int i = 0; i < roots.length; ++i) {\n"
+      "    var node = null;\n"
+      "    for (int j = 0; j < (1 << 10); ++j) {\n"
+      "      node = [node, i, j];\n"
+      "    }\n"
+      "    roots[i] = node;\n"
+      "  }\n"
+      "  return roots;\n"
+      "}";
+  // Cached pages may come from either kind of mapping.
+  Page::ClearCache();
+  Dart_Handle h_lib = TestCase::LoadTestScript(kScript, NULL);
+  EXPECT_VALID(h_lib);
+  Dart_Handle h_result = Dart_Invoke(h_lib, NewString("makeHeap"), 0, NULL);
+  EXPECT_VALID(h_result);
+  TransitionNativeToVM transition(thread);
+  // Promote everything so later collections only mark.
+  GCTestHelper::CollectAllGarbage();
+  const intptr_t kLoopCount = 10;
+  Timer timer;
+  timer.Start();
+  for (intptr_t i = 0; i < kLoopCount; i++) {
+    GCTestHelper::CollectOldSpace();
+  }
+  timer.Stop();
+  int64_t elapsed_time = timer.TotalElapsedTime();
+  benchmark->set_score(elapsed_time);
+}
+
+BENCHMARK(OldSpaceMarkingBasePages) {
+  SetFlagScope<bool> sfs(&FLAG_use_huge_pages, false);
+  MarkLargeOldSpace(benchmark, thread);
+}
+
+BENCHMARK(OldSpaceMarkingHugePages) {
+  SetFlagScope<bool> sfs(&FLAG_use_huge_pages, true);
+  if (!VirtualMemory::HugePagesEnabled()) {
+    OS::PrintErr("Transparent huge pages are not available.\n");
+  }
+  MarkLargeOldSpace(benchmark, thread);
+}
+
+// Measures parallel marking as the number of marker tasks grows.
+static void MarkLargeOldSpaceWithTasks(Benchmark* benchmark,
+                                       Thread* thread,
+                                       int num_tasks,
+                                       bool work_stealing) {
+  // Finish any marking in progress; it is unsafe to change FLAG_marker_tasks
+  // while incremental marking is in progress.
+  {
+    TransitionNativeToVM transition(thread);
+    GCTestHelper::CollectAllGarbage();
+  }
+  SetFlagScope<int> sfs_tasks(&FLAG_marker_tasks, num_tasks);
+  SetFlagScope<bool> sfs_stealing(&FLAG_marker_work_stealing, work_stealing);
+  MarkLargeOldSpace(benchmark, thread);
+}
+
+BENCHMARK(ParallelMarking1Task) {
+  MarkLargeOldSpaceWithTasks(benchmark, thread, 1, true);
+}
+
+BENCHMARK(ParallelMarking2Tasks) {
+  MarkLargeOldSpaceWithTasks(benchmark, thread, 2, true);
+}
+
+BENCHMARK(ParallelMarking4Tasks) {
+  MarkLargeOldSpaceWithTasks(benchmark, thread, 4, true);
+}
+
+BENCHMARK(ParallelMarking8Tasks) {
+  MarkLargeOldSpaceWithTasks(benchmark, thread, 8, true);
+}
+
+BENCHMARK(ParallelMarking16Tasks) {
+  MarkLargeOldSpaceWithTasks(benchmark, thread, 16, true);
+}
+
+BENCHMARK(ParallelMarking8TasksSharedStack) {
+  MarkLargeOldSpaceWithTasks(benchmark, thread, 8, false);
+}
+
+BENCHMARK(ParallelMarking16TasksSharedStack) {
+  MarkLargeOldSpaceWithTasks(benchmark, thread, 16, false);
+}
+
+// Measures scavenges of a heap of promoted arrays too large for the free
+// lists, each of which has a few of its slots overwritten with new objects
+// between scavenges. Without card marking every written array is rescanned
+// in full from the store buffer.
+static void ScavengeWrittenLargeOldArrays(Benchmark* benchmark,
+                                          Thread* thread) {
+  const char* kScript =
+      "makeArrays() {\n"
+      "  return List<List<dynamic>>.generate(\n"
+      "      1 << 8, (_) => List<dynamic>.filled(1 << 14, null));\n"
+      "}\n"
+      "write(List<List<dynamic>> arrays, int i) {\n"
+      "  for (final array in arrays) {\n"
+      "    array[(i * 97) % array.length] = Object();\n"
+      "  }\n"
+      "}";
+  Dart_Handle h_lib = TestCase::LoadTestScript(kScript, NULL);
+  EXPECT_VALID(h_lib);
+  Dart_Handle h_arrays = Dart_Invoke(h_lib, NewString("makeArrays"), 0, NULL);
+  EXPECT_VALID(h_arrays);
+  {
+    TransitionNativeToVM transition(thread);
+    // Promote the arrays.
+    GCTestHelper::CollectAllGarbage();
+  }
+  const intptr_t kLoopCount = 50;
+  Timer timer;
+  for (intptr_t i = 0; i < kLoopCount; i++) {
+    Dart_Handle args[2] = {h_arrays, Dart_NewInteger(i)};
+    EXPECT_VALID(Dart_Invoke(h_lib, NewString("write"), 2, args));
+    TransitionNativeToVM transition(thread);
+    timer.Start();
+    GCTestHelper::CollectNewSpace();
+    timer.Stop();
+  }
+  int64_t elapsed_time = timer.TotalElapsedTime();
+  benchmark->set_score(elapsed_time);
+}
+
+BENCHMARK(ScavengeWrittenLargeOldArraysStoreBuffer) {
+  SetFlagScope<bool> sfs(&FLAG_card_mark_promoted_large_arrays, false);
+  ScavengeWrittenLargeOldArrays(benchmark, thread);
+}
+
+BENCHMARK(ScavengeWrittenLargeOldArraysCards) {
+  SetFlagScope<bool> sfs(&FLAG_card_mark_promoted_large_arrays, true);
+  ScavengeWrittenLargeOldArrays(benchmark, thread);
+}
+
 BENCHMARK_MEMORY(InitialRSS) {
   benchmark->set_score(bin::Process::MaxRSS());
 }
@@ -356,6 +356,9 @@ void ClassTable::AllocationProfilePrintJSON(JSONStream* stream, bool internal) {
       obj.AddProperty64("accumulatedSize", size);
       obj.AddProperty64("instancesCurrent", count);
       obj.AddProperty64("bytesCurrent", size);
+      obj.AddProperty64("_externalBytesCurrent",
+                        visitor.new_external_size_[i] +
+                            visitor.old_external_size_[i]);
 
       if (internal) {
         {
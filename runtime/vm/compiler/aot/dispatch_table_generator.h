@@ -16,6 +16,7 @@ namespace dart {
 
 class ClassTable;
 class Precompiler;
+class PrecompilerCache;
 class PrecompilerTracer;
 
 namespace compiler {
@@ -78,6 +79,7 @@ class SelectorMap {
   int32_t NumIds() const { return selectors_.length(); }
 
   friend class dart::Precompiler;
+  friend class dart::PrecompilerCache;
   friend class dart::PrecompilerTracer;
   friend class DispatchTableGenerator;
   friend class SelectorRow;
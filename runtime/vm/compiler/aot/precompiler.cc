@@ -13,6 +13,7 @@
 #include "vm/closure_functions_cache.h"
 #include "vm/code_patcher.h"
 #include "vm/compiler/aot/aot_call_specializer.h"
+#include "vm/compiler/aot/precompiler_cache.h"
 #include "vm/compiler/aot/precompiler_tracer.h"
 #include "vm/compiler/assembler/assembler.h"
 #include "vm/compiler/assembler/disassembler.h"
@@ -33,6 +34,7 @@
 #include "vm/compiler/frontend/flow_graph_builder.h"
 #include "vm/compiler/frontend/kernel_to_il.h"
 #include "vm/compiler/jit/compiler.h"
+#include "vm/dart.h"
 #include "vm/dart_entry.h"
 #include "vm/exceptions.h"
 #include "vm/ffi/native_assets.h"
@@ -83,7 +85,14 @@ DEFINE_FLAG(charp,
             write_retained_reasons_to,
             nullptr,
             "Print reasons for retaining objects to the given file");
-
+DEFINE_FLAG(int,
+            precompiler_compile_threads,
+            0,
+            "Number of threads compiling functions in parallel, or 0 to "
+            "compile them on the main thread. The snapshot is the same for "
+            "any number of threads, including 0.");
+
+DECLARE_FLAG(charp, precompiler_cache_dir);
 DECLARE_FLAG(bool, print_flow_graph);
 DECLARE_FLAG(bool, print_flow_graph_optimized);
 DECLARE_FLAG(bool, trace_compiler);
@@ -334,11 +343,15 @@ class PrecompileParsedFunctionHelper : public ValueObject {
  public:
   PrecompileParsedFunctionHelper(Precompiler* precompiler,
                                  ParsedFunction* parsed_function,
-                                 bool optimized)
+                                 bool optimized,
+                                 CompileBatch* batch,
+                                 intptr_t index)
       : precompiler_(precompiler),
         parsed_function_(parsed_function),
         optimized_(optimized),
-        thread_(Thread::Current()) {}
+        thread_(Thread::Current()),
+        batch_(batch),
+        index_(index) {}
 
   bool Compile(CompilationPipeline* pipeline);
 
@@ -356,10 +369,108 @@ class PrecompileParsedFunctionHelper : public ValueObject {
   ParsedFunction* parsed_function_;
   const bool optimized_;
   Thread* const thread_;
+  // The batch of functions compiled in parallel this one is part of, if any.
+  CompileBatch* const batch_;
+  const intptr_t index_;
 
   DISALLOW_COPY_AND_ASSIGN(PrecompileParsedFunctionHelper);
 };
 
+// Compiles the functions of a batch on a number of helper threads.
+//
+// Building and optimizing the flow graphs runs fully in parallel. Code
+// generation adds to the global object pool and installs the code, so the
+// functions of a batch take turns in the order of the batch for it: a
+// function generates code only after the previous one was committed. The
+// main thread then adds the callees and selectors used by the function
+// before it lets the next one in, and functions found this way are
+// compiled in the next batch. This keeps the object pool and the order in
+// which functions are found the same regardless of the number of threads.
+//
+// A function also needs the turn to add closures, dispatchers and other
+// functions to the program while it is compiled, so that they are created
+// in the same order as well. It then keeps the turn until it is committed.
+//
+// With --precompiler_compile_threads=0 the main thread compiles the batch
+// itself in the same order, so the snapshot is the same for any number of
+// threads.
+class CompileBatch {
+ public:
+  CompileBatch(Precompiler* precompiler,
+               const GrowableArray<const Function*>& functions)
+      : precompiler_(precompiler),
+        isolate_group_(precompiler->thread()->isolate_group()),
+        type_usage_info_(precompiler->thread()->type_usage_info()),
+        functions_(functions) {}
+
+  // Compiles the batch on [num_threads] helper threads and finishes the
+  // compiled functions on the main thread. Returns the error of the first
+  // function which failed to compile, if any.
+  ErrorPtr Run(intptr_t num_threads);
+
+  // Called on a helper thread before the function at [index] generates
+  // code. Returns false if the batch was aborted.
+  bool AcquireTurn(intptr_t index);
+
+  // Called on a helper thread after the function at [index] was installed.
+  // Returns once the main thread finished it.
+  void Commit(intptr_t index, FlowGraphCompiler* graph_compiler) {
+    Publish(index, graph_compiler, nullptr);
+  }
+
+ private:
+  class Task : public ThreadPool::Task {
+   public:
+    explicit Task(CompileBatch* batch) : batch_(batch) {}
+
+   private:
+    virtual void Run() { batch_->Work(); }
+
+    CompileBatch* const batch_;
+
+    DISALLOW_COPY_AND_ASSIGN(Task);
+  };
+
+  // Makes the function at [index] wait for its turn before it changes the
+  // program.
+  class Turn : public CompilerState::ProgramChangeListener {
+   public:
+    Turn(CompileBatch* batch, intptr_t index) : batch_(batch), index_(index) {}
+
+    virtual void WillChangeProgram();
+
+   private:
+    CompileBatch* const batch_;
+    const intptr_t index_;
+
+    DISALLOW_COPY_AND_ASSIGN(Turn);
+  };
+
+  void Work();
+  void Publish(intptr_t index,
+               FlowGraphCompiler* graph_compiler,
+               const Error* error);
+
+  Precompiler* const precompiler_;
+  IsolateGroup* const isolate_group_;
+  TypeUsageInfo* const type_usage_info_;
+  const GrowableArray<const Function*>& functions_;
+
+  Monitor monitor_;
+  // The next function to be claimed by a helper thread.
+  intptr_t next_ = 0;
+  // The function which may generate code.
+  intptr_t turn_ = 0;
+  // The last function which was committed or failed, and its results.
+  intptr_t published_ = -1;
+  FlowGraphCompiler* graph_compiler_ = nullptr;
+  const Error* error_ = nullptr;
+  intptr_t num_workers_ = 0;
+  bool aborted_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(CompileBatch);
+};
+
 static void Jump(const Error& error) {
   Thread::Current()->long_jump_base()->Jump(1, error);
 }
@@ -574,7 +685,12 @@ void Precompiler::DoCompileAll() {
 
       // Compile newly found targets and add their callees until we reach a
       // fixed point.
+      PrecompilerCache cache(this);
+      if (cache.Init(FLAG_precompiler_cache_dir)) {
+        cache_ = &cache;
+      }
       Iterate();
+      cache_ = nullptr;
 
       // Replace the default type testing stubs installed on [Type]s with new
       // [Type]-specialized stubs.
@@ -779,15 +895,12 @@ void Precompiler::AddRoots() {
 void Precompiler::Iterate() {
   PRECOMPILER_TIMER_SCOPE(this, Iterate);
 
-  Function& function = Function::Handle(Z);
-
   phase_ = Phase::kFixpointCodeGeneration;
   while (changed_) {
     changed_ = false;
 
     while (pending_functions_.Length() > 0) {
-      function ^= pending_functions_.RemoveLast();
-      ProcessFunction(function);
+      ProcessBatch();
     }
 
     CheckForNewDynamicFunctions();
@@ -896,6 +1009,68 @@ void Precompiler::ProcessFunction(const Function& function) {
   AddCalleesOf(function, gop_offset);
 }
 
+void Precompiler::ProcessBatch() {
+  HANDLESCOPE(T);
+  GrowableArray<const Function*> functions;
+  while (pending_functions_.Length() > 0) {
+    Function& function = Function::Handle(Z);
+    function ^= pending_functions_.RemoveLast();
+    RELEASE_ASSERT(!function.HasCode());
+    // Ffi trampoline functions have no signature.
+    ASSERT(function.kind() == UntaggedFunction::kFfiTrampoline ||
+           FunctionType::Handle(Z, function.signature()).IsFinalized());
+    ASSERT(!function.is_abstract());
+    functions.Add(&function);
+  }
+
+  if (FLAG_precompiler_compile_threads == 0) {
+    // Callees of these functions are compiled in the next batch, as with
+    // helper threads.
+    for (intptr_t i = 0; i < functions.length(); i++) {
+      ProcessFunction(*functions[i]);
+    }
+    return;
+  }
+
+  CompileBatch batch(this, functions);
+  error_ = batch.Run(FLAG_precompiler_compile_threads);
+  if (!error_.IsNull()) {
+    Jump(error_);
+  }
+}
+
+void Precompiler::FinishFunction(const Function& function,
+                                 FlowGraphCompiler* graph_compiler,
+                                 intptr_t gop_offset) {
+  HANDLESCOPE(T);
+  TracingScope tracing_scope(this);
+  function_count_++;
+
+  if (FLAG_trace_precompiler) {
+    THR_Print("Precompiled %" Pd " %s (%s, %s)\n", function_count_,
+              function.ToLibNamePrefixedQualifiedCString(),
+              function.token_pos().ToCString(),
+              Function::KindToCString(function.kind()));
+  }
+  if (is_tracing()) {
+    tracer_->WriteCompileFunctionEvent(function);
+  }
+
+  for (intptr_t i = 0; i < graph_compiler->used_static_fields().length();
+       i++) {
+    AddField(*graph_compiler->used_static_fields().At(i));
+  }
+  const GrowableArray<const compiler::TableSelector*>& call_selectors =
+      graph_compiler->dispatch_table_call_targets();
+  for (intptr_t i = 0; i < call_selectors.length(); i++) {
+    AddTableSelector(call_selectors[i]);
+  }
+
+  // Used in the JIT to save type-feedback across compilations.
+  function.ClearICDataArray();
+  AddCalleesOf(function, gop_offset);
+}
+
 void Precompiler::AddCalleesOf(const Function& function, intptr_t gop_offset) {
   PRECOMPILER_TIMER_SCOPE(this, AddCalleesOf);
   ASSERT(function.HasCode());
@@ -2634,6 +2809,32 @@ void Precompiler::DropTransitiveUserDefinedConstants() {
   }
 }
 
+static int CompareConstants(const Instance* const* a,
+                            const Instance* const* b) {
+  const uint32_t hash_a = (*a)->CanonicalizeHash();
+  const uint32_t hash_b = (*b)->CanonicalizeHash();
+  if (hash_a != hash_b) {
+    return hash_a < hash_b ? -1 : 1;
+  }
+  return strcmp((*a)->ToCString(), (*b)->ToCString());
+}
+
+// Constants canonicalized by several threads were added to the constants of
+// their classes in any order. Sorts them by their values, so that the tables
+// rehashed from them are the same in every run and for any number of
+// threads.
+static void SortConstants(const GrowableObjectArray& constants) {
+  Zone* zone = Thread::Current()->zone();
+  GrowableArray<const Instance*> sorted(constants.Length());
+  for (intptr_t i = 0; i < constants.Length(); i++) {
+    sorted.Add(&Instance::Handle(zone, Instance::RawCast(constants.At(i))));
+  }
+  sorted.Sort(CompareConstants);
+  for (intptr_t i = 0; i < sorted.length(); i++) {
+    constants.SetAt(i, *sorted[i]);
+  }
+}
+
 void Precompiler::TraceTypesFromRetainedClasses() {
   HANDLESCOPE(T);
   auto& lib = Library::Handle(Z);
@@ -2681,6 +2882,7 @@ void Precompiler::TraceTypesFromRetainedClasses() {
           }
         }
       }
+      SortConstants(retained_constants);
       // Rehash.
       cls.set_constants(Object::null_array());
       for (intptr_t j = 0; j < retained_constants.Length(); j++) {
@@ -3427,7 +3629,7 @@ void PrecompileParsedFunctionHelper::FinalizeCompilation(
 
   if (optimized()) {
     // Installs code while at safepoint.
-    ASSERT(thread()->IsMutatorThread());
+    ASSERT(thread()->IsMutatorThread() || batch_ != nullptr);
     function.InstallOptimizedCode(code);
   } else {  // not optimized.
     function.set_unoptimized_code(code);
@@ -3468,6 +3670,10 @@ bool PrecompileParsedFunctionHelper::Compile(CompilationPipeline* pipeline) {
   volatile intptr_t far_branch_level = 0;
   SpeculativeInliningPolicy speculative_policy(
       true, FLAG_max_speculative_inlining_attempts);
+  PrecompilerCache* const cache =
+      precompiler_->phase() == Precompiler::Phase::kFixpointCodeGeneration
+          ? precompiler_->cache()
+          : nullptr;
 
   while (!done) {
     LongJumpScope jump;
@@ -3476,6 +3682,8 @@ bool PrecompileParsedFunctionHelper::Compile(CompilationPipeline* pipeline) {
       FlowGraph* flow_graph = nullptr;
       ZoneGrowableArray<const ICData*>* ic_data_array = nullptr;
       const Function& function = parsed_function()->function();
+      const uint8_t* cache_entry = nullptr;
+      intptr_t cache_entry_size = 0;
 
       CompilerState compiler_state(thread(), /*is_aot=*/true, optimized(),
                                    CompilerState::ShouldTrace(function));
@@ -3521,7 +3729,18 @@ bool PrecompileParsedFunctionHelper::Compile(CompilationPipeline* pipeline) {
                                             &speculative_policy);
         pass_state.call_specializer = &call_specializer;
 
-        flow_graph = CompilerPass::RunPipeline(CompilerPass::kAOT, &pass_state);
+        // Retries after a failed speculation always run the pipeline.
+        if (cache != nullptr && speculative_policy.length() == 0 &&
+            cache->Lookup(&pass_state)) {
+          flow_graph = pass_state.flow_graph();
+        } else {
+          flow_graph =
+              CompilerPass::RunPipeline(CompilerPass::kAOT, &pass_state);
+          if (cache != nullptr) {
+            cache_entry = cache->Serialize(&pass_state, &cache_entry_size);
+            flow_graph = pass_state.flow_graph();
+          }
+        }
       }
 
       ASSERT(pass_state.inline_id_to_function.length() ==
@@ -3529,6 +3748,12 @@ bool PrecompileParsedFunctionHelper::Compile(CompilationPipeline* pipeline) {
 
       ASSERT(precompiler_ != nullptr);
 
+      if (batch_ != nullptr && !batch_->AcquireTurn(index_)) {
+        // An earlier function of the batch failed to compile.
+        thread()->set_sticky_error(Object::background_compilation_error());
+        return false;
+      }
+
       // When generating code in bare instruction mode all code objects
       // share the same global object pool. To reduce interleaving of
       // unrelated object pool entries from different code objects
@@ -3572,13 +3797,17 @@ bool PrecompileParsedFunctionHelper::Compile(CompilationPipeline* pipeline) {
       {
         COMPILER_TIMINGS_TIMER_SCOPE(thread(), FinalizeCode);
         TIMELINE_DURATION(thread(), CompilerVerbose, "FinalizeCompilation");
-        ASSERT(thread()->IsMutatorThread());
+        ASSERT(thread()->IsMutatorThread() || batch_ != nullptr);
         FinalizeCompilation(&assembler, &graph_compiler, flow_graph,
                             function_stats);
       }
 
-      if (precompiler_->phase() ==
-          Precompiler::Phase::kFixpointCodeGeneration) {
+      if (batch_ != nullptr) {
+        // The precompiler adds them once the function is committed below.
+        ASSERT(precompiler_->phase() ==
+               Precompiler::Phase::kFixpointCodeGeneration);
+      } else if (precompiler_->phase() ==
+                 Precompiler::Phase::kFixpointCodeGeneration) {
         for (intptr_t i = 0; i < graph_compiler.used_static_fields().length();
              i++) {
           precompiler_->AddField(*graph_compiler.used_static_fields().At(i));
@@ -3614,6 +3843,12 @@ bool PrecompileParsedFunctionHelper::Compile(CompilationPipeline* pipeline) {
         done = false;
         continue;
       }
+      if (batch_ != nullptr) {
+        batch_->Commit(index_, &graph_compiler);
+      }
+      if (cache_entry != nullptr) {
+        cache->Insert(function, cache_entry, cache_entry_size);
+      }
       // Exit the loop and the function with the correct result value.
       is_compiled = true;
       done = true;
@@ -3667,7 +3902,9 @@ bool PrecompileParsedFunctionHelper::Compile(CompilationPipeline* pipeline) {
 static ErrorPtr PrecompileFunctionHelper(Precompiler* precompiler,
                                          CompilationPipeline* pipeline,
                                          const Function& function,
-                                         bool optimized) {
+                                         bool optimized,
+                                         CompileBatch* batch = nullptr,
+                                         intptr_t index = -1) {
   // Check that we optimize, except if the function is not optimizable.
   ASSERT(CompilerState::Current().is_aot());
   ASSERT(!function.IsOptimizable() || optimized);
@@ -3696,13 +3933,15 @@ static ErrorPtr PrecompileFunctionHelper(Precompiler* precompiler,
     }
 
     PrecompileParsedFunctionHelper helper(precompiler, parsed_function,
-                                          optimized);
+                                          optimized, batch, index);
     const bool success = helper.Compile(pipeline);
     if (!success) {
       // We got an error during compilation.
       const Error& error = Error::Handle(thread->StealStickyError());
-      ASSERT(error.IsLanguageError() &&
-             LanguageError::Cast(error).kind() != Report::kBailout);
+      ASSERT((error.IsLanguageError() &&
+              LanguageError::Cast(error).kind() != Report::kBailout) ||
+             (batch != nullptr &&
+              error.ptr() == Object::background_compilation_error().ptr()));
       return error.ptr();
     }
 
@@ -3759,6 +3998,161 @@ ErrorPtr Precompiler::CompileFunction(Precompiler* precompiler,
   return PrecompileFunctionHelper(precompiler, &pipeline, function, optimized);
 }
 
+ErrorPtr CompileBatch::Run(intptr_t num_threads) {
+  Thread* const thread = Thread::Current();
+  ASSERT(thread == precompiler_->thread());
+  const intptr_t length = functions_.length();
+  // The length of the global object pool when the function which has the
+  // turn started to generate code. It must be read before the turn is
+  // granted, as the helper thread appends to the pool right away.
+  intptr_t gop_offset =
+      precompiler_->global_object_pool_builder()->CurrentLength();
+  {
+    SafepointMonitorLocker ml(&monitor_);
+    const intptr_t num_tasks = Utils::Minimum(num_threads, length);
+    for (intptr_t i = 0; i < num_tasks; ++i) {
+      if (!Dart::thread_pool()->Run<Task>(this)) {
+        break;
+      }
+      num_workers_++;
+    }
+    if (num_workers_ == 0) {
+      FATAL("Failed to start precompiler compile threads");
+    }
+  }
+
+  Error& error = Error::Handle(thread->zone());
+  for (intptr_t index = 0; index < length; ++index) {
+    FlowGraphCompiler* graph_compiler = nullptr;
+    {
+      SafepointMonitorLocker ml(&monitor_);
+      while (published_ != index) {
+        ml.Wait();
+      }
+      if (error_ != nullptr) {
+        // Report the first failure in the order of the batch, as the serial
+        // compilation would.
+        error = error_->ptr();
+        aborted_ = true;
+        ml.NotifyAll();
+        break;
+      }
+      graph_compiler = graph_compiler_;
+    }
+    // The helper thread waits in Publish until it gets the next turn.
+    precompiler_->FinishFunction(*functions_[index], graph_compiler,
+                                 gop_offset);
+    gop_offset = precompiler_->global_object_pool_builder()->CurrentLength();
+    {
+      SafepointMonitorLocker ml(&monitor_);
+      turn_ = index + 1;
+      ml.NotifyAll();
+    }
+  }
+
+  SafepointMonitorLocker ml(&monitor_);
+  while (num_workers_ > 0) {
+    ml.Wait();
+  }
+  return error.ptr();
+}
+
+void CompileBatch::Work() {
+  bool result = Thread::EnterIsolateGroupAsHelper(
+      isolate_group_, Thread::kCompilerTask, /*bypass_safepoint=*/false);
+  ASSERT(result);
+  {
+    Thread* const thread = Thread::Current();
+    StackZone stack_zone(thread);
+    Zone* const zone = stack_zone.GetZone();
+    HierarchyInfo hierarchy_info(thread);
+    CompilerState compiler_state(thread, /*is_aot=*/true,
+                                 /*is_optimizing=*/true);
+    NoActiveIsolateScope no_isolate_scope;
+    VMTagScope tag_scope(thread, VMTag::kCompileUnoptimizedTagId);
+    DartCompilationPipeline pipeline;
+    Error& error = Error::Handle(zone);
+
+    while (true) {
+      intptr_t index;
+      {
+        SafepointMonitorLocker ml(&monitor_);
+        if (aborted_ || next_ == functions_.length()) {
+          break;
+        }
+        index = next_++;
+      }
+      const Function& function = *functions_[index];
+      TIMELINE_FUNCTION_COMPILATION_DURATION(thread, "CompileFunction",
+                                             function);
+      Turn turn(this, index);
+      compiler_state.set_program_change_listener(&turn);
+      error = PrecompileFunctionHelper(precompiler_, &pipeline, function,
+                                       function.IsOptimizable(), this, index);
+      compiler_state.set_program_change_listener(nullptr);
+      if (error.IsNull() ||
+          error.ptr() == Object::background_compilation_error().ptr()) {
+        continue;
+      }
+      // Report the failure when it is this function's turn, unless an
+      // earlier one failed as well.
+      if (AcquireTurn(index)) {
+        Publish(index, nullptr, &error);
+      }
+    }
+  }
+  Thread::ExitIsolateGroupAsHelper(/*bypass_safepoint=*/false);
+
+  MonitorLocker ml(&monitor_);
+  num_workers_--;
+  ml.NotifyAll();
+}
+
+bool CompileBatch::AcquireTurn(intptr_t index) {
+  Thread* const thread = Thread::Current();
+  {
+    SafepointMonitorLocker ml(&monitor_);
+    while (!aborted_ && turn_ != index) {
+      ml.Wait();
+    }
+    if (aborted_) {
+      return false;
+    }
+  }
+  // Code generation records the types used in type tests for
+  // Precompiler::AttachOptimizedTypeTestingStub.
+  if (thread->type_usage_info() == nullptr) {
+    thread->set_type_usage_info(type_usage_info_);
+  }
+  return true;
+}
+
+void CompileBatch::Turn::WillChangeProgram() {
+  if (!batch_->AcquireTurn(index_)) {
+    // An earlier function of the batch failed to compile.
+    Jump(Object::background_compilation_error());
+  }
+}
+
+void CompileBatch::Publish(intptr_t index,
+                           FlowGraphCompiler* graph_compiler,
+                           const Error* error) {
+  Thread* const thread = Thread::Current();
+  if (thread->type_usage_info() != nullptr) {
+    thread->set_type_usage_info(nullptr);
+  }
+  SafepointMonitorLocker ml(&monitor_);
+  ASSERT(turn_ == index);
+  published_ = index;
+  graph_compiler_ = graph_compiler;
+  error_ = error;
+  ml.NotifyAll();
+  // The main thread reads the results from the zone of this thread.
+  while (!aborted_ && turn_ == index) {
+    ml.Wait();
+  }
+}
+
 Obfuscator::Obfuscator(Thread* thread, const String& private_key)
     : state_(NULL) {
   auto isolate_group = thread->isolate_group();
@@ -22,6 +22,7 @@ namespace dart {
 
 // Forward declarations.
 class Class;
+class CompileBatch;
 class Error;
 class Field;
 class Function;
@@ -29,6 +30,8 @@ class GrowableObjectArray;
 class String;
 class Precompiler;
 class FlowGraph;
+class FlowGraphCompiler;
+class PrecompilerCache;
 class PrecompilerTracer;
 class RetainedReasonsWriter;
 
@@ -277,10 +280,15 @@ class Precompiler : public ValueObject {
 
   bool is_tracing() const { return is_tracing_; }
 
+  // The cache of optimized flow graphs, or null if there is none.
+  PrecompilerCache* cache() const { return cache_; }
+
   Thread* thread() const { return thread_; }
   Zone* zone() const { return zone_; }
 
  private:
+  friend class CompileBatch;
+
   static Precompiler* singleton_;
 
   // Scope which activates machine readable precompiler tracing if tracer
@@ -333,6 +341,13 @@ class Precompiler : public ValueObject {
   bool HasApiUse(const Object& obj);
 
   void ProcessFunction(const Function& function);
+  // Compiles all pending functions as a batch, with a CompileBatch or, with
+  // --precompiler_compile_threads=0, on this thread in the same order.
+  void ProcessBatch();
+  // Adds the callees of [function] compiled by a CompileBatch.
+  void FinishFunction(const Function& function,
+                      FlowGraphCompiler* graph_compiler,
+                      intptr_t gop_offset);
   void CheckForNewDynamicFunctions();
   void CollectCallbackFields();
 
@@ -413,6 +428,7 @@ class Precompiler : public ValueObject {
   Phase phase_ = Phase::kPreparation;
   PrecompilerTracer* tracer_ = nullptr;
   RetainedReasonsWriter* retained_reasons_writer_ = nullptr;
+  PrecompilerCache* cache_ = nullptr;
   bool is_tracing_ = false;
 };
 
@@ -0,0 +1,846 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/compiler/aot/precompiler_cache.h"
+
+#include "vm/bit_vector.h"
+#include "vm/class_table.h"
+#include "vm/compiler/aot/dispatch_table_generator.h"
+#include "vm/compiler/aot/precompiler.h"
+#include "vm/compiler/backend/flow_graph.h"
+#include "vm/compiler/backend/il_serializer.h"
+#include "vm/compiler/backend/inliner.h"
+#include "vm/compiler/compiler_pass.h"
+#include "vm/compiler/compiler_state.h"
+#include "vm/compiler/frontend/kernel_fingerprints.h"
+#include "vm/dart.h"
+#include "vm/datastream.h"
+#include "vm/flags.h"
+#include "vm/lockers.h"
+#include "vm/version.h"
+
+namespace dart {
+
+#if defined(DART_PRECOMPILER) && !defined(TARGET_ARCH_IA32)
+
+DEFINE_FLAG(charp,
+            precompiler_cache_dir,
+            nullptr,
+            "Directory in which the precompiler caches optimized flow graphs "
+            "for later runs.");
+
+DECLARE_FLAG(bool, trace_precompiler);
+
+// An entry starts with a header of these values:
+//
+//   kMagic, program hash, key, payload size, payload hash
+//
+// followed by the payload:
+//
+//   fingerprint of the function, dependency hash, dependencies, and as
+//   written by a FlowGraphSerializer: instruction count, call site count,
+//   inlining depth, deopt id, inlining tables, flow graph
+static constexpr uint64_t kMagic = 0x4441525449434302;  // "DARTICC" 2
+
+// Accumulates a 64-bit FNV-1a hash.
+class CacheHasher : public ValueObject {
+ public:
+  CacheHasher() : hash_(kOffsetBasis) {}
+
+  void Add(uint64_t value) {
+    for (intptr_t i = 0; i < 8; ++i) {
+      hash_ = (hash_ ^ ((value >> (i * kBitsPerByte)) & 0xff)) * kPrime;
+    }
+  }
+
+  void Add(const uint8_t* bytes, intptr_t size) {
+    Add(size);
+    for (intptr_t i = 0; i < size; ++i) {
+      hash_ = (hash_ ^ bytes[i]) * kPrime;
+    }
+  }
+
+  void Add(const char* str) {
+    if (str == nullptr) {
+      Add(uint64_t{0});
+      return;
+    }
+    Add(reinterpret_cast<const uint8_t*>(str), strlen(str));
+  }
+
+  void Add(const String& str) { Add(str.IsNull() ? 0 : str.Hash()); }
+
+  void Add(const AbstractType& type) {
+    if (type.IsNull()) {
+      Add(uint64_t{0});
+    } else if (type.IsFinalized()) {
+      Add(type.Hash());
+    } else {
+      Add(String::Handle(type.Name()));
+    }
+  }
+
+  uint64_t Finish() const { return hash_; }
+
+ private:
+  static constexpr uint64_t kOffsetBasis = 0xcbf29ce484222325;
+  static constexpr uint64_t kPrime = 0x100000001b3;
+
+  uint64_t hash_;
+
+  DISALLOW_COPY_AND_ASSIGN(CacheHasher);
+};
+
+// Identifies [function] among the functions of the same program, see
+// ComputeProgramHash. Returns false if [function] is not cached.
+static bool ComputeKey(Zone* zone, const Function& function, uint64_t* key) {
+  CacheHasher hasher;
+  hasher.Add(function.kind());
+  switch (function.kind()) {
+    case UntaggedFunction::kRegularFunction:
+    case UntaggedFunction::kGetterFunction:
+    case UntaggedFunction::kSetterFunction:
+    case UntaggedFunction::kImplicitGetter:
+    case UntaggedFunction::kImplicitSetter:
+    case UntaggedFunction::kImplicitStaticGetter:
+    case UntaggedFunction::kConstructor: {
+      const auto& owner = Class::Handle(zone, function.Owner());
+      const intptr_t index = owner.FindFunctionIndex(function);
+      if (index < 0) {
+        return false;
+      }
+      hasher.Add(owner.id());
+      hasher.Add(index);
+      break;
+    }
+    case UntaggedFunction::kFieldInitializer: {
+      const auto& field = Field::Handle(zone, function.accessor_field());
+      const auto& owner = Class::Handle(zone, field.Owner());
+      const intptr_t index = owner.FindFieldIndex(field);
+      if (index < 0) {
+        return false;
+      }
+      hasher.Add(owner.id());
+      hasher.Add(index);
+      break;
+    }
+    default:
+      return false;
+  }
+  *key = hasher.Finish();
+  return true;
+}
+
+// Computes the compilation fingerprint of the kernel [function] is built
+// from. Returns false if it is not known.
+static bool ComputeFingerprint(Zone* zone,
+                               const Function& function,
+                               uint64_t* fingerprint) {
+  using kernel::KernelSourceFingerprintHelper;
+  switch (function.kind()) {
+    case UntaggedFunction::kRegularFunction:
+    case UntaggedFunction::kGetterFunction:
+    case UntaggedFunction::kSetterFunction:
+    case UntaggedFunction::kImplicitGetter:
+    case UntaggedFunction::kImplicitSetter:
+    case UntaggedFunction::kImplicitStaticGetter:
+    case UntaggedFunction::kConstructor: {
+      if (function.KernelData() == ExternalTypedData::null() ||
+          function.kernel_offset() <= 0) {
+        return false;
+      }
+      CacheHasher hasher;
+      hasher.Add(KernelSourceFingerprintHelper::
+                     CalculateFunctionCompilationFingerprint(function));
+      if (function.IsGenerativeConstructor()) {
+        // Generative constructors also run the initializers of the fields.
+        const auto& owner = Class::Handle(zone, function.Owner());
+        const auto& fields = Array::Handle(zone, owner.fields());
+        auto& field = Field::Handle(zone);
+        for (intptr_t i = 0; i < fields.Length(); ++i) {
+          field ^= fields.At(i);
+          if (!field.is_static() && field.kernel_offset() > 0) {
+            hasher.Add(KernelSourceFingerprintHelper::
+                           CalculateFieldCompilationFingerprint(field));
+          }
+        }
+      }
+      *fingerprint = hasher.Finish();
+      return true;
+    }
+    case UntaggedFunction::kFieldInitializer: {
+      const auto& field = Field::Handle(zone, function.accessor_field());
+      if (field.KernelData() == ExternalTypedData::null() ||
+          field.kernel_offset() <= 0) {
+        return false;
+      }
+      *fingerprint =
+          KernelSourceFingerprintHelper::CalculateFieldCompilationFingerprint(
+              field);
+      return true;
+    }
+    case UntaggedFunction::kImplicitClosureFunction:
+      return ComputeFingerprint(
+          zone, Function::Handle(zone, function.parent_function()),
+          fingerprint);
+    case UntaggedFunction::kDynamicInvocationForwarder:
+      return ComputeFingerprint(
+          zone, Function::Handle(zone, function.ForwardingTarget()),
+          fingerprint);
+    case UntaggedFunction::kMethodExtractor: {
+      const auto& closure =
+          Function::Handle(zone, function.extracted_method_closure());
+      return ComputeFingerprint(
+          zone, Function::Handle(zone, closure.parent_function()),
+          fingerprint);
+    }
+    case UntaggedFunction::kInvokeFieldDispatcher:
+    case UntaggedFunction::kNoSuchMethodDispatcher:
+      // These only depend on the members of classes.
+      *fingerprint = 0;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// The classes, members and dispatch table selectors a flow graph refers to,
+// in the order in which they are first written.
+class PrecompilerCache::Dependencies
+    : public FlowGraphSerializer::ReferenceRecorder {
+ public:
+  explicit Dependencies(Zone* zone)
+      : recorded_(zone), classes_(), functions_(), fields_(), selectors_() {}
+
+  virtual void RecordClass(classid_t cid) {
+    if (Add({Reference::kClass, cid, 0})) {
+      classes_.Add(cid);
+    }
+  }
+  virtual void RecordFunction(classid_t owner_cid, intptr_t index) {
+    if (Add({Reference::kFunction, owner_cid, index})) {
+      functions_.Add(owner_cid);
+      functions_.Add(index);
+    }
+  }
+  virtual void RecordField(classid_t owner_cid, intptr_t index) {
+    if (Add({Reference::kField, owner_cid, index})) {
+      fields_.Add(owner_cid);
+      fields_.Add(index);
+    }
+  }
+  virtual void RecordSelector(int32_t id) {
+    if (Add({Reference::kSelector, id, 0})) {
+      selectors_.Add(id);
+    }
+  }
+
+  void Write(BaseWriteStream* stream) const {
+    WriteList(stream, classes_);
+    WriteList(stream, functions_);
+    WriteList(stream, fields_);
+    WriteList(stream, selectors_);
+  }
+
+  void Read(ReadStream* stream) {
+    ReadList(stream, &classes_);
+    ReadList(stream, &functions_);
+    ReadList(stream, &fields_);
+    ReadList(stream, &selectors_);
+  }
+
+  // Functions and fields take two elements, the owner and the index.
+  const GrowableArray<intptr_t>& classes() const { return classes_; }
+  const GrowableArray<intptr_t>& functions() const { return functions_; }
+  const GrowableArray<intptr_t>& fields() const { return fields_; }
+  const GrowableArray<intptr_t>& selectors() const { return selectors_; }
+
+ private:
+  bool Add(const Reference& reference) {
+    if (recorded_.HasKey(reference)) {
+      return false;
+    }
+    recorded_.Insert({reference, 0});
+    return true;
+  }
+
+  static void WriteList(BaseWriteStream* stream,
+                        const GrowableArray<intptr_t>& list) {
+    stream->Write<intptr_t>(list.length());
+    for (intptr_t i = 0; i < list.length(); ++i) {
+      stream->Write<intptr_t>(list[i]);
+    }
+  }
+
+  static void ReadList(ReadStream* stream, GrowableArray<intptr_t>* list) {
+    const intptr_t length = stream->Read<intptr_t>();
+    for (intptr_t i = 0; i < length; ++i) {
+      list->Add(stream->Read<intptr_t>());
+    }
+  }
+
+  DirectChainedHashMap<ReferenceKeyValueTrait> recorded_;
+  GrowableArray<intptr_t> classes_;
+  GrowableArray<intptr_t> functions_;
+  GrowableArray<intptr_t> fields_;
+  GrowableArray<intptr_t> selectors_;
+
+  DISALLOW_COPY_AND_ASSIGN(Dependencies);
+};
+
+PrecompilerCache::PrecompilerCache(Precompiler* precompiler)
+    : precompiler_(precompiler),
+      directory_(nullptr),
+      program_hash_(0),
+      facts_mutex_(),
+      facts_(),
+      serializer_mutex_(),
+      hits_(0),
+      misses_(0) {}
+
+PrecompilerCache::~PrecompilerCache() {
+  if (directory_ != nullptr && FLAG_trace_precompiler) {
+    THR_Print("Precompiler cache: reused %" Pd " of %" Pd " flow graphs\n",
+              hits_.load(), hits_.load() + misses_.load());
+  }
+}
+
+bool PrecompilerCache::Init(const char* directory) {
+  if (directory == nullptr) return false;
+
+  if ((Dart::file_read_callback() == nullptr) ||
+      (Dart::file_write_callback() == nullptr) ||
+      (Dart::file_open_callback() == nullptr) ||
+      (Dart::file_close_callback() == nullptr)) {
+    OS::PrintErr("warning: Could not access file callbacks.\n");
+    return false;
+  }
+
+  directory_ = directory;
+  program_hash_ = ComputeProgramHash();
+  return true;
+}
+
+uint64_t PrecompilerCache::ComputeProgramHash() {
+  Thread* thread = Thread::Current();
+  Zone* zone = thread->zone();
+  IsolateGroup* isolate_group = thread->isolate_group();
+  CacheHasher hasher;
+
+  hasher.Add(Version::SnapshotString());
+  hasher.Add(Version::String());
+  char* features = Dart::FeaturesString(isolate_group, /*is_vm_snapshot=*/false,
+                                        Snapshot::kFullAOT);
+  hasher.Add(features);
+  free(features);
+  hasher.Add(Flags::Hash("precompiler_cache_dir"));
+  hasher.Add(precompiler_->get_runtime_type_is_unique());
+
+  // The class ids and the class hierarchy, which determine the class id
+  // ranges in type tests.
+  ClassTable* class_table = isolate_group->class_table();
+  auto& cls = Class::Handle(zone);
+  auto& library = Library::Handle(zone);
+  auto& type = AbstractType::Handle(zone);
+  auto& interfaces = Array::Handle(zone);
+  auto& name = String::Handle(zone);
+  for (intptr_t cid = kIllegalCid + 1; cid < class_table->NumCids(); ++cid) {
+    if (!class_table->HasValidClassAt(cid)) {
+      continue;
+    }
+    cls = class_table->At(cid);
+    hasher.Add(cid);
+    name = cls.Name();
+    hasher.Add(name);
+    library = cls.library();
+    if (!library.IsNull()) {
+      name = library.url();
+      hasher.Add(name);
+    }
+    type = cls.super_type();
+    hasher.Add(type);
+    interfaces = cls.interfaces();
+    for (intptr_t i = 0; !interfaces.IsNull() && i < interfaces.Length();
+         ++i) {
+      type ^= interfaces.At(i);
+      hasher.Add(type);
+    }
+    hasher.Add(cls.is_abstract());
+    hasher.Add(cls.is_implemented());
+  }
+
+  return hasher.Finish();
+}
+
+bool PrecompilerCache::ComputeDependencyHash(Zone* zone,
+                                             const Dependencies& dependencies,
+                                             uint64_t* hash) {
+  CacheHasher hasher;
+  uint64_t facts;
+  const auto& classes = dependencies.classes();
+  for (intptr_t i = 0; i < classes.length(); ++i) {
+    if (!ComputeClassFacts(zone, classes[i], &facts)) {
+      return false;
+    }
+    hasher.Add(facts);
+  }
+  const auto& functions = dependencies.functions();
+  for (intptr_t i = 0; i + 1 < functions.length(); i += 2) {
+    if (!ComputeFunctionFacts(zone, functions[i], functions[i + 1], &facts)) {
+      return false;
+    }
+    hasher.Add(facts);
+  }
+  const auto& fields = dependencies.fields();
+  for (intptr_t i = 0; i + 1 < fields.length(); i += 2) {
+    if (!ComputeFieldFacts(zone, fields[i], fields[i + 1], &facts)) {
+      return false;
+    }
+    hasher.Add(facts);
+  }
+  const auto& selectors = dependencies.selectors();
+  for (intptr_t i = 0; i < selectors.length(); ++i) {
+    if (!ComputeSelectorFacts(selectors[i], &facts)) {
+      return false;
+    }
+    hasher.Add(facts);
+  }
+  *hash = hasher.Finish();
+  return true;
+}
+
+static ClassPtr ClassAt(intptr_t cid) {
+  ClassTable* class_table = IsolateGroup::Current()->class_table();
+  if (!class_table->IsValidIndex(cid) || !class_table->HasValidClassAt(cid)) {
+    return Class::null();
+  }
+  return class_table->At(cid);
+}
+
+bool PrecompilerCache::ComputeClassFacts(Zone* zone,
+                                         intptr_t cid,
+                                         uint64_t* facts) {
+  const auto& cls = Class::Handle(zone, ClassAt(cid));
+  if (cls.IsNull()) {
+    return false;
+  }
+  CacheHasher hasher;
+  hasher.Add(String::Handle(zone, cls.Name()));
+  const auto& library = Library::Handle(zone, cls.library());
+  if (!library.IsNull()) {
+    hasher.Add(String::Handle(zone, library.url()));
+  }
+  hasher.Add(cls.is_abstract());
+  hasher.Add(cls.is_finalized());
+  if (cls.is_finalized() || cls.is_prefinalized()) {
+    hasher.Add(cls.target_instance_size());
+    hasher.Add(cls.target_type_arguments_field_offset());
+  }
+  if (!cls.IsTopLevel()) {
+    ClassTable* class_table = IsolateGroup::Current()->class_table();
+    hasher.Add(class_table->GetUnboxedFieldsMapAt(cid).Value());
+  }
+  *facts = hasher.Finish();
+  return true;
+}
+
+// Hashes the subclasses and implementors of the owner of [function] which
+// override it, as calls are devirtualized when there are none.
+static void AddOverrides(Zone* zone,
+                         const Function& function,
+                         CacheHasher* hasher) {
+  Thread* thread = Thread::Current();
+  ClassTable* class_table = thread->isolate_group()->class_table();
+  const auto& name = String::Handle(zone, function.name());
+  auto& field_name = String::Handle(zone);
+  if (Field::IsGetterName(name)) {
+    field_name = Field::NameFromGetter(name);
+  } else if (Field::IsSetterName(name)) {
+    field_name = Field::NameFromSetter(name);
+  }
+
+  SafepointReadRwLocker ml(thread, thread->isolate_group()->program_lock());
+  auto& cls = Class::Handle(zone, function.Owner());
+  auto& subclasses = GrowableObjectArray::Handle(zone);
+  auto& subclass = Class::Handle(zone);
+  BitVector* visited = new (zone) BitVector(zone, class_table->NumCids());
+  GrowableArray<intptr_t> worklist;
+  worklist.Add(cls.id());
+  visited->Add(cls.id());
+  while (!worklist.is_empty()) {
+    cls = class_table->At(worklist.RemoveLast());
+    for (intptr_t pass = 0; pass < 2; ++pass) {
+      subclasses =
+          pass == 0 ? cls.direct_subclasses() : cls.direct_implementors();
+      for (intptr_t i = 0; !subclasses.IsNull() && i < subclasses.Length();
+           ++i) {
+        subclass ^= subclasses.At(i);
+        if (visited->Contains(subclass.id())) {
+          continue;
+        }
+        visited->Add(subclass.id());
+        worklist.Add(subclass.id());
+        if (!subclass.is_finalized() ||
+            subclass.LookupFunctionReadLocked(name) != Function::null() ||
+            (!field_name.IsNull() &&
+             subclass.LookupField(field_name) != Field::null())) {
+          hasher->Add(subclass.id());
+        }
+      }
+    }
+  }
+}
+
+bool PrecompilerCache::ComputeFunctionFacts(Zone* zone,
+                                            intptr_t owner_cid,
+                                            intptr_t index,
+                                            uint64_t* facts) {
+  const auto& owner = Class::Handle(zone, ClassAt(owner_cid));
+  if (owner.IsNull() || index < 0) {
+    return false;
+  }
+  const Reference key = {Reference::kFunction, owner_cid, index};
+  {
+    MutexLocker ml(&facts_mutex_);
+    if (auto* pair = facts_.Lookup(key)) {
+      *facts = pair->value;
+      return true;
+    }
+  }
+  const auto& functions = Array::Handle(zone, owner.current_functions());
+  if (functions.IsNull() || index >= functions.Length()) {
+    return false;
+  }
+  auto& function = Function::Handle(zone);
+  function ^= functions.At(index);
+
+  CacheHasher hasher;
+  hasher.Add(String::Handle(zone, function.name()));
+  hasher.Add(function.kind());
+  hasher.Add(function.is_static());
+  hasher.Add(function.is_abstract());
+  hasher.Add(function.recognized_kind());
+  hasher.Add(FunctionType::Handle(zone, function.signature()));
+  for (intptr_t i = 0; i < function.NumParameters(); ++i) {
+    hasher.Add(function.is_unboxed_integer_parameter_at(i));
+    hasher.Add(function.is_unboxed_double_parameter_at(i));
+  }
+  hasher.Add(function.has_unboxed_integer_return());
+  hasher.Add(function.has_unboxed_double_return());
+  hasher.Add(function.has_unboxed_record_return());
+  // Whether the function is inlined depends on its body.
+  uint64_t fingerprint = 0;
+  hasher.Add(ComputeFingerprint(zone, function, &fingerprint));
+  hasher.Add(fingerprint);
+  if (!function.is_static() && !function.IsGenerativeConstructor()) {
+    const compiler::TableSelector* selector =
+        precompiler_->selector_map()->GetSelector(function);
+    hasher.Add(selector == nullptr ? -1 : selector->id);
+    AddOverrides(zone, function, &hasher);
+  }
+  *facts = hasher.Finish();
+
+  MutexLocker ml(&facts_mutex_);
+  if (facts_.Lookup(key) == nullptr) {
+    facts_.Insert({key, *facts});
+  }
+  return true;
+}
+
+bool PrecompilerCache::ComputeFieldFacts(Zone* zone,
+                                         intptr_t owner_cid,
+                                         intptr_t index,
+                                         uint64_t* facts) {
+  const auto& owner = Class::Handle(zone, ClassAt(owner_cid));
+  if (owner.IsNull() || index < 0) {
+    return false;
+  }
+  const Reference key = {Reference::kField, owner_cid, index};
+  {
+    MutexLocker ml(&facts_mutex_);
+    if (auto* pair = facts_.Lookup(key)) {
+      *facts = pair->value;
+      return true;
+    }
+  }
+  const auto& fields = Array::Handle(zone, owner.fields());
+  if (fields.IsNull() || index >= fields.Length()) {
+    return false;
+  }
+  auto& field = Field::Handle(zone);
+  field ^= fields.At(index);
+
+  CacheHasher hasher;
+  hasher.Add(String::Handle(zone, field.name()));
+  hasher.Add(field.is_static());
+  hasher.Add(field.is_final());
+  hasher.Add(field.is_late());
+  hasher.Add(field.guarded_cid());
+  hasher.Add(field.is_nullable());
+  hasher.Add(field.is_unboxed());
+  hasher.Add(field.guarded_list_length());
+  hasher.Add(field.static_type_exactness_state().Encode());
+  hasher.Add(AbstractType::Handle(zone, field.type()));
+  if (!field.is_static()) {
+    hasher.Add(field.TargetOffset());
+  }
+  // The initializer is inlined into constructors and the field initializer
+  // function.
+  if (field.KernelData() != ExternalTypedData::null() &&
+      field.kernel_offset() > 0) {
+    hasher.Add(
+        kernel::KernelSourceFingerprintHelper::
+            CalculateFieldCompilationFingerprint(field));
+  }
+  *facts = hasher.Finish();
+
+  MutexLocker ml(&facts_mutex_);
+  if (facts_.Lookup(key) == nullptr) {
+    facts_.Insert({key, *facts});
+  }
+  return true;
+}
+
+bool PrecompilerCache::ComputeSelectorFacts(intptr_t id, uint64_t* facts) {
+  compiler::SelectorMap* selector_map = precompiler_->selector_map();
+  if (id < 0 || id >= selector_map->NumIds() ||
+      selector_map->GetSelector(id) == nullptr) {
+    return false;
+  }
+  const compiler::TableSelector& selector = selector_map->selectors_[id];
+  CacheHasher hasher;
+  hasher.Add(selector.offset);
+  hasher.Add(selector.called_on_null);
+  hasher.Add(selector.torn_off);
+  hasher.Add(selector.on_null_interface);
+  hasher.Add(selector.requires_args_descriptor);
+  *facts = hasher.Finish();
+  return true;
+}
+
+const char* PrecompilerCache::EntryPath(Zone* zone, uint64_t key) const {
+  return OS::SCreate(zone, "%s/%016" Px64 ".il", directory_, key);
+}
+
+bool PrecompilerCache::Lookup(CompilerPassState* state) {
+  Thread* thread = Thread::Current();
+  Zone* zone = thread->zone();
+  const Function& function = state->flow_graph()->function();
+  uint64_t key;
+  uint64_t fingerprint;
+  if (!ComputeKey(zone, function, &key) ||
+      !ComputeFingerprint(zone, function, &fingerprint)) {
+    return false;
+  }
+
+  void* file = Dart::file_open_callback()(EntryPath(zone, key),
+                                          /*write=*/false);
+  if (file == nullptr) {
+    misses_++;
+    return false;
+  }
+  uint8_t* data = nullptr;
+  intptr_t length = -1;
+  Dart::file_read_callback()(&data, &length, file);
+  Dart::file_close_callback()(file);
+  if (data == nullptr || length <= 0) {
+    free(data);
+    misses_++;
+    return false;
+  }
+  uint8_t* entry = zone->Alloc<uint8_t>(length);
+  memmove(entry, data, length);
+  free(data);
+
+  // Check that the entry is for this program and function and wasn't
+  // truncated or corrupted.
+  const intptr_t kHeaderSize = 5 * sizeof(uint64_t);
+  bool valid = length >= kHeaderSize;
+  if (valid) {
+    ReadStream header(entry, length);
+    valid = header.Read<uint64_t>() == kMagic &&
+            header.Read<uint64_t>() == program_hash_ &&
+            header.Read<uint64_t>() == key;
+    const uint64_t size = header.Read<uint64_t>();
+    const uint64_t hash = header.Read<uint64_t>();
+    if (valid && size == static_cast<uint64_t>(header.PendingBytes())) {
+      const uint8_t* payload = header.AddressOfCurrentPosition();
+      CacheHasher hasher;
+      hasher.Add(payload, size);
+      valid = hasher.Finish() == hash &&
+              ReadPayload(state, fingerprint, payload, size,
+                          /*validate=*/true);
+    } else {
+      valid = false;
+    }
+  }
+  if (valid) {
+    hits_++;
+  } else {
+    misses_++;
+  }
+  return valid;
+}
+
+const uint8_t* PrecompilerCache::Serialize(CompilerPassState* state,
+                                           intptr_t* size) {
+  Thread* thread = Thread::Current();
+  Zone* zone = thread->zone();
+  FlowGraph* flow_graph = state->flow_graph();
+  const Function& function = flow_graph->function();
+  uint64_t key = 0;
+  uint64_t fingerprint = 0;
+  bool can_cache = ComputeKey(zone, function, &key) &&
+                   ComputeFingerprint(zone, function, &fingerprint);
+
+  auto* detached_defs = new (zone) ZoneGrowableArray<Definition*>(zone, 0);
+  flow_graph->CompactSSA(detached_defs);
+
+  Dependencies dependencies(zone);
+  ZoneWriteStream graph(zone, 1024);
+  {
+    SafepointMutexLocker ml(&serializer_mutex_);
+    FlowGraphSerializer serializer(&graph);
+    serializer.set_reference_recorder(&dependencies);
+    // See FlowGraphInliner::CollectGraphInfo.
+    const bool has_counts = FlowGraphInliner::MayCacheOnFunctions();
+    serializer.Write<intptr_t>(
+        has_counts ? function.optimized_instruction_count() : 0);
+    serializer.Write<intptr_t>(
+        has_counts ? function.optimized_call_site_count() : 0);
+    serializer.Write<intptr_t>(state->inlining_depth);
+    serializer.Write<intptr_t>(thread->compiler_state().deopt_id());
+    const intptr_t inlined = state->inline_id_to_function.length();
+    serializer.Write<intptr_t>(inlined);
+    for (intptr_t i = 0; i < inlined; ++i) {
+      serializer.Write<const Function&>(*state->inline_id_to_function[i]);
+      serializer.Write<TokenPosition>(state->inline_id_to_token_pos[i]);
+      serializer.Write<intptr_t>(state->caller_inline_id[i]);
+    }
+    serializer.WriteFlowGraph(*flow_graph, *detached_defs);
+    can_cache = can_cache && !serializer.has_process_local_refs();
+  }
+
+  uint64_t dependency_hash = 0;
+  can_cache = can_cache &&
+              ComputeDependencyHash(zone, dependencies, &dependency_hash);
+
+  ZoneWriteStream payload(zone, graph.bytes_written() + 256);
+  payload.Write<uint64_t>(fingerprint);
+  payload.Write<uint64_t>(dependency_hash);
+  dependencies.Write(&payload);
+  payload.WriteBytes(graph.buffer(), graph.bytes_written());
+
+  if (!ReadPayload(state, fingerprint, payload.buffer(),
+                   payload.bytes_written(), /*validate=*/false)) {
+    UNREACHABLE();
+  }
+  if (!can_cache) {
+    return nullptr;
+  }
+
+  CacheHasher hasher;
+  hasher.Add(payload.buffer(), payload.bytes_written());
+  ZoneWriteStream entry(zone, payload.bytes_written() + 64);
+  entry.Write<uint64_t>(kMagic);
+  entry.Write<uint64_t>(program_hash_);
+  entry.Write<uint64_t>(key);
+  entry.Write<uint64_t>(payload.bytes_written());
+  entry.Write<uint64_t>(hasher.Finish());
+  entry.WriteBytes(payload.buffer(), payload.bytes_written());
+  *size = entry.bytes_written();
+  return entry.buffer();
+}
+
+void PrecompilerCache::Insert(const Function& function,
+                              const uint8_t* entry,
+                              intptr_t size) {
+  Zone* zone = Thread::Current()->zone();
+  uint64_t key;
+  if (!ComputeKey(zone, function, &key)) {
+    UNREACHABLE();
+  }
+  const char* path = EntryPath(zone, key);
+  const char* temp_path =
+      OS::SCreate(zone, "%s.%" Pd ".tmp", path, OS::ProcessId());
+  void* file = Dart::file_open_callback()(temp_path, /*write=*/true);
+  if (file == nullptr) {
+    return;
+  }
+  Dart::file_write_callback()(entry, size, file);
+  Dart::file_close_callback()(file);
+  if (Utils::Rename(temp_path, path) != 0) {
+    Utils::Unlink(temp_path);
+  }
+}
+
+bool PrecompilerCache::ReadPayload(CompilerPassState* state,
+                                   uint64_t fingerprint,
+                                   const uint8_t* payload,
+                                   intptr_t size,
+                                   bool validate) {
+  Thread* thread = Thread::Current();
+  Zone* zone = thread->zone();
+  const ParsedFunction& parsed_function =
+      state->flow_graph()->parsed_function();
+  const Function& function = parsed_function.function();
+
+  ReadStream stream(payload, size);
+  if (stream.Read<uint64_t>() != fingerprint) {
+    return false;
+  }
+  const uint64_t expected_dependency_hash = stream.Read<uint64_t>();
+  Dependencies dependencies(zone);
+  dependencies.Read(&stream);
+  // All references in the flow graph must be valid before it is read.
+  uint64_t dependency_hash;
+  if (validate &&
+      (!ComputeDependencyHash(zone, dependencies, &dependency_hash) ||
+       dependency_hash != expected_dependency_hash)) {
+    return false;
+  }
+
+  FlowGraphDeserializer deserializer(parsed_function, &stream);
+  const intptr_t instruction_count = deserializer.Read<intptr_t>();
+  const intptr_t call_site_count = deserializer.Read<intptr_t>();
+  const intptr_t inlining_depth = deserializer.Read<intptr_t>();
+  const intptr_t deopt_id = deserializer.Read<intptr_t>();
+  const intptr_t inlined = deserializer.Read<intptr_t>();
+  GrowableArray<const Function*> inline_id_to_function(inlined);
+  GrowableArray<TokenPosition> inline_id_to_token_pos(inlined);
+  GrowableArray<intptr_t> caller_inline_id(inlined);
+  for (intptr_t i = 0; i < inlined; ++i) {
+    inline_id_to_function.Add(&Function::ZoneHandle(
+        zone, deserializer.Read<const Function&>().ptr()));
+    inline_id_to_token_pos.Add(deserializer.Read<TokenPosition>());
+    caller_inline_id.Add(deserializer.Read<intptr_t>());
+  }
+  FlowGraph* flow_graph = deserializer.ReadFlowGraph();
+
+  // Restore what the pipeline leaves behind besides the flow graph.
+  state->set_flow_graph(flow_graph);
+  state->inlining_depth = inlining_depth;
+  state->inline_id_to_function.Clear();
+  state->inline_id_to_token_pos.Clear();
+  state->caller_inline_id.Clear();
+  for (intptr_t i = 0; i < inlined; ++i) {
+    state->inline_id_to_function.Add(inline_id_to_function[i]);
+    state->inline_id_to_token_pos.Add(inline_id_to_token_pos[i]);
+    state->caller_inline_id.Add(caller_inline_id[i]);
+  }
+  function.set_inlining_depth(inlining_depth);
+  if (FlowGraphInliner::MayCacheOnFunctions() && instruction_count > 0) {
+    function.SetOptimizedInstructionCountClamped(instruction_count);
+    function.SetOptimizedCallSiteCountClamped(call_site_count);
+  }
+  CompilerState& compiler_state = thread->compiler_state();
+  if (deopt_id > compiler_state.deopt_id()) {
+    compiler_state.set_deopt_id(deopt_id);
+  }
+  return true;
+}
+
+#endif  // defined(DART_PRECOMPILER) && !defined(TARGET_ARCH_IA32)
+
+}  // namespace dart
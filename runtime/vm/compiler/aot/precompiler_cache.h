@@ -0,0 +1,160 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef RUNTIME_VM_COMPILER_AOT_PRECOMPILER_CACHE_H_
+#define RUNTIME_VM_COMPILER_AOT_PRECOMPILER_CACHE_H_
+
+#if defined(DART_PRECOMPILED_RUNTIME)
+#error "AOT runtime should not use compiler sources (including header files)"
+#endif  // defined(DART_PRECOMPILED_RUNTIME)
+
+#include "platform/atomic.h"
+#include "vm/allocation.h"
+#include "vm/hash_map.h"
+#include "vm/object.h"
+#include "vm/os_thread.h"
+
+namespace dart {
+
+// Forward declarations.
+class CompilerPassState;
+class Precompiler;
+
+// An on-disk cache of optimized flow graphs, which allows the precompiler
+// to skip the optimization pipeline of functions which did not change since
+// an earlier run.
+//
+// An entry holds the flow graph of a function after register allocation as
+// written by the FlowGraphSerializer, together with the inlining tables of
+// its compilation. Entries are found by the function and are only used with
+// the same hash of the VM version, the flags and the class hierarchy, which
+// class ids and type tests depend on. There is one entry per function, which
+// is replaced when the function is compiled for a different hash, so entries
+// of earlier programs don't accumulate.
+//
+// An entry also lists the classes, members and dispatch table selectors the
+// flow graph refers to, and is only used if what the optimizer knew about
+// them is unchanged: the compilation fingerprints of the function and of
+// the functions it inlines or calls (see KernelSourceFingerprintHelper),
+// their signatures, unboxing and overrides, the guards of fields, the
+// layout of classes and the dispatch table offsets. Changes elsewhere in
+// the program don't affect the entry.
+//
+// Flow graphs which refer to closure functions are not cached, as those can
+// only be identified within the process.
+class PrecompilerCache : public ValueObject {
+ public:
+  explicit PrecompilerCache(Precompiler* precompiler);
+  ~PrecompilerCache();
+
+  // Uses the cache in [directory], which must exist. Returns false if there
+  // is no directory or it can't be accessed.
+  bool Init(const char* directory);
+
+  // Replaces the flow graph of [state], which was just built, with the
+  // optimized flow graph cached for its function and restores the inlining
+  // state of the compilation. Returns false if there is no valid entry.
+  bool Lookup(CompilerPassState* state);
+
+  // Serializes the optimized flow graph of [state] and replaces it with the
+  // graph read back, so that the code generated after a hit is the same.
+  // Returns the entry to pass to Insert once the function is compiled, or
+  // null if the flow graph can't be cached.
+  const uint8_t* Serialize(CompilerPassState* state, intptr_t* size);
+
+  // Writes the entry returned by Serialize for [function]. The entry is
+  // written to a file of its own which is then renamed into place, so that
+  // concurrent runs sharing the directory never read a partial entry.
+  void Insert(const Function& function, const uint8_t* entry, intptr_t size);
+
+ private:
+  class Dependencies;
+
+  // A class, member or dispatch table selector of the program. Members are
+  // identified by the id of their owner and their index in it.
+  struct Reference {
+    enum Kind { kClass, kFunction, kField, kSelector };
+    Kind kind;
+    intptr_t id;
+    intptr_t index;
+
+    bool operator==(const Reference& other) const {
+      return kind == other.kind && id == other.id && index == other.index;
+    }
+  };
+
+  class ReferenceKeyValueTrait {
+   public:
+    typedef Reference Key;
+    typedef uint64_t Value;
+
+    struct Pair {
+      Key key;
+      Value value;
+      Pair() : key({Reference::kClass, 0, 0}), value(0) {}
+      Pair(const Key& key, Value value) : key(key), value(value) {}
+      Pair(const Pair& other) = default;
+      Pair& operator=(const Pair&) = default;
+    };
+
+    static Key KeyOf(const Pair& kv) { return kv.key; }
+    static Value ValueOf(const Pair& kv) { return kv.value; }
+    static uword Hash(const Key& key) {
+      return CombineHashes(CombineHashes(key.kind, key.id), key.index);
+    }
+    static bool IsKeyEqual(const Pair& kv, const Key& key) {
+      return kv.key == key;
+    }
+  };
+
+  uint64_t ComputeProgramHash();
+  const char* EntryPath(Zone* zone, uint64_t key) const;
+
+  // Hash what the optimizer knows about the referenced parts of the
+  // program. Return false if a reference is not valid in this program.
+  bool ComputeDependencyHash(Zone* zone,
+                             const Dependencies& dependencies,
+                             uint64_t* hash);
+  bool ComputeClassFacts(Zone* zone, intptr_t cid, uint64_t* facts);
+  bool ComputeFunctionFacts(Zone* zone,
+                            intptr_t owner_cid,
+                            intptr_t index,
+                            uint64_t* facts);
+  bool ComputeFieldFacts(Zone* zone,
+                         intptr_t owner_cid,
+                         intptr_t index,
+                         uint64_t* facts);
+  bool ComputeSelectorFacts(intptr_t id, uint64_t* facts);
+
+  // Reads the compilation of the function of [state] from [payload].
+  // Validates the dependencies of the flow graph if [validate].
+  bool ReadPayload(CompilerPassState* state,
+                   uint64_t fingerprint,
+                   const uint8_t* payload,
+                   intptr_t size,
+                   bool validate);
+
+  Precompiler* const precompiler_;
+  const char* directory_;
+  uint64_t program_hash_;
+
+  // The facts of functions and fields, which don't change while the
+  // precompiler generates code. Computing them involves the kernel of the
+  // member and, for overrides, all of its subclasses.
+  Mutex facts_mutex_;
+  MallocDirectChainedHashMap<ReferenceKeyValueTrait> facts_;
+
+  // The FlowGraphSerializer uses the object id table of the heap, so only
+  // one flow graph can be written at a time.
+  Mutex serializer_mutex_;
+
+  RelaxedAtomic<intptr_t> hits_;
+  RelaxedAtomic<intptr_t> misses_;
+
+  DISALLOW_COPY_AND_ASSIGN(PrecompilerCache);
+};
+
+}  // namespace dart
+
+#endif  // RUNTIME_VM_COMPILER_AOT_PRECOMPILER_CACHE_H_
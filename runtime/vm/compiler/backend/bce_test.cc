@@ -10,6 +10,8 @@
 #include "vm/compiler/backend/il.h"
 #include "vm/compiler/backend/il_printer.h"
 #include "vm/compiler/backend/il_test_helper.h"
+#include "vm/compiler/backend/loop_versioner.h"
+#include "vm/compiler/backend/loops.h"
 #include "vm/compiler/compiler_pass.h"
 #include "vm/object.h"
 #include "vm/unit_test.h"
@@ -63,6 +65,74 @@ static std::pair<intptr_t, intptr_t> ApplyBCE(const char* script_chars,
   return {num_bc_before, num_bc_after};
 }
 
+// Helper method to count number of loops without bounds checks.
+static intptr_t CountUncheckedLoops(FlowGraph* flow_graph) {
+  const LoopHierarchy& loop_hierarchy = flow_graph->GetLoopHierarchy();
+  intptr_t count = 0;
+  for (auto header : loop_hierarchy.headers()) {
+    bool checked = false;
+    for (BitVector::Iterator block_it(header->loop_info()->blocks());
+         !block_it.Done(); block_it.Advance()) {
+      BlockEntryInstr* block = flow_graph->preorder()[block_it.Current()];
+      for (ForwardInstructionIterator it(block); !it.Done(); it.Advance()) {
+        checked = checked || it.Current()->IsCheckBoundBase();
+      }
+    }
+    if (!checked) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Helper method to check that each phi input of a loop header is defined
+// in a block which dominates the predecessor it comes from, so that the
+// checked loop resumes from the index reached by the unchecked one.
+static void CheckLoopEntries(FlowGraph* flow_graph) {
+  const auto& headers = flow_graph->GetLoopHierarchy().headers();
+  for (intptr_t i = 0; i < headers.length(); ++i) {
+    JoinEntryInstr* header = headers[i]->AsJoinEntry();
+    for (PhiIterator it(header); !it.Done(); it.Advance()) {
+      PhiInstr* phi = it.Current();
+      for (intptr_t j = 0; j < phi->InputCount(); ++j) {
+        EXPECT(phi->InputAt(j)->definition()->GetBlock()->Dominates(
+            header->PredecessorAt(j)));
+      }
+    }
+  }
+}
+
+// Helper method to build CFG, run BCE and loop versioning, and count
+// number of loops and of loops without bounds checks.
+static std::pair<intptr_t, intptr_t> ApplyLoopVersioning(
+    const char* script_chars) {
+  const auto& root_library = Library::Handle(LoadTestScript(script_chars));
+  Invoke(root_library, "main");
+  std::initializer_list<CompilerPass::Id> passes = {
+      CompilerPass::kComputeSSA,
+      CompilerPass::kTypePropagation,
+      CompilerPass::kApplyICData,
+      CompilerPass::kInlining,
+      CompilerPass::kTypePropagation,
+      CompilerPass::kApplyICData,
+      CompilerPass::kSelectRepresentations,
+      CompilerPass::kCanonicalize,
+      CompilerPass::kConstantPropagation,
+      CompilerPass::kCSE,
+      CompilerPass::kLICM,
+  };
+  const auto& function = Function::Handle(GetFunction(root_library, "foo"));
+  TestPipeline pipeline(function, CompilerPass::kJIT);
+  FlowGraph* flow_graph = pipeline.RunPasses(passes);
+  RangeAnalysis range_analysis(flow_graph);
+  range_analysis.Analyze();
+  LoopVersioner versioner(flow_graph);
+  versioner.Version();
+  CheckLoopEntries(flow_graph);
+  return {flow_graph->GetLoopHierarchy().num_loops(),
+          CountUncheckedLoops(flow_graph)};
+}
+
 static void TestScriptJIT(const char* script_chars,
                           intptr_t expected_before,
                           intptr_t expected_after) {
@@ -71,6 +141,14 @@ static void TestScriptJIT(const char* script_chars,
   EXPECT_EQ(expected_after, jit_result.second);
 }
 
+static void TestLoopVersioningJIT(const char* script_chars,
+                                  intptr_t expected_loops,
+                                  intptr_t expected_unchecked_loops) {
+  auto jit_result = ApplyLoopVersioning(script_chars);
+  EXPECT_EQ(expected_loops, jit_result.first);
+  EXPECT_EQ(expected_unchecked_loops, jit_result.second);
+}
+
 //
 // BCE (bounds-check-elimination) tests.
 //
@@ -294,4 +372,59 @@ ISOLATE_UNIT_TEST_CASE(BCEListNamedAndPlainLength) {
   TestScriptJIT(kScriptChars, 2, 0);
 }
 
+//
+// Loop versioning tests.
+//
+
+ISOLATE_UNIT_TEST_CASE(BCEVersionLoop) {
+  const char* kScriptChars =
+      R"(
+      import 'dart:typed_data';
+      foo(Float64List l, int n) {
+        for (int i = 0; i < n; i++) {
+          l[i] = 0;
+        }
+      }
+      main() {
+        foo(new Float64List(100), 100);
+      }
+    )";
+  // The limit n is unrelated to the length, so the check stays in the
+  // original loop, but not in its unchecked version.
+  TestScriptJIT(kScriptChars, 1, 1);
+  TestLoopVersioningJIT(kScriptChars, 2, 1);
+}
+
+ISOLATE_UNIT_TEST_CASE(BCEVersionLoopWithOffsets) {
+  const char* kScriptChars =
+      R"(
+      import 'dart:typed_data';
+      foo(Float64List a, Float64List b, int n) {
+        for (int i = 1; i < n; i++) {
+          a[i - 1] = b[i] + b[i + 1];
+        }
+      }
+      main() {
+        foo(new Float64List(100), new Float64List(101), 100);
+      }
+    )";
+  TestLoopVersioningJIT(kScriptChars, 2, 1);
+}
+
+ISOLATE_UNIT_TEST_CASE(BCEDoNotVersionScaledIndex) {
+  const char* kScriptChars =
+      R"(
+      import 'dart:typed_data';
+      foo(Float64List l, int n) {
+        for (int i = 0; i < n; i++) {
+          l[2 * i] = 0;
+        }
+      }
+      main() {
+        foo(new Float64List(100), 50);
+      }
+    )";
+  TestLoopVersioningJIT(kScriptChars, 1, 0);
+}
+
 }  // namespace dart
@@ -420,6 +420,9 @@ void FlowGraphSerializer::WriteTrait<const Class&>::Write(
     s->Write<classid_t>(kIllegalCid);
     return;
   }
+  if (s->reference_recorder_ != nullptr) {
+    s->reference_recorder_->RecordClass(x.id());
+  }
   s->Write<classid_t>(x.id());
 }
 
@@ -793,6 +796,9 @@ void FlowGraphSerializer::WriteTrait<const Function&>::Write(
       const intptr_t function_index = owner.FindFunctionIndex(x);
       ASSERT(function_index >= 0);
       s->Write<intptr_t>(function_index);
+      if (s->reference_recorder_ != nullptr) {
+        s->reference_recorder_->RecordFunction(owner.id(), function_index);
+      }
       return;
     }
     case UntaggedFunction::kImplicitClosureFunction: {
@@ -811,6 +817,7 @@ void FlowGraphSerializer::WriteTrait<const Function&>::Write(
       // We need to serialize kernel offset and re-create
       // closure functions when reading as needed.
       s->Write<intptr_t>(ClosureFunctionsCache::FindClosureIndex(x));
+      s->has_process_local_refs_ = true;
       return;
     case UntaggedFunction::kMethodExtractor: {
       Function& function = Function::Handle(zone, x.extracted_method_closure());
@@ -1511,6 +1518,9 @@ void FlowGraphSerializer::WriteObjectImpl(const Object& x,
       const intptr_t field_index = owner.FindFieldIndex(field);
       ASSERT(field_index >= 0);
       Write<intptr_t>(field_index);
+      if (reference_recorder_ != nullptr) {
+        reference_recorder_->RecordField(owner.id(), field_index);
+      }
       break;
     }
     case kFunctionCid:
@@ -2312,6 +2322,9 @@ void FlowGraphSerializer::WriteTrait<const compiler::TableSelector*>::Write(
     const compiler::TableSelector* x) {
 #if defined(DART_PRECOMPILER)
   ASSERT(x != nullptr);
+  if (s->reference_recorder_ != nullptr) {
+    s->reference_recorder_->RecordSelector(x->id);
+  }
   s->Write<int32_t>(x->id);
 #else
   UNREACHABLE();
@@ -146,6 +146,18 @@ class NativeCallingConvention;
 //
 class FlowGraphSerializer : public ValueObject {
  public:
+  // Receives the references to classes, members and dispatch table
+  // selectors of the program as they are written. Functions and fields are
+  // identified by their owner and their index in it.
+  class ReferenceRecorder {
+   public:
+    virtual ~ReferenceRecorder() {}
+    virtual void RecordClass(classid_t cid) = 0;
+    virtual void RecordFunction(classid_t owner_cid, intptr_t index) = 0;
+    virtual void RecordField(classid_t owner_cid, intptr_t index) = 0;
+    virtual void RecordSelector(int32_t id) = 0;
+  };
+
   explicit FlowGraphSerializer(NonStreamingWriteStream* stream);
   ~FlowGraphSerializer();
 
@@ -304,6 +316,14 @@ class FlowGraphSerializer : public ValueObject {
   Heap* heap() const { return heap_; }
   bool can_write_refs() const { return can_write_refs_; }
 
+  // Returns true if the written flow graph refers to objects in a way which
+  // is only valid in the current process, so it can't be read by another.
+  bool has_process_local_refs() const { return has_process_local_refs_; }
+
+  void set_reference_recorder(ReferenceRecorder* recorder) {
+    reference_recorder_ = recorder;
+  }
+
  private:
   void WriteObjectImpl(const Object& x, intptr_t cid, intptr_t object_index);
 
@@ -340,6 +360,8 @@ class FlowGraphSerializer : public ValueObject {
   intptr_t object_counter_ = 0;
   bool can_write_refs_ = false;
   bool writing_recursive_type_ = false;
+  bool has_process_local_refs_ = false;
+  ReferenceRecorder* reference_recorder_ = nullptr;
 };
 
 // Deserializes flow graph.
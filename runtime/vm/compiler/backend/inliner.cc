@@ -1243,7 +1243,9 @@ class CallSiteInliner : public ValueObject {
     // Abort if this function has deoptimized too much.
     if (function.deoptimization_counter() >=
         FLAG_max_deoptimization_counter_threshold) {
-      function.set_is_inlinable(false);
+      if (FlowGraphInliner::MayCacheOnFunctions()) {
+        function.set_is_inlinable(false);
+      }
       TRACE_INLINING(THR_Print("     Bailout: deoptimization threshold\n"));
       PRINT_INLINING_TREE("Deoptimization threshold exceeded",
                           &call_data->caller, &function, call_data->call);
@@ -1427,7 +1429,9 @@ class CallSiteInliner : public ValueObject {
           if (!AdjustForOptionalParameters(
                   *parsed_function, first_actual_param_index, argument_names,
                   arguments, param_stubs, callee_graph)) {
-            function.set_is_inlinable(false);
+            if (FlowGraphInliner::MayCacheOnFunctions()) {
+              function.set_is_inlinable(false);
+            }
             TRACE_INLINING(THR_Print("     Bailout: optional arg mismatch\n"));
             PRINT_INLINING_TREE("Optional arg mismatch", &call_data->caller,
                                 &function, call_data->call);
@@ -1539,7 +1543,8 @@ class CallSiteInliner : public ValueObject {
               // Will keep trying to inline the function if it can be
               // specialized based on argument types.
               if (!FlowGraphInliner::FunctionHasAlwaysConsiderInliningPragma(
-                      function)) {
+                      function) &&
+                  FlowGraphInliner::MayCacheOnFunctions()) {
                 function.set_is_inlinable(false);
                 TRACE_INLINING(THR_Print("     Mark not inlinable\n"));
               }
@@ -2547,6 +2552,16 @@ FlowGraphInliner::FlowGraphInliner(
       speculative_policy_(speculative_policy),
       precompiler_(precompiler) {}
 
+bool FlowGraphInliner::MayCacheOnFunctions() {
+  if (!CompilerState::Current().is_aot()) {
+    return true;
+  }
+  Precompiler* precompiler = Precompiler::Instance();
+  return (precompiler == nullptr) ||
+         (precompiler->phase() !=
+          Precompiler::Phase::kFixpointCodeGeneration);
+}
+
 void FlowGraphInliner::CollectGraphInfo(FlowGraph* flow_graph,
                                         intptr_t constants_count,
                                         bool force,
@@ -2574,6 +2589,11 @@ void FlowGraphInliner::CollectGraphInfo(FlowGraph* flow_graph,
   if (force || (function.optimized_instruction_count() == 0)) {
     GraphInfoCollector info;
     info.Collect(*flow_graph);
+    if (!MayCacheOnFunctions()) {
+      *instruction_count = info.instruction_count();
+      *call_site_count = info.call_site_count();
+      return;
+    }
     function.SetOptimizedInstructionCountClamped(info.instruction_count());
     function.SetOptimizedCallSiteCountClamped(info.call_site_count());
   }
@@ -119,6 +119,13 @@ class FlowGraphInliner : ValueObject {
 
   static void SetInliningId(FlowGraph* flow_graph, intptr_t inlining_id);
 
+  // Whether what is learned about a function while inlining it may be cached
+  // on the Function. The precompiler doesn't while it compiles the program,
+  // possibly on several threads, so that inlining decisions depend neither
+  // on the order in which functions are compiled nor on the number of
+  // threads. The counts cached for constructors beforehand are still used.
+  static bool MayCacheOnFunctions();
+
   bool AlwaysInline(const Function& function);
 
   static bool FunctionHasPreferInlinePragma(const Function& function);
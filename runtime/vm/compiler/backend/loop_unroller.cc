@@ -0,0 +1,634 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/compiler/backend/loop_unroller.h"
+
+#include "vm/bit_vector.h"
+#include "vm/compiler/backend/flow_graph.h"
+#include "vm/compiler/backend/loops.h"
+#include "vm/compiler/backend/range_analysis.h"
+
+namespace dart {
+
+DEFINE_FLAG(bool, loop_unrolling, true, "Unroll small counted loops.");
+DEFINE_FLAG(int,
+            loop_unroll_factor,
+            4,
+            "Maximum number of copies of a loop body made by loop unrolling.");
+DEFINE_FLAG(int,
+            loop_unroll_budget,
+            64,
+            "Maximum number of instructions in the body of an unrolled loop.");
+
+// Quick access to the locally defined zone() method.
+#define Z (zone_)
+
+LoopUnroller::LoopUnroller(FlowGraph* flow_graph)
+    : flow_graph_(flow_graph), zone_(flow_graph->zone()), map_() {}
+
+void LoopUnroller::Optimize(FlowGraph* flow_graph) {
+  if (!FLAG_loop_unrolling || FLAG_loop_unroll_factor < 2) {
+    return;
+  }
+  // The entry of an OSR graph jumps into the middle of a loop.
+  if (flow_graph->IsCompiledForOsr()) {
+    return;
+  }
+  LoopUnroller unroller(flow_graph);
+  unroller.Unroll();
+}
+
+bool LoopUnroller::Unroll() {
+  const LoopHierarchy& loop_hierarchy = flow_graph_->GetLoopHierarchy();
+  if (loop_hierarchy.num_loops() == 0) {
+    return false;
+  }
+  loop_hierarchy.ComputeInduction();
+
+  // Innermost loops are disjoint, so all of them can be analyzed before
+  // any of them is changed.
+  GrowableArray<Candidate> candidates;
+  const ZoneGrowableArray<BlockEntryInstr*>& headers =
+      loop_hierarchy.headers();
+  for (intptr_t i = 0; i < headers.length(); ++i) {
+    Candidate candidate;
+    if (IsCandidate(headers[i]->loop_info(), &candidate)) {
+      candidates.Add(candidate);
+    }
+  }
+  if (candidates.is_empty()) {
+    return false;
+  }
+
+  map_.FillWith(nullptr, 0, flow_graph_->current_ssa_temp_index());
+  for (intptr_t i = 0; i < candidates.length(); ++i) {
+    UnrollLoop(candidates[i]);
+  }
+
+  // The loops gained blocks and their headers gained predecessors.
+  flow_graph_->DiscoverBlocks();
+  GrowableArray<BitVector*> dominance_frontier;
+  flow_graph_->ComputeDominators(&dominance_frontier);
+  return true;
+}
+
+bool LoopUnroller::IsCandidate(LoopInfo* loop, Candidate* candidate) {
+  if (loop->inner() != nullptr || loop->back_edges().length() != 1) {
+    return false;
+  }
+  JoinEntryInstr* header = loop->header()->AsJoinEntry();
+  if (header == nullptr || header->try_index() != kInvalidTryIndex ||
+      header->PredecessorCount() != 2) {
+    return false;
+  }
+  intptr_t num_blocks = 0;
+  for (BitVector::Iterator it(loop->blocks()); !it.Done(); it.Advance()) {
+    num_blocks++;
+  }
+  if (num_blocks != 2) {
+    return false;
+  }
+
+  // The pre-header comes first among the predecessors of the header, which
+  // the phi inputs replaced below rely on.
+  BlockEntryInstr* pre_header = header->PredecessorAt(0);
+  if (loop->Contains(pre_header) || !pre_header->last_instruction()->IsGoto()) {
+    return false;
+  }
+  TargetEntryInstr* body = loop->back_edges()[0]->AsTargetEntry();
+  if (body == nullptr) {
+    return false;
+  }
+  ASSERT(body->last_instruction()->AsGoto()->successor() == header);
+
+  // The header holds nothing but phis, the stack overflow check and the
+  // exit branch.
+  Instruction* current = header->next();
+  CheckStackOverflowInstr* check = current->AsCheckStackOverflow();
+  if (check != nullptr) {
+    current = current->next();
+  }
+  BranchInstr* branch = current->AsBranch();
+  if (branch == nullptr || branch->true_successor() != body) {
+    return false;
+  }
+
+  candidate->loop = loop;
+  candidate->header = header;
+  candidate->body = body;
+  candidate->pre_header = pre_header;
+  candidate->check = check;
+  candidate->branch = branch;
+  if (!IsCountedExit(loop, candidate)) {
+    return false;
+  }
+
+  return Accept(candidate);
+}
+
+bool LoopUnroller::IsCountedExit(LoopInfo* loop, Candidate* candidate) {
+  RelationalOpInstr* compare =
+      candidate->branch->comparison()->AsRelationalOp();
+  if (compare == nullptr) {
+    return false;
+  }
+  if (compare->operation_cid() == kSmiCid) {
+    candidate->representation = kTagged;
+  } else if (compare->operation_cid() == kMintCid) {
+    candidate->representation = kUnboxedInt64;
+  } else {
+    return false;
+  }
+  Definition* left = compare->left()->definition();
+  Definition* right = compare->right()->definition();
+  Token::Kind kind = compare->kind();
+  if (loop->IsHeaderPhi(left)) {
+    candidate->index = left->AsPhi();
+    candidate->index_is_left = true;
+    candidate->limit = right;
+  } else if (loop->IsHeaderPhi(right)) {
+    candidate->index = right->AsPhi();
+    candidate->index_is_left = false;
+    candidate->limit = left;
+    kind = Token::FlipComparison(kind);
+  } else {
+    return false;
+  }
+  if (loop->Contains(candidate->limit->GetBlock())) {
+    return false;
+  }
+
+  InductionVar* induc = loop->LookupInduction(candidate->index);
+  if (!InductionVar::IsLinear(induc, &candidate->stride)) {
+    return false;
+  }
+  switch (candidate->stride) {
+    case 1:
+      return kind == Token::kLT || kind == Token::kLTE;
+    case -1:
+      return kind == Token::kGT || kind == Token::kGTE;
+    default:
+      return false;
+  }
+}
+
+bool LoopUnroller::Accept(Candidate* candidate) {
+  for (auto instr : candidate->body->instructions()) {
+    if (!instr->IsGoto() && !CanCopy(instr)) {
+      return false;
+    }
+  }
+  candidate->factor = ChooseFactor(*candidate);
+  if (candidate->factor < 2) {
+    return false;
+  }
+
+  // The limit of the unrolled loop is moved towards the initial value by
+  // (factor - 1) strides, which must not overflow.
+  const Representation rep = candidate->representation;
+  const int64_t min = rep == kTagged ? compiler::target::kSmiMin : kMinInt64;
+  const int64_t max = rep == kTagged ? compiler::target::kSmiMax : kMaxInt64;
+  const int64_t delta = (candidate->factor - 1) * candidate->stride;
+  Definition* limit = candidate->limit;
+  if (rep == kTagged && limit->Type()->ToCid() != kSmiCid) {
+    return false;
+  }
+  if (limit->IsConstant()) {
+    const Object& value = limit->AsConstant()->value();
+    if (!value.IsInteger()) {
+      return false;
+    }
+    const int64_t n = Integer::Cast(value).AsInt64Value();
+    if (delta > 0 ? n < min + delta : n > max + delta) {
+      return false;
+    }
+    // Don't bother if the unrolled loop would not run at all.
+    int64_t initial;
+    InductionVar* induc = candidate->loop->LookupInduction(candidate->index);
+    if (InductionVar::IsConstant(induc->initial(), &initial) &&
+        (n - initial) * candidate->stride <= delta * candidate->stride) {
+      return false;
+    }
+    return true;
+  }
+  return delta > 0 ? RangeUtils::IsWithin(limit->range(), min + delta, max)
+                   : RangeUtils::IsWithin(limit->range(), min, max + delta);
+}
+
+intptr_t LoopUnroller::ChooseFactor(const Candidate& candidate) {
+  intptr_t size = 0;
+  for (auto instr : candidate.body->instructions()) {
+    if (!instr->IsGoto()) {
+      size++;
+    }
+  }
+  intptr_t factor = FLAG_loop_unroll_factor;
+  while (factor > 1 && factor * size > FLAG_loop_unroll_budget) {
+    factor--;
+  }
+  return factor;
+}
+
+bool LoopUnroller::CanCopy(Instruction* instr) {
+  if (BinaryIntegerOpInstr* op = instr->AsBinaryIntegerOp()) {
+    // The range of a non-constant right operand of these is not copied.
+    if (op->IsBinarySmiOp()) {
+      switch (op->op_kind()) {
+        case Token::kSHL:
+        case Token::kSHR:
+        case Token::kUSHR:
+        case Token::kMOD:
+        case Token::kTRUNCDIV:
+          return op->right()->BindsToConstant();
+        default:
+          return true;
+      }
+    }
+    return true;
+  }
+  if (LoadFieldInstr* load = instr->AsLoadField()) {
+    return !load->calls_initializer();
+  }
+  return instr->IsBinaryDoubleOp() || instr->IsLoadIndexed() ||
+         instr->IsStoreIndexed() || instr->IsLoadUntagged() ||
+         instr->IsCheckWritable() || instr->IsBox() || instr->IsUnbox() ||
+         instr->IsIntConverter();
+}
+
+Instruction* LoopUnroller::Copy(Instruction* instr) {
+  ASSERT(CanCopy(instr));
+  auto input = [&](intptr_t i) -> Value* {
+    return new (Z) Value(Lookup(instr->InputAt(i)->definition()));
+  };
+  const intptr_t deopt_id = instr->GetDeoptId();
+
+  if (BinaryIntegerOpInstr* op = instr->AsBinaryIntegerOp()) {
+    BinaryIntegerOpInstr* copy;
+    if (op->IsBinaryInt64Op()) {
+      // Make doesn't pass the speculative mode on to these.
+      copy = new (Z)
+          BinaryInt64OpInstr(op->op_kind(), input(0), input(1), deopt_id,
+                             op->SpeculativeModeOfInput(0));
+    } else {
+      copy = BinaryIntegerOpInstr::Make(
+          op->representation(), op->op_kind(), input(0), input(1), deopt_id,
+          op->can_overflow(), op->is_truncating(), /*range=*/nullptr,
+          op->SpeculativeModeOfInput(0));
+    }
+    if (ShiftIntegerOpInstr* shift = op->AsShiftIntegerOp()) {
+      copy->AsShiftIntegerOp()->set_shift_range(shift->shift_range());
+    }
+    return copy;
+  }
+  if (BinaryDoubleOpInstr* op = instr->AsBinaryDoubleOp()) {
+    return new (Z) BinaryDoubleOpInstr(op->op_kind(), input(0), input(1),
+                                       deopt_id, op->source(),
+                                       op->SpeculativeModeOfInput(0));
+  }
+  if (LoadIndexedInstr* load = instr->AsLoadIndexed()) {
+    return new (Z) LoadIndexedInstr(
+        input(0), input(1), load->index_unboxed(), load->index_scale(),
+        load->class_id(), load->aligned() ? kAlignedAccess : kUnalignedAccess,
+        deopt_id, load->source(), load->result_type());
+  }
+  if (StoreIndexedInstr* store = instr->AsStoreIndexed()) {
+    return new (Z) StoreIndexedInstr(
+        input(StoreIndexedInstr::kArrayPos),
+        input(StoreIndexedInstr::kIndexPos),
+        input(StoreIndexedInstr::kValuePos), store->emit_store_barrier(),
+        store->index_unboxed(), store->index_scale(), store->class_id(),
+        store->aligned() ? kAlignedAccess : kUnalignedAccess, deopt_id,
+        store->source(), store->SpeculativeModeOfInput(0));
+  }
+  if (LoadUntaggedInstr* load = instr->AsLoadUntagged()) {
+    return new (Z) LoadUntaggedInstr(input(0), load->offset());
+  }
+  if (CheckWritableInstr* check = instr->AsCheckWritable()) {
+    return new (Z) CheckWritableInstr(input(0), deopt_id, check->source());
+  }
+  if (LoadFieldInstr* load = instr->AsLoadField()) {
+    return new (Z) LoadFieldInstr(input(0), load->slot(), load->source(),
+                                  /*calls_initializer=*/false, deopt_id);
+  }
+  if (BoxInstr* box = instr->AsBox()) {
+    return BoxInstr::Create(box->from_representation(), input(0));
+  }
+  if (UnboxInstr* unbox = instr->AsUnbox()) {
+    UnboxInstr* copy =
+        UnboxInstr::Create(unbox->representation(), input(0), deopt_id,
+                           unbox->SpeculativeModeOfInput(0));
+    if (unbox->IsUnboxInteger() && unbox->AsUnboxInteger()->is_truncating()) {
+      copy->AsUnboxInteger()->mark_truncating();
+    }
+    return copy;
+  }
+  IntConverterInstr* conv = instr->AsIntConverter();
+  IntConverterInstr* copy = new (Z)
+      IntConverterInstr(conv->from(), conv->to(), input(0), deopt_id);
+  if (conv->is_truncating()) {
+    copy->mark_truncating();
+  }
+  return copy;
+}
+
+Instruction* LoopUnroller::AppendCopy(Instruction* instr,
+                                      Instruction* cursor) {
+  Instruction* copy = Copy(instr);
+  if (Definition* def = instr->AsDefinition()) {
+    Definition* def_copy = copy->AsDefinition();
+    if (def->HasSSATemp()) {
+      flow_graph_->AllocateSSAIndex(def_copy);
+      Map(def, def_copy);
+    }
+    def_copy->UpdateType(*def->Type());
+    if (def->range() != nullptr) {
+      def_copy->set_range(*def->range());
+    }
+  }
+  CopyEnvironment(instr, copy);
+  return cursor->AppendInstruction(copy);
+}
+
+void LoopUnroller::CopyEnvironment(Instruction* from, Instruction* to) {
+  if (from->env() == nullptr) {
+    return;
+  }
+  Environment* env = from->env()->DeepCopy(Z);
+  for (Environment::DeepIterator it(env); !it.Done(); it.Advance()) {
+    Value* value = it.CurrentValue();
+    value->set_definition(Lookup(value->definition()));
+  }
+  to->SetEnvironment(env);
+  for (Environment::DeepIterator it(env); !it.Done(); it.Advance()) {
+    Value* value = it.CurrentValue();
+    value->definition()->AddEnvUse(value);
+  }
+}
+
+Definition* LoopUnroller::AdjustLimit(const Candidate& candidate) {
+  const Representation rep = candidate.representation;
+  const int64_t delta = (candidate.factor - 1) * candidate.stride;
+  Definition* limit = candidate.limit;
+  if (limit->IsConstant()) {
+    const int64_t n =
+        Integer::Cast(limit->AsConstant()->value()).AsInt64Value();
+    if (rep == kTagged) {
+      return flow_graph_->GetConstant(
+          Smi::ZoneHandle(Z, Smi::New(static_cast<intptr_t>(n - delta))));
+    }
+    return flow_graph_->GetConstant(
+        Integer::ZoneHandle(Z, Integer::NewCanonical(n - delta)), rep);
+  }
+  const int64_t distance = Utils::Abs(delta);
+  Definition* offset;
+  if (rep == kTagged) {
+    offset = flow_graph_->GetConstant(
+        Smi::ZoneHandle(Z, Smi::New(static_cast<intptr_t>(distance))));
+  } else {
+    offset = flow_graph_->GetConstant(
+        Integer::ZoneHandle(Z, Integer::NewCanonical(distance)), rep);
+  }
+  // Range analysis has shown that this doesn't overflow.
+  BinaryIntegerOpInstr* adjusted = BinaryIntegerOpInstr::Make(
+      rep, delta > 0 ? Token::kSUB : Token::kADD, new (Z) Value(limit),
+      new (Z) Value(offset), DeoptId::kNone, /*can_overflow=*/false,
+      /*is_truncating=*/false, /*range=*/nullptr, Instruction::kNotSpeculative);
+  flow_graph_->InsertBefore(candidate.pre_header->last_instruction(), adjusted,
+                            nullptr, FlowGraph::kValue);
+  return adjusted;
+}
+
+Instruction* LoopUnroller::EmitBody(const Candidate& candidate,
+                                    Instruction* cursor) {
+  if (FLAG_trace_optimization && flow_graph_->should_print()) {
+    THR_Print("Unrolling loop B%" Pd " %" Pd " times\n",
+              candidate.header->block_id(), candidate.factor);
+  }
+
+  // Copy the body, advancing the header phis to their values at the next
+  // iteration after each copy.
+  const intptr_t kBackEdge = 1;
+  GrowableArray<PhiInstr*> phis;
+  for (PhiIterator it(candidate.header); !it.Done(); it.Advance()) {
+    phis.Add(it.Current());
+  }
+  GrowableArray<Definition*> next(phis.length());
+  for (intptr_t i = 0; i < candidate.factor; ++i) {
+    for (auto instr : candidate.body->instructions()) {
+      if (instr->IsGoto()) {
+        continue;
+      }
+      cursor = AppendCopy(instr, cursor);
+    }
+    next.Clear();
+    for (intptr_t j = 0; j < phis.length(); ++j) {
+      next.Add(Lookup(phis[j]->InputAt(kBackEdge)->definition()));
+    }
+    for (intptr_t j = 0; j < phis.length(); ++j) {
+      Map(phis[j], next[j]);
+    }
+  }
+  return cursor;
+}
+
+void LoopUnroller::UnrollLoop(const Candidate& candidate) {
+  JoinEntryInstr* header = candidate.header;
+  TargetEntryInstr* body = candidate.body;
+  const intptr_t try_index = header->try_index();
+  const intptr_t kEntry = 0;
+  const intptr_t kBackEdge = 1;
+
+  JoinEntryInstr* unrolled_header = new (Z) JoinEntryInstr(
+      flow_graph_->allocate_block_id(), try_index, DeoptId::kNone);
+  TargetEntryInstr* unrolled_body = new (Z) TargetEntryInstr(
+      flow_graph_->allocate_block_id(), try_index, DeoptId::kNone);
+  TargetEntryInstr* remainder = new (Z) TargetEntryInstr(
+      flow_graph_->allocate_block_id(), try_index, DeoptId::kNone);
+
+  // The unrolled header gets a phi for every phi of the original header.
+  GrowableArray<PhiInstr*> phis;
+  GrowableArray<PhiInstr*> unrolled_phis;
+  for (PhiIterator it(header); !it.Done(); it.Advance()) {
+    PhiInstr* phi = it.Current();
+    PhiInstr* unrolled_phi = new (Z) PhiInstr(unrolled_header, 2);
+    unrolled_phi->set_representation(phi->representation());
+    flow_graph_->AllocateSSAIndex(unrolled_phi);
+    unrolled_phi->UpdateType(*phi->Type());
+    if (phi->range() != nullptr) {
+      unrolled_phi->set_range(*phi->range());
+    }
+    unrolled_phi->mark_alive();
+    unrolled_header->InsertPhi(unrolled_phi);
+    phis.Add(phi);
+    unrolled_phis.Add(unrolled_phi);
+    Map(phi, unrolled_phi);
+  }
+
+  // Enter the unrolled loop instead of the original one.
+  Definition* limit = AdjustLimit(candidate);
+  candidate.pre_header->last_instruction()->AsGoto()->set_successor(
+      unrolled_header);
+
+  Instruction* cursor = unrolled_header;
+  if (candidate.check != nullptr) {
+    CheckStackOverflowInstr* check = candidate.check;
+    // Checks only needed for OSR were removed by canonicalization.
+    CheckStackOverflowInstr* copy = new (Z) CheckStackOverflowInstr(
+        check->source(), check->stack_depth(), check->loop_depth(),
+        check->GetDeoptId(), CheckStackOverflowInstr::kOsrAndPreemption);
+    CopyEnvironment(check, copy);
+    cursor = cursor->AppendInstruction(copy);
+  }
+  Value* index = new (Z) Value(Lookup(candidate.index));
+  Value* bound = new (Z) Value(limit);
+  ComparisonInstr* compare = candidate.branch->comparison();
+  BranchInstr* branch = new (Z) BranchInstr(
+      candidate.index_is_left ? compare->CopyWithNewOperands(index, bound)
+                              : compare->CopyWithNewOperands(bound, index),
+      DeoptId::kNone);
+  *branch->true_successor_address() = unrolled_body;
+  *branch->false_successor_address() = remainder;
+  cursor->AppendInstruction(branch);
+  unrolled_header->set_last_instruction(branch);
+
+  cursor = EmitBody(candidate, unrolled_body);
+  GotoInstr* jump = new (Z) GotoInstr(unrolled_header, DeoptId::kNone);
+  cursor->AppendInstruction(jump);
+  unrolled_body->set_last_instruction(jump);
+
+  // Run the remaining iterations in the original loop.
+  jump = new (Z) GotoInstr(header, DeoptId::kNone);
+  remainder->AppendInstruction(jump);
+  remainder->set_last_instruction(jump);
+
+  // The predecessors of a join are sorted by block id when the blocks are
+  // discovered again, so the remainder, which is newer than the back edge,
+  // becomes the second predecessor of the original header. The unrolled
+  // header keeps the pre-header first.
+  ASSERT(candidate.pre_header->block_id() < unrolled_body->block_id());
+  ASSERT(body->block_id() < remainder->block_id());
+  const intptr_t kRemainderBackEdge = 0;
+  const intptr_t kRemainderEntry = 1;
+  for (intptr_t i = 0; i < phis.length(); ++i) {
+    PhiInstr* phi = phis[i];
+    PhiInstr* unrolled_phi = unrolled_phis[i];
+    Value* initial = new (Z) Value(phi->InputAt(kEntry)->definition());
+    unrolled_phi->SetInputAt(kEntry, initial);
+    initial->definition()->AddInputUse(initial);
+    Value* back_edge = new (Z) Value(Lookup(phi));
+    unrolled_phi->SetInputAt(kBackEdge, back_edge);
+    back_edge->definition()->AddInputUse(back_edge);
+
+    phi->InputAt(kEntry)->RemoveFromUseList();
+    phi->SetInputAt(kRemainderBackEdge, phi->InputAt(kBackEdge));
+    Value* entry = new (Z) Value(unrolled_phi);
+    phi->SetInputAt(kRemainderEntry, entry);
+    unrolled_phi->AddInputUse(entry);
+  }
+
+  // Forget the copies, a later loop may use the values of this one.
+  for (intptr_t i = 0; i < phis.length(); ++i) {
+    Map(phis[i], nullptr);
+  }
+  for (auto instr : body->instructions()) {
+    Definition* def = instr->AsDefinition();
+    if (def != nullptr && def->HasSSATemp()) {
+      Map(def, nullptr);
+    }
+  }
+}
+
+bool LoopUnroller::IsWithin(Definition* def, int64_t min, int64_t max) {
+  if (ConstantInstr* constant = def->AsConstant()) {
+    const Object& value = constant->value();
+    if (!value.IsInteger()) {
+      return false;
+    }
+    const int64_t n = Integer::Cast(value).AsInt64Value();
+    return min <= n && n <= max;
+  }
+  return RangeUtils::IsWithin(def->range(), min, max);
+}
+
+Definition* LoopUnroller::Emit(Definition* def, Instruction* before) {
+  flow_graph_->InsertBefore(before, def, nullptr, FlowGraph::kValue);
+  return def;
+}
+
+Definition* LoopUnroller::Int64(int64_t value) {
+  return flow_graph_->GetConstant(
+      Integer::ZoneHandle(Z, Integer::NewCanonical(value)), kUnboxedInt64);
+}
+
+Definition* LoopUnroller::ToInt64(Definition* def, Instruction* before) {
+  if (def->representation() == kUnboxedInt64) {
+    return def;
+  }
+  if (ConstantInstr* constant = def->AsConstant()) {
+    return Int64(Integer::Cast(constant->value()).AsInt64Value());
+  }
+  if (def->representation() == kTagged) {
+    return Emit(UnboxInstr::Create(kUnboxedInt64, new (Z) Value(def),
+                                   DeoptId::kNone,
+                                   Instruction::kNotSpeculative),
+                before);
+  }
+  return Emit(new (Z) IntConverterInstr(def->representation(), kUnboxedInt64,
+                                        new (Z) Value(def), DeoptId::kNone),
+              before);
+}
+
+Definition* LoopUnroller::Int64Op(Token::Kind op_kind,
+                                    Definition* left,
+                                    Definition* right,
+                                    Instruction* before) {
+  return Emit(BinaryIntegerOpInstr::Make(
+                  kUnboxedInt64, op_kind, new (Z) Value(left),
+                  new (Z) Value(right), DeoptId::kNone,
+                  /*can_overflow=*/false, /*is_truncating=*/false,
+                  /*range=*/nullptr, Instruction::kNotSpeculative),
+              before);
+}
+
+Definition* LoopUnroller::Select(Definition* mask,
+                                   Definition* if_set,
+                                   Definition* if_clear,
+                                   Instruction* before) {
+  // if_clear ^ ((if_set ^ if_clear) & mask)
+  Definition* diff = Int64Op(Token::kBIT_XOR, if_set, if_clear, before);
+  diff = Int64Op(Token::kBIT_AND, diff, mask, before);
+  return Int64Op(Token::kBIT_XOR, if_clear, diff, before);
+}
+
+Definition* LoopUnroller::Min(Definition* left,
+                                Definition* right,
+                                Instruction* before) {
+  // The sign bit of d ^ ((left ^ right) & (d ^ left)) with d = left - right
+  // is set iff left < right, also when the subtraction wraps around.
+  Definition* diff = Int64Op(Token::kSUB, left, right, before);
+  Definition* mask = Int64Op(Token::kBIT_AND,
+                             Int64Op(Token::kBIT_XOR, left, right, before),
+                             Int64Op(Token::kBIT_XOR, diff, left, before),
+                             before);
+  mask = Int64Op(Token::kBIT_XOR, diff, mask, before);
+  mask = Int64Op(Token::kSHR, mask, Int64(63), before);
+  return Select(mask, left, right, before);
+}
+
+Definition* LoopUnroller::Lookup(Definition* def) const {
+  if (def->HasSSATemp() && def->ssa_temp_index() < map_.length()) {
+    Definition* copy = map_[def->ssa_temp_index()];
+    if (copy != nullptr) {
+      return copy;
+    }
+  }
+  return def;
+}
+
+void LoopUnroller::Map(Definition* def, Definition* copy) {
+  ASSERT(def->ssa_temp_index() < map_.length());
+  map_[def->ssa_temp_index()] = copy;
+}
+
+}  // namespace dart
@@ -0,0 +1,143 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef RUNTIME_VM_COMPILER_BACKEND_LOOP_UNROLLER_H_
+#define RUNTIME_VM_COMPILER_BACKEND_LOOP_UNROLLER_H_
+
+#if defined(DART_PRECOMPILED_RUNTIME)
+#error "AOT runtime should not use compiler sources (including header files)"
+#endif  // defined(DART_PRECOMPILED_RUNTIME)
+
+#include "vm/allocation.h"
+#include "vm/compiler/backend/il.h"
+
+namespace dart {
+
+class FlowGraph;
+class LoopInfo;
+
+// Partially unrolls small counted loops.
+//
+// A loop qualifies when it is innermost and consists of a header, which
+// holds only phis, an optional stack overflow check and the exit branch,
+// and a single body block that jumps back to the header. The exit branch
+// must compare a linear induction with unit stride against a loop invariant
+// limit (i < n for i++, i > n for i--), and the body must consist of
+// instructions the unroller knows how to copy. The limit must be a constant
+// or have a range that keeps n - (k - 1) from overflowing, as it has for
+// the length of a list.
+//
+//   for (i = a; i < n; i++) body(i);
+//
+// becomes
+//
+//   for (i = a; i < n - (k - 1); i += k) {
+//     body(i); body(i + 1); ... body(i + k - 1);
+//   }
+//   for (; i < n; i++) body(i);
+//
+// The unrolled loop runs k copies of the body per iteration for as long as
+// all k of them are within the limit, and then hands over to the original
+// loop, which runs the remaining (at most k - 1) iterations. Values of
+// the header phis flow into the copies and out of the unrolled loop, so
+// the original loop resumes exactly where the unrolled loop stopped. The
+// factor k is at most --loop_unroll_factor and is chosen such that the
+// unrolled body stays within --loop_unroll_budget instructions.
+class LoopUnroller : public ValueObject {
+ public:
+  explicit LoopUnroller(FlowGraph* flow_graph);
+  virtual ~LoopUnroller() {}
+
+  static void Optimize(FlowGraph* flow_graph);
+
+  // Unrolls all qualifying loops. Returns true if the graph changed.
+  bool Unroll();
+
+ protected:
+  struct Candidate {
+    LoopInfo* loop;
+    JoinEntryInstr* header;
+    TargetEntryInstr* body;
+    BlockEntryInstr* pre_header;
+    CheckStackOverflowInstr* check;
+    BranchInstr* branch;
+    // The induction compared with the limit, and on which side it is.
+    PhiInstr* index;
+    bool index_is_left;
+    int64_t stride;
+    Definition* limit;
+    // Representation of the compared values.
+    Representation representation;
+    // Unroll factor.
+    intptr_t factor;
+  };
+
+  // Decides whether the counted loop described by [candidate] is unrolled
+  // and sets its factor.
+  virtual bool Accept(Candidate* candidate);
+
+  // Computes the limit of the unrolled loop in the pre-header.
+  virtual Definition* AdjustLimit(const Candidate& candidate);
+
+  // Appends the body of the unrolled loop after [cursor] and maps the
+  // header phis to their values at the start of the next iteration.
+  // Returns the last appended instruction.
+  virtual Instruction* EmitBody(const Candidate& candidate,
+                                Instruction* cursor);
+
+  // Whether the body instruction [instr] can be copied by AppendCopy.
+  static bool CanCopy(Instruction* instr);
+
+  // Appends a copy of the body instruction [instr] after [cursor], with its
+  // inputs and environment mapped to their current copies. Returns the
+  // copy.
+  Instruction* AppendCopy(Instruction* instr, Instruction* cursor);
+
+  void CopyEnvironment(Instruction* from, Instruction* to);
+
+  // Maps an original definition to its current copy.
+  Definition* Lookup(Definition* def) const;
+  void Map(Definition* def, Definition* copy);
+
+  // Helpers computing the limit of the new loop in the pre-header with
+  // 64-bit arithmetic. Select and Min don't branch.
+  static bool IsWithin(Definition* def, int64_t min, int64_t max);
+  Definition* Emit(Definition* def, Instruction* before);
+  Definition* Int64(int64_t value);
+  Definition* ToInt64(Definition* def, Instruction* before);
+  Definition* Int64Op(Token::Kind op_kind,
+                      Definition* left,
+                      Definition* right,
+                      Instruction* before);
+  Definition* Select(Definition* mask,
+                     Definition* if_set,
+                     Definition* if_clear,
+                     Instruction* before);
+  Definition* Min(Definition* left, Definition* right, Instruction* before);
+
+  FlowGraph* flow_graph() const { return flow_graph_; }
+  Zone* zone() const { return zone_; }
+
+ private:
+  bool IsCandidate(LoopInfo* loop, Candidate* candidate);
+  bool IsCountedExit(LoopInfo* loop, Candidate* candidate);
+  intptr_t ChooseFactor(const Candidate& candidate);
+
+  Instruction* Copy(Instruction* instr);
+
+  void UnrollLoop(const Candidate& candidate);
+
+  FlowGraph* const flow_graph_;
+  Zone* const zone_;
+
+  // Copies of the header phis and body definitions indexed by the SSA temp
+  // index of the original definition.
+  GrowableArray<Definition*> map_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoopUnroller);
+};
+
+}  // namespace dart
+
+#endif  // RUNTIME_VM_COMPILER_BACKEND_LOOP_UNROLLER_H_
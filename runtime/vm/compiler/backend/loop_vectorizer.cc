@@ -0,0 +1,601 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/compiler/backend/loop_vectorizer.h"
+
+#include "vm/compiler/backend/flow_graph.h"
+#include "vm/compiler/backend/flow_graph_compiler.h"
+#include "vm/compiler/backend/loops.h"
+#include "vm/compiler/backend/range_analysis.h"
+
+namespace dart {
+
+DEFINE_FLAG(bool,
+            loop_vectorization,
+            true,
+            "Vectorize element-wise loops over typed data.");
+
+// Quick access to the zone of the flow graph.
+#define Z (zone())
+
+LoopVectorizer::LoopVectorizer(FlowGraph* flow_graph)
+    : LoopUnroller(flow_graph),
+      element_cid_(kIllegalCid),
+      vector_cid_(kIllegalCid),
+      width_(0),
+      next_index_(nullptr),
+      lanes_(),
+      checks_(),
+      accesses_(),
+      splats_() {}
+
+void LoopVectorizer::Optimize(FlowGraph* flow_graph) {
+#if defined(TARGET_ARCH_X64) || defined(TARGET_ARCH_ARM64)
+  if (!FLAG_loop_vectorization ||
+      !FlowGraphCompiler::SupportsUnboxedSimd128()) {
+    return;
+  }
+  // The entry of an OSR graph jumps into the middle of a loop.
+  if (flow_graph->IsCompiledForOsr()) {
+    return;
+  }
+  LoopVectorizer vectorizer(flow_graph);
+  vectorizer.Vectorize();
+#endif  // defined(TARGET_ARCH_X64) || defined(TARGET_ARCH_ARM64)
+}
+
+bool LoopVectorizer::Accept(Candidate* candidate) {
+  if (candidate->stride != 1) {
+    return false;
+  }
+  // The index is the only value carried from one iteration to the next.
+  intptr_t num_phis = 0;
+  for (PhiIterator it(candidate->header); !it.Done(); it.Advance()) {
+    num_phis++;
+  }
+  if (num_phis != 1 || !Analyze(*candidate)) {
+    return false;
+  }
+  candidate->factor = width_;
+
+  // The limit of the vector loop is computed with 64-bit arithmetic, which
+  // doesn't overflow on these, and it is a Smi again if the index is.
+  const int64_t min = compiler::target::kSmiMin;
+  const int64_t max = compiler::target::kSmiMax;
+  Definition* initial = candidate->index->InputAt(0)->definition();
+  if (!IsWithin(candidate->limit, min + width_, max) ||
+      !IsWithin(initial, min + 1, max)) {
+    return false;
+  }
+  for (intptr_t i = 0; i < checks_.length(); ++i) {
+    if (!IsWithin(checks_[i]->length()->definition(), 0, max)) {
+      return false;
+    }
+  }
+  // Only the last lane is compared with the lengths of bounds checks, the
+  // first one must not go below zero.
+  return checks_.is_empty() || IsWithin(initial, 0, max);
+}
+
+bool LoopVectorizer::Analyze(const Candidate& candidate) {
+  LoopInfo* loop = candidate.loop;
+  element_cid_ = kIllegalCid;
+  lanes_.Clear();
+  lanes_.FillWith(kNoLane, 0, flow_graph()->current_ssa_temp_index());
+  checks_.Clear();
+  accesses_.Clear();
+
+  // The vector loop advances the index on its own.
+  next_index_ = candidate.index->InputAt(1)->definition();
+  if (next_index_->GetBlock() != candidate.body) {
+    return false;
+  }
+
+  bool stored = false;
+  for (auto instr : candidate.body->instructions()) {
+    if (instr->IsGoto() || instr == next_index_) {
+      continue;
+    }
+    if (CheckBoundBase* check = instr->AsCheckBoundBase()) {
+      if (!IsIndex(candidate, check->index()) ||
+          loop->Contains(check->length()->definition()->GetBlock())) {
+        return false;
+      }
+      checks_.Add(check);
+      continue;
+    }
+    if (LoadUntaggedInstr* load = instr->AsLoadUntagged()) {
+      // Copied into the vector loop, see AddAccess for its uses.
+      Definition* object = load->object()->definition()->OriginalDefinition();
+      if (loop->Contains(object->GetBlock())) {
+        return false;
+      }
+      continue;
+    }
+    if (CheckWritableInstr* check = instr->AsCheckWritable()) {
+      // Copied into the vector loop. It throws on the first iteration if
+      // at all, and the stores of that iteration must not happen before.
+      Definition* object = check->value()->definition()->OriginalDefinition();
+      if (stored || check->env() != nullptr ||
+          loop->Contains(object->GetBlock())) {
+        return false;
+      }
+      continue;
+    }
+    stored = stored || instr->IsStoreIndexed();
+    const Lane lane = Classify(candidate, instr);
+    if (lane == kNoLane) {
+      return false;
+    }
+    Definition* def = instr->AsDefinition();
+    if (def != nullptr && def->HasSSATemp()) {
+      lanes_[def->ssa_temp_index()] = lane;
+    }
+  }
+  if (element_cid_ == kIllegalCid || !stored) {
+    return false;
+  }
+
+  // Vectors only flow into vectorized instructions. The bounds checks are
+  // not part of the vector loop, so their environments are irrelevant.
+  for (auto instr : candidate.body->instructions()) {
+    Definition* def = instr->AsDefinition();
+    if (def == nullptr || def == next_index_ || instr->IsCheckBoundBase()) {
+      continue;
+    }
+    for (Value* use = def->input_use_list(); use != nullptr;
+         use = use->next_use()) {
+      Instruction* user = use->instruction();
+      if (user == next_index_ || user->IsCheckBoundBase() ||
+          user->GetBlock() != candidate.body) {
+        return false;
+      }
+    }
+    for (Value* use = def->env_use_list(); use != nullptr;
+         use = use->next_use()) {
+      Instruction* user = use->instruction();
+      if (!user->IsCheckBoundBase() || user->GetBlock() != candidate.body) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+LoopVectorizer::Lane LoopVectorizer::Classify(const Candidate& candidate,
+                                              Instruction* instr) {
+  if (instr->CanDeoptimize()) {
+    return kNoLane;
+  }
+  if (LoadIndexedInstr* load = instr->AsLoadIndexed()) {
+    if (!SetElementCid(load->class_id()) ||
+        !IsIndex(candidate, load->index()) ||
+        !AddAccess(candidate, load->array()->definition(),
+                   /*is_store=*/false)) {
+      return kNoLane;
+    }
+    switch (element_cid_) {
+      case kTypedDataFloat64ArrayCid:
+        return kFloat64;
+      case kTypedDataFloat32ArrayCid:
+        return kFloat32;
+      default:
+        return kInt32;
+    }
+  }
+  if (StoreIndexedInstr* store = instr->AsStoreIndexed()) {
+    if (!SetElementCid(store->class_id()) ||
+        !IsIndex(candidate, store->index()) ||
+        !AddAccess(candidate, store->array()->definition(),
+                   /*is_store=*/true)) {
+      return kNoLane;
+    }
+    const Lane lane = LaneOf(store->value());
+    switch (element_cid_) {
+      case kTypedDataFloat64ArrayCid:
+        return lane == kFloat64 ? lane : kNoLane;
+      case kTypedDataFloat32ArrayCid:
+        return lane == kFloat32 ? lane : kNoLane;
+      default:
+        return lane == kInt32 ? lane : kNoLane;
+    }
+  }
+  if (FloatToDoubleInstr* conv = instr->AsFloatToDouble()) {
+    return LaneOf(conv->value()) == kFloat32 ? kWidenedFloat32 : kNoLane;
+  }
+  if (DoubleToFloatInstr* conv = instr->AsDoubleToFloat()) {
+    const Lane lane = LaneOf(conv->value());
+    return (lane == kWidenedFloat32 || lane == kFloat32Result) ? kFloat32
+                                                                : kNoLane;
+  }
+  if (IntConverterInstr* conv = instr->AsIntConverter()) {
+    const Lane lane = LaneOf(conv->value());
+    if (conv->from() == kUnboxedInt32 && conv->to() == kUnboxedInt64) {
+      return lane == kInt32 ? kInt64 : kNoLane;
+    }
+    if (conv->from() == kUnboxedInt64 && conv->to() == kUnboxedInt32 &&
+        conv->is_truncating()) {
+      return lane == kInt64 ? kInt32 : kNoLane;
+    }
+    return kNoLane;
+  }
+  if (BinaryDoubleOpInstr* op = instr->AsBinaryDoubleOp()) {
+    switch (op->op_kind()) {
+      case Token::kADD:
+      case Token::kSUB:
+      case Token::kMUL:
+      case Token::kDIV:
+        break;
+      default:
+        return kNoLane;
+    }
+    const Lane left = LaneOf(op->left());
+    const Lane right = LaneOf(op->right());
+    // Rounding the exact result to double and then to float is the same
+    // as rounding it to float directly.
+    if (left == kWidenedFloat32 && right == kWidenedFloat32) {
+      return kFloat32Result;
+    }
+    if ((left == kFloat64 && right == kFloat64) ||
+        (left == kFloat64 && IsInvariantDouble(candidate, op->right())) ||
+        (right == kFloat64 && IsInvariantDouble(candidate, op->left()))) {
+      return kFloat64;
+    }
+    return kNoLane;
+  }
+  if (instr->IsBinaryInt64Op() || instr->IsBinaryInt32Op()) {
+    BinaryIntegerOpInstr* op = instr->AsBinaryIntegerOp();
+    switch (op->op_kind()) {
+      case Token::kADD:
+      case Token::kSUB:
+      case Token::kBIT_AND:
+      case Token::kBIT_OR:
+      case Token::kBIT_XOR:
+        break;
+      default:
+        return kNoLane;
+    }
+    // The low 32 bits of these only depend on the low 32 bits of their
+    // operands.
+    const Lane lane = op->IsBinaryInt64Op() ? kInt64 : kInt32;
+    return (LaneOf(op->left()) == lane && LaneOf(op->right()) == lane)
+               ? lane
+               : kNoLane;
+  }
+  return kNoLane;
+}
+
+LoopVectorizer::Lane LoopVectorizer::LaneOf(Value* value) const {
+  Definition* def = value->definition();
+  if (!def->HasSSATemp() || def->ssa_temp_index() >= lanes_.length()) {
+    return kNoLane;
+  }
+  return lanes_[def->ssa_temp_index()];
+}
+
+bool LoopVectorizer::SetElementCid(intptr_t cid) {
+  if (element_cid_ != kIllegalCid) {
+    return cid == element_cid_;
+  }
+  switch (cid) {
+    case kTypedDataFloat64ArrayCid:
+      vector_cid_ = kTypedDataFloat64x2ArrayCid;
+      width_ = 2;
+      break;
+    case kTypedDataFloat32ArrayCid:
+      vector_cid_ = kTypedDataFloat32x4ArrayCid;
+      width_ = 4;
+      break;
+    case kTypedDataInt32ArrayCid:
+      vector_cid_ = kTypedDataInt32x4ArrayCid;
+      width_ = 4;
+      break;
+    default:
+      return false;
+  }
+  element_cid_ = cid;
+  return true;
+}
+
+bool LoopVectorizer::IsIndex(const Candidate& candidate, Value* index) const {
+  return index->definition()->OriginalDefinition() == candidate.index;
+}
+
+bool LoopVectorizer::AddAccess(const Candidate& candidate,
+                               Definition* array,
+                               bool is_store) {
+  Definition* object = array;
+  bool untagged = false;
+  if (array->representation() == kUntagged) {
+    LoadUntaggedInstr* load = array->AsLoadUntagged();
+    if (load == nullptr ||
+        load->offset() != compiler::target::PointerBase::data_offset()) {
+      return false;
+    }
+    object = load->object()->definition();
+    untagged = true;
+  }
+  object = object->OriginalDefinition();
+  if (object->representation() != kTagged ||
+      candidate.loop->Contains(object->GetBlock())) {
+    return false;
+  }
+  accesses_.Add({object, untagged, is_store});
+  return true;
+}
+
+bool LoopVectorizer::IsInvariantDouble(const Candidate& candidate,
+                                       Value* value) const {
+  Definition* def = value->definition();
+  return element_cid_ == kTypedDataFloat64ArrayCid &&
+         def->representation() == kUnboxedDouble &&
+         !candidate.loop->Contains(def->GetBlock());
+}
+
+Definition* LoopVectorizer::DataAddress(Definition* object,
+                                        Instruction* before) {
+  Definition* data = Emit(
+      new (Z) LoadUntaggedInstr(new (Z) Value(object),
+                                compiler::target::PointerBase::data_offset()),
+      before);
+  return Emit(new (Z) IntConverterInstr(kUntagged, kUnboxedIntPtr,
+                                        new (Z) Value(data), DeoptId::kNone),
+              before);
+}
+
+// Whether [a] and [b] are among the pairs in [pairs].
+static bool IsPair(const GrowableArray<Definition*>& pairs,
+                   Definition* a,
+                   Definition* b) {
+  for (intptr_t i = 0; i < pairs.length(); i += 2) {
+    if ((pairs[i] == a && pairs[i + 1] == b) ||
+        (pairs[i] == b && pairs[i + 1] == a)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Definition* LoopVectorizer::AdjustLimit(const Candidate& candidate) {
+  // Other loops were analyzed since this one.
+  if (!Analyze(candidate)) {
+    UNREACHABLE();
+  }
+  Instruction* before = candidate.pre_header->last_instruction();
+  Token::Kind kind = candidate.branch->comparison()->kind();
+  if (!candidate.index_is_left) {
+    kind = Token::FlipComparison(kind);
+  }
+
+  // The last lane i + k - 1 must be within the limit of the loop and pass
+  // all bounds checks.
+  Definition* limit = Int64Op(Token::kSUB, ToInt64(candidate.limit, before),
+                              Int64(width_ - 1), before);
+  const int64_t check_offset = kind == Token::kLT ? width_ - 1 : width_;
+  for (intptr_t i = 0; i < checks_.length(); ++i) {
+    Definition* length = ToInt64(checks_[i]->length()->definition(), before);
+    limit = Min(limit,
+                Int64Op(Token::kSUB, length, Int64(check_offset), before),
+                before);
+  }
+
+  // Lanes only observe each other's stores if the data of a stored array
+  // and another accessed array start less than a vector apart. Distinct
+  // TypedData objects never overlap, but views and external data may.
+  // Objects moved by the GC move along with their views.
+  const int64_t vector_size = width_ * TypedDataBase::ElementSizeFor(
+                                           element_cid_);
+  GrowableArray<Definition*> objects;
+  GrowableArray<Definition*> addresses;
+  auto address_of = [&](Definition* object) {
+    for (intptr_t i = 0; i < objects.length(); ++i) {
+      if (objects[i] == object) {
+        return addresses[i];
+      }
+    }
+    objects.Add(object);
+    addresses.Add(DataAddress(object, before));
+    return addresses.Last();
+  };
+  GrowableArray<Definition*> pairs;
+  Definition* overlap = nullptr;
+  for (intptr_t i = 0; i < accesses_.length(); ++i) {
+    const Access& store = accesses_[i];
+    if (!store.is_store) {
+      continue;
+    }
+    for (intptr_t j = 0; j < accesses_.length(); ++j) {
+      const Access& other = accesses_[j];
+      if (store.object == other.object ||
+          (!store.untagged && !other.untagged) ||
+          IsPair(pairs, store.object, other.object)) {
+        continue;
+      }
+      pairs.Add(store.object);
+      pairs.Add(other.object);
+      // The sign bit of (d - size) & (-d - size) is set iff |d| < size.
+      Definition* a = address_of(store.object);
+      Definition* b = address_of(other.object);
+      Definition* size = Int64(vector_size);
+      Definition* above = Int64Op(
+          Token::kSUB, Int64Op(Token::kSUB, a, b, before), size, before);
+      Definition* below = Int64Op(
+          Token::kSUB, Int64Op(Token::kSUB, b, a, before), size, before);
+      Definition* close = Int64Op(Token::kBIT_AND, above, below, before);
+      overlap = overlap == nullptr
+                    ? close
+                    : Int64Op(Token::kBIT_OR, overlap, close, before);
+    }
+  }
+  if (overlap != nullptr) {
+    // Don't enter the vector loop at all.
+    Definition* mask = Int64Op(Token::kSHR, overlap, Int64(63), before);
+    Definition* initial =
+        ToInt64(candidate.index->InputAt(0)->definition(), before);
+    limit = Select(mask, Int64Op(Token::kSUB, initial, Int64(1), before),
+                   limit, before);
+  }
+
+  if (candidate.representation == kTagged) {
+    // A Smi, see Accept.
+    limit = Emit(BoxInstr::Create(kUnboxedInt64, new (Z) Value(limit)),
+                 before);
+  }
+  return limit;
+}
+
+Definition* LoopVectorizer::Vector(Value* value, Instruction* pre_header_end) {
+  Definition* def = value->definition();
+  if (LaneOf(value) != kNoLane) {
+    return Lookup(def);
+  }
+  // A loop invariant double, splatted once in the pre-header.
+  for (intptr_t i = 0; i < splats_.length(); i += 2) {
+    if (splats_[i] == def) {
+      return splats_[i + 1];
+    }
+  }
+  Definition* splat =
+      SimdOpInstr::Create(MethodRecognizer::kFloat64x2Splat,
+                          new (Z) Value(def), DeoptId::kNone);
+  flow_graph()->InsertBefore(pre_header_end, splat, nullptr,
+                             FlowGraph::kValue);
+  splats_.Add(def);
+  splats_.Add(splat);
+  return splat;
+}
+
+SimdOpInstr::Kind LoopVectorizer::VectorOp(Token::Kind op_kind) const {
+  switch (vector_cid_) {
+    case kTypedDataFloat64x2ArrayCid:
+      switch (op_kind) {
+        case Token::kADD:
+          return SimdOpInstr::kFloat64x2Add;
+        case Token::kSUB:
+          return SimdOpInstr::kFloat64x2Sub;
+        case Token::kMUL:
+          return SimdOpInstr::kFloat64x2Mul;
+        case Token::kDIV:
+          return SimdOpInstr::kFloat64x2Div;
+        default:
+          break;
+      }
+      break;
+    case kTypedDataFloat32x4ArrayCid:
+      switch (op_kind) {
+        case Token::kADD:
+          return SimdOpInstr::kFloat32x4Add;
+        case Token::kSUB:
+          return SimdOpInstr::kFloat32x4Sub;
+        case Token::kMUL:
+          return SimdOpInstr::kFloat32x4Mul;
+        case Token::kDIV:
+          return SimdOpInstr::kFloat32x4Div;
+        default:
+          break;
+      }
+      break;
+    case kTypedDataInt32x4ArrayCid:
+      switch (op_kind) {
+        case Token::kADD:
+          return SimdOpInstr::kInt32x4Add;
+        case Token::kSUB:
+          return SimdOpInstr::kInt32x4Sub;
+        case Token::kBIT_AND:
+          return SimdOpInstr::kInt32x4BitAnd;
+        case Token::kBIT_OR:
+          return SimdOpInstr::kInt32x4BitOr;
+        case Token::kBIT_XOR:
+          return SimdOpInstr::kInt32x4BitXor;
+        default:
+          break;
+      }
+      break;
+    default:
+      break;
+  }
+  UNREACHABLE();
+  return SimdOpInstr::kIllegalSimdOp;
+}
+
+Instruction* LoopVectorizer::EmitBody(const Candidate& candidate,
+                                      Instruction* cursor) {
+  if (FLAG_trace_optimization && flow_graph()->should_print()) {
+    THR_Print("Vectorizing loop B%" Pd " with %" Pd " lanes\n",
+              candidate.header->block_id(), width_);
+  }
+
+  Instruction* pre_header_end = candidate.pre_header->last_instruction();
+  Definition* index = Lookup(candidate.index);
+  for (auto instr : candidate.body->instructions()) {
+    if (instr->IsGoto() || instr == next_index_ ||
+        instr->IsCheckBoundBase()) {
+      continue;
+    }
+    Definition* vector;
+    if (LoadUntaggedInstr* load = instr->AsLoadUntagged()) {
+      vector = new (Z) LoadUntaggedInstr(
+          new (Z) Value(Lookup(load->object()->definition())), load->offset());
+    } else if (CheckWritableInstr* check = instr->AsCheckWritable()) {
+      Definition* array = Lookup(check->value()->definition());
+      vector = new (Z) CheckWritableInstr(new (Z) Value(array),
+                                          check->deopt_id(), check->source());
+    } else if (LoadIndexedInstr* load = instr->AsLoadIndexed()) {
+      vector = new (Z) LoadIndexedInstr(
+          new (Z) Value(Lookup(load->array()->definition())),
+          new (Z) Value(index), load->index_unboxed(), load->index_scale(),
+          vector_cid_, load->aligned() ? kAlignedAccess : kUnalignedAccess,
+          DeoptId::kNone, load->source());
+    } else if (StoreIndexedInstr* store = instr->AsStoreIndexed()) {
+      cursor = cursor->AppendInstruction(new (Z) StoreIndexedInstr(
+          new (Z) Value(Lookup(store->array()->definition())),
+          new (Z) Value(index),
+          new (Z) Value(Lookup(store->value()->definition())),
+          kNoStoreBarrier, store->index_unboxed(), store->index_scale(),
+          vector_cid_, store->aligned() ? kAlignedAccess : kUnalignedAccess,
+          DeoptId::kNone, store->source(), Instruction::kNotSpeculative));
+      continue;
+    } else if (BinaryDoubleOpInstr* op = instr->AsBinaryDoubleOp()) {
+      vector = SimdOpInstr::Create(
+          VectorOp(op->op_kind()),
+          new (Z) Value(Vector(op->left(), pre_header_end)),
+          new (Z) Value(Vector(op->right(), pre_header_end)),
+          DeoptId::kNone);
+    } else if (BinaryIntegerOpInstr* op = instr->AsBinaryIntegerOp()) {
+      vector = SimdOpInstr::Create(
+          VectorOp(op->op_kind()),
+          new (Z) Value(Lookup(op->left()->definition())),
+          new (Z) Value(Lookup(op->right()->definition())), DeoptId::kNone);
+    } else {
+      // Conversions between elements and their arithmetic representation
+      // leave the lanes as they are.
+      ASSERT(instr->IsFloatToDouble() || instr->IsDoubleToFloat() ||
+             instr->IsIntConverter());
+      Map(instr->AsDefinition(), Lookup(instr->InputAt(0)->definition()));
+      continue;
+    }
+    flow_graph()->AllocateSSAIndex(vector);
+    Map(instr->AsDefinition(), vector);
+    cursor = cursor->AppendInstruction(vector);
+  }
+  splats_.Clear();
+
+  // Advance the index by a vector, which doesn't overflow as the last lane
+  // is within the limit.
+  const Representation rep = candidate.representation;
+  Definition* width =
+      rep == kTagged
+          ? flow_graph()->GetConstant(Smi::ZoneHandle(Z, Smi::New(width_)))
+          : Int64(width_);
+  Definition* next = BinaryIntegerOpInstr::Make(
+      rep, Token::kADD, new (Z) Value(index), new (Z) Value(width),
+      DeoptId::kNone, /*can_overflow=*/false, /*is_truncating=*/false,
+      /*range=*/nullptr, Instruction::kNotSpeculative);
+  flow_graph()->AllocateSSAIndex(next);
+  cursor = cursor->AppendInstruction(next);
+  Map(candidate.index, next);
+  return cursor;
+}
+
+}  // namespace dart
@@ -0,0 +1,119 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef RUNTIME_VM_COMPILER_BACKEND_LOOP_VECTORIZER_H_
+#define RUNTIME_VM_COMPILER_BACKEND_LOOP_VECTORIZER_H_
+
+#if defined(DART_PRECOMPILED_RUNTIME)
+#error "AOT runtime should not use compiler sources (including header files)"
+#endif  // defined(DART_PRECOMPILED_RUNTIME)
+
+#include "vm/compiler/backend/loop_unroller.h"
+
+namespace dart {
+
+class CheckBoundBase;
+
+// Rewrites element-wise loops over typed data to use 128-bit vector loads,
+// stores and SimdOps.
+//
+//   for (i = a; i < n; i++) x[i] = y[i] + z[i];
+//
+// becomes
+//
+//   for (i = a; i < n' ; i += k) x[i..i+k) = y[i..i+k) + z[i..i+k);
+//   for (; i < n; i++) x[i] = y[i] + z[i];
+//
+// where k is the number of lanes: 2 for Float64List and 4 for Float32List
+// and Int32List. The original loop serves as the scalar epilogue.
+//
+// The loop must have the shape accepted by the LoopUnroller with a unit
+// stride and no other loop carried values than the index. Its body may
+// only consist of loads and stores of elements at the index of arrays with
+// the same element type, the arithmetic which maps to SimdOps (+, -, * and
+// / on doubles, +, -, &, | and ^ on 32-bit integers), conversions between
+// the element and its arithmetic representation, bounds checks of the
+// index against loop invariant lengths and, before any store, checks that
+// the arrays are writable.
+//
+// The vector loop stops early enough that every lane is within the limit
+// and passes all bounds checks, so the epilogue performs any failing check
+// at the right iteration. It is skipped entirely when two of the accessed
+// arrays may overlap in a way that would make the lanes observe each
+// other's stores.
+//
+// Float32 arithmetic is only vectorized when each operation is converted
+// back to single precision directly, where it is exact.
+class LoopVectorizer : public LoopUnroller {
+ public:
+  explicit LoopVectorizer(FlowGraph* flow_graph);
+
+  static void Optimize(FlowGraph* flow_graph);
+
+  // Vectorizes all qualifying loops. Returns true if the graph changed.
+  bool Vectorize() { return Unroll(); }
+
+ protected:
+  virtual bool Accept(Candidate* candidate);
+  virtual Definition* AdjustLimit(const Candidate& candidate);
+  virtual Instruction* EmitBody(const Candidate& candidate,
+                                Instruction* cursor);
+
+ private:
+  // What the lanes of the vector replacing a scalar value hold.
+  enum Lane {
+    kNoLane,
+    // Elements of a Float64List.
+    kFloat64,
+    // Elements of a Float32List, as floats and converted to doubles.
+    kFloat32,
+    kWidenedFloat32,
+    // The result of an operation on widened Float32List elements, which
+    // must be converted back to float.
+    kFloat32Result,
+    // Elements of an Int32List, and 64-bit integers whose low 32 bits are
+    // those of the lanes.
+    kInt32,
+    kInt64,
+  };
+
+  // An array accessed in the loop body. [object] is the typed data, also
+  // when the access goes through its untagged data pointer.
+  struct Access {
+    Definition* object;
+    bool untagged;
+    bool is_store;
+  };
+
+  // Collects the accesses and bounds checks of the loop body and assigns
+  // lanes to its values. Returns false if it can't be vectorized.
+  bool Analyze(const Candidate& candidate);
+  Lane Classify(const Candidate& candidate, Instruction* instr);
+  Lane LaneOf(Value* value) const;
+  bool SetElementCid(intptr_t cid);
+  bool IsIndex(const Candidate& candidate, Value* index) const;
+  bool AddAccess(const Candidate& candidate, Definition* array, bool is_store);
+  bool IsInvariantDouble(const Candidate& candidate, Value* value) const;
+
+  Definition* Vector(Value* value, Instruction* pre_header_end);
+  SimdOpInstr::Kind VectorOp(Token::Kind op_kind) const;
+
+  Definition* DataAddress(Definition* object, Instruction* before);
+
+  intptr_t element_cid_;
+  intptr_t vector_cid_;
+  intptr_t width_;
+  Definition* next_index_;
+  GrowableArray<Lane> lanes_;
+  GrowableArray<CheckBoundBase*> checks_;
+  GrowableArray<Access> accesses_;
+  // Loop invariant doubles followed by their splats.
+  GrowableArray<Definition*> splats_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoopVectorizer);
+};
+
+}  // namespace dart
+
+#endif  // RUNTIME_VM_COMPILER_BACKEND_LOOP_VECTORIZER_H_
@@ -0,0 +1,289 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/compiler/backend/loop_versioner.h"
+
+#include "vm/compiler/backend/flow_graph.h"
+#include "vm/compiler/backend/loops.h"
+#include "vm/compiler/backend/range_analysis.h"
+
+namespace dart {
+
+DEFINE_FLAG(bool,
+            loop_versioning,
+            true,
+            "Hoist checks out of loops into a copy of the loop without them.");
+DEFINE_FLAG(int,
+            loop_versioning_budget,
+            64,
+            "Maximum number of instructions in the body of a versioned loop.");
+
+// Quick access to the zone of the flow graph.
+#define Z (zone())
+
+LoopVersioner::LoopVersioner(FlowGraph* flow_graph)
+    : LoopUnroller(flow_graph),
+      bounds_checks_(),
+      class_checks_(),
+      hoisted_() {}
+
+void LoopVersioner::Optimize(FlowGraph* flow_graph) {
+  if (!FLAG_loop_versioning) {
+    return;
+  }
+  // The entry of an OSR graph jumps into the middle of a loop.
+  if (flow_graph->IsCompiledForOsr()) {
+    return;
+  }
+  LoopVersioner versioner(flow_graph);
+  versioner.Version();
+}
+
+bool LoopVersioner::Accept(Candidate* candidate) {
+  if (candidate->stride != 1 || !Analyze(*candidate)) {
+    return false;
+  }
+  candidate->factor = 1;
+
+  // The limit of the unchecked loop is the minimum of the limit and values
+  // computed with 64-bit arithmetic, which doesn't overflow on these. It is
+  // a Smi again if the limit is, which a limit compared as a Smi is checked
+  // to be before the loop.
+  const int64_t min = compiler::target::kSmiMin;
+  const int64_t max = compiler::target::kSmiMax;
+  Definition* initial = candidate->index->InputAt(0)->definition();
+  if (!IsWithin(initial, min + 1, max)) {
+    return false;
+  }
+  if (candidate->representation != kTagged) {
+    return true;
+  }
+  ComparisonInstr* compare = candidate->branch->comparison();
+  Value* limit = candidate->index_is_left ? compare->right() : compare->left();
+  return limit->Type()->ToCid() == kSmiCid ||
+         IsWithin(candidate->limit, min, max);
+}
+
+bool LoopVersioner::Analyze(const Candidate& candidate) {
+  bounds_checks_.Clear();
+  class_checks_.Clear();
+  hoisted_.Clear();
+
+  intptr_t size = 0;
+  for (auto instr : candidate.body->instructions()) {
+    if (instr->IsGoto()) {
+      continue;
+    }
+    if (CheckBoundBase* check = instr->AsCheckBoundBase()) {
+      if (!AddBoundsCheck(candidate, check)) {
+        return false;
+      }
+      continue;
+    }
+    if (instr->IsCheckNull() || instr->IsCheckClass() ||
+        instr->IsCheckClassId() || instr->IsCheckSmi()) {
+      if (!AddClassCheck(candidate, instr)) {
+        return false;
+      }
+      continue;
+    }
+    if (!CanCopy(instr)) {
+      return false;
+    }
+    size++;
+  }
+  return !hoisted_.is_empty() && size <= FLAG_loop_versioning_budget;
+}
+
+bool LoopVersioner::AddBoundsCheck(const Candidate& candidate,
+                                   CheckBoundBase* check) {
+  const int64_t min = compiler::target::kSmiMin;
+  const int64_t max = compiler::target::kSmiMax;
+  Definition* length = check->length()->definition();
+  if (!IsInvariant(candidate, length) || !IsWithin(length, 0, max)) {
+    return false;
+  }
+  Definition* index = check->index()->definition()->OriginalDefinition();
+  int64_t offset = 0;
+  if (index != candidate.index) {
+    // The index is i + c or i - c.
+    BinaryIntegerOpInstr* op = index->AsBinaryIntegerOp();
+    if (op == nullptr || op->GetBlock() != candidate.body ||
+        !(op->IsBinarySmiOp() || op->IsBinaryInt64Op()) ||
+        op->left()->definition()->OriginalDefinition() != candidate.index ||
+        !op->right()->BindsToConstant() ||
+        !op->right()->BoundConstant().IsInteger()) {
+      return false;
+    }
+    offset = Integer::Cast(op->right()->BoundConstant()).AsInt64Value();
+    switch (op->op_kind()) {
+      case Token::kADD:
+        break;
+      case Token::kSUB:
+        offset = -offset;
+        break;
+      default:
+        return false;
+    }
+    if (offset <= min || offset > max) {
+      return false;
+    }
+  }
+  bounds_checks_.Add({check, offset});
+  hoisted_.Add(check);
+  return true;
+}
+
+bool LoopVersioner::AddClassCheck(const Candidate& candidate,
+                                  Instruction* check) {
+  Definition* value = check->InputAt(0)->definition();
+  ClassCheck class_check = {value, kNullCid, kNullCid, false};
+  if (check->IsCheckNull()) {
+    class_check.is_null_check = true;
+  } else if (CheckClassIdInstr* check_cid = check->AsCheckClassId()) {
+    class_check.cid_start = check_cid->cids().cid_start;
+    class_check.cid_end = check_cid->cids().cid_end;
+  } else if (CheckClassInstr* check_class = check->AsCheckClass()) {
+    if (!check_class->cids().IsMonomorphic()) {
+      return false;
+    }
+    class_check.cid_start = class_check.cid_end =
+        check_class->cids().MonomorphicReceiverCid();
+  } else {
+    ASSERT(check->IsCheckSmi());
+    class_check.cid_start = class_check.cid_end = kSmiCid;
+  }
+  if (!IsInvariant(candidate, value)) {
+    return false;
+  }
+  class_checks_.Add(class_check);
+  hoisted_.Add(check);
+  return true;
+}
+
+bool LoopVersioner::IsInvariant(const Candidate& candidate,
+                                Definition* def) const {
+  return !candidate.loop->Contains(def->GetBlock());
+}
+
+bool LoopVersioner::IsHoisted(Instruction* instr) const {
+  for (intptr_t i = 0; i < hoisted_.length(); ++i) {
+    if (hoisted_[i] == instr) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Definition* LoopVersioner::AdjustLimit(const Candidate& candidate) {
+  // Other loops were analyzed since this one.
+  if (!Analyze(candidate)) {
+    UNREACHABLE();
+  }
+  Instruction* before = candidate.pre_header->last_instruction();
+  Token::Kind kind = candidate.branch->comparison()->kind();
+  if (!candidate.index_is_left) {
+    kind = Token::FlipComparison(kind);
+  }
+
+  // Every i up to the limit passes the upper bound i + c < length of all
+  // bounds checks.
+  Definition* limit = ToInt64(candidate.limit, before);
+  const int64_t extra = kind == Token::kLT ? 0 : 1;
+  for (intptr_t i = 0; i < bounds_checks_.length(); ++i) {
+    const BoundsCheck& bounds_check = bounds_checks_[i];
+    Definition* length =
+        ToInt64(bounds_check.check->length()->definition(), before);
+    limit = Min(limit,
+                Int64Op(Token::kSUB, length,
+                        Int64(bounds_check.offset + extra), before),
+                before);
+  }
+
+  // The remaining checks pass on all iterations or on none of them. The
+  // sign bit of [failing] is set iff one of them fails.
+  Definition* initial_def = candidate.index->InputAt(0)->definition();
+  Definition* initial = ToInt64(initial_def, before);
+  Definition* failing = nullptr;
+  auto add_failing = [&](Definition* def) {
+    failing = failing == nullptr
+                  ? def
+                  : Int64Op(Token::kBIT_OR, failing, def, before);
+  };
+  for (intptr_t i = 0; i < bounds_checks_.length(); ++i) {
+    const int64_t offset = bounds_checks_[i].offset;
+    if (!IsWithin(initial_def, -offset, compiler::target::kSmiMax)) {
+      add_failing(Int64Op(Token::kADD, initial, Int64(offset), before));
+    }
+  }
+  for (intptr_t i = 0; i < class_checks_.length(); ++i) {
+    const ClassCheck& class_check = class_checks_[i];
+    Definition* cid = ToInt64(
+        Emit(new (Z) LoadClassIdInstr(new (Z) Value(class_check.value)),
+             before),
+        before);
+    // The sign bit of (cid - start) | (end - cid) is set iff the class id
+    // is outside of [start, end].
+    Definition* outside = Int64Op(
+        Token::kBIT_OR,
+        Int64Op(Token::kSUB, cid, Int64(class_check.cid_start), before),
+        Int64Op(Token::kSUB, Int64(class_check.cid_end), cid, before),
+        before);
+    add_failing(class_check.is_null_check
+                    ? Int64Op(Token::kBIT_XOR, outside, Int64(-1), before)
+                    : outside);
+  }
+  if (failing != nullptr) {
+    // Don't enter the unchecked loop at all.
+    Definition* mask = Int64Op(Token::kSHR, failing, Int64(63), before);
+    limit = Select(mask, Int64Op(Token::kSUB, initial, Int64(1), before),
+                   limit, before);
+  }
+
+  if (candidate.representation == kTagged) {
+    // A Smi, see Accept.
+    limit = Emit(BoxInstr::Create(kUnboxedInt64, new (Z) Value(limit)),
+                 before);
+  }
+  return limit;
+}
+
+Instruction* LoopVersioner::EmitBody(const Candidate& candidate,
+                                     Instruction* cursor) {
+  if (FLAG_trace_optimization && flow_graph()->should_print()) {
+    THR_Print("Versioning loop B%" Pd " without %" Pd " checks\n",
+              candidate.header->block_id(), hoisted_.length());
+  }
+
+  // Copy the body without the hoisted checks. Their redefinitions are
+  // replaced by the checked values.
+  for (auto instr : candidate.body->instructions()) {
+    if (instr->IsGoto()) {
+      continue;
+    }
+    if (IsHoisted(instr)) {
+      Definition* def = instr->AsDefinition();
+      if (def != nullptr && def->HasSSATemp()) {
+        ASSERT(def->RedefinedValue() != nullptr);
+        Map(def, Lookup(def->RedefinedValue()->definition()));
+      }
+      continue;
+    }
+    cursor = AppendCopy(instr, cursor);
+  }
+
+  const intptr_t kBackEdge = 1;
+  GrowableArray<PhiInstr*> phis;
+  GrowableArray<Definition*> next;
+  for (PhiIterator it(candidate.header); !it.Done(); it.Advance()) {
+    phis.Add(it.Current());
+    next.Add(Lookup(it.Current()->InputAt(kBackEdge)->definition()));
+  }
+  for (intptr_t i = 0; i < phis.length(); ++i) {
+    Map(phis[i], next[i]);
+  }
+  return cursor;
+}
+
+}  // namespace dart
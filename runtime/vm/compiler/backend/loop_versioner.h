@@ -0,0 +1,91 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef RUNTIME_VM_COMPILER_BACKEND_LOOP_VERSIONER_H_
+#define RUNTIME_VM_COMPILER_BACKEND_LOOP_VERSIONER_H_
+
+#if defined(DART_PRECOMPILED_RUNTIME)
+#error "AOT runtime should not use compiler sources (including header files)"
+#endif  // defined(DART_PRECOMPILED_RUNTIME)
+
+#include "vm/compiler/backend/loop_unroller.h"
+
+namespace dart {
+
+// Hoists the bounds checks, null checks and class checks out of loops
+// by running them in a copy of the loop without them for as long as they
+// are known to pass.
+//
+//   for (i = a; i < n; i++) {
+//     check(0 <= i + c < len); check(x != null); body(i);
+//   }
+//
+// becomes
+//
+//   n' = (a + c >= 0 && x != null) ? min(n, len - c) : a - 1;
+//   for (i = a; i < n'; i++) body(i);
+//   for (; i < n; i++) {
+//     check(0 <= i + c < len); check(x != null); body(i);
+//   }
+//
+// The checked original loop serves as the fallback, which takes over where
+// the checks would start to fail and performs the failing check at the
+// right iteration. The limit n' is computed without branches, the class id
+// of a checked value stands in for the outcome of its check.
+//
+// The loop must have the shape accepted by the LoopUnroller with an
+// increasing unit stride. Hoisted checks must be of values and lengths
+// which are loop invariant, and of indices which differ from the induction
+// by a constant. All other instructions of the body must be copyable.
+class LoopVersioner : public LoopUnroller {
+ public:
+  explicit LoopVersioner(FlowGraph* flow_graph);
+
+  static void Optimize(FlowGraph* flow_graph);
+
+  // Versions all qualifying loops. Returns true if the graph changed.
+  bool Version() { return Unroll(); }
+
+ protected:
+  virtual bool Accept(Candidate* candidate);
+  virtual Definition* AdjustLimit(const Candidate& candidate);
+  virtual Instruction* EmitBody(const Candidate& candidate,
+                                Instruction* cursor);
+
+ private:
+  // A bounds check of the index i + [offset].
+  struct BoundsCheck {
+    CheckBoundBase* check;
+    int64_t offset;
+  };
+
+  // A check that the class id of [value] is within [cid_start, cid_end],
+  // or that [value] is not null.
+  struct ClassCheck {
+    Definition* value;
+    intptr_t cid_start;
+    intptr_t cid_end;
+    bool is_null_check;
+  };
+
+  // Collects the hoisted checks of the loop body. Returns false if the
+  // loop can't be versioned.
+  bool Analyze(const Candidate& candidate);
+  bool AddBoundsCheck(const Candidate& candidate, CheckBoundBase* check);
+  bool AddClassCheck(const Candidate& candidate, Instruction* check);
+  bool IsInvariant(const Candidate& candidate, Definition* def) const;
+
+  // Whether the body instruction [instr] is one of the hoisted checks.
+  bool IsHoisted(Instruction* instr) const;
+
+  GrowableArray<BoundsCheck> bounds_checks_;
+  GrowableArray<ClassCheck> class_checks_;
+  GrowableArray<Instruction*> hoisted_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoopVersioner);
+};
+
+}  // namespace dart
+
+#endif  // RUNTIME_VM_COMPILER_BACKEND_LOOP_VERSIONER_H_
@@ -11,6 +11,7 @@
 #include "vm/compiler/backend/il_printer.h"
 #include "vm/compiler/backend/il_test_helper.h"
 #include "vm/compiler/backend/inliner.h"
+#include "vm/compiler/backend/loop_unroller.h"
 #include "vm/compiler/backend/type_propagator.h"
 #include "vm/compiler/compiler_pass.h"
 #include "vm/compiler/frontend/kernel_to_il.h"
@@ -23,6 +24,11 @@
 
 namespace dart {
 
+DECLARE_FLAG(bool, loop_unrolling);
+DECLARE_FLAG(int, loop_unroll_factor);
+DECLARE_FLAG(bool, loop_vectorization);
+DECLARE_FLAG(bool, loop_versioning);
+
 // Helper method to construct an induction debug string for loop hierarchy.
 void TestString(BaseTextBuffer* f,
                 LoopInfo* loop,
@@ -509,4 +515,333 @@ ISOLATE_UNIT_TEST_CASE(SecondExitDown) {
   EXPECT_STREQ(expected, ComputeInduction(thread, script_chars));
 }
 
+//
+// Loop unrolling tests.
+//
+
+// Helper method to count the instructions with the given tag in the graph.
+static intptr_t CountInstructions(FlowGraph* flow_graph,
+                                  Instruction::Tag tag) {
+  intptr_t count = 0;
+  for (auto block : flow_graph->reverse_postorder()) {
+    for (ForwardInstructionIterator it(block); !it.Done(); it.Advance()) {
+      if (it.Current()->tag() == tag) {
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+// Helper method to check that each phi input of a loop header is defined
+// in a block which dominates the predecessor it comes from, also when the
+// loop runs the remaining iterations of a loop made of it. Returns the
+// number of loops entered with the values of another loop.
+static intptr_t CountLoopsEnteredFromLoops(FlowGraph* flow_graph) {
+  intptr_t count = 0;
+  const auto& headers = flow_graph->GetLoopHierarchy().headers();
+  for (intptr_t i = 0; i < headers.length(); ++i) {
+    JoinEntryInstr* header = headers[i]->AsJoinEntry();
+    LoopInfo* loop = header->loop_info();
+    bool entered_from_loop = false;
+    for (PhiIterator it(header); !it.Done(); it.Advance()) {
+      PhiInstr* phi = it.Current();
+      for (intptr_t j = 0; j < phi->InputCount(); ++j) {
+        BlockEntryInstr* predecessor = header->PredecessorAt(j);
+        Definition* input = phi->InputAt(j)->definition();
+        EXPECT(input->GetBlock()->Dominates(predecessor));
+        if (!loop->Contains(predecessor) && input->IsPhi() &&
+            input->GetBlock()->IsLoopHeader()) {
+          entered_from_loop = true;
+        }
+      }
+    }
+    if (entered_from_loop) {
+      count++;
+    }
+  }
+  return count;
+}
+
+ISOLATE_UNIT_TEST_CASE(UnrollTypedDataLoop) {
+  const char* script_chars =
+      R"(
+      import 'dart:typed_data';
+      int foo(Uint8List list) {
+        int sum = 0;
+        for (int i = 0; i < list.length; i++) {
+          sum += list[i];
+        }
+        return sum;
+      }
+      main() {
+        foo(Uint8List(10));
+      }
+      )";
+  const auto& root_library = Library::Handle(LoadTestScript(script_chars));
+  const auto& function = Function::Handle(GetFunction(root_library, "foo"));
+  SetFlagScope<bool> sfs1(&FLAG_loop_unrolling, true);
+  SetFlagScope<int> sfs2(&FLAG_loop_unroll_factor, 4);
+
+  TestPipeline pipeline(function, CompilerPass::kAOT);
+  FlowGraph* flow_graph = pipeline.RunPasses({});
+
+  // The unrolled loop comes with a remainder loop, which is the original.
+  EXPECT_EQ(2, flow_graph->GetLoopHierarchy().num_loops());
+  EXPECT_EQ(1, CountLoopsEnteredFromLoops(flow_graph));
+  EXPECT_EQ(5, CountInstructions(flow_graph, Instruction::kLoadIndexed));
+
+  // Run the unrolled code for lengths that do and do not divide evenly.
+  pipeline.CompileGraphAndAttachFunction();
+  auto& list = TypedData::Handle();
+  auto& arguments = Array::Handle(Array::New(1));
+  auto& result = Object::Handle();
+  for (intptr_t length = 0; length < 12; length++) {
+    list = TypedData::New(kTypedDataUint8ArrayCid, length);
+    int64_t expected = 0;
+    for (intptr_t i = 0; i < length; i++) {
+      list.SetUint8(i, static_cast<uint8_t>(i + 1));
+      expected += i + 1;
+    }
+    arguments.SetAt(0, list);
+    result = DartEntry::InvokeFunction(function, arguments);
+    EXPECT(result.IsInteger());
+    EXPECT_EQ(expected, Integer::Cast(result).AsInt64Value());
+  }
+}
+
+ISOLATE_UNIT_TEST_CASE(UnrollConstantDownLoop) {
+  const char* script_chars =
+      R"(
+      int foo(int x) {
+        for (int i = 9; i > 0; i--) {
+          x = x * 3 + i;
+        }
+        return x;
+      }
+      main() {
+        foo(1);
+      }
+      )";
+  const auto& root_library = Library::Handle(LoadTestScript(script_chars));
+  const auto& function = Function::Handle(GetFunction(root_library, "foo"));
+  SetFlagScope<bool> sfs1(&FLAG_loop_unrolling, true);
+  SetFlagScope<int> sfs2(&FLAG_loop_unroll_factor, 4);
+
+  TestPipeline pipeline(function, CompilerPass::kAOT);
+  FlowGraph* flow_graph = pipeline.RunPasses({});
+  EXPECT_EQ(2, flow_graph->GetLoopHierarchy().num_loops());
+  EXPECT_EQ(1, CountLoopsEnteredFromLoops(flow_graph));
+
+  // Nine iterations: two unrolled ones and a single remaining one.
+  pipeline.CompileGraphAndAttachFunction();
+  int64_t expected = 5;
+  for (intptr_t i = 9; i > 0; i--) {
+    expected = expected * 3 + i;
+  }
+  auto& arguments = Array::Handle(Array::New(1));
+  arguments.SetAt(0, Smi::Handle(Smi::New(5)));
+  const auto& result =
+      Object::Handle(DartEntry::InvokeFunction(function, arguments));
+  EXPECT(result.IsInteger());
+  EXPECT_EQ(expected, Integer::Cast(result).AsInt64Value());
+}
+
+ISOLATE_UNIT_TEST_CASE(DoNotUnrollLoopWithCall) {
+  const char* script_chars =
+      R"(
+      import 'dart:typed_data';
+      @pragma('vm:never-inline')
+      int bar(int x) => x + 1;
+      int foo(Uint8List list) {
+        int sum = 0;
+        for (int i = 0; i < list.length; i++) {
+          sum += bar(list[i]);
+        }
+        return sum;
+      }
+      main() {
+        foo(Uint8List(10));
+      }
+      )";
+  const auto& root_library = Library::Handle(LoadTestScript(script_chars));
+  const auto& function = Function::Handle(GetFunction(root_library, "foo"));
+  SetFlagScope<bool> sfs1(&FLAG_loop_unrolling, true);
+  SetFlagScope<int> sfs2(&FLAG_loop_unroll_factor, 4);
+
+  TestPipeline pipeline(function, CompilerPass::kAOT);
+  FlowGraph* flow_graph = pipeline.RunPasses({});
+  EXPECT_EQ(1, flow_graph->GetLoopHierarchy().num_loops());
+  EXPECT_EQ(0, CountLoopsEnteredFromLoops(flow_graph));
+  EXPECT_EQ(1, CountInstructions(flow_graph, Instruction::kLoadIndexed));
+}
+
+//
+// Loop versioning tests.
+//
+
+ISOLATE_UNIT_TEST_CASE(VersionLoopWithFailingCheck) {
+  const char* script_chars =
+      R"(
+      import 'dart:typed_data';
+      void foo(Float64List a, int n) {
+        for (int i = 1; i < n; i++) {
+          a[i] = a[i - 1] + 1.0;
+        }
+      }
+      bool check() {
+        for (int n = 0; n < 12; n++) {
+          final a = Float64List(8);
+          try {
+            foo(a, n);
+            if (n > 8) return false;
+          } on RangeError {
+            if (n <= 8) return false;
+          }
+          // The stores before the failing check happened.
+          for (int i = 0; i < 8; i++) {
+            if (a[i] != (i < n ? i.toDouble() : 0.0)) return false;
+          }
+        }
+        return true;
+      }
+      main() {
+        foo(Float64List(8), 8);
+      }
+      )";
+  const auto& root_library = Library::Handle(LoadTestScript(script_chars));
+  const auto& function = Function::Handle(GetFunction(root_library, "foo"));
+  SetFlagScope<bool> sfs1(&FLAG_loop_versioning, true);
+  SetFlagScope<bool> sfs2(&FLAG_loop_unrolling, false);
+
+  TestPipeline pipeline(function, CompilerPass::kAOT);
+  FlowGraph* flow_graph = pipeline.RunPasses({});
+  // The unchecked loop comes with the checked original one, which resumes
+  // from the index it reached.
+  EXPECT_EQ(2, flow_graph->GetLoopHierarchy().num_loops());
+  EXPECT_EQ(1, CountLoopsEnteredFromLoops(flow_graph));
+  pipeline.CompileGraphAndAttachFunction();
+
+  const auto& result = Object::Handle(Invoke(root_library, "check"));
+  EXPECT(result.IsBool() && Bool::Cast(result).value());
+}
+
+//
+// Loop vectorization tests.
+//
+
+#if defined(TARGET_ARCH_X64) || defined(TARGET_ARCH_ARM64)
+
+// Helper method to compile foo with the AOT pipeline and run check, which
+// calls it. Returns the number of SimdOps in the graph of foo.
+static intptr_t VectorizeAndCheck(const char* script_chars) {
+  const auto& root_library = Library::Handle(LoadTestScript(script_chars));
+  const auto& function = Function::Handle(GetFunction(root_library, "foo"));
+  SetFlagScope<bool> sfs(&FLAG_loop_vectorization, true);
+
+  TestPipeline pipeline(function, CompilerPass::kAOT);
+  FlowGraph* flow_graph = pipeline.RunPasses({});
+  const intptr_t count = CountInstructions(flow_graph, Instruction::kSimdOp);
+  // A vectorized loop hands its index to the scalar epilogue.
+  const intptr_t entered = CountLoopsEnteredFromLoops(flow_graph);
+  EXPECT(count == 0 || entered > 0);
+  pipeline.CompileGraphAndAttachFunction();
+
+  const auto& result = Object::Handle(Invoke(root_library, "check"));
+  EXPECT(result.IsBool());
+  EXPECT(result.IsBool() && Bool::Cast(result).value());
+  return count;
+}
+
+ISOLATE_UNIT_TEST_CASE(VectorizeFloat64Loop) {
+  const char* script_chars =
+      R"(
+      import 'dart:typed_data';
+      void foo(Float64List a, Float64List b, Float64List c) {
+        for (int i = 0; i < a.length; i++) {
+          a[i] = b[i] * 2.0 + c[i];
+        }
+      }
+      bool check() {
+        for (int n = 0; n < 10; n++) {
+          final a = Float64List(n), b = Float64List(n), c = Float64List(n);
+          for (int i = 0; i < n; i++) {
+            b[i] = i.toDouble();
+            c[i] = 0.5;
+          }
+          foo(a, b, c);
+          for (int i = 0; i < n; i++) {
+            if (a[i] != 2.0 * i + 0.5) return false;
+          }
+        }
+        // Overlapping views see each other's stores in order.
+        final data = Float64List(10);
+        data[0] = 1.0;
+        foo(Float64List.sublistView(data, 1), data, Float64List(9));
+        for (int i = 0; i < 10; i++) {
+          if (data[i] != (1 << i).toDouble()) return false;
+        }
+        // A failing bounds check happens at the right iteration.
+        final a = Float64List(8);
+        final b = Float64List(8)..fillRange(0, 8, 1.0);
+        try {
+          foo(a, b, Float64List(5));
+          return false;
+        } on RangeError {
+          if (a[4] != 2.0 || a[5] != 0.0) return false;
+        }
+        return true;
+      }
+      )";
+  EXPECT_EQ(3, VectorizeAndCheck(script_chars));  // splat, mul and add
+}
+
+ISOLATE_UNIT_TEST_CASE(VectorizeFloat32Loop) {
+  const char* script_chars =
+      R"(
+      import 'dart:typed_data';
+      void foo(Float32List a, Float32List b) {
+        for (int i = 0; i < a.length; i++) {
+          a[i] = a[i] / b[i];
+        }
+      }
+      bool check() {
+        for (int n = 0; n < 10; n++) {
+          final a = Float32List(n), b = Float32List(n), c = Float32List(n);
+          for (int i = 0; i < n; i++) {
+            a[i] = c[i] = 1.0 + i;
+            b[i] = 3.0;
+          }
+          foo(a, b);
+          for (int i = 0; i < n; i++) {
+            c[i] = c[i] / 3.0;
+            if (a[i] != c[i]) return false;
+          }
+        }
+        return true;
+      }
+      )";
+  EXPECT_EQ(1, VectorizeAndCheck(script_chars));
+}
+
+ISOLATE_UNIT_TEST_CASE(DoNotVectorizeReduction) {
+  const char* script_chars =
+      R"(
+      import 'dart:typed_data';
+      double foo(Float64List a) {
+        double sum = 0.0;
+        for (int i = 0; i < a.length; i++) {
+          sum += a[i];
+        }
+        return sum;
+      }
+      bool check() {
+        return foo(Float64List(5)..fillRange(0, 5, 1.5)) == 7.5;
+      }
+      )";
+  EXPECT_EQ(0, VectorizeAndCheck(script_chars));
+}
+
+#endif  // defined(TARGET_ARCH_X64) || defined(TARGET_ARCH_ARM64)
+
 }  // namespace dart
@@ -12,6 +12,9 @@
 #include "vm/compiler/backend/il_printer.h"
 #include "vm/compiler/backend/inliner.h"
 #include "vm/compiler/backend/linearscan.h"
+#include "vm/compiler/backend/loop_unroller.h"
+#include "vm/compiler/backend/loop_vectorizer.h"
+#include "vm/compiler/backend/loop_versioner.h"
 #include "vm/compiler/backend/range_analysis.h"
 #include "vm/compiler/backend/redundancy_elimination.h"
 #include "vm/compiler/backend/type_propagator.h"
@@ -375,6 +378,13 @@ FlowGraph* CompilerPass::RunPipeline(PipelineMode mode,
   // so it should not be lifted earlier than that pass.
   INVOKE_PASS(DCE);
   INVOKE_PASS(Canonicalize);
+  // Vectorize, version and unroll loops once their bodies are free of dead
+  // code and of the environments of instructions that cannot deoptimize.
+  // Vector loops are not unrolled any further, versioned loops are unrolled
+  // once their checks are hoisted.
+  INVOKE_PASS(VectorizeLoops);
+  INVOKE_PASS(VersionLoops);
+  INVOKE_PASS(UnrollLoops);
   INVOKE_PASS_AOT(DelayAllocations);
   // Repeat branches optimization after DCE, as it could make more
   // empty blocks.
@@ -525,6 +535,12 @@ COMPILER_PASS(EliminateDeadPhis,
 
 COMPILER_PASS(DCE, { DeadCodeElimination::EliminateDeadCode(flow_graph); });
 
+COMPILER_PASS(VectorizeLoops, { LoopVectorizer::Optimize(flow_graph); });
+
+COMPILER_PASS(VersionLoops, { LoopVersioner::Optimize(flow_graph); });
+
+COMPILER_PASS(UnrollLoops, { LoopUnroller::Optimize(flow_graph); });
+
 COMPILER_PASS(DelayAllocations, { DelayAllocations::Optimize(flow_graph); });
 
 COMPILER_PASS(AllocationSinking_Sink, {
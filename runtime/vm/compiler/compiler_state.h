@@ -43,6 +43,9 @@ class CompilerState : public ThreadStackResource {
         is_optimizing_(is_optimizing),
         tracing_(tracing) {
     previous_ = thread->SetCompilerState(this);
+    if (previous_ != nullptr) {
+      program_change_listener_ = previous_->program_change_listener_;
+    }
   }
 
   ~CompilerState() {
@@ -121,6 +124,30 @@ class CompilerState : public ThreadStackResource {
 
   void ReportCrash();
 
+  // Notified before the compiler adds to the program, e.g. creates a closure
+  // or a dispatcher while it builds or optimizes a flow graph.
+  class ProgramChangeListener {
+   public:
+    virtual ~ProgramChangeListener() {}
+    virtual void WillChangeProgram() = 0;
+  };
+
+  // The listener is inherited by nested compiler states.
+  void set_program_change_listener(ProgramChangeListener* listener) {
+    program_change_listener_ = listener;
+  }
+
+  // Notifies the listener of the compilation running on [thread], if any.
+  // Must be called before the program lock is taken.
+  static void WillChangeProgram(Thread* thread) {
+    if (thread->HasCompilerState()) {
+      auto listener = thread->compiler_state().program_change_listener_;
+      if (listener != nullptr) {
+        listener->WillChangeProgram();
+      }
+    }
+  }
+
  private:
   CHA cha_;
   intptr_t deopt_id_ = 0;
@@ -147,6 +174,8 @@ class CompilerState : public ThreadStackResource {
   const CompilerPass* pass_ = nullptr;
   const CompilerPassState* pass_state_ = nullptr;
 
+  ProgramChangeListener* program_change_listener_ = nullptr;
+
   CompilerState* previous_;
 };
 
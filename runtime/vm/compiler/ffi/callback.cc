@@ -6,6 +6,7 @@
 
 #include "vm/canonical_tables.h"
 #include "vm/class_finalizer.h"
+#include "vm/compiler/compiler_state.h"
 #include "vm/object_store.h"
 #include "vm/symbols.h"
 
@@ -77,6 +78,7 @@ FunctionPtr NativeCallbackFunction(const FunctionType& c_signature,
     // Ensure only one thread updates the cache of deduped ffi trampoline
     // functions.
     auto isolate_group = thread->isolate_group();
+    CompilerState::WillChangeProgram(thread);
     SafepointWriteRwLocker ml(thread, isolate_group->program_lock());
 
     auto object_store = isolate_group->object_store();
@@ -5891,6 +5891,7 @@ Fragment StreamingFlowGraphBuilder::BuildFunctionNode(
   }
 
   if (function.IsNull()) {
+    CompilerState::WillChangeProgram(thread());
     SafepointWriteRwLocker ml(thread(),
                               thread()->isolate_group()->program_lock());
     // NOTE: This is not TokenPosition in the general sense!
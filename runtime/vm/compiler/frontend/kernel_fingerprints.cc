@@ -3,7 +3,9 @@
 // BSD-style license that can be found in the LICENSE file.
 
 #include "vm/compiler/frontend/kernel_fingerprints.h"
+#include "vm/compiler/frontend/constant_reader.h"
 #include "vm/compiler/frontend/kernel_translation_helper.h"
+#include "vm/hash.h"
 
 #define H (translation_helper_)
 #define I Isolate::Current()
@@ -11,6 +13,20 @@
 namespace dart {
 namespace kernel {
 
+// Gives access to the metadata of all nodes in a range.
+class MetadataRangeHelper : public MetadataHelper {
+ public:
+  MetadataRangeHelper(KernelReaderHelper* helper, const char* tag)
+      : MetadataHelper(helper, tag, /* precompiler_only = */ false) {}
+
+  intptr_t GetPayloadOffsetInRange(intptr_t* node_offset, intptr_t end) {
+    return GetMetadataPayloadOffsetInRange(node_offset, end);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MetadataRangeHelper);
+};
+
 class KernelFingerprintHelper : public KernelReaderHelper {
  public:
   KernelFingerprintHelper(Zone* zone,
@@ -23,12 +39,23 @@ class KernelFingerprintHelper : public KernelReaderHelper {
                            script,
                            data,
                            data_program_offset),
-        hash_(0) {}
+        hash_(0),
+        for_compilation_(false),
+        start_offset_(0),
+        compilation_hash_(0),
+        active_class_(),
+        constant_reader_(this, &active_class_) {}
 
   virtual ~KernelFingerprintHelper() {}
   uint32_t CalculateFieldFingerprint();
   uint32_t CalculateFunctionFingerprint();
 
+  // Calculates the fingerprint of the member at the current offset which
+  // also covers everything else its flow graph is built from.
+  uint64_t CalculateCompilationFingerprint();
+
+  void RecordTokenPosition(TokenPosition position) override;
+
   static uint32_t CalculateHash(uint32_t current, uint32_t val) {
     return current * 31 + val;
   }
@@ -61,13 +88,244 @@ class KernelFingerprintHelper : public KernelReaderHelper {
   void CalculateStatementFingerprint();
   void CalculateFunctionNodeFingerprint();
 
+  // Only contribute to the compilation fingerprint.
+  void CalculateVariablePositionFingerprint();
+  void CalculateCanonicalNamePathFingerprint(NameIndex name);
+  void CalculateConstantFingerprint(intptr_t constant_index);
+  void CalculateMetadataFingerprint(intptr_t start, intptr_t end);
+  void CalculateSourceUriFingerprint(intptr_t source_uri_index);
+
+  // In compilation mode, these also hash what they read or skip. They hide
+  // rather than override the KernelReaderHelper methods, so what is read
+  // through the base class, e.g. by FieldHelper and the other node helpers,
+  // is hashed explicitly from the fields of the helpers.
+  bool ReadBool();
+  uint8_t ReadByte();
+  uint8_t ReadFlags();
+  uint32_t ReadUInt();
+  NameIndex ReadCanonicalNameReference();
+  void SkipBytes(intptr_t skip);
+  void SkipCanonicalNameReference();
+  void SkipConstantReference();
+  void SkipDartType();
+  void SkipListOfDartTypes();
+  void SkipExpression();
+
   uint32_t hash_;
 
+  // Whether a compilation fingerprint is calculated. It hashes everything
+  // that affects the flow graph, including source positions, constants and
+  // the full names of referenced members, into [compilation_hash_].
+  bool for_compilation_;
+  intptr_t start_offset_;
+  uint32_t compilation_hash_;
+  ActiveClass active_class_;
+  ConstantReader constant_reader_;
+
   DISALLOW_COPY_AND_ASSIGN(KernelFingerprintHelper);
 };
 
 void KernelFingerprintHelper::BuildHash(uint32_t val) {
   hash_ = CalculateHash(hash_, val);
+  if (for_compilation_) {
+    compilation_hash_ = CombineHashes(compilation_hash_, val);
+  }
+}
+
+void KernelFingerprintHelper::RecordTokenPosition(TokenPosition position) {
+  if (for_compilation_) {
+    BuildHash(position.Serialize());
+  }
+}
+
+bool KernelFingerprintHelper::ReadBool() {
+  const bool value = KernelReaderHelper::ReadBool();
+  if (for_compilation_) {
+    BuildHash(static_cast<uint32_t>(value));
+  }
+  return value;
+}
+
+uint8_t KernelFingerprintHelper::ReadByte() {
+  const uint8_t value = KernelReaderHelper::ReadByte();
+  if (for_compilation_) {
+    BuildHash(value);
+  }
+  return value;
+}
+
+uint8_t KernelFingerprintHelper::ReadFlags() {
+  const uint8_t value = KernelReaderHelper::ReadFlags();
+  if (for_compilation_) {
+    BuildHash(value);
+  }
+  return value;
+}
+
+uint32_t KernelFingerprintHelper::ReadUInt() {
+  const uint32_t value = KernelReaderHelper::ReadUInt();
+  if (for_compilation_) {
+    BuildHash(value);
+  }
+  return value;
+}
+
+NameIndex KernelFingerprintHelper::ReadCanonicalNameReference() {
+  const NameIndex name = KernelReaderHelper::ReadCanonicalNameReference();
+  if (for_compilation_) {
+    CalculateCanonicalNamePathFingerprint(name);
+  }
+  return name;
+}
+
+void KernelFingerprintHelper::SkipBytes(intptr_t skip) {
+  if (!for_compilation_) {
+    KernelReaderHelper::SkipBytes(skip);
+    return;
+  }
+  for (intptr_t i = 0; i < skip; ++i) {
+    ReadByte();
+  }
+}
+
+void KernelFingerprintHelper::SkipCanonicalNameReference() {
+  if (!for_compilation_) {
+    KernelReaderHelper::SkipCanonicalNameReference();
+    return;
+  }
+  ReadCanonicalNameReference();
+}
+
+void KernelFingerprintHelper::SkipConstantReference() {
+  if (!for_compilation_) {
+    KernelReaderHelper::SkipConstantReference();
+    return;
+  }
+  CalculateConstantFingerprint(KernelReaderHelper::ReadUInt());
+}
+
+void KernelFingerprintHelper::SkipDartType() {
+  if (!for_compilation_) {
+    KernelReaderHelper::SkipDartType();
+    return;
+  }
+  CalculateDartTypeFingerprint();
+}
+
+void KernelFingerprintHelper::SkipListOfDartTypes() {
+  if (!for_compilation_) {
+    KernelReaderHelper::SkipListOfDartTypes();
+    return;
+  }
+  CalculateListOfDartTypesFingerprint();
+}
+
+void KernelFingerprintHelper::SkipExpression() {
+  if (!for_compilation_) {
+    KernelReaderHelper::SkipExpression();
+    return;
+  }
+  CalculateExpressionFingerprint();
+}
+
+void KernelFingerprintHelper::CalculateVariablePositionFingerprint() {
+  const intptr_t position = KernelReaderHelper::ReadUInt();
+  if (for_compilation_) {
+    // Variables are referred to by the offset of their declaration in the
+    // component, which moves with any change before the member.
+    BuildHash(position - start_offset_);
+  }
+}
+
+void KernelFingerprintHelper::CalculateSourceUriFingerprint(
+    intptr_t source_uri_index) {
+  if (for_compilation_) {
+    // The index into the source table moves with any change to it.
+    BuildHash(SourceTableUriFor(source_uri_index).Hash());
+  }
+}
+
+void KernelFingerprintHelper::CalculateCanonicalNamePathFingerprint(
+    NameIndex name) {
+  // The names of the parents identify the library and class of a member.
+  for (; !H.IsRoot(name); name = H.CanonicalNameParent(name)) {
+    BuildHash(H.DartString(H.CanonicalNameString(name)).Hash());
+  }
+  BuildHash(0);
+}
+
+void KernelFingerprintHelper::CalculateConstantFingerprint(
+    intptr_t constant_index) {
+  // Constants are referred to by their index in the constant table of the
+  // component, so hash their value instead.
+  const Instance& constant =
+      Instance::Handle(zone_, constant_reader_.ReadConstant(constant_index));
+  if (constant.IsNull()) {
+    BuildHash(kNullCid);
+    return;
+  }
+  BuildHash(constant.GetClassId());
+  BuildHash(constant.CanonicalizeHash());
+}
+
+void KernelFingerprintHelper::CalculateMetadataFingerprint(intptr_t start,
+                                                           intptr_t end) {
+  enum MetadataKind {
+    kDirectCall,
+    kInferredType,
+    kProcedureAttributes,
+    kCallSiteAttributes,
+    kUnboxingInfo,
+    kNumMetadataKinds,
+  };
+  const char* const tags[kNumMetadataKinds] = {
+      DirectCallMetadataHelper::tag(),
+      InferredTypeMetadataHelper::tag(),
+      ProcedureAttributesMetadataHelper::tag(),
+      CallSiteAttributesMetadataHelper::tag(),
+      UnboxingInfoMetadataHelper::tag(),
+  };
+  for (intptr_t kind = 0; kind < kNumMetadataKinds; ++kind) {
+    MetadataRangeHelper helper(this, tags[kind]);
+    intptr_t node_offset = start;
+    intptr_t md_offset;
+    while ((md_offset = helper.GetPayloadOffsetInRange(&node_offset, end)) >=
+           0) {
+      BuildHash(kind);
+      BuildHash(node_offset - start);
+      AlternativeReadingScopeWithNewData alt(&reader_, &H.metadata_payloads(),
+                                             md_offset);
+      switch (kind) {
+        case kDirectCall:
+          ReadCanonicalNameReference();  // read target.
+          ReadBool();                    // read check_receiver_for_null.
+          break;
+        case kInferredType:
+          ReadCanonicalNameReference();  // read class.
+          if ((ReadByte() & InferredTypeMetadata::kFlagConstant) != 0) {
+            SkipConstantReference();  // read constant value.
+          }
+          break;
+        case kProcedureAttributes:
+          ReadByte();  // read flags.
+          ReadUInt();  // read method_or_setter_selector_id.
+          ReadUInt();  // read getter_selector_id.
+          break;
+        case kCallSiteAttributes:
+          CalculateDartTypeFingerprint();  // read receiver type.
+          break;
+        case kUnboxingInfo: {
+          const intptr_t num_args = ReadUInt();
+          SkipBytes(num_args);  // read unboxing info of arguments.
+          ReadByte();           // read unboxing info of the return value.
+          break;
+        }
+        default:
+          UNREACHABLE();
+      }
+      ++node_offset;
+    }
+  }
 }
 
 void KernelFingerprintHelper::CalculateConstructorFingerprint() {
@@ -82,6 +340,7 @@ void KernelFingerprintHelper::CalculateConstructorFingerprint() {
   }
   helper.SetJustRead(ConstructorHelper::kInitializers);
   BuildHash(helper.flags_);
+  CalculateSourceUriFingerprint(helper.source_uri_index_);
 }
 
 void KernelFingerprintHelper::CalculateArgumentsFingerprint() {
@@ -107,6 +366,9 @@ void KernelFingerprintHelper::CalculateVariableDeclarationFingerprint() {
   }
 
   BuildHash(helper.flags_);
+  if (for_compilation_) {
+    BuildHash(H.DartString(helper.name_index_).Hash());
+  }
 }
 
 void KernelFingerprintHelper::CalculateStatementListFingerprint() {
@@ -175,6 +437,9 @@ void KernelFingerprintHelper::CalculateTypeParameterFingerprint() {
   CalculateDartTypeFingerprint();  // read bound
   CalculateDartTypeFingerprint();  // read default type
   BuildHash(helper.flags_);
+  if (for_compilation_) {
+    BuildHash(H.DartString(helper.name_index_).Hash());
+  }
 }
 
 void KernelFingerprintHelper::CalculateTypeParametersListFingerprint() {
@@ -378,24 +643,24 @@ void KernelFingerprintHelper::CalculateExpressionFingerprint() {
       return;
     case kVariableGet:
       ReadPosition();                          // read position.
-      ReadUInt();                              // read kernel position.
+      CalculateVariablePositionFingerprint();  // read kernel position.
       ReadUInt();                              // read relative variable index.
       CalculateOptionalDartTypeFingerprint();  // read promoted type.
       return;
     case kSpecializedVariableGet:
-      ReadPosition();  // read position.
-      ReadUInt();      // read kernel position.
+      ReadPosition();                          // read position.
+      CalculateVariablePositionFingerprint();  // read kernel position.
       return;
     case kVariableSet:
-      ReadPosition();                    // read position.
-      ReadUInt();                        // read kernel position.
-      ReadUInt();                        // read relative variable index.
-      CalculateExpressionFingerprint();  // read expression.
+      ReadPosition();                          // read position.
+      CalculateVariablePositionFingerprint();  // read kernel position.
+      ReadUInt();                              // read relative variable index.
+      CalculateExpressionFingerprint();        // read expression.
       return;
     case kSpecializedVariableSet:
-      ReadPosition();                    // read position.
-      ReadUInt();                        // read kernel position.
-      CalculateExpressionFingerprint();  // read expression.
+      ReadPosition();                          // read position.
+      CalculateVariablePositionFingerprint();  // read kernel position.
+      CalculateExpressionFingerprint();        // read expression.
       return;
     case kInstanceGet:
       ReadByte();                                // read kind.
@@ -486,11 +751,11 @@ void KernelFingerprintHelper::CalculateExpressionFingerprint() {
       CalculateArgumentsFingerprint();           // read arguments.
       return;
     case kLocalFunctionInvocation:
-      ReadPosition();                   // read position.
-      ReadUInt();                       // read variable kernel position.
-      ReadUInt();                       // read relative variable index.
-      CalculateArgumentsFingerprint();  // read arguments.
-      SkipDartType();                   // read function_type.
+      ReadPosition();                          // read position.
+      CalculateVariablePositionFingerprint();  // read variable kernel position.
+      ReadUInt();                              // read relative variable index.
+      CalculateArgumentsFingerprint();         // read arguments.
+      SkipDartType();                          // read function_type.
       return;
     case kFunctionInvocation:
       BuildHash(ReadByte());             // read kind.
@@ -845,6 +1110,13 @@ uint32_t KernelFingerprintHelper::CalculateFieldFingerprint() {
   const String& name = ReadNameAsFieldName();  // read name.
   field_helper.SetJustRead(FieldHelper::kName);
 
+  if (for_compilation_) {
+    // Pragmas affect the compilation.
+    field_helper.ReadUntilExcluding(FieldHelper::kAnnotations);
+    CalculateListOfExpressionsFingerprint();
+    field_helper.SetJustRead(FieldHelper::kAnnotations);
+  }
+
   field_helper.ReadUntilExcluding(FieldHelper::kType);
   CalculateDartTypeFingerprint();  // read type.
   field_helper.SetJustRead(FieldHelper::kType);
@@ -860,6 +1132,7 @@ uint32_t KernelFingerprintHelper::CalculateFieldFingerprint() {
   BuildHash(name.Hash());
   BuildHash(field_helper.flags_);
   BuildHash(field_helper.annotation_count_);
+  CalculateSourceUriFingerprint(field_helper.source_uri_index_);
   return hash_;
 }
 
@@ -882,6 +1155,10 @@ void KernelFingerprintHelper::CalculateFunctionNodeFingerprint() {
   }
   BuildHash(function_node_helper.total_parameter_count_);
   BuildHash(function_node_helper.required_parameter_count_);
+  if (for_compilation_) {
+    BuildHash(function_node_helper.async_marker_);
+    BuildHash(function_node_helper.dart_async_marker_);
+  }
 }
 
 uint32_t KernelFingerprintHelper::CalculateFunctionFingerprint() {
@@ -898,7 +1175,18 @@ uint32_t KernelFingerprintHelper::CalculateFunctionFingerprint() {
   const String& name = ReadNameAsMethodName();  // Read name.
   procedure_helper.SetJustRead(ProcedureHelper::kName);
 
+  if (for_compilation_) {
+    // Pragmas affect the compilation.
+    procedure_helper.ReadUntilExcluding(ProcedureHelper::kAnnotations);
+    CalculateListOfExpressionsFingerprint();
+    procedure_helper.SetJustRead(ProcedureHelper::kAnnotations);
+  }
   procedure_helper.ReadUntilExcluding(ProcedureHelper::kFunction);
+  if (for_compilation_ && procedure_helper.stub_kind_ ==
+                              ProcedureHelper::kConcreteForwardingStubKind) {
+    CalculateCanonicalNamePathFingerprint(
+        procedure_helper.concrete_forwarding_stub_target_);
+  }
   CalculateFunctionNodeFingerprint();
 
   BuildHash(procedure_helper.kind_);
@@ -906,9 +1194,21 @@ uint32_t KernelFingerprintHelper::CalculateFunctionFingerprint() {
   BuildHash(procedure_helper.annotation_count_);
   BuildHash(procedure_helper.stub_kind_);
   BuildHash(name.Hash());
+  CalculateSourceUriFingerprint(procedure_helper.source_uri_index_);
   return hash_;
 }
 
+uint64_t KernelFingerprintHelper::CalculateCompilationFingerprint() {
+  for_compilation_ = true;
+  compilation_hash_ = 0;
+  const intptr_t start = ReaderOffset();
+  start_offset_ = data_program_offset_ + start;
+  CalculateFunctionFingerprint();
+  CalculateMetadataFingerprint(start, ReaderOffset());
+  return (static_cast<uint64_t>(FinalizeHash(compilation_hash_)) << 32) |
+         hash_;
+}
+
 uint32_t KernelSourceFingerprintHelper::CalculateClassFingerprint(
     const Class& klass) {
   Zone* zone = Thread::Current()->zone();
@@ -987,5 +1287,39 @@ uint32_t KernelSourceFingerprintHelper::CalculateFunctionFingerprint(
   return helper.CalculateFunctionFingerprint();
 }
 
+uint64_t KernelSourceFingerprintHelper::CalculateFieldCompilationFingerprint(
+    const Field& field) {
+  Thread* thread = Thread::Current();
+  Zone* zone = thread->zone();
+  const Script& script = Script::Handle(zone, field.Script());
+
+  TranslationHelper translation_helper(thread);
+  translation_helper.InitFromScript(script);
+
+  KernelFingerprintHelper helper(
+      zone, &translation_helper, script,
+      ExternalTypedData::Handle(zone, field.KernelData()),
+      field.KernelDataProgramOffset());
+  helper.SetOffset(field.kernel_offset());
+  return helper.CalculateCompilationFingerprint();
+}
+
+uint64_t KernelSourceFingerprintHelper::CalculateFunctionCompilationFingerprint(
+    const Function& func) {
+  Thread* thread = Thread::Current();
+  Zone* zone = thread->zone();
+  const Script& script = Script::Handle(zone, func.script());
+
+  TranslationHelper translation_helper(thread);
+  translation_helper.InitFromScript(script);
+
+  KernelFingerprintHelper helper(
+      zone, &translation_helper, script,
+      ExternalTypedData::Handle(zone, func.KernelData()),
+      func.KernelDataProgramOffset());
+  helper.SetOffset(func.kernel_offset());
+  return helper.CalculateCompilationFingerprint();
+}
+
 }  // namespace kernel
 }  // namespace dart
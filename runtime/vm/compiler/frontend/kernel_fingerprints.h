@@ -20,6 +20,15 @@ class KernelSourceFingerprintHelper : public AllStatic {
   static uint32_t CalculateClassFingerprint(const Class& klass);
   static uint32_t CalculateFieldFingerprint(const Field& field);
   static uint32_t CalculateFunctionFingerprint(const Function& func);
+
+  // Unlike the fingerprints above, which only change with the source, these
+  // cover everything in the kernel of the member which the flow graph built
+  // for it depends on. Besides its body, this includes source positions, the
+  // values of constants, the libraries and classes of referenced members,
+  // annotations and the metadata attached by the global transformations.
+  static uint64_t CalculateFieldCompilationFingerprint(const Field& field);
+  static uint64_t CalculateFunctionCompilationFingerprint(
+      const Function& func);
 };
 
 }  // namespace kernel
@@ -1673,6 +1673,36 @@ intptr_t MetadataHelper::GetNextMetadataPayloadOffset(intptr_t node_offset) {
   }
 }
 
+intptr_t MetadataHelper::GetMetadataPayloadOffsetInRange(intptr_t* node_offset,
+                                                        intptr_t end) {
+  if (!mappings_scanned_) {
+    ScanMetadataMappings();
+    mappings_scanned_ = true;
+  }
+
+  if (mappings_num_ == 0) {
+    return -1;  // No metadata.
+  }
+
+  const intptr_t index =
+      FindMetadataMapping(*node_offset + helper_->data_program_offset_);
+  if (index == mappings_num_) {
+    return -1;
+  }
+
+  Reader reader(H.metadata_mappings());
+  const intptr_t kUInt32Size = 4;
+  reader.set_offset(mappings_offset_ + index * 2 * kUInt32Size);
+  const intptr_t mapping_node_offset =
+      reader.ReadUInt32() - helper_->data_program_offset_;
+  const intptr_t mapping_md_offset = reader.ReadUInt32();
+  if (mapping_node_offset >= end) {
+    return -1;
+  }
+  *node_offset = mapping_node_offset;
+  return mapping_md_offset;
+}
+
 intptr_t MetadataHelper::GetComponentMetadataPayloadOffset() {
   const intptr_t kComponentNodeOffset = 0;
   return GetNextMetadataPayloadOffset(kComponentNodeOffset -
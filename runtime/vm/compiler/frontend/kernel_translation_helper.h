@@ -958,6 +958,12 @@ class MetadataHelper {
   // Assumes metadata is accesses for nodes in linear order most of the time.
   intptr_t GetNextMetadataPayloadOffset(intptr_t node_offset);
 
+  // Return offset of the metadata payload of the first node at or after
+  // [*node_offset] and before [end], or -1 if there is no such node.
+  // Sets [*node_offset] to the offset of the node.
+  intptr_t GetMetadataPayloadOffsetInRange(intptr_t* node_offset,
+                                           intptr_t end);
+
   // Returns metadata associated with component.
   intptr_t GetComponentMetadataPayloadOffset();
 
@@ -25,6 +25,7 @@
 #include "vm/exceptions.h"
 #include "vm/flags.h"
 #include "vm/growable_array.h"
+#include "vm/heap/memory_pressure.h"
 #include "vm/heap/verifier.h"
 #include "vm/image_snapshot.h"
 #include "vm/isolate_reload.h"
@@ -1855,8 +1856,10 @@ DART_EXPORT void Dart_SetHeapSamplingPeriod(intptr_t bytes) {
 
 DART_EXPORT void Dart_NotifyLowMemory() {
   API_TIMELINE_BEGIN_END(Thread::Current());
-  Page::ClearCache();
-  Zone::ClearCache();
+  // Releases the page and zone caches, shrinks old-space growth and has each
+  // heap collect old space after its next scavenge, as when the cgroup reports
+  // critical pressure.
+  MemoryPressure::Global()->NotifyLowMemory(OS::GetCurrentMonotonicMicros());
 
   // For each isolate's global variables, we might also clear:
   //  - RegExp backtracking stack (both bytecode and compiled versions)
@@ -7134,4 +7137,18 @@ DART_EXPORT char* Dart_WriteHeapSnapshot(
 #endif
 }
 
+DART_EXPORT char* Dart_WriteHeapProfile(uint8_t** buffer,
+                                        intptr_t* buffer_size) {
+#if !defined(PRODUCT)
+  if ((buffer == nullptr) || (buffer_size == nullptr)) {
+    return Utils::StrDup("Dart_WriteHeapProfile expects a buffer and a size.");
+  }
+  DARTSCOPE(Thread::Current());
+  *buffer = T->heap()->heap_profile()->Write(T, buffer_size);
+  return nullptr;
+#else
+  return Utils::StrDup("VM is built without the heap profile.");
+#endif
+}
+
 }  // namespace dart
@@ -10651,6 +10651,60 @@ TEST_CASE(DartAPI_HeapSampling_NonTrivialSamplingPeriod) {
   Dart_RegisterHeapSamplingCallback(nullptr);
 }
 
+static bool BufferContains(const uint8_t* buffer,
+                           intptr_t size,
+                           const char* str) {
+  const intptr_t length = strlen(str);
+  for (intptr_t i = 0; i + length <= size; i++) {
+    if (memcmp(buffer + i, str, length) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+TEST_CASE(DartAPI_HeapSampling_WriteHeapProfile) {
+  DisableBackgroundCompilationScope scope;
+  const char* kScriptChars = R"(
+    class Bar {}
+    final retained = [];
+    allocateBars() {
+      for (int i = 0; i < 10000; ++i) {
+        retained.add(Bar());
+      }
+    }
+    )";
+  Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, nullptr);
+  EXPECT_VALID(lib);
+
+  InitHeapSampling(thread);
+  Dart_SetHeapSamplingPeriod(1 << 10);
+  HandleInterrupts(thread);
+
+  Dart_Handle result = Dart_Invoke(lib, NewString("allocateBars"), 0, nullptr);
+  EXPECT_VALID(result);
+  EXPECT(heap_samples > 0);
+
+  uint8_t* buffer = nullptr;
+  intptr_t size = 0;
+  char* error = Dart_WriteHeapProfile(&buffer, &size);
+  EXPECT(error == nullptr);
+  EXPECT_GT(size, 0);
+  // The string table names the sample types and the allocating function.
+  EXPECT(BufferContains(buffer, size, "alloc_space"));
+  EXPECT(BufferContains(buffer, size, "inuse_space"));
+  EXPECT(BufferContains(buffer, size, "allocateBars"));
+  free(buffer);
+
+  error = Dart_WriteHeapProfile(nullptr, &size);
+  EXPECT(error != nullptr);
+  free(error);
+
+  Dart_DisableHeapSampling();
+  HandleInterrupts(thread);
+  Dart_RegisterHeapSamplingCallback(nullptr);
+}
+
 #endif  // !PRODUCT
 
 #if defined(DART_ENABLE_HEAP_SNAPSHOT_WRITER)
@@ -548,6 +548,16 @@ class FinalizablePersistentHandles
             kOffsetOfRawPtrInFinalizablePersistentHandle>::Visit(visitor);
   }
 
+  // Visit one of [num_slices] disjoint subsets of the handles.
+  void VisitHandles(HandleVisitor* visitor,
+                    intptr_t slice,
+                    intptr_t num_slices) {
+    Handles<kFinalizablePersistentHandleSizeInWords,
+            kFinalizablePersistentHandlesPerChunk,
+            kOffsetOfRawPtrInFinalizablePersistentHandle>::
+        VisitSlice(visitor, slice, num_slices);
+  }
+
   // Visit all object pointers stored in the various handles.
   void VisitObjectPointers(ObjectPointerVisitor* visitor) {
     visitor->set_gc_root_type("weak persistent handle");
@@ -720,6 +730,12 @@ class ApiState {
     weak_persistent_handles_.VisitHandles(visitor);
   }
 
+  void VisitWeakHandlesUnlocked(HandleVisitor* visitor,
+                                intptr_t slice,
+                                intptr_t num_slices) {
+    weak_persistent_handles_.VisitHandles(visitor, slice, num_slices);
+  }
+
   PersistentHandle* AllocatePersistentHandle() {
     MutexLocker ml(&mutex_);
     return persistent_handles_.AllocateHandle();
@@ -5,6 +5,7 @@
 #include "vm/flags.h"
 
 #include "platform/assert.h"
+#include "vm/hash.h"
 #include "vm/isolate.h"
 #include "vm/json_stream.h"
 #include "vm/os.h"
@@ -494,6 +495,50 @@ void Flags::PrintFlags() {
   }
 }
 
+static uint32_t HashString(uint32_t hash, const char* value) {
+  if (value == nullptr) {
+    return CombineHashes(hash, 0);
+  }
+  return CombineHashes(
+      hash, HashBytes(reinterpret_cast<const uint8_t*>(value), strlen(value)));
+}
+
+uint32_t Flags::Hash(const char* excluded) {
+  uint32_t hash = 0;
+  for (intptr_t i = 0; i < num_flags_; ++i) {
+    const Flag* flag = flags_[i];
+    if (flag->IsUnrecognized() ||
+        (excluded != nullptr && strcmp(flag->name_, excluded) == 0)) {
+      continue;
+    }
+    hash = HashString(hash, flag->name_);
+    switch (flag->type_) {
+      case Flag::kBoolean:
+        hash = CombineHashes(hash, *flag->bool_ptr_ ? 1 : 0);
+        break;
+      case Flag::kInteger:
+        hash = CombineHashes(hash, static_cast<uint32_t>(*flag->int_ptr_));
+        break;
+      case Flag::kUint64:
+        hash = CombineHashes(hash, static_cast<uint32_t>(*flag->uint64_ptr_));
+        hash = CombineHashes(hash,
+                             static_cast<uint32_t>(*flag->uint64_ptr_ >> 32));
+        break;
+      case Flag::kString:
+        hash = HashString(hash, *flag->charp_ptr_);
+        break;
+      case Flag::kFlagHandler:
+      case Flag::kOptionHandler:
+        hash = HashString(hash, flag->string_value_.get());
+        break;
+      default:
+        UNREACHABLE();
+        break;
+    }
+  }
+  return FinalizeHash(hash);
+}
+
 #ifndef PRODUCT
 void Flags::PrintFlagToJSONArray(JSONArray* jsarr, const Flag* flag) {
   if (flag->IsUnrecognized()) {
@@ -79,6 +79,10 @@ class Flags {
 
   static bool SetFlag(const char* name, const char* value, const char** error);
 
+  // Returns a hash of the names and current values of all flags other than
+  // [excluded].
+  static uint32_t Hash(const char* excluded = nullptr);
+
  private:
   static Flag** flags_;
   static intptr_t capacity_;
@@ -75,6 +75,11 @@ class Handles {
   // Visit all of the various handles.
   void Visit(HandleVisitor* visitor);
 
+  // Visit the handles in every [num_slices]th block, starting with block
+  // [slice]. Visiting all slices visits the same handles as Visit, which lets
+  // the blocks be divided between several GC tasks.
+  void VisitSlice(HandleVisitor* visitor, intptr_t slice, intptr_t num_slices);
+
   // Reset the handles so that we can reuse.
   void Reset();
 
@@ -7,16 +7,29 @@
 #include "platform/assert.h"
 #include "platform/utils.h"
 
+#include "vm/dart.h"
 #include "vm/dart_api_state.h"
+#include "vm/heap/gc_shared.h"
+#include "vm/heap/pages.h"
 #include "vm/heap/safepoint.h"
+#include "vm/heap/scavenger.h"
 #include "vm/isolate_reload.h"
+#include "vm/lockers.h"
 #include "vm/object.h"
 #include "vm/raw_object.h"
+#include "vm/thread_barrier.h"
+#include "vm/thread_pool.h"
 #include "vm/timeline.h"
 #include "vm/visitor.h"
 
 namespace dart {
 
+DEFINE_FLAG(int,
+            become_tasks,
+            2,
+            "The number of tasks forwarding the pointers in the heap after a "
+            "become.");
+
 ForwardingCorpse* ForwardingCorpse::AsForwarder(uword addr, intptr_t size) {
   ASSERT(size >= kObjectAlignment);
   ASSERT(Utils::IsAligned(size, kObjectAlignment));
@@ -217,6 +230,64 @@ class WritableCodeLiteralsScope : public ValueObject {
 };
 #endif
 
+// Forwards the pointers in the objects on pages claimed from a shared index.
+// Each page is visited by a single task, so the remembered bits and card
+// tables of its objects are only updated by that task.
+class BecomeTask : public ThreadPool::Task {
+ public:
+  BecomeTask(IsolateGroup* isolate_group,
+             ThreadBarrier* barrier,
+             RelaxedAtomic<intptr_t>* next_page,
+             Page* const* pages,
+             intptr_t num_pages)
+      : isolate_group_(isolate_group),
+        barrier_(barrier),
+        next_page_(next_page),
+        pages_(pages),
+        num_pages_(num_pages) {}
+
+  void Run() {
+    if (!barrier_->TryEnter()) {
+      barrier_->Release();
+      return;
+    }
+
+    bool result = Thread::EnterIsolateGroupAsHelper(
+        isolate_group_, Thread::kBecomeTask, /*bypass_safepoint=*/true);
+    ASSERT(result);
+    RunEnteredIsolateGroup();
+    Thread::ExitIsolateGroupAsHelper(/*bypass_safepoint=*/true);
+
+    // This task is done. Notify the original thread.
+    barrier_->Sync();
+    barrier_->Release();
+  }
+
+  void RunEnteredIsolateGroup() {
+    // The store buffer and marking stack blocks filled by the barrier belong
+    // to the current thread, which may be a helper.
+    ForwardPointersVisitor pointer_visitor(Thread::Current());
+    ForwardHeapPointersVisitor object_visitor(&pointer_visitor);
+    while (true) {
+      const intptr_t index = next_page_->fetch_add(1u);
+      if (index >= num_pages_) break;
+      pages_[index]->VisitObjects(&object_visitor);
+    }
+    pointer_visitor.VisitingObject(nullptr);
+  }
+
+ private:
+  IsolateGroup* isolate_group_;
+  ThreadBarrier* barrier_;
+  RelaxedAtomic<intptr_t>* next_page_;
+  Page* const* pages_;
+  intptr_t num_pages_;
+
+  DISALLOW_COPY_AND_ASSIGN(BecomeTask);
+};
+
+static constexpr intptr_t kBecomeWordsPerTask = 8 * MBInWords;
+
 Become::Become() {
   IsolateGroup* group = Thread::Current()->isolate_group();
   ASSERT(group->become() == nullptr);  // Only one outstanding become at a time.
@@ -341,17 +412,14 @@ void Become::FollowForwardingPointers(Thread* thread) {
   isolate_group->ReleaseStoreBuffers();
   isolate_group->store_buffer()->Reset();
 
-  ForwardPointersVisitor pointer_visitor(thread);
-
   {
     // Heap pointers.
     WritableCodeLiteralsScope writable_code(heap);
-    ForwardHeapPointersVisitor object_visitor(&pointer_visitor);
-    heap->VisitObjects(&object_visitor);
-    pointer_visitor.VisitingObject(NULL);
+    ForwardHeapPointers(thread);
   }
 
   // C++ pointers.
+  ForwardPointersVisitor pointer_visitor(thread);
   isolate_group->VisitObjectPointers(&pointer_visitor,
                                      ValidationPolicy::kValidateFrames);
 #ifndef PRODUCT
@@ -370,4 +438,65 @@ void Become::FollowForwardingPointers(Thread* thread) {
   isolate_group->VisitWeakPersistentHandles(&handle_visitor);
 }
 
+void Become::ForwardHeapPointers(Thread* thread) {
+  auto isolate_group = thread->isolate_group();
+  Heap* heap = isolate_group->heap();
+  PageSpace* old_space = heap->old_space();
+
+  // Keep the old-space page lists from changing, as the page iterators do.
+  MutexLocker ml(&old_space->pages_lock_);
+  old_space->MakeIterable();
+  NoSafepointScope no_safepoint;
+
+  MallocGrowableArray<Page*> pages;
+  for (Page* page = heap->new_space()->head(); page != nullptr;
+       page = page->next()) {
+    pages.Add(page);
+  }
+  for (Page* page = old_space->pages_; page != nullptr; page = page->next()) {
+    pages.Add(page);
+  }
+  for (Page* page = old_space->exec_pages_; page != nullptr;
+       page = page->next()) {
+    pages.Add(page);
+  }
+  for (Page* page = old_space->large_pages_; page != nullptr;
+       page = page->next()) {
+    pages.Add(page);
+  }
+  for (Page* page = old_space->image_pages_; page != nullptr;
+       page = page->next()) {
+    pages.Add(page);
+  }
+  const intptr_t num_pages = pages.length();
+  if (num_pages == 0) {
+    return;
+  }
+
+  const intptr_t num_tasks = Utils::Minimum<intptr_t>(
+      num_pages,
+      Utils::Maximum<intptr_t>(
+          1, ChooseGCTasks(FLAG_become_tasks,
+                           heap->UsedInWords(Heap::kNew) +
+                               heap->UsedInWords(Heap::kOld),
+                           kBecomeWordsPerTask)));
+  TIMELINE_FUNCTION_GC_DURATION(thread, "ForwardHeapPointers");
+
+  ThreadBarrier* barrier = new ThreadBarrier(num_tasks, 1);
+  RelaxedAtomic<intptr_t> next_page = {0};
+  for (intptr_t task_index = 0; task_index < num_tasks; task_index++) {
+    if (task_index < (num_tasks - 1)) {
+      Dart::thread_pool()->Run<BecomeTask>(isolate_group, barrier, &next_page,
+                                           pages.data(), num_pages);
+    } else {
+      // Last worker is the main thread.
+      BecomeTask task(isolate_group, barrier, &next_page, pages.data(),
+                      num_pages);
+      task.RunEnteredIsolateGroup();
+      barrier->Sync();
+      barrier->Release();
+    }
+  }
+}
+
 }  // namespace dart
@@ -114,6 +114,10 @@ class Become {
   static void FollowForwardingPointers(Thread* thread);
 
  private:
+  // Forwards the pointers in all heap pages, using up to --become_tasks
+  // tasks.
+  static void ForwardHeapPointers(Thread* thread);
+
   MallocGrowableArray<ObjectPtr> pointers_;
   DISALLOW_COPY_AND_ASSIGN(Become);
 };
@@ -5,13 +5,17 @@
 #include "platform/assert.h"
 #include "platform/globals.h"
 
+#include "vm/benchmark_test.h"
 #include "vm/globals.h"
 #include "vm/heap/become.h"
 #include "vm/heap/heap.h"
+#include "vm/timer.h"
 #include "vm/unit_test.h"
 
 namespace dart {
 
+DECLARE_FLAG(int, become_tasks);
+
 void TestBecomeForward(Heap::Space before_space, Heap::Space after_space) {
   // Allocate the container in old space to test the remembered set.
   const Array& container = Array::Handle(Array::New(1, Heap::kOld));
@@ -194,4 +198,104 @@ ISOLATE_UNIT_TEST_CASE(BecomeForwardRememberedCards) {
   }
 }
 
+// Fills [num_arrays] old-space arrays of [length] elements with references to
+// the elements of [before], forwards those to the elements of [after] and
+// returns the time the become took in microseconds.
+static int64_t ForwardManyReferences(intptr_t num_arrays,
+                                     intptr_t length,
+                                     const Array& before,
+                                     const Array& after) {
+  const intptr_t num_forwarded = before.Length();
+  const Array& arrays = Array::Handle(Array::New(num_arrays, Heap::kOld));
+  Array& array = Array::Handle();
+  Object& element = Object::Handle();
+  for (intptr_t i = 0; i < num_arrays; i++) {
+    array = Array::New(length, Heap::kOld);
+    for (intptr_t j = 0; j < length; j++) {
+      element = before.At((i + j) % num_forwarded);
+      array.SetAt(j, element);
+    }
+    arrays.SetAt(i, array);
+  }
+
+  Timer timer;
+  timer.Start();
+  {
+    Become become;
+    Object& before_obj = Object::Handle();
+    Object& after_obj = Object::Handle();
+    for (intptr_t i = 0; i < num_forwarded; i++) {
+      before_obj = before.At(i);
+      after_obj = after.At(i);
+      become.Add(before_obj, after_obj);
+    }
+    become.Forward();
+  }
+  timer.Stop();
+
+  for (intptr_t i = 0; i < num_arrays; i++) {
+    array ^= arrays.At(i);
+    for (intptr_t j = 0; j < length; j++) {
+      if (array.At(j) != after.At((i + j) % num_forwarded)) {
+        FATAL("become: Reference not forwarded");
+      }
+    }
+  }
+  return timer.TotalElapsedTime();
+}
+
+static void AllocateForwardingPairs(intptr_t count,
+                                    Heap::Space after_space,
+                                    Array* before,
+                                    Array* after) {
+  *before = Array::New(count, Heap::kOld);
+  *after = Array::New(count, Heap::kOld);
+  String& str = String::Handle();
+  for (intptr_t i = 0; i < count; i++) {
+    str = String::New("before", Heap::kOld);
+    before->SetAt(i, str);
+    str = String::New("after", after_space);
+    after->SetAt(i, str);
+  }
+}
+
+ISOLATE_UNIT_TEST_CASE(BecomeForwardParallel) {
+  SetFlagScope<int> sfs(&FLAG_become_tasks, 4);
+  Array& before = Array::Handle();
+  Array& after = Array::Handle();
+  // Forwarding to new-space objects has the tasks rebuild the remembered set.
+  AllocateForwardingPairs(100, Heap::kNew, &before, &after);
+  ForwardManyReferences(1000, 100, before, after);
+
+  GCTestHelper::CollectAllGarbage();
+  EXPECT_STREQ("after", Object::Handle(before.At(0)).ToCString());
+}
+
+static void BenchmarkBecomeForward(Benchmark* benchmark,
+                                   Thread* thread,
+                                   intptr_t tasks) {
+  SetFlagScope<int> sfs(&FLAG_become_tasks, tasks);
+  TransitionNativeToVM transition(thread);
+  StackZone zone(thread);
+  HANDLESCOPE(thread);
+
+  // About 256 MB of references with uncompressed pointers.
+  const intptr_t kNumArrays = 32 * KB;
+  const intptr_t kLength = KB;
+  const intptr_t kNumForwarded = 16 * KB;
+  Array& before = Array::Handle();
+  Array& after = Array::Handle();
+  AllocateForwardingPairs(kNumForwarded, Heap::kOld, &before, &after);
+  benchmark->set_score(
+      ForwardManyReferences(kNumArrays, kLength, before, after));
+}
+
+BENCHMARK(BecomeForwardLargeHeapSerial) {
+  BenchmarkBecomeForward(benchmark, thread, 1);
+}
+
+BENCHMARK(BecomeForwardLargeHeap) {
+  BenchmarkBecomeForward(benchmark, thread, FLAG_become_tasks);
+}
+
 }  // namespace dart
@@ -7,6 +7,7 @@
 #include "platform/atomic.h"
 #include "vm/globals.h"
 #include "vm/heap/become.h"
+#include "vm/heap/gc_shared.h"
 #include "vm/heap/heap.h"
 #include "vm/heap/pages.h"
 #include "vm/thread_barrier.h"
@@ -172,6 +173,10 @@ class CompactorTask : public ThreadPool::Task {
   DISALLOW_COPY_AND_ASSIGN(CompactorTask);
 };
 
+// With --adaptive_gc_tasks, roughly one compactor task is used per this many
+// words of pages.
+static constexpr intptr_t kCompactorWordsPerTask = 8 * MBInWords;
+
 // Slides live objects down past free gaps, updates pointers and frees empty
 // pages. Keeps cursors pointing to the next free and next live chunks, and
 // repeatedly moves the next live chunk to the next free chunk, one block at a
@@ -188,7 +193,9 @@ void GCCompactor::Compact(Page* pages, FreeList* freelist, Mutex* pages_lock) {
     num_pages++;
   }
 
-  intptr_t num_tasks = FLAG_compactor_tasks;
+  intptr_t num_tasks = ChooseGCTasks(FLAG_compactor_tasks,
+                                     num_pages * kPageSizeInWords,
+                                     kCompactorWordsPerTask);
   RELEASE_ASSERT(num_tasks >= 1);
   if (num_pages < num_tasks) {
     num_tasks = num_pages;
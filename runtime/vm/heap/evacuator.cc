@@ -0,0 +1,421 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/heap/evacuator.h"
+
+#include "vm/globals.h"
+#include "vm/heap/become.h"
+#include "vm/heap/freelist.h"
+#include "vm/heap/heap.h"
+#include "vm/heap/pages.h"
+#include "vm/isolate.h"
+#include "vm/object_id_ring.h"
+#include "vm/timeline.h"
+
+namespace dart {
+
+DEFINE_FLAG(bool,
+            evacuate_fragmented_pages,
+            false,
+            "Move the live objects off the most fragmented old-space pages "
+            "during stop-the-world mark-sweeps.");
+DEFINE_FLAG(int,
+            evacuation_max_pages,
+            8,
+            "The maximum number of pages evacuated by one mark-sweep.");
+DEFINE_FLAG(int,
+            evacuation_live_percent,
+            30,
+            "Only pages with at most this percentage of live bytes are "
+            "evacuated.");
+
+GCEvacuator::GCEvacuator(Thread* thread, Heap* heap)
+    : HandleVisitor(thread),
+      ObjectPointerVisitor(thread->isolate_group()),
+      heap_(heap) {}
+
+static bool IsFragmented(Page* page, intptr_t live_bytes) {
+  return (live_bytes * 100) <= (page->used() * FLAG_evacuation_live_percent);
+}
+
+static int CompareLiveBytes(Page* const* a, Page* const* b) {
+  const intptr_t a_live = (*a)->live_bytes();
+  const intptr_t b_live = (*b)->live_bytes();
+  if (a_live < b_live) {
+    return -1;
+  } else if (a_live == b_live) {
+    return 0;
+  } else {
+    return 1;
+  }
+}
+
+static int CompareAddresses(const uword* a, const uword* b) {
+  if (*a < *b) {
+    return -1;
+  } else if (*a == *b) {
+    return 0;
+  } else {
+    return 1;
+  }
+}
+
+bool GCEvacuator::SelectCandidates(Page* pages, uword pinned) {
+  ASSERT(candidates_.is_empty());
+  MallocGrowableArray<Page*> fragmented;
+  for (Page* page = pages; page != nullptr; page = page->next()) {
+    if (page->live_bytes() < 0) {
+      continue;  // Not swept since it was allocated.
+    }
+    if (page->Contains(pinned)) {
+      continue;
+    }
+    if (IsFragmented(page, page->live_bytes())) {
+      fragmented.Add(page);
+    }
+  }
+  fragmented.Sort(CompareLiveBytes);
+
+  const intptr_t count =
+      Utils::Minimum<intptr_t>(fragmented.length(), FLAG_evacuation_max_pages);
+  for (intptr_t i = 0; i < count; i++) {
+    candidates_.Add(reinterpret_cast<uword>(fragmented[i]));
+  }
+  candidates_.Sort(CompareAddresses);
+  return !candidates_.is_empty();
+}
+
+bool GCEvacuator::IsCandidateAddress(uword addr) const {
+  const uword page = addr & kPageMask;
+  intptr_t lo = 0;
+  intptr_t hi = candidates_.length() - 1;
+  while (lo <= hi) {
+    const intptr_t mid = (lo + hi) / 2;
+    if (page < candidates_[mid]) {
+      hi = mid - 1;
+    } else if (page > candidates_[mid]) {
+      lo = mid + 1;
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+void GCEvacuator::AddSlots(EvacuationSlots* slots) {
+  MutexLocker ml(&slots_mutex_);
+  for (intptr_t i = 0; i < slots->slots_.length(); i++) {
+    slots_.slots_.Add(slots->slots_[i]);
+  }
+  for (intptr_t i = 0; i < slots->compressed_slots_.length(); i++) {
+    slots_.compressed_slots_.Add(slots->compressed_slots_[i]);
+  }
+  for (intptr_t i = 0; i < slots->objects_.length(); i++) {
+    slots_.objects_.Add(slots->objects_[i]);
+  }
+  slots->slots_.Clear();
+  slots->compressed_slots_.Clear();
+  slots->objects_.Clear();
+}
+
+void GCEvacuator::Evacuate() {
+  ASSERT(destinations_.is_empty());
+  {
+    TIMELINE_FUNCTION_GC_DURATION(thread(), "EvacuatePages");
+    intptr_t i = 0;
+    while (i < candidates_.length()) {
+      Page* page = reinterpret_cast<Page*>(candidates_[i]);
+      const intptr_t live_bytes = LiveBytes(page);
+      if (!IsFragmented(page, live_bytes)) {
+        // Refilled since it was last swept; not worth moving after all.
+        candidates_.EraseAt(i);
+        continue;
+      }
+      if (!ReserveDestination(page)) {
+        // Out of capacity: keep this and the remaining candidates.
+        candidates_.TruncateTo(i);
+        break;
+      }
+      EvacuatePage(page);
+      i++;
+    }
+    FinishDestinationPage();
+  }
+
+  if (candidates_.is_empty()) {
+    // Any reserved destination page is a single free list element and will be
+    // released by the sweeper.
+    return;
+  }
+
+  {
+    TIMELINE_FUNCTION_GC_DURATION(thread(), "ForwardEvacuatedObjects");
+    for (intptr_t i = 0; i < destinations_.length(); i++) {
+      Page* page = destinations_[i];
+      uword current = page->object_start();
+      const uword end = page->object_end();
+      while (current < end) {
+        ObjectPtr obj = UntaggedObject::FromAddr(current);
+        if (obj->untag()->IsMarked()) {
+          current += obj->untag()->VisitPointers(this);
+        } else {
+          current += obj->untag()->HeapSize();
+        }
+      }
+    }
+  }
+
+  {
+    TIMELINE_FUNCTION_GC_DURATION(thread(), "ForwardRememberedSlots");
+    for (intptr_t i = 0; i < slots_.objects_.length(); i++) {
+      ObjectPtr obj = slots_.objects_[i];
+      if (IsCandidate(obj)) {
+        continue;  // The copy was visited above.
+      }
+      obj->untag()->VisitPointers(this);
+      if (obj->GetClassId() == kFinalizerEntryCid) {
+        // Mourning may have linked the entry into its finalizer.
+        ObjectPtr finalizer =
+            static_cast<FinalizerEntryPtr>(obj)->untag()->finalizer();
+        if (finalizer != Object::null()) {
+          finalizer->untag()->VisitPointers(this);
+        }
+      }
+    }
+    for (intptr_t i = 0; i < slots_.slots_.length(); i++) {
+      ObjectPtr* slot = slots_.slots_[i];
+      if (!IsCandidateAddress(reinterpret_cast<uword>(slot))) {
+        ForwardPointer(slot);
+      }
+    }
+    for (intptr_t i = 0; i < slots_.compressed_slots_.length(); i++) {
+      const EvacuationSlots::CompressedSlot& entry =
+          slots_.compressed_slots_[i];
+      if (!IsCandidateAddress(reinterpret_cast<uword>(entry.slot))) {
+        ForwardCompressedPointer(entry.heap_base, entry.slot);
+      }
+    }
+  }
+
+  IsolateGroup* isolate_group = this->isolate_group();
+  {
+    TIMELINE_FUNCTION_GC_DURATION(thread(), "ForwardRememberedSet");
+    isolate_group->store_buffer()->VisitObjectPointers(this);
+  }
+  {
+    TIMELINE_FUNCTION_GC_DURATION(thread(), "ForwardWeakTables");
+    heap_->ForwardWeakTables(this);
+  }
+  {
+    TIMELINE_FUNCTION_GC_DURATION(thread(), "ForwardWeakHandles");
+    isolate_group->VisitWeakPersistentHandles(this);
+  }
+#ifndef PRODUCT
+  {
+    TIMELINE_FUNCTION_GC_DURATION(thread(), "ForwardObjectIdRing");
+    isolate_group->ForEachIsolate(
+        [&](Isolate* isolate) {
+          ObjectIdRing* ring = isolate->object_id_ring();
+          if (ring != nullptr) {
+            ring->VisitPointers(this);
+          }
+        },
+        /*at_safepoint=*/true);
+  }
+#endif  // !PRODUCT
+  {
+    // Includes the strong persistent handles allocated while mourning
+    // finalizer entries, which the marker has not seen.
+    TIMELINE_FUNCTION_GC_DURATION(thread(), "ForwardStackPointers");
+    isolate_group->VisitObjectPointers(this,
+                                       ValidationPolicy::kDontValidateFrames);
+  }
+  {
+    TIMELINE_FUNCTION_GC_DURATION(thread(),
+                                  "ForwardPostponedSuspendStatePointers");
+    can_visit_stack_frames_ = true;
+    for (intptr_t i = 0; i < postponed_suspend_states_.length(); i++) {
+      postponed_suspend_states_[i]->untag()->VisitPointers(this);
+    }
+  }
+
+  {
+    PageSpace* old_space = heap_->old_space();
+    Page* previous_page = nullptr;
+    Page* page = old_space->pages_;
+    while (page != nullptr) {
+      Page* next_page = page->next();
+      if (IsCandidateAddress(reinterpret_cast<uword>(page))) {
+        old_space->FreePage(page, previous_page);
+      } else {
+        previous_page = page;
+      }
+      page = next_page;
+    }
+  }
+}
+
+intptr_t GCEvacuator::LiveBytes(Page* page) {
+  intptr_t live_bytes = 0;
+  uword current = page->object_start();
+  const uword end = page->object_end();
+  while (current < end) {
+    ObjectPtr obj = UntaggedObject::FromAddr(current);
+    const intptr_t size = obj->untag()->HeapSize();
+    if (obj->untag()->IsMarked()) {
+      live_bytes += size;
+    }
+    current += size;
+  }
+  return live_bytes;
+}
+
+// Allocates the fresh pages EvacuatePage will need for [page] by replaying its
+// placement of the marked objects.
+bool GCEvacuator::ReserveDestination(Page* page) {
+  intptr_t index = current_destination_;
+  uword top = top_;
+  uword end = end_;
+  uword current = page->object_start();
+  const uword page_end = page->object_end();
+  while (current < page_end) {
+    ObjectPtr obj = UntaggedObject::FromAddr(current);
+    const intptr_t size = obj->untag()->HeapSize();
+    if (obj->untag()->IsMarked()) {
+      if (size > static_cast<intptr_t>(end - top)) {
+        index++;
+        if ((index == destinations_.length()) && !AddDestinationPage()) {
+          return false;
+        }
+        top = destinations_[index]->object_start();
+        end = destinations_[index]->object_end();
+      }
+      top += size;
+    }
+    current += size;
+  }
+  return true;
+}
+
+bool GCEvacuator::AddDestinationPage() {
+  Page* page = heap_->old_space()->AllocatePage(Page::kData, /*link=*/true);
+  if (page == nullptr) {
+    return false;
+  }
+  // Keep the page walkable until objects are copied into it.
+  FreeListElement::AsElement(page->object_start(),
+                             page->object_end() - page->object_start());
+  destinations_.Add(page);
+  return true;
+}
+
+void GCEvacuator::EvacuatePage(Page* page) {
+  uword current = page->object_start();
+  const uword end = page->object_end();
+  while (current < end) {
+    ObjectPtr old_obj = UntaggedObject::FromAddr(current);
+    const intptr_t size = old_obj->untag()->HeapSize();
+    if (old_obj->untag()->IsMarked()) {
+      if (size > static_cast<intptr_t>(end_ - top_)) {
+        FinishDestinationPage();
+        // The next page was allocated by ReserveDestination.
+        Page* destination = destinations_[++current_destination_];
+        top_ = destination->object_start();
+        end_ = destination->object_end();
+      }
+      const uword new_addr = top_;
+      top_ += size;
+
+      // The copy keeps the mark bit, so the sweeper retains it.
+      memcpy(reinterpret_cast<void*>(new_addr),
+             reinterpret_cast<void*>(current), size);
+      ObjectPtr new_obj = UntaggedObject::FromAddr(new_addr);
+      if (IsTypedDataClassId(new_obj->GetClassId())) {
+        static_cast<TypedDataPtr>(new_obj)->untag()->RecomputeDataField();
+      }
+      ForwardingCorpse::AsForwarder(current, size)->set_target(new_obj);
+    }
+    current += size;
+  }
+}
+
+void GCEvacuator::FinishDestinationPage() {
+  if (top_ < end_) {
+    // Unmarked, so the sweeper adds it to the free list.
+    FreeListElement::AsElement(top_, end_ - top_);
+  }
+  top_ = end_;
+}
+
+void GCEvacuator::ForwardPointer(ObjectPtr* ptr) {
+  ObjectPtr old_target = *ptr;
+  if (!IsCandidate(old_target)) {
+    return;
+  }
+  // Dead objects on the candidates are not forwarded; only tables the marker
+  // does not clean up (see Heap::ForwardWeakTables) may still refer to them.
+  if (old_target->GetClassId() != kForwardingCorpse) {
+    return;
+  }
+  ForwardingCorpse* corpse = reinterpret_cast<ForwardingCorpse*>(
+      UntaggedObject::ToAddr(old_target));
+  *ptr = corpse->target();
+}
+
+void GCEvacuator::ForwardCompressedPointer(uword heap_base,
+                                           CompressedObjectPtr* ptr) {
+  ObjectPtr old_target = ptr->Decompress(heap_base);
+  if (!IsCandidate(old_target)) {
+    return;
+  }
+  if (old_target->GetClassId() != kForwardingCorpse) {
+    return;
+  }
+  ForwardingCorpse* corpse = reinterpret_cast<ForwardingCorpse*>(
+      UntaggedObject::ToAddr(old_target));
+  *ptr = corpse->target();
+}
+
+void GCEvacuator::VisitTypedDataViewPointers(TypedDataViewPtr view,
+                                             CompressedObjectPtr* first,
+                                             CompressedObjectPtr* last) {
+  VisitCompressedPointers(view->heap_base(), first, last);
+
+  // Either the view or its backing store may have moved. The backing store
+  // has been copied already, so its class id can be read.
+  const classid_t cid = view->untag()->typed_data()->GetClassIdMayBeSmi();
+  if (IsTypedDataClassId(cid)) {
+    view->untag()->RecomputeDataFieldForInternalTypedData();
+  }
+}
+
+void GCEvacuator::VisitPointers(ObjectPtr* first, ObjectPtr* last) {
+  for (ObjectPtr* ptr = first; ptr <= last; ptr++) {
+    ForwardPointer(ptr);
+  }
+}
+
+void GCEvacuator::VisitCompressedPointers(uword heap_base,
+                                          CompressedObjectPtr* first,
+                                          CompressedObjectPtr* last) {
+  for (CompressedObjectPtr* ptr = first; ptr <= last; ptr++) {
+    ForwardCompressedPointer(heap_base, ptr);
+  }
+}
+
+bool GCEvacuator::CanVisitSuspendStatePointers(SuspendStatePtr suspend_state) {
+  if ((suspend_state->untag()->pc() != 0) && !can_visit_stack_frames_) {
+    postponed_suspend_states_.Add(suspend_state);
+    return false;
+  }
+  return true;
+}
+
+void GCEvacuator::VisitHandle(uword addr) {
+  FinalizablePersistentHandle* handle =
+      reinterpret_cast<FinalizablePersistentHandle*>(addr);
+  ForwardPointer(handle->ptr_addr());
+}
+
+}  // namespace dart
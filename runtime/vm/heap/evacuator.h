@@ -0,0 +1,137 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef RUNTIME_VM_HEAP_EVACUATOR_H_
+#define RUNTIME_VM_HEAP_EVACUATOR_H_
+
+#include "platform/growable_array.h"
+
+#include "vm/allocation.h"
+#include "vm/dart_api_state.h"
+#include "vm/flags.h"
+#include "vm/globals.h"
+#include "vm/heap/page.h"
+#include "vm/os_thread.h"
+#include "vm/visitor.h"
+
+namespace dart {
+
+DECLARE_FLAG(bool, evacuate_fragmented_pages);
+
+// Forward declarations.
+class Heap;
+
+// The references to evacuation candidates found by one marking visitor.
+class EvacuationSlots {
+ public:
+  EvacuationSlots() {}
+
+  void AddSlot(ObjectPtr* slot) { slots_.Add(slot); }
+  void AddCompressedSlot(uword heap_base, CompressedObjectPtr* slot) {
+    compressed_slots_.Add({heap_base, slot});
+  }
+  // Records an object whose pointers must be revisited after evacuation
+  // because the marker does not visit all of them through the slot visitor
+  // (weak references, weak arrays and finalizer entries), or because it holds
+  // an inner pointer into a candidate (typed data views).
+  void AddObject(ObjectPtr obj) { objects_.Add(obj); }
+
+ private:
+  struct CompressedSlot {
+    uword heap_base;
+    CompressedObjectPtr* slot;
+  };
+
+  MallocGrowableArray<ObjectPtr*> slots_;
+  MallocGrowableArray<CompressedSlot> compressed_slots_;
+  MallocGrowableArray<ObjectPtr> objects_;
+
+  friend class GCEvacuator;
+  DISALLOW_COPY_AND_ASSIGN(EvacuationSlots);
+};
+
+// Implements partial compaction by evacuation. The most fragmented data pages,
+// according to the statistics of the previous sweep, are chosen before a
+// stop-the-world mark. The marker remembers every slot it finds referring to
+// one of these candidates. After marking, the live objects on the candidates
+// are copied to fresh pages, only the remembered slots are updated, and the
+// candidates are released. Unlike GCCompactor, which slides every page and
+// forwards every pointer in the heap, the pause is proportional to the
+// evacuated bytes rather than the heap size.
+class GCEvacuator : public ValueObject,
+                    public HandleVisitor,
+                    public ObjectPointerVisitor {
+ public:
+  GCEvacuator(Thread* thread, Heap* heap);
+  ~GCEvacuator() {}
+
+  // Chooses up to FLAG_evacuation_max_pages of [pages] whose live bytes were
+  // at most FLAG_evacuation_live_percent of their size when last swept,
+  // skipping the page containing [pinned]. Returns whether any was chosen.
+  bool SelectCandidates(Page* pages, uword pinned);
+
+  // Whether [obj] lies on a candidate page. Safe to call with any pointer,
+  // including pointers into image pages, since the object is not accessed.
+  bool IsCandidate(ObjectPtr obj) const {
+    if (obj->IsSmiOrNewObject()) {
+      return false;
+    }
+    return IsCandidateAddress(UntaggedObject::ToAddr(obj));
+  }
+
+  // Merges references found by a marking visitor, emptying [slots].
+  void AddSlots(EvacuationSlots* slots);
+
+  // Copies the marked objects on the candidate pages to fresh pages, updates
+  // the references to them and frees the candidates. Must be called after
+  // marking completes and before the data pages are swept.
+  void Evacuate();
+
+ private:
+  bool IsCandidateAddress(uword addr) const;
+
+  intptr_t LiveBytes(Page* page);
+  bool ReserveDestination(Page* page);
+  bool AddDestinationPage();
+  void EvacuatePage(Page* page);
+  void FinishDestinationPage();
+
+  void ForwardPointer(ObjectPtr* ptr);
+  void ForwardCompressedPointer(uword heap_base, CompressedObjectPtr* ptr);
+  void VisitTypedDataViewPointers(TypedDataViewPtr view,
+                                  CompressedObjectPtr* first,
+                                  CompressedObjectPtr* last) override;
+  void VisitPointers(ObjectPtr* first, ObjectPtr* last) override;
+  void VisitCompressedPointers(uword heap_base,
+                               CompressedObjectPtr* first,
+                               CompressedObjectPtr* last) override;
+  bool CanVisitSuspendStatePointers(SuspendStatePtr suspend_state) override;
+  void VisitHandle(uword addr) override;
+
+  Heap* heap_;
+
+  // Start addresses of the candidate pages, sorted.
+  MallocGrowableArray<uword> candidates_;
+
+  // Fresh pages receiving the evacuated objects, and the allocation cursor in
+  // the one being filled.
+  MallocGrowableArray<Page*> destinations_;
+  intptr_t current_destination_ = -1;
+  uword top_ = 0;
+  uword end_ = 0;
+
+  Mutex slots_mutex_;
+  EvacuationSlots slots_;
+
+  // SuspendState objects with copied frames are updated last, as visiting
+  // their frames may touch objects whose references are not yet updated.
+  bool can_visit_stack_frames_ = false;
+  MallocGrowableArray<SuspendStatePtr> postponed_suspend_states_;
+
+  DISALLOW_COPY_AND_ASSIGN(GCEvacuator);
+};
+
+}  // namespace dart
+
+#endif  // RUNTIME_VM_HEAP_EVACUATOR_H_
@@ -0,0 +1,208 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/heap/external_memory.h"
+
+#include "platform/utils.h"
+#include "vm/dart.h"
+#include "vm/heap/safepoint.h"
+#include "vm/isolate.h"
+#include "vm/lockers.h"
+#include "vm/thread.h"
+#include "vm/thread_pool.h"
+
+namespace dart {
+
+DEFINE_FLAG(int,
+            external_gc_interval,
+            10,
+            "Minimum time in milliseconds between two collections of a space "
+            "started by external allocations, unless they keep growing.");
+DEFINE_FLAG(int,
+            external_gc_growth,
+            50,
+            "Percentage by which the external allocations surviving a "
+            "collection must grow before they start another.");
+DEFINE_FLAG(bool,
+            batch_finalizers,
+            false,
+            "Run the finalizers of finalizable handles and native finalizers "
+            "in batches on a helper thread after each collection instead of "
+            "during it.");
+
+intptr_t ExternalGCPolicy::ThresholdInWords(intptr_t limit_in_words) const {
+  const int64_t surviving = surviving_in_words_;
+  const int64_t grown = surviving + (surviving * FLAG_external_gc_growth) / 100;
+  return Utils::Maximum(limit_in_words, static_cast<intptr_t>(grown));
+}
+
+bool ExternalGCPolicy::ShouldCollect(int64_t now_micros,
+                                     intptr_t external_in_words,
+                                     intptr_t limit_in_words) const {
+  const intptr_t threshold = ThresholdInWords(limit_in_words);
+  if (external_in_words < threshold) {
+    return false;
+  }
+  const int64_t last = last_collection_micros_;
+  const int64_t interval =
+      static_cast<int64_t>(FLAG_external_gc_interval) *
+      kMicrosecondsPerMillisecond;
+  if ((last != 0) && ((now_micros - last) < interval) &&
+      ((external_in_words / 2) < threshold)) {
+    return false;
+  }
+  return true;
+}
+
+void ExternalGCPolicy::RecordCollection(int64_t now_micros,
+                                        intptr_t external_in_words) {
+  last_collection_micros_ = now_micros;
+  surviving_in_words_ = external_in_words;
+}
+
+class FinalizerBatchTask : public ThreadPool::Task {
+ public:
+  explicit FinalizerBatchTask(FinalizerBatches* batches) : batches_(batches) {}
+
+  void Run() { batches_->RunTask(); }
+
+ private:
+  FinalizerBatches* batches_;
+
+  DISALLOW_COPY_AND_ASSIGN(FinalizerBatchTask);
+};
+
+FinalizerBatches::FinalizerBatches(IsolateGroup* isolate_group)
+    : isolate_group_(isolate_group) {}
+
+FinalizerBatches::~FinalizerBatches() {
+  Drain();
+}
+
+void FinalizerBatches::RunHandleFinalizer(Dart_HandleFinalizer callback,
+                                          void* peer) {
+  if (!FLAG_batch_finalizers) {
+    (*callback)(isolate_group_->embedder_data(), peer);
+    return;
+  }
+  MonitorLocker ml(&monitor_);
+  pending_.Add({callback, nullptr, peer});
+}
+
+void FinalizerBatches::RunNativeFinalizer(NativeCallback callback,
+                                          void* peer) {
+  if (!FLAG_batch_finalizers) {
+    (*callback)(peer);
+    return;
+  }
+  MonitorLocker ml(&monitor_);
+  pending_.Add({nullptr, callback, peer});
+}
+
+void FinalizerBatches::Schedule() {
+  {
+    MonitorLocker ml(&monitor_);
+    if (pending_.is_empty() || task_running_) {
+      return;
+    }
+    task_running_ = true;
+  }
+  if (!Dart::thread_pool()->Run<FinalizerBatchTask>(this)) {
+    // The pool is shutting down.
+    RunBatches();
+    MonitorLocker ml(&monitor_);
+    task_running_ = false;
+    ml.NotifyAll();
+  }
+}
+
+void FinalizerBatches::Drain() {
+  MallocGrowableArray<Callback> batch;
+  {
+    MonitorLocker ml(&monitor_);
+    // The helper task waits for safepoint operations to end before it
+    // enters the isolate group.
+    Thread* thread = Thread::Current();
+    const bool in_group = (thread != nullptr) &&
+                          (thread->isolate_group() == isolate_group_) &&
+                          (thread->execution_state() == Thread::kThreadInVM);
+    while (task_running_) {
+      if (in_group) {
+        ml.WaitWithSafepointCheck(thread);
+      } else {
+        ml.Wait();
+      }
+    }
+    for (intptr_t i = 0; i < pending_.length(); i++) {
+      batch.Add(pending_[i]);
+    }
+    pending_.Clear();
+  }
+  RunAll(&batch);
+}
+
+intptr_t FinalizerBatches::num_pending() {
+  MonitorLocker ml(&monitor_);
+  return pending_.length();
+}
+
+void FinalizerBatches::RunTask() {
+  for (;;) {
+    // Handle finalizers may use the API, which needs a current isolate
+    // group. If it is shutting down, Drain runs the callbacks.
+    const bool entered = Thread::EnterIsolateGroupAsHelper(
+        isolate_group_, Thread::kUnknownTask, /*bypass_safepoint=*/false);
+    if (entered) {
+      {
+        // Embedder code doesn't hold up safepoint operations.
+        TransitionVMToNative transition(Thread::Current());
+        RunBatches();
+      }
+      // Leave before Drain can return and the isolate group go away.
+      Thread::ExitIsolateGroupAsHelper(/*bypass_safepoint=*/false);
+    }
+
+    MonitorLocker ml(&monitor_);
+    if (!entered || pending_.is_empty()) {
+      task_running_ = false;
+      ml.NotifyAll();
+      return;
+    }
+  }
+}
+
+void FinalizerBatches::RunBatches() {
+  MallocGrowableArray<Callback> batch;
+  for (;;) {
+    {
+      MonitorLocker ml(&monitor_);
+      if (pending_.is_empty()) {
+        return;
+      }
+      for (intptr_t i = 0; i < pending_.length(); i++) {
+        batch.Add(pending_[i]);
+      }
+      pending_.Clear();
+    }
+    RunAll(&batch);
+  }
+}
+
+void FinalizerBatches::RunAll(MallocGrowableArray<Callback>* batch) {
+  if (batch->is_empty()) {
+    return;
+  }
+  void* embedder_data = isolate_group_->embedder_data();
+  for (intptr_t i = 0; i < batch->length(); i++) {
+    const Callback& callback = batch->At(i);
+    if (callback.handle_callback != nullptr) {
+      (*callback.handle_callback)(embedder_data, callback.peer);
+    } else {
+      (*callback.native_callback)(callback.peer);
+    }
+  }
+  batch->Clear();
+}
+
+}  // namespace dart
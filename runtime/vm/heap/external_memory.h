@@ -0,0 +1,109 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef RUNTIME_VM_HEAP_EXTERNAL_MEMORY_H_
+#define RUNTIME_VM_HEAP_EXTERNAL_MEMORY_H_
+
+#include "include/dart_api.h"
+#include "platform/atomic.h"
+#include "platform/growable_array.h"
+
+#include "vm/allocation.h"
+#include "vm/flags.h"
+#include "vm/globals.h"
+#include "vm/os_thread.h"
+
+namespace dart {
+
+DECLARE_FLAG(bool, batch_finalizers);
+
+// Forward declarations.
+class IsolateGroup;
+
+// Decides when external allocations alone should collect a space. A space is
+// collected once its external allocations reach a threshold, which is the
+// larger of the space's limit and the external allocations that survived the
+// previous such collection grown by --external_gc_growth percent. Collections
+// are further held back to one per --external_gc_interval milliseconds unless
+// the external allocations reach twice the threshold. Without this, a program
+// keeping most of its native memory alive collects on every external
+// allocation once it is over the limit.
+class ExternalGCPolicy {
+ public:
+  ExternalGCPolicy() {}
+
+  // Whether [external_in_words] of external allocations should collect the
+  // space at [now_micros]. [limit_in_words] is the external size the space
+  // tolerates without any history.
+  bool ShouldCollect(int64_t now_micros,
+                     intptr_t external_in_words,
+                     intptr_t limit_in_words) const;
+
+  // Records that a collection started because of external allocations ended
+  // at [now_micros] with [external_in_words] remaining.
+  void RecordCollection(int64_t now_micros, intptr_t external_in_words);
+
+  intptr_t ThresholdInWords(intptr_t limit_in_words) const;
+
+ private:
+  RelaxedAtomic<int64_t> last_collection_micros_ = {0};
+  RelaxedAtomic<intptr_t> surviving_in_words_ = {0};
+
+  DISALLOW_COPY_AND_ASSIGN(ExternalGCPolicy);
+};
+
+// Finalizer callbacks of external allocations that are allowed to run on any
+// thread at any time after their object died: those of finalizable handles
+// (Dart_NewFinalizableHandle, external typed data), which nothing can observe
+// after their referent is collected, and those of NativeFinalizers. With
+// --batch_finalizers a collection queues them instead of running them one at
+// a time in its pause, and they run together on a helper thread after it.
+// Their external sizes are still freed during the collection.
+class FinalizerBatches {
+ public:
+  typedef void (*NativeCallback)(void* peer);
+
+  explicit FinalizerBatches(IsolateGroup* isolate_group);
+  ~FinalizerBatches();
+
+  // Runs [callback] now, or queues it with --batch_finalizers.
+  void RunHandleFinalizer(Dart_HandleFinalizer callback, void* peer);
+  void RunNativeFinalizer(NativeCallback callback, void* peer);
+
+  // Starts a helper task running the queued callbacks, unless one is running
+  // already. Called at the end of each collection.
+  void Schedule();
+
+  // Waits for the helper task and runs the callbacks still queued on the
+  // current thread. Called before the isolate group's embedder data goes
+  // away, while the current thread is still in the isolate group.
+  void Drain();
+
+  intptr_t num_pending();
+
+ private:
+  struct Callback {
+    Dart_HandleFinalizer handle_callback;
+    NativeCallback native_callback;
+    void* peer;
+  };
+
+  // Runs the queued callbacks in the isolate group on a helper thread.
+  void RunTask();
+  void RunBatches();
+  void RunAll(MallocGrowableArray<Callback>* batch);
+
+  IsolateGroup* isolate_group_;
+
+  Monitor monitor_;
+  MallocGrowableArray<Callback> pending_;
+  bool task_running_ = false;
+
+  friend class FinalizerBatchTask;
+  DISALLOW_COPY_AND_ASSIGN(FinalizerBatches);
+};
+
+}  // namespace dart
+
+#endif  // RUNTIME_VM_HEAP_EXTERNAL_MEMORY_H_
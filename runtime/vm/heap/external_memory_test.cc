@@ -0,0 +1,135 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "platform/assert.h"
+#include "vm/dart_api_state.h"
+#include "vm/heap/external_memory.h"
+#include "vm/heap/heap.h"
+#include "vm/unit_test.h"
+
+namespace dart {
+
+DECLARE_FLAG(int, external_gc_interval);
+DECLARE_FLAG(int, external_gc_growth);
+
+VM_UNIT_TEST_CASE(ExternalGCPolicy_Threshold) {
+  SetFlagScope<int> sfs_interval(&FLAG_external_gc_interval, 10);
+  SetFlagScope<int> sfs_growth(&FLAG_external_gc_growth, 50);
+  const int64_t kInterval = 10 * kMicrosecondsPerMillisecond;
+  const intptr_t kLimit = 1000;
+  ExternalGCPolicy policy;
+
+  // Without history, the limit applies.
+  EXPECT(!policy.ShouldCollect(1, kLimit - 1, kLimit));
+  EXPECT(policy.ShouldCollect(1, kLimit, kLimit));
+
+  // Most of the external allocations survived: the next collection waits
+  // until they grow by half.
+  int64_t now = 1;
+  policy.RecordCollection(now, 1200);
+  EXPECT_EQ(1800, policy.ThresholdInWords(kLimit));
+  now += 2 * kInterval;
+  EXPECT(!policy.ShouldCollect(now, 1500, kLimit));
+  EXPECT(policy.ShouldCollect(now, 1800, kLimit));
+
+  // Little survived: back to the limit.
+  policy.RecordCollection(now, 100);
+  EXPECT_EQ(kLimit, policy.ThresholdInWords(kLimit));
+
+  // Within the interval, only twice the threshold collects.
+  now += kInterval / 2;
+  EXPECT(!policy.ShouldCollect(now, kLimit, kLimit));
+  EXPECT(!policy.ShouldCollect(now, 2 * kLimit - 1, kLimit));
+  EXPECT(policy.ShouldCollect(now, 2 * kLimit, kLimit));
+  now += kInterval;
+  EXPECT(policy.ShouldCollect(now, kLimit, kLimit));
+}
+
+static void CountingFinalizer(void* isolate_callback_data, void* peer) {
+  (*reinterpret_cast<RelaxedAtomic<intptr_t>*>(peer))++;
+}
+
+ISOLATE_UNIT_TEST_CASE(FinalizerBatches_DeferFinalizableHandles) {
+  SetFlagScope<bool> sfs(&FLAG_batch_finalizers, true);
+  auto isolate_group = thread->isolate_group();
+  Heap* heap = isolate_group->heap();
+  GCTestHelper::CollectAllGarbage();
+  heap->finalizer_batches()->Drain();
+
+  RelaxedAtomic<intptr_t> finalized = {0};
+  RelaxedAtomic<intptr_t> cleared = {0};
+  FinalizablePersistentHandle* weak;
+  {
+    HANDLESCOPE(thread);
+    const Array& finalizable = Array::Handle(Array::New(1, Heap::kNew));
+    FinalizablePersistentHandle::New(isolate_group, finalizable, &finalized,
+                                     CountingFinalizer, 1 * MB,
+                                     /*auto_delete=*/true);
+    const Array& weakly_held = Array::Handle(Array::New(1, Heap::kNew));
+    weak = FinalizablePersistentHandle::New(isolate_group, weakly_held,
+                                            &cleared, CountingFinalizer, 0,
+                                            /*auto_delete=*/false);
+  }
+  EXPECT_EQ(1 * MB, heap->ExternalInWords(Heap::kNew) * kWordSize);
+
+  GCTestHelper::CollectNewSpace();
+  // The external size is freed by the collection itself.
+  EXPECT_EQ(0, heap->ExternalInWords(Heap::kNew));
+  // A weak persistent handle is observably cleared, so its finalizer still
+  // runs during the collection.
+  EXPECT_EQ(1, cleared.load());
+
+  heap->finalizer_batches()->Drain();
+  EXPECT_EQ(1, finalized.load());
+  EXPECT_EQ(0, heap->finalizer_batches()->num_pending());
+
+  isolate_group->api_state()->FreeWeakPersistentHandle(weak);
+}
+
+struct HelperFinalization {
+  IsolateGroup* isolate_group;
+  Dart_PersistentHandle handle;
+  ThreadId thread_id;
+  bool had_isolate_group;
+};
+
+static void HelperFinalizer(void* isolate_callback_data, void* peer) {
+  auto finalization = reinterpret_cast<HelperFinalization*>(peer);
+  finalization->thread_id = OSThread::GetCurrentThreadId();
+  finalization->had_isolate_group =
+      IsolateGroup::Current() == finalization->isolate_group;
+  // Allowed in finalizers, see Dart_HandleFinalizer.
+  Dart_DeletePersistentHandle(finalization->handle);
+}
+
+ISOLATE_UNIT_TEST_CASE(FinalizerBatches_HelperEntersIsolateGroup) {
+  SetFlagScope<bool> sfs(&FLAG_batch_finalizers, true);
+  auto isolate_group = thread->isolate_group();
+  Heap* heap = isolate_group->heap();
+  GCTestHelper::CollectAllGarbage();
+  heap->finalizer_batches()->Drain();
+
+  ApiState* state = isolate_group->api_state();
+  PersistentHandle* persistent = state->AllocatePersistentHandle();
+  persistent->set_ptr(Object::null());
+  HelperFinalization finalization = {isolate_group, persistent->apiHandle(),
+                                     OSThread::kInvalidThreadId, false};
+  {
+    HANDLESCOPE(thread);
+    const Array& finalizable = Array::Handle(Array::New(1, Heap::kNew));
+    FinalizablePersistentHandle::New(isolate_group, finalizable, &finalization,
+                                     HelperFinalizer, 0,
+                                     /*auto_delete=*/true);
+  }
+
+  // The collection schedules the helper task, which Drain waits for.
+  GCTestHelper::CollectNewSpace();
+  heap->finalizer_batches()->Drain();
+  EXPECT(finalization.thread_id != OSThread::kInvalidThreadId);
+  EXPECT(finalization.thread_id != OSThread::GetCurrentThreadId());
+  EXPECT(finalization.had_isolate_group);
+  EXPECT(!state->IsActivePersistentHandle(finalization.handle));
+}
+
+}  // namespace dart
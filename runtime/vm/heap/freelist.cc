@@ -6,6 +6,7 @@
 
 #include "vm/bit_set.h"
 #include "vm/hash_map.h"
+#include "vm/heap/page.h"
 #include "vm/lockers.h"
 #include "vm/object.h"
 #include "vm/os_thread.h"
@@ -128,6 +129,10 @@ uword FreeList::TryAllocateLocked(intptr_t size, bool is_protected) {
                                VirtualMemory::kReadWrite);
       }
 
+      // The sweeper may have returned some of the element's pages to the OS.
+      Page::Of(reinterpret_cast<uword>(current))
+          ->ClearReleased(reinterpret_cast<uword>(current),
+                          current->HeapSize());
       if (previous == NULL) {
         free_lists_[kNumLists] = current->next();
       } else {
@@ -352,6 +357,9 @@ FreeListElement* FreeList::TryAllocateLargeLocked(intptr_t minimum_size) {
       } else {
         previous->set_next(next);
       }
+      Page::Of(reinterpret_cast<uword>(current))
+          ->ClearReleased(reinterpret_cast<uword>(current),
+                          current->HeapSize());
       freelist_search_budget_ =
           Utils::Minimum(tries_left, kInitialFreeListSearchBudget);
       return current;
@@ -14,6 +14,72 @@
 
 namespace dart {
 
+DEFINE_FLAG(bool,
+            adaptive_gc_tasks,
+            false,
+            "Choose the number of scavenger, marker and compactor tasks for "
+            "each collection from the amount of live data and the processors "
+            "available to the process.");
+
+// Parallel GC phases stop scaling well beyond this many tasks.
+static constexpr intptr_t kMaxAdaptiveGCTasks = 16;
+
+intptr_t MaxGCTasks(intptr_t flag_tasks) {
+  if (!FLAG_adaptive_gc_tasks || (flag_tasks == 0)) {
+    return flag_tasks;
+  }
+  const intptr_t processors = OS::NumberOfUsableProcessors();
+  return Utils::Maximum<intptr_t>(
+      1, Utils::Minimum<intptr_t>(processors, kMaxAdaptiveGCTasks));
+}
+
+intptr_t ChooseGCTasks(intptr_t flag_tasks,
+                       intptr_t work_in_words,
+                       intptr_t words_per_task,
+                       intptr_t max_tasks) {
+  ASSERT(words_per_task > 0);
+  intptr_t tasks = flag_tasks;
+  if (FLAG_adaptive_gc_tasks && (flag_tasks != 0)) {
+    tasks = Utils::Maximum<intptr_t>(1, work_in_words / words_per_task);
+    tasks = Utils::Minimum(tasks, MaxGCTasks(flag_tasks));
+  }
+  return Utils::Minimum(tasks, max_tasks);
+}
+
+void UnreachableWeakHandles::AddAll(
+    MallocGrowableArray<FinalizablePersistentHandle*>* handles) {
+  if (handles->is_empty()) {
+    return;
+  }
+  MutexLocker ml(&mutex_);
+  for (intptr_t i = 0; i < handles->length(); i++) {
+    handles_.Add(handles->At(i));
+  }
+  handles->Clear();
+}
+
+void UnreachableWeakHandles::Finalize(IsolateGroup* isolate_group) {
+  MutexLocker ml(&mutex_);
+  FinalizerBatches* batches = isolate_group->heap()->finalizer_batches();
+  for (intptr_t i = 0; i < handles_.length(); i++) {
+    FinalizablePersistentHandle* handle = handles_[i];
+    // An earlier finalizer may have deleted this handle.
+    if (!handle->ptr()->IsHeapObject()) {
+      continue;
+    }
+    if (!handle->auto_delete() || !FLAG_batch_finalizers) {
+      handle->UpdateUnreachable(isolate_group);
+      continue;
+    }
+    // A finalizable handle is gone with its referent, so only its callback
+    // can be deferred.
+    handle->EnsureFreedExternal(isolate_group);
+    batches->RunHandleFinalizer(handle->callback(), handle->peer());
+    isolate_group->api_state()->FreeWeakPersistentHandle(handle);
+  }
+  handles_.Clear();
+}
+
 void GCLinkedLists::Release() {
 #define FOREACH(type, var) var.Release();
   GC_LINKED_LIST(FOREACH)
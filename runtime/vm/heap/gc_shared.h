@@ -96,6 +96,43 @@ struct GCLinkedLists {
 #define TRACE_FINALIZER(format, ...)
 #endif
 
+DECLARE_FLAG(bool, adaptive_gc_tasks);
+
+// Upper bound on the number of tasks a parallel GC phase controlled by the
+// given --*_tasks flag value may use. Zero means the phase runs serially on the
+// main thread.
+intptr_t MaxGCTasks(intptr_t flag_tasks);
+
+// The number of tasks a parallel GC phase should use for an estimated
+// [work_in_words] of live data. With --adaptive_gc_tasks this is one task per
+// [words_per_task], between one and MaxGCTasks(flag_tasks), and at most
+// [max_tasks]. Otherwise it is the flag value, at most [max_tasks].
+intptr_t ChooseGCTasks(intptr_t flag_tasks,
+                       intptr_t work_in_words,
+                       intptr_t words_per_task,
+                       intptr_t max_tasks = kIntptrMax);
+
+// Weak persistent handles found to be unreachable by GC tasks that divide the
+// handles between them. The handles' finalizers run on one thread after all
+// tasks are done visiting: a finalizer may delete other handles, which must not
+// happen while another task could still be visiting them.
+class UnreachableWeakHandles {
+ public:
+  UnreachableWeakHandles() {}
+
+  // Takes the handles found by one task.
+  void AddAll(MallocGrowableArray<FinalizablePersistentHandle*>* handles);
+
+  // Runs the finalizers of all handles taken so far.
+  void Finalize(IsolateGroup* isolate_group);
+
+ private:
+  Mutex mutex_;
+  MallocGrowableArray<FinalizablePersistentHandle*> handles_;
+
+  DISALLOW_COPY_AND_ASSIGN(UnreachableWeakHandles);
+};
+
 // The space in which `raw_entry`'s `value` is.
 Heap::Space SpaceForExternal(FinalizerEntryPtr raw_entry);
 
@@ -132,7 +169,8 @@ void RunNativeFinalizerCallback(NativeFinalizerPtr raw_finalizer,
                       raw_finalizer->untag(), callback, peer);
     }
     raw_entry.untag()->set_token(raw_entry);
-    (*callback)(peer);
+    visitor->isolate_group()->heap()->finalizer_batches()->RunNativeFinalizer(
+        callback, peer);
     if (external_size > 0) {
       if (FLAG_trace_finalizers) {
         TRACE_FINALIZER("Clearing external size %" Pd " bytes in %s space",
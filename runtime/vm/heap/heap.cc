@@ -12,6 +12,7 @@
 #include "vm/compiler/jit/compiler.h"
 #include "vm/dart.h"
 #include "vm/flags.h"
+#include "vm/heap/memory_pressure.h"
 #include "vm/heap/pages.h"
 #include "vm/heap/safepoint.h"
 #include "vm/heap/scavenger.h"
@@ -34,6 +35,8 @@
 
 namespace dart {
 
+DECLARE_FLAG(bool, old_gen_tlab);
+
 DEFINE_FLAG(bool, write_protect_vm_isolate, true, "Write protect vm_isolate.");
 DEFINE_FLAG(bool,
             disable_heap_verification,
@@ -48,8 +51,13 @@ Heap::Heap(IsolateGroup* isolate_group,
       is_vm_isolate_(is_vm_isolate),
       new_space_(this, max_new_gen_semi_words),
       old_space_(this, max_old_gen_words),
+#if !defined(PRODUCT)
+      heap_profile_(this),
+#endif
+      finalizer_batches_(isolate_group),
       read_only_(false),
       last_gc_was_old_space_(false),
+      memory_pressure_epoch_(MemoryPressure::Global()->critical_epoch()),
       assume_scavenge_will_fail_(false),
       gc_on_nth_allocation_(kNoForcedGarbageCollection) {
   UpdateGlobalMaxUsed();
@@ -104,10 +112,22 @@ uword Heap::AllocateOld(Thread* thread, intptr_t size, Page::PageType type) {
 
   if (!thread->force_growth()) {
     CollectForDebugging(thread);
-    uword addr = old_space_.TryAllocate(size, type);
+    const bool use_tlab =
+        FLAG_old_gen_tlab && (type == Page::kData) && !is_vm_isolate();
+    uword addr = use_tlab ? old_space_.TryAllocateDataTLAB(thread, size)
+                          : old_space_.TryAllocate(size, type);
     if (addr != 0) {
       return addr;
     }
+    // Help the concurrent sweeper a few pages at a time rather than waiting
+    // for all of old space to be swept.
+    while (old_space_.AssistSweep() > 0) {
+      addr = old_space_.TryAllocate(size, type);
+      if (addr != 0) {
+        return addr;
+      }
+      thread->CheckForSafepoint();
+    }
     // Wait for any GC tasks that are in progress.
     WaitForSweeperTasks(thread);
     addr = old_space_.TryAllocate(size, type);
@@ -199,19 +219,34 @@ void Heap::CheckExternalGC(Thread* thread) {
     return;
   }
 
-  if (new_space_.ExternalInWords() >= (4 * new_space_.CapacityInWords())) {
+  const intptr_t new_limit = 4 * new_space_.CapacityInWords();
+  if (new_external_gc_.ShouldCollect(OS::GetCurrentMonotonicMicros(),
+                                     new_space_.ExternalInWords(),
+                                     new_limit)) {
     // Attempt to free some external allocation by a scavenge. (If the total
-    // remains above the limit, next external alloc will trigger another.)
+    // remains above the threshold, a later external alloc will trigger
+    // another.)
     CollectGarbage(thread, GCType::kScavenge, GCReason::kExternal);
+    new_external_gc_.RecordCollection(OS::GetCurrentMonotonicMicros(),
+                                      new_space_.ExternalInWords());
     // Promotion may have pushed old space over its limit. Fall through for old
     // space GC check.
   }
 
-  if (old_space_.ReachedHardThreshold()) {
+  // Old space has no separate limit for external allocations, which count
+  // towards its hard threshold. The policy only holds back collections that
+  // would find no more external allocations to free than the last one did;
+  // concurrent marking still starts for those.
+  if (old_space_.ReachedHardThreshold() &&
+      old_external_gc_.ShouldCollect(OS::GetCurrentMonotonicMicros(),
+                                     old_space_.ExternalInWords(),
+                                     /*limit_in_words=*/0)) {
     if (last_gc_was_old_space_) {
       CollectNewSpaceGarbage(thread, GCType::kScavenge, GCReason::kFull);
     }
     CollectGarbage(thread, GCType::kMarkSweep, GCReason::kExternal);
+    old_external_gc_.RecordCollection(OS::GetCurrentMonotonicMicros(),
+                                      old_space_.ExternalInWords());
   } else {
     CheckConcurrentMarking(thread, GCReason::kExternal, 0);
   }
@@ -474,8 +509,9 @@ void Heap::CollectNewSpaceGarbage(Thread* thread,
     return;
   }
   {
+    const int64_t safepoint_start = OS::GetCurrentMonotonicMicros();
     GcSafepointOperationScope safepoint_operation(thread);
-    RecordBeforeGC(type, reason);
+    RecordBeforeGC(type, reason, safepoint_start);
     {
       VMTagScope tagScope(thread, reason == GCReason::kIdle
                                       ? VMTag::kGCIdleTagId
@@ -486,6 +522,7 @@ void Heap::CollectNewSpaceGarbage(Thread* thread,
       PrintStats();
 #if defined(SUPPORT_TIMELINE)
       PrintStatsToTimeline(&tbes, reason);
+      new_space_.PrintAgesToTimeline(&tbes);
 #endif
       last_gc_was_old_space_ = false;
     }
@@ -493,11 +530,15 @@ void Heap::CollectNewSpaceGarbage(Thread* thread,
       if (old_space_.ReachedHardThreshold()) {
         CollectOldSpaceGarbage(thread, GCType::kMarkSweep,
                                GCReason::kPromotion);
+      } else if (ReachedMemoryPressure()) {
+        CollectOldSpaceGarbage(thread, GCType::kMarkSweep,
+                               GCReason::kLowMemory);
       } else {
         CheckConcurrentMarking(thread, GCReason::kPromotion, 0);
       }
     }
   }
+  finalizer_batches_.Schedule();
 }
 
 void Heap::CollectOldSpaceGarbage(Thread* thread,
@@ -519,6 +560,7 @@ void Heap::CollectOldSpaceGarbage(Thread* thread,
     return;
   }
   {
+    const int64_t safepoint_start = OS::GetCurrentMonotonicMicros();
     GcSafepointOperationScope safepoint_operation(thread);
     if (reason == GCReason::kFinalize) {
       MonitorLocker ml(old_space_.tasks_lock());
@@ -534,13 +576,18 @@ void Heap::CollectOldSpaceGarbage(Thread* thread,
         },
         /*at_safepoint=*/true);
 
-    RecordBeforeGC(type, reason);
+    RecordBeforeGC(type, reason, safepoint_start);
     VMTagScope tagScope(thread, reason == GCReason::kIdle
                                     ? VMTag::kGCIdleTagId
                                     : VMTag::kGCOldSpaceTagId);
     TIMELINE_FUNCTION_GC_DURATION(thread, "CollectOldGeneration");
+    memory_pressure_epoch_ = MemoryPressure::Global()->critical_epoch();
     old_space_.CollectGarbage(thread, /*compact=*/type == GCType::kMarkCompact,
                               /*finalize=*/true);
+    if (reason == GCReason::kLowMemory) {
+      // Return cached pages to the OS instead of keeping them for reuse.
+      Page::ClearCache();
+    }
     RecordAfterGC(type);
     PrintStats();
 #if defined(SUPPORT_TIMELINE)
@@ -557,6 +604,7 @@ void Heap::CollectOldSpaceGarbage(Thread* thread,
     last_gc_was_old_space_ = true;
     assume_scavenge_will_fail_ = false;
   }
+  finalizer_batches_.Schedule();
 }
 
 void Heap::CollectGarbage(Thread* thread, GCType type, GCReason reason) {
@@ -607,6 +655,14 @@ void Heap::CheckCatchUp(Thread* thread) {
   }
 }
 
+bool Heap::ReachedMemoryPressure() {
+  MemoryPressure* pressure = MemoryPressure::Global();
+  if (FLAG_cgroup_aware_heap) {
+    pressure->Poll(OS::GetCurrentMonotonicMicros());
+  }
+  return pressure->critical_epoch() != memory_pressure_epoch_;
+}
+
 void Heap::CheckConcurrentMarking(Thread* thread,
                                   GCReason reason,
                                   intptr_t size) {
@@ -654,8 +710,9 @@ void Heap::CheckConcurrentMarking(Thread* thread,
 }
 
 void Heap::StartConcurrentMarking(Thread* thread, GCReason reason) {
+  const int64_t safepoint_start = OS::GetCurrentMonotonicMicros();
   GcSafepointOperationScope safepoint_operation(thread);
-  RecordBeforeGC(GCType::kStartConcurrentMark, reason);
+  RecordBeforeGC(GCType::kStartConcurrentMark, reason, safepoint_start);
   VMTagScope tagScope(thread, reason == GCReason::kIdle
                                   ? VMTag::kGCIdleTagId
                                   : VMTag::kGCOldSpaceTagId);
@@ -893,6 +950,8 @@ const char* Heap::GCReasonToString(GCReason gc_reason) {
       return "debugging";
     case GCReason::kCatchUp:
       return "catch-up";
+    case GCReason::kLowMemory:
+      return "low memory";
     default:
       UNREACHABLE();
       return "";
@@ -1016,11 +1075,19 @@ void Heap::PrintMemoryUsageJSON(JSONObject* jsobj) const {
 }
 #endif  // PRODUCT
 
-void Heap::RecordBeforeGC(GCType type, GCReason reason) {
+void Heap::RecordBeforeGC(GCType type,
+                          GCReason reason,
+                          int64_t safepoint_start) {
   stats_.num_++;
   stats_.type_ = type;
   stats_.reason_ = reason;
+  stats_.num_tasks_ = 0;
   stats_.before_.micros_ = OS::GetCurrentMonotonicMicros();
+  stats_.safepoint_micros_ = stats_.before_.micros_ - safepoint_start;
+  for (intptr_t i = 0; i < static_cast<intptr_t>(GCPhase::kNumPhases); i++) {
+    stats_.phase_micros_[i] = 0;
+    stats_.phase_cpu_micros_[i] = 0;
+  }
   stats_.before_.new_ = new_space_.GetCurrentUsage();
   stats_.before_.old_ = old_space_.GetCurrentUsage();
   stats_.before_.store_buffer_ = isolate_group_->store_buffer()->Size();
@@ -1098,10 +1165,50 @@ void Heap::RecordAfterGC(GCType type) {
           isolate_group_uptime_micros, old_space_collections);
     }
 
+    // Pause.
+    {
+      event.time_to_safepoint = stats_.safepoint_micros_;
+      event.pause = delta;
+      Dart_GCPhaseTime* phases[] = {&event.roots, &event.marking, &event.weak,
+                                    &event.sweeping, &event.compaction};
+      COMPILE_ASSERT(ARRAY_SIZE(phases) ==
+                     static_cast<intptr_t>(GCPhase::kNumPhases));
+      for (intptr_t i = 0; i < ARRAY_SIZE(phases); i++) {
+        phases[i]->wall = stats_.phase_micros_[i];
+        phases[i]->cpu = stats_.phase_cpu_micros_[i];
+      }
+      event.promoted = 0;
+      if ((stats_.type_ == GCType::kScavenge) ||
+          (stats_.type_ == GCType::kEvacuate)) {
+        event.promoted = new_space_.LastPromotedInWords() * kWordSize;
+      }
+      const intptr_t used_before =
+          stats_.before_.new_.used_in_words + stats_.before_.old_.used_in_words;
+      const intptr_t used_after =
+          stats_.after_.new_.used_in_words + stats_.after_.old_.used_in_words;
+      event.freed = Utils::Maximum<intptr_t>(used_before - used_after, 0) *
+                    kWordSize;
+    }
+
     (*Dart::gc_event_callback())(&event);
   }
 }
 
+GCPhaseScope::GCPhaseScope(Heap* heap, GCPhase phase)
+    : heap_(heap),
+      phase_(static_cast<intptr_t>(phase)),
+      start_micros_(OS::GetCurrentMonotonicMicros()),
+      start_cpu_micros_(OS::GetCurrentThreadCPUMicros()) {
+  ASSERT(phase_ < static_cast<intptr_t>(GCPhase::kNumPhases));
+}
+
+GCPhaseScope::~GCPhaseScope() {
+  heap_->stats_.phase_micros_[phase_] +=
+      OS::GetCurrentMonotonicMicros() - start_micros_;
+  heap_->stats_.phase_cpu_micros_[phase_] +=
+      OS::GetCurrentThreadCPUMicros() - start_cpu_micros_;
+}
+
 void Heap::PrintStats() {
   if (!FLAG_verbose_gc) return;
 
@@ -1110,13 +1217,13 @@ void Heap::PrintStats() {
     OS::PrintErr(
         "[              |                          |     |       |      | new "
         "gen     | new gen     | new gen | old gen       | old gen       | old "
-        "gen     |  store  | delta used   ]\n"
+        "gen     |  store  | delta used   |     ]\n"
         "[ GC isolate   | space (reason)           | GC# | start | time | used "
         "(MB)   | capacity MB | external| used (MB)     | capacity (MB) | "
-        "external MB |  buffer | new  | old   ]\n"
+        "external MB |  buffer | new  | old   | GC  ]\n"
         "[              |                          |     |  (s)  | (ms) "
         "|before| after|before| after| b4 |aftr| before| after | before| after "
-        "|before| after| b4 |aftr| (MB) | (MB)  ]\n");
+        "|before| after| b4 |aftr| (MB) | (MB)  |tasks]\n");
   }
 
   // clang-format off
@@ -1133,6 +1240,7 @@ void Heap::PrintStats() {
     "%5.1f, %5.1f, "   // old gen: external before/after
     "%3" Pd ", %3" Pd ", "   // store buffer: before/after
     "%5.1f, %6.1f, "   // delta used: new gen/old gen
+    "%3" Pd ", "   // scavenger or marker tasks
     "]\n",  // End with a comma to make it easier to import in spreadsheets.
     isolate_group()->source()->name,
     GCTypeToString(stats_.type_),
@@ -1158,7 +1266,8 @@ void Heap::PrintStats() {
     WordsToMB(stats_.after_.new_.used_in_words -
               stats_.before_.new_.used_in_words),
     WordsToMB(stats_.after_.old_.used_in_words -
-              stats_.before_.old_.used_in_words));
+              stats_.before_.old_.used_in_words),
+    stats_.num_tasks_);
   // clang-format on
 }
 
@@ -1168,7 +1277,7 @@ void Heap::PrintStatsToTimeline(TimelineEventScope* event, GCReason reason) {
     return;
   }
   intptr_t arguments = event->GetNumArguments();
-  event->SetNumArguments(arguments + 13);
+  event->SetNumArguments(arguments + 14);
   event->CopyArgument(arguments + 0, "Reason", GCReasonToString(reason));
   event->FormatArgument(arguments + 1, "Before.New.Used (kB)", "%" Pd "",
                         RoundWordsToKB(stats_.before_.new_.used_in_words));
@@ -1196,6 +1305,7 @@ void Heap::PrintStatsToTimeline(TimelineEventScope* event, GCReason reason) {
                         RoundWordsToKB(stats_.before_.old_.external_in_words));
   event->FormatArgument(arguments + 12, "After.Old.External (kB)", "%" Pd "",
                         RoundWordsToKB(stats_.after_.old_.external_in_words));
+  event->FormatArgument(arguments + 13, "Tasks", "%" Pd "", stats_.num_tasks_);
 #endif  // defined(SUPPORT_TIMELINE)
 }
 
@@ -15,6 +15,8 @@
 #include "vm/allocation.h"
 #include "vm/flags.h"
 #include "vm/globals.h"
+#include "vm/heap/external_memory.h"
+#include "vm/heap/heap_profile.h"
 #include "vm/heap/pages.h"
 #include "vm/heap/scavenger.h"
 #include "vm/heap/spaces.h"
@@ -48,6 +50,9 @@ class Heap {
     kCanonicalHashes,
     kObjectIds,
     kLoadingUnits,
+#if !defined(PRODUCT)
+    kHeapSamples,
+#endif
     kNumWeakSelectors
   };
 
@@ -72,6 +77,10 @@ class Heap {
 
   Scavenger* new_space() { return &new_space_; }
   PageSpace* old_space() { return &old_space_; }
+#if !defined(PRODUCT)
+  HeapProfile* heap_profile() { return &heap_profile_; }
+#endif
+  FinalizerBatches* finalizer_batches() { return &finalizer_batches_; }
 
   uword Allocate(Thread* thread, intptr_t size, Space space) {
     ASSERT(!read_only_);
@@ -146,6 +155,9 @@ class Heap {
                          bool compact = false);
 
   void CheckCatchUp(Thread* thread);
+  // Whether memory pressure has become critical since old space was last
+  // collected.
+  bool ReachedMemoryPressure();
   void CheckConcurrentMarking(Thread* thread, GCReason reason, intptr_t size);
   void StartConcurrentMarking(Thread* thread, GCReason reason);
   void WaitForMarkerTasks(Thread* thread);
@@ -314,6 +326,10 @@ class Heap {
     GCReason reason_;
     LeakCountState state_;  // State to track finalization of GCed object.
     intptr_t reachability_barrier_;  // Tracks reachability of GCed objects.
+    intptr_t num_tasks_;  // Scavenger or marker tasks used; 0 if serial.
+    int64_t safepoint_micros_;  // Time taken to stop the mutators.
+    int64_t phase_micros_[static_cast<intptr_t>(GCPhase::kNumPhases)];
+    int64_t phase_cpu_micros_[static_cast<intptr_t>(GCPhase::kNumPhases)];
 
     class Data : public ValueObject {
      public:
@@ -361,7 +377,8 @@ class Heap {
   void CollectOldSpaceGarbage(Thread* thread, GCType type, GCReason reason);
 
   // GC stats collection.
-  void RecordBeforeGC(GCType type, GCReason reason);
+  // [safepoint_start] is when the safepoint for the collection was requested.
+  void RecordBeforeGC(GCType type, GCReason reason, int64_t safepoint_start);
   void RecordAfterGC(GCType type);
   void PrintStats();
   void PrintStatsToTimeline(TimelineEventScope* event, GCReason reason);
@@ -381,6 +398,17 @@ class Heap {
   WeakTable* new_weak_tables_[kNumWeakSelectors];
   WeakTable* old_weak_tables_[kNumWeakSelectors];
 
+#if !defined(PRODUCT)
+  HeapProfile heap_profile_;
+#endif
+
+  // Finalizer callbacks queued by collections.
+  FinalizerBatches finalizer_batches_;
+
+  // When external allocations alone should collect each space.
+  ExternalGCPolicy new_external_gc_;
+  ExternalGCPolicy old_external_gc_;
+
   // GC stats collection.
   GCStats stats_;
 
@@ -390,6 +418,9 @@ class Heap {
   bool read_only_;
 
   bool last_gc_was_old_space_;
+  // MemoryPressure::critical_epoch() when old space was last collected, or
+  // when the heap was created.
+  intptr_t memory_pressure_epoch_;
   bool assume_scavenge_will_fail_;
 
   static const intptr_t kNoForcedGarbageCollection = -1;
@@ -413,10 +444,28 @@ class Heap {
   friend class Serializer;            // VisitObjectsImagePages
   friend class HeapTestHelper;
   friend class GCTestHelper;
+  friend class GCPhaseScope;
 
   DISALLOW_COPY_AND_ASSIGN(Heap);
 };
 
+// Adds the wall time and the CPU time of the current thread spent in its
+// scope to a phase of the current collection. Helper tasks are not included
+// in the CPU time.
+class GCPhaseScope : public ValueObject {
+ public:
+  GCPhaseScope(Heap* heap, GCPhase phase);
+  ~GCPhaseScope();
+
+ private:
+  Heap* heap_;
+  intptr_t phase_;
+  int64_t start_micros_;
+  int64_t start_cpu_micros_;
+
+  DISALLOW_COPY_AND_ASSIGN(GCPhaseScope);
+};
+
 class HeapIterationScope : public ThreadStackResource {
  public:
   explicit HeapIterationScope(Thread* thread, bool writable = false);
@@ -0,0 +1,349 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#if !defined(PRODUCT)
+
+#include "vm/heap/heap_profile.h"
+
+#include "platform/utils.h"
+#include "vm/datastream.h"
+#include "vm/heap/heap.h"
+#include "vm/heap/safepoint.h"
+#include "vm/heap/sampler.h"
+#include "vm/heap/weak_table.h"
+#include "vm/lockers.h"
+#include "vm/object.h"
+#include "vm/os.h"
+#include "vm/stack_frame.h"
+#include "vm/thread.h"
+#include "vm/zone_text_buffer.h"
+
+namespace dart {
+
+// Encodes protocol buffer messages. Nested messages are encoded into their
+// own writer first, as their length precedes them.
+class ProtobufWriter : public ValueObject {
+ public:
+  ProtobufWriter() : stream_(kInitialSize) {}
+
+  void WriteVarint(uint64_t value) {
+    while (value >= 0x80) {
+      stream_.WriteByte(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    stream_.WriteByte(static_cast<uint8_t>(value));
+  }
+
+  void WriteInt(intptr_t field, int64_t value) {
+    WriteTag(field, kVarint);
+    WriteVarint(static_cast<uint64_t>(value));
+  }
+
+  void WriteBytes(intptr_t field, const void* bytes, intptr_t length) {
+    WriteTag(field, kLengthDelimited);
+    WriteVarint(length);
+    stream_.WriteBytes(bytes, length);
+  }
+
+  void WriteString(intptr_t field, const char* str) {
+    WriteBytes(field, str, strlen(str));
+  }
+
+  void WriteMessage(intptr_t field, const ProtobufWriter& message) {
+    WriteBytes(field, message.stream_.buffer(),
+               message.stream_.bytes_written());
+  }
+
+  void WritePacked(intptr_t field, const int64_t* values, intptr_t length) {
+    ProtobufWriter packed;
+    for (intptr_t i = 0; i < length; i++) {
+      packed.WriteVarint(static_cast<uint64_t>(values[i]));
+    }
+    WriteMessage(field, packed);
+  }
+
+  uint8_t* Steal(intptr_t* length) { return stream_.Steal(length); }
+
+ private:
+  static constexpr intptr_t kInitialSize = 64;
+
+  enum WireType {
+    kVarint = 0,
+    kLengthDelimited = 2,
+  };
+
+  void WriteTag(intptr_t field, WireType type) {
+    WriteVarint((static_cast<uint64_t>(field) << 3) | type);
+  }
+
+  MallocWriteStream stream_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProtobufWriter);
+};
+
+// Field numbers of profile.proto.
+enum ProfileField {
+  kProfileSampleType = 1,
+  kProfileSample = 2,
+  kProfileLocation = 4,
+  kProfileFunction = 5,
+  kProfileStringTable = 6,
+  kProfileTimeNanos = 9,
+  kProfilePeriodType = 11,
+  kProfilePeriod = 12,
+};
+enum ValueTypeField {
+  kValueTypeType = 1,
+  kValueTypeUnit = 2,
+};
+enum SampleField {
+  kSampleLocationId = 1,
+  kSampleValue = 2,
+};
+enum LocationField {
+  kLocationId = 1,
+  kLocationLine = 4,
+};
+enum LineField {
+  kLineFunctionId = 1,
+};
+enum FunctionField {
+  kFunctionId = 1,
+  kFunctionName = 2,
+  kFunctionSystemName = 3,
+  kFunctionFilename = 4,
+};
+
+// The order of the values of each sample.
+enum SampleValue {
+  kAllocObjects,
+  kAllocSpace,
+  kInuseObjects,
+  kInuseSpace,
+  kNumSampleValues,
+};
+
+static const char* const kSampleTypes[kNumSampleValues][2] = {
+    {"alloc_objects", "count"},
+    {"alloc_space", "bytes"},
+    {"inuse_objects", "count"},
+    {"inuse_space", "bytes"},
+};
+
+// The function standing for allocations made outside of Dart code.
+static const char* const kVMFunctionName = "[VM]";
+
+HeapProfile::HeapProfile(Heap* heap) : heap_(heap) {
+  InternString("");
+}
+
+HeapProfile::~HeapProfile() {
+  for (intptr_t i = 0; i < strings_.length(); i++) {
+    free(strings_[i]);
+  }
+  for (intptr_t i = 0; i < keys_.length(); i++) {
+    free(keys_[i]);
+  }
+}
+
+intptr_t HeapProfile::EncodeSample(intptr_t stack, intptr_t weight) {
+  ASSERT((stack >= 0) && (stack < kMaxStacks));
+  const intptr_t weight_in_kb =
+      Utils::Minimum(Utils::Maximum<intptr_t>(weight / KB, 1), kMaxWeightInKB);
+  return (weight_in_kb << kStackIndexBits) | (stack + 1);
+}
+
+intptr_t HeapProfile::InternString(const char* str) {
+  ASSERT(mutex_.IsOwnedByCurrentThread() || strings_.is_empty());
+  const intptr_t id = string_ids_.LookupValue(str);
+  if (id != CStringIntMapKeyValueTrait::kNoValue) {
+    return id;
+  }
+  char* copy = Utils::StrDup(str);
+  strings_.Add(copy);
+  string_ids_.Insert({copy, strings_.length() - 1});
+  return strings_.length() - 1;
+}
+
+intptr_t HeapProfile::InternFunction(const char* name, const char* url) {
+  ASSERT(mutex_.IsOwnedByCurrentThread());
+  char* key = OS::SCreate(nullptr, "%s\n%s", name, url);
+  const intptr_t id = function_ids_.LookupValue(key);
+  if (id != CStringIntMapKeyValueTrait::kNoValue) {
+    free(key);
+    return id;
+  }
+  keys_.Add(key);
+  functions_.Add(InternString(name));
+  functions_.Add(InternString(url));
+  const intptr_t function = (functions_.length() / 2) - 1;
+  function_ids_.Insert({key, function});
+  return function;
+}
+
+intptr_t HeapProfile::InternStack(const char* key,
+                                  const intptr_t* functions,
+                                  intptr_t num_functions) {
+  ASSERT(mutex_.IsOwnedByCurrentThread());
+  const intptr_t id = stack_ids_.LookupValue(key);
+  if (id != CStringIntMapKeyValueTrait::kNoValue) {
+    return id;
+  }
+  if (stacks_.length() >= kMaxStacks) {
+    return -1;
+  }
+  char* copy = Utils::StrDup(key);
+  keys_.Add(copy);
+  stacks_.Add({frames_.length(), num_functions, 0, 0});
+  for (intptr_t i = 0; i < num_functions; i++) {
+    frames_.Add(functions[i]);
+  }
+  stack_ids_.Insert({copy, stacks_.length() - 1});
+  return stacks_.length() - 1;
+}
+
+void HeapProfile::RecordSample(Thread* thread,
+                               ObjectPtr obj,
+                               intptr_t size,
+                               intptr_t weight) {
+  ASSERT(thread == Thread::Current());
+  Zone* zone = thread->zone();
+
+  // Name the frames outside of the lock, as this uses handles.
+  const char* names[kMaxFrames];
+  const char* urls[kMaxFrames];
+  intptr_t num_frames = 0;
+  Code& code = Code::Handle(zone);
+  Function& function = Function::Handle(zone);
+  Script& script = Script::Handle(zone);
+  String& url = String::Handle(zone);
+  DartFrameIterator frames(thread, StackFrameIterator::kNoCrossThreadIteration);
+  for (StackFrame* frame = frames.NextFrame();
+       (frame != nullptr) && (num_frames < kMaxFrames);
+       frame = frames.NextFrame()) {
+    code = frame->LookupDartCode();
+    if (code.IsNull() || !code.IsFunctionCode()) {
+      continue;
+    }
+    function = code.function();
+    script = function.script();
+    url = script.IsNull() ? String::null() : script.url();
+    names[num_frames] = function.QualifiedUserVisibleNameCString();
+    urls[num_frames] = url.IsNull() ? "" : url.ToCString();
+    num_frames++;
+  }
+  if (num_frames == 0) {
+    names[0] = kVMFunctionName;
+    urls[0] = "";
+    num_frames = 1;
+  }
+
+  intptr_t stack;
+  {
+    MutexLocker ml(&mutex_);
+    intptr_t functions[kMaxFrames];
+    ZoneTextBuffer key(zone);
+    for (intptr_t i = 0; i < num_frames; i++) {
+      functions[i] = InternFunction(names[i], urls[i]);
+      key.Printf("%" Pd ",", functions[i]);
+    }
+    stack = InternStack(key.buffer(), functions, num_frames);
+    if (stack < 0) {
+      return;
+    }
+    stacks_[stack].alloc_objects += Utils::Maximum<intptr_t>(weight / size, 1);
+    stacks_[stack].alloc_bytes += weight;
+  }
+  heap_->SetWeakEntry(obj, Heap::kHeapSamples, EncodeSample(stack, weight));
+}
+
+uint8_t* HeapProfile::Write(Thread* thread, intptr_t* length) {
+  GcSafepointOperationScope safepoint(thread);
+  MutexLocker ml(&mutex_);
+
+  // Find the live samples.
+  const intptr_t num_stacks = stacks_.length();
+  int64_t* inuse = reinterpret_cast<int64_t*>(
+      calloc(2 * Utils::Maximum<intptr_t>(num_stacks, 1), sizeof(int64_t)));
+  const Heap::Space spaces[] = {Heap::kNew, Heap::kOld};
+  for (Heap::Space space : spaces) {
+    WeakTable* table = heap_->GetWeakTable(space, Heap::kHeapSamples);
+    for (intptr_t i = 0; i < table->num_slots(); i++) {
+      if (!table->IsValidEntryAtExclusive(i)) {
+        continue;
+      }
+      const intptr_t value = table->ValueAtExclusive(i);
+      const intptr_t stack = DecodeStack(value);
+      const intptr_t weight = DecodeWeight(value);
+      const intptr_t size = table->ObjectAtExclusive(i)->untag()->HeapSize();
+      inuse[2 * stack] += Utils::Maximum<intptr_t>(weight / size, 1);
+      inuse[2 * stack + 1] += weight;
+    }
+  }
+
+  ProtobufWriter profile;
+  intptr_t type_ids[kNumSampleValues][2];
+  for (intptr_t i = 0; i < kNumSampleValues; i++) {
+    type_ids[i][0] = InternString(kSampleTypes[i][0]);
+    type_ids[i][1] = InternString(kSampleTypes[i][1]);
+    ProtobufWriter value_type;
+    value_type.WriteInt(kValueTypeType, type_ids[i][0]);
+    value_type.WriteInt(kValueTypeUnit, type_ids[i][1]);
+    profile.WriteMessage(kProfileSampleType, value_type);
+  }
+
+  int64_t location_ids[kMaxFrames];
+  for (intptr_t i = 0; i < num_stacks; i++) {
+    const Stack& stack = stacks_[i];
+    int64_t values[kNumSampleValues];
+    values[kAllocObjects] = stack.alloc_objects;
+    values[kAllocSpace] = stack.alloc_bytes;
+    values[kInuseObjects] = inuse[2 * i];
+    values[kInuseSpace] = inuse[2 * i + 1];
+    // Each function has a single location, numbered from 1.
+    for (intptr_t j = 0; j < stack.num_frames; j++) {
+      location_ids[j] = frames_[stack.first_frame + j] + 1;
+    }
+    ProtobufWriter sample;
+    sample.WritePacked(kSampleLocationId, location_ids, stack.num_frames);
+    sample.WritePacked(kSampleValue, values, kNumSampleValues);
+    profile.WriteMessage(kProfileSample, sample);
+  }
+  free(inuse);
+
+  const intptr_t num_functions = functions_.length() / 2;
+  for (intptr_t i = 0; i < num_functions; i++) {
+    ProtobufWriter line;
+    line.WriteInt(kLineFunctionId, i + 1);
+    ProtobufWriter location;
+    location.WriteInt(kLocationId, i + 1);
+    location.WriteMessage(kLocationLine, line);
+    profile.WriteMessage(kProfileLocation, location);
+  }
+  for (intptr_t i = 0; i < num_functions; i++) {
+    ProtobufWriter function;
+    function.WriteInt(kFunctionId, i + 1);
+    function.WriteInt(kFunctionName, functions_[2 * i]);
+    function.WriteInt(kFunctionSystemName, functions_[2 * i]);
+    function.WriteInt(kFunctionFilename, functions_[2 * i + 1]);
+    profile.WriteMessage(kProfileFunction, function);
+  }
+
+  ProtobufWriter period_type;
+  period_type.WriteInt(kValueTypeType, InternString("space"));
+  period_type.WriteInt(kValueTypeUnit, InternString("bytes"));
+  // The string table must be complete before it is written.
+  for (intptr_t i = 0; i < strings_.length(); i++) {
+    profile.WriteString(kProfileStringTable, strings_[i]);
+  }
+  profile.WriteInt(kProfileTimeNanos, OS::GetCurrentTimeMicros() * 1000);
+  profile.WriteMessage(kProfilePeriodType, period_type);
+  profile.WriteInt(kProfilePeriod, HeapProfileSampler::sampling_interval());
+
+  return profile.Steal(length);
+}
+
+}  // namespace dart
+
+#endif  // !defined(PRODUCT)
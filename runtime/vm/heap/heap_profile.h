@@ -0,0 +1,118 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef RUNTIME_VM_HEAP_HEAP_PROFILE_H_
+#define RUNTIME_VM_HEAP_HEAP_PROFILE_H_
+
+#if !defined(PRODUCT)
+
+#include "platform/growable_array.h"
+
+#include "vm/allocation.h"
+#include "vm/globals.h"
+#include "vm/hash_map.h"
+#include "vm/os_thread.h"
+#include "vm/tagged_pointer.h"
+
+namespace dart {
+
+// Forward declarations.
+class Heap;
+class Thread;
+
+// A sampled profile of the allocations of an isolate group, keyed by the Dart
+// stack that allocated them.
+//
+// Every allocation chosen by a thread's HeapProfileSampler is recorded here
+// with the weight the sampler assigned to it. The sampled object is entered
+// into the heap's kHeapSamples weak table, so the GC forgets samples whose
+// objects die and the objects still alive give an estimate of the retained
+// (in use) space per stack, while the totals kept per stack give the
+// allocated space.
+//
+// The profile is exported in the pprof format (profile.proto), with the
+// sample types alloc_objects, alloc_space, inuse_objects and inuse_space.
+class HeapProfile {
+ public:
+  explicit HeapProfile(Heap* heap);
+  ~HeapProfile();
+
+  // Records [obj], of [size] bytes, which the sampler of [thread] chose to
+  // stand for [weight] bytes of allocation. Must be called by [thread] right
+  // after allocating [obj].
+  void RecordSample(Thread* thread,
+                    ObjectPtr obj,
+                    intptr_t size,
+                    intptr_t weight);
+
+  // Returns the profile as a malloc'd, uncompressed pprof message and stores
+  // its length in [length]. Pauses the isolate group to find the sampled
+  // objects that are still alive.
+  uint8_t* Write(Thread* thread, intptr_t* length);
+
+  intptr_t num_stacks() const { return stacks_.length(); }
+
+  // Deeper stacks are truncated to their innermost frames.
+  static constexpr intptr_t kMaxFrames = 64;
+
+ private:
+  struct Stack {
+    intptr_t first_frame;
+    intptr_t num_frames;
+    int64_t alloc_objects;
+    int64_t alloc_bytes;
+  };
+
+  // The value of a sample in the weak table holds the index of its stack
+  // plus one in the low half and its weight in KB in the high half.
+  static constexpr intptr_t kStackIndexBits = kBitsPerWord / 2;
+  static constexpr intptr_t kMaxStacks =
+      (static_cast<intptr_t>(1) << kStackIndexBits) - 1;
+  static constexpr intptr_t kMaxWeightInKB =
+      (static_cast<intptr_t>(1) << (kBitsPerWord - kStackIndexBits - 1)) - 1;
+
+  static intptr_t EncodeSample(intptr_t stack, intptr_t weight);
+  static intptr_t DecodeStack(intptr_t value) {
+    return (value & kMaxStacks) - 1;
+  }
+  static intptr_t DecodeWeight(intptr_t value) {
+    return (value >> kStackIndexBits) * KB;
+  }
+
+  intptr_t InternString(const char* str);
+  intptr_t InternFunction(const char* name, const char* url);
+  intptr_t InternStack(const char* key,
+                       const intptr_t* functions,
+                       intptr_t num_functions);
+
+  Heap* heap_;
+
+  // Protects the tables below, which only grow.
+  Mutex mutex_;
+
+  // The pprof string table, where the empty string comes first.
+  MallocGrowableArray<char*> strings_;
+  MallocDirectChainedHashMap<CStringIntMapKeyValueTrait> string_ids_;
+
+  // Functions as pairs of indices into strings_ for the name and the url of
+  // its script.
+  MallocGrowableArray<intptr_t> functions_;
+  MallocDirectChainedHashMap<CStringIntMapKeyValueTrait> function_ids_;
+
+  // Stacks of indices into functions_, innermost first, stored back to back
+  // in frames_.
+  MallocGrowableArray<Stack> stacks_;
+  MallocGrowableArray<intptr_t> frames_;
+  MallocDirectChainedHashMap<CStringIntMapKeyValueTrait> stack_ids_;
+
+  // Owned keys of function_ids_ and stack_ids_.
+  MallocGrowableArray<char*> keys_;
+
+  DISALLOW_COPY_AND_ASSIGN(HeapProfile);
+};
+
+}  // namespace dart
+
+#endif  // !defined(PRODUCT)
+#endif  // RUNTIME_VM_HEAP_HEAP_PROFILE_H_
@@ -14,7 +14,11 @@
 #include "vm/dart_api_impl.h"
 #include "vm/globals.h"
 #include "vm/heap/become.h"
+#include "vm/heap/evacuator.h"
+#include "vm/heap/gc_shared.h"
 #include "vm/heap/heap.h"
+#include "vm/heap/pointer_block.h"
+#include "vm/heap/sweeper.h"
 #include "vm/message_handler.h"
 #include "vm/message_snapshot.h"
 #include "vm/object_graph.h"
@@ -24,6 +28,8 @@
 
 namespace dart {
 
+DECLARE_FLAG(int, early_tenuring_threshold);
+
 TEST_CASE(OldGC) {
   const char* kScriptChars =
       "main() {\n"
@@ -898,4 +904,582 @@ ISOLATE_UNIT_TEST_CASE(WeakSmi) {
   EXPECT(old_finalizer.value() == Smi::New(42));
 }
 
+VM_UNIT_TEST_CASE(AdaptiveGCTasks) {
+  {
+    SetFlagScope<bool> sfs(&FLAG_adaptive_gc_tasks, false);
+    EXPECT_EQ(2, ChooseGCTasks(2, 0, MBInWords));
+    EXPECT_EQ(2, ChooseGCTasks(2, 100 * MBInWords, MBInWords));
+    EXPECT_EQ(1, ChooseGCTasks(2, 100 * MBInWords, MBInWords, 1));
+  }
+  {
+    SetFlagScope<bool> sfs(&FLAG_adaptive_gc_tasks, true);
+    const intptr_t max_tasks = MaxGCTasks(2);
+    EXPECT_LE(1, max_tasks);
+    EXPECT_LE(max_tasks, OS::NumberOfUsableProcessors());
+    // Zero still means serial.
+    EXPECT_EQ(0, MaxGCTasks(0));
+    EXPECT_EQ(0, ChooseGCTasks(0, 100 * MBInWords, MBInWords));
+    // Small heaps get a single task, large heaps all available ones.
+    EXPECT_EQ(1, ChooseGCTasks(2, 0, MBInWords));
+    EXPECT_EQ(max_tasks, ChooseGCTasks(2, 1024 * MBInWords, MBInWords));
+    EXPECT_EQ(Utils::Minimum<intptr_t>(3, max_tasks),
+              ChooseGCTasks(2, 3 * MBInWords, MBInWords));
+  }
+}
+
+VM_UNIT_TEST_CASE(WorkStealingDeque) {
+  WorkStealingDeque<4>* deque = new WorkStealingDeque<4>();
+  ObjectPtr a = Smi::New(1);
+  ObjectPtr b = Smi::New(2);
+  ObjectPtr c = Smi::New(3);
+  EXPECT(deque->Pop() == nullptr);
+  EXPECT(deque->Steal() == nullptr);
+
+  // The owner pops newest first; thieves steal oldest first.
+  EXPECT(deque->Push(a));
+  EXPECT(deque->Push(b));
+  EXPECT(deque->Push(c));
+  EXPECT_EQ(3, deque->Size());
+  EXPECT(deque->Steal() == a);
+  EXPECT(deque->Pop() == c);
+  EXPECT(deque->Pop() == b);
+  EXPECT(deque->Pop() == nullptr);
+  EXPECT(deque->IsEmpty());
+
+  // Pushing fails once the deque is full, and wraps around after stealing.
+  for (intptr_t i = 0; i < 4; i++) {
+    EXPECT(deque->Push(a));
+  }
+  EXPECT(!deque->Push(b));
+  EXPECT(deque->Steal() == a);
+  EXPECT(deque->Push(b));
+  EXPECT(deque->Pop() == b);
+  while (deque->Pop() != nullptr) {
+  }
+  EXPECT(deque->IsEmpty());
+  delete deque;
+}
+
+ISOLATE_UNIT_TEST_CASE(PretenureSurvivingAllocationSite) {
+  Scavenger* new_space = thread->heap()->new_space();
+  AllocationSiteTable* sites = new_space->allocation_sites();
+  const uword kSurvivingSite = 0x1000;
+  const uword kDyingSite = 0x2000;
+  const intptr_t kNumSamples = AllocationSiteTable::kMinSamples;
+
+  const Array& holder = Array::Handle(Array::New(kNumSamples, Heap::kOld));
+  {
+    HANDLESCOPE(thread);
+    Array& element = Array::Handle();
+    for (intptr_t i = 0; i < kNumSamples; i++) {
+      element = Array::New(1, Heap::kNew);
+      holder.SetAt(i, element);
+      sites->RecordAllocation(kSurvivingSite, element.ptr());
+      element = Array::New(1, Heap::kNew);
+      sites->RecordAllocation(kDyingSite, element.ptr());
+    }
+  }
+  GCTestHelper::CollectNewSpace();
+  EXPECT(sites->ShouldPretenure(kSurvivingSite));
+  EXPECT(!sites->ShouldPretenure(kDyingSite));
+
+  // Old-space allocations for pretenured sites are reported by the next
+  // scavenge as copying avoided.
+  const intptr_t pretenured_before = new_space->pretenured_in_words();
+  sites->RecordPretenured(4 * kWordSize);
+  GCTestHelper::CollectNewSpace();
+  EXPECT_EQ(pretenured_before + 4, new_space->pretenured_in_words());
+
+  // Decisions are kept across old-space collections.
+  GCTestHelper::CollectOldSpace();
+  EXPECT(sites->ShouldPretenure(kSurvivingSite));
+}
+
+// Allocates [count] objects for [site] like the runtime entries do, and adds
+// them to [retained] unless it is null. Returns how many were pretenured.
+static intptr_t AllocateAtSite(AllocationSiteTable* sites,
+                               uword site,
+                               intptr_t count,
+                               const GrowableObjectArray& retained) {
+  HANDLESCOPE(Thread::Current());
+  Array& element = Array::Handle();
+  intptr_t pretenured = 0;
+  for (intptr_t i = 0; i < count; i++) {
+    if (sites->ShouldPretenure(site)) {
+      element = Array::New(1, Heap::kOld);
+      sites->RecordPretenured(element.ptr()->untag()->HeapSize());
+      pretenured++;
+    } else {
+      element = Array::New(1, Heap::kNew);
+      sites->RecordAllocation(site, element.ptr());
+    }
+    if (!retained.IsNull()) {
+      retained.Add(element);
+    }
+  }
+  return pretenured;
+}
+
+ISOLATE_UNIT_TEST_CASE(PretenuredSiteStaysPretenuredAcrossGCs) {
+  AllocationSiteTable* sites = thread->heap()->new_space()->allocation_sites();
+  const uword kSite = 0x3000;
+  const intptr_t kAllocations = AllocationSiteTable::kMinSamples *
+                                AllocationSiteTable::kPretenuredSampleInterval;
+  const intptr_t kSampled =
+      kAllocations / AllocationSiteTable::kPretenuredSampleInterval;
+  const GrowableObjectArray& retained =
+      GrowableObjectArray::Handle(GrowableObjectArray::New(Heap::kOld));
+
+  // Surviving objects get the site pretenured by the first scavenge. From
+  // then on it stays pretenured through scavenges and old-space collections,
+  // while a few of its objects are still sampled in new space.
+  EXPECT_EQ(0, AllocateAtSite(sites, kSite, kAllocations, retained));
+  GCTestHelper::CollectNewSpace();
+  for (intptr_t i = 0; i < 4; i++) {
+    GCTestHelper::CollectOldSpace();
+    EXPECT_EQ(kAllocations - kSampled,
+              AllocateAtSite(sites, kSite, kAllocations, retained));
+    GCTestHelper::CollectNewSpace();
+  }
+
+  // Once its objects stop surviving, the site allocates in new space again.
+  const GrowableObjectArray& none = GrowableObjectArray::Handle();
+  for (intptr_t i = 0; i < 8; i++) {
+    AllocateAtSite(sites, kSite, kAllocations, none);
+    GCTestHelper::CollectNewSpace();
+  }
+  EXPECT_EQ(0, AllocateAtSite(sites, kSite, kAllocations, none));
+}
+
+ISOLATE_UNIT_TEST_CASE(TenureAge) {
+  SetFlagScope<int> sfs_age(&FLAG_scavenger_tenure_age, 3);
+  SetFlagScope<bool> sfs_adaptive(&FLAG_adaptive_tenure_age, false);
+  // Never promote everything early.
+  SetFlagScope<int> sfs_early(&FLAG_early_tenuring_threshold, 101);
+  Scavenger* new_space = thread->heap()->new_space();
+  GCTestHelper::CollectAllGarbage();
+  EXPECT_EQ(3, new_space->tenure_age());
+
+  const Array& array = Array::Handle(Array::New(4, Heap::kNew));
+  const intptr_t size_in_words = Array::InstanceSize(4) >> kWordSizeLog2;
+  for (intptr_t age = 0; age < 3; age++) {
+    GCTestHelper::CollectNewSpace();
+    EXPECT(array.IsNew());
+    EXPECT_LE(size_in_words, new_space->LastSurvivedOfAge(age));
+  }
+  EXPECT_LE(size_in_words, new_space->LastWordsOfAge(2));
+  GCTestHelper::CollectNewSpace();
+  EXPECT(array.IsOld());
+  EXPECT_LE(size_in_words, new_space->LastSurvivedOfAge(3));
+}
+
+VM_UNIT_TEST_CASE(NextTenureAge) {
+  SetFlagScope<int> sfs_age(&FLAG_scavenger_tenure_age, 2);
+  SetFlagScope<int> sfs_early(&FLAG_early_tenuring_threshold, 60);
+  {
+    SetFlagScope<bool> sfs_adaptive(&FLAG_adaptive_tenure_age, false);
+    EXPECT_EQ(2, Scavenger::NextTenureAge(1, 0.1));
+    EXPECT_EQ(2, Scavenger::NextTenureAge(3, 0.9));
+  }
+  SetFlagScope<bool> sfs_adaptive(&FLAG_adaptive_tenure_age, true);
+  // Few candidates survive: wait longer.
+  EXPECT_EQ(3, Scavenger::NextTenureAge(2, 0.1));
+  EXPECT_EQ(Scavenger::kMaxTenureAge,
+            Scavenger::NextTenureAge(Scavenger::kMaxTenureAge, 0.1));
+  // Most survive: promote sooner.
+  EXPECT_EQ(1, Scavenger::NextTenureAge(2, 0.9));
+  EXPECT_EQ(1, Scavenger::NextTenureAge(1, 0.9));
+  // In between, or no candidates.
+  EXPECT_EQ(2, Scavenger::NextTenureAge(2, 0.5));
+  EXPECT_EQ(2, Scavenger::NextTenureAge(2, -1.0));
+}
+
+static void CountingFinalizer(void* isolate_callback_data, void* peer) {
+  (*static_cast<intptr_t*>(peer))++;
+}
+
+ISOLATE_UNIT_TEST_CASE(ParallelWeakHandleProcessing) {
+  // Finalize any GC in progress as it is unsafe to change FLAG_marker_tasks
+  // when incremental marking is in progress.
+  GCTestHelper::CollectAllGarbage();
+  SetFlagScope<int> sfs_marker(&FLAG_marker_tasks, 4);
+  SetFlagScope<int> sfs_scavenger(&FLAG_scavenger_tasks, 4);
+
+  // Enough handles to fill many handle blocks, so every task gets some.
+  const intptr_t kNumHandles = 4 * KB;
+  auto isolate_group = thread->isolate_group();
+  Heap* heap = thread->heap();
+  intptr_t finalized = 0;
+  intptr_t peer_marker = 0;
+
+  const Array& holder = Array::Handle(Array::New(kNumHandles, Heap::kOld));
+  {
+    HANDLESCOPE(thread);
+    Array& element = Array::Handle();
+    for (intptr_t i = 0; i < kNumHandles; i++) {
+      // Alternate spaces and reachability.
+      element = Array::New(1, (i % 4) < 2 ? Heap::kNew : Heap::kOld);
+      FinalizablePersistentHandle::New(isolate_group, element, &finalized,
+                                       CountingFinalizer, 0,
+                                       /*auto_delete=*/true);
+      heap->SetPeer(element.ptr(), &peer_marker);
+      if ((i % 2) == 0) {
+        holder.SetAt(i, element);
+      }
+    }
+  }
+
+  // Only the unreachable new-space objects are finalized by a scavenge.
+  GCTestHelper::CollectNewSpace();
+  EXPECT_EQ(kNumHandles / 4, finalized);
+
+  // The rest of the unreachable objects are finalized by a mark-sweep, and
+  // the weak table entries of the survivors are kept.
+  GCTestHelper::CollectOldSpace();
+  EXPECT_EQ(kNumHandles / 2, finalized);
+  Object& element = Object::Handle();
+  for (intptr_t i = 0; i < kNumHandles; i += 2) {
+    element = holder.At(i);
+    EXPECT(heap->GetPeer(element.ptr()) == &peer_marker);
+  }
+
+  for (intptr_t i = 0; i < kNumHandles; i++) {
+    holder.SetAt(i, Object::null_object());
+  }
+  GCTestHelper::CollectAllGarbage();
+  EXPECT_EQ(kNumHandles, finalized);
+}
+
+ISOLATE_UNIT_TEST_CASE(EvacuateFragmentedPages) {
+  // Finish any concurrent marking, which would prevent evacuation.
+  GCTestHelper::CollectAllGarbage();
+  SetFlagScope<bool> sfs(&FLAG_evacuate_fragmented_pages, true);
+  Heap* heap = thread->heap();
+
+  // Fill several pages while keeping only one array in sixteen alive, and a
+  // view into a typed data allocated among them.
+  const intptr_t kNumArrays = 16 * KB;
+  const intptr_t kKeepEvery = 16;
+  intptr_t peer = 0;
+  const Array& survivors =
+      Array::Handle(Array::New(kNumArrays / kKeepEvery, Heap::kOld));
+  TypedDataView& view = TypedDataView::Handle();
+  {
+    HANDLESCOPE(thread);
+    Array& element = Array::Handle();
+    Smi& value = Smi::Handle();
+    for (intptr_t i = 0; i < kNumArrays; i++) {
+      element = Array::New(32, Heap::kOld);
+      value = Smi::New(i);
+      element.SetAt(0, value);
+      if ((i % kKeepEvery) == 0) {
+        survivors.SetAt(i / kKeepEvery, element);
+        heap->SetPeer(element.ptr(), &peer);
+      }
+      if (i == kNumArrays / 2) {
+        const TypedData& data = TypedData::Handle(
+            TypedData::New(kTypedDataUint8ArrayCid, 64, Heap::kOld));
+        for (intptr_t j = 0; j < 64; j++) {
+          data.SetUint8(j, j);
+        }
+        view = TypedDataView::New(kTypedDataUint8ArrayViewCid, data, 8, 16,
+                                  Heap::kOld);
+      }
+    }
+  }
+
+  // The first collection sweeps the garbage and records page statistics, the
+  // second evacuates the sparse pages.
+  GCTestHelper::CollectOldSpace();
+  const int64_t capacity_before = heap->CapacityInWords(Heap::kOld);
+  GCTestHelper::CollectOldSpace();
+  EXPECT_LT(heap->CapacityInWords(Heap::kOld), capacity_before);
+
+  Array& element = Array::Handle();
+  for (intptr_t i = 0; i < kNumArrays / kKeepEvery; i++) {
+    element ^= survivors.At(i);
+    EXPECT_EQ(Smi::New(i * kKeepEvery), element.At(0));
+    EXPECT(heap->GetPeer(element.ptr()) == &peer);
+  }
+  for (intptr_t j = 0; j < 16; j++) {
+    EXPECT_EQ(8 + j, view.GetUint8(j));
+  }
+}
+
+ISOLATE_UNIT_TEST_CASE(ReleaseFreeInteriors) {
+  GCTestHelper::CollectAllGarbage();
+  SetFlagScope<bool> sfs(&FLAG_release_free_interiors, true);
+  Heap* heap = thread->heap();
+  PageSpace* old_space = heap->old_space();
+
+  // Fill several pages with arrays of about 1KB, keeping one in 256 alive so
+  // that the sweeper finds large free blocks inside pages still in use.
+  const intptr_t kNumArrays = 4 * KB;
+  const intptr_t kKeepEvery = 256;
+  const Array& survivors =
+      Array::Handle(Array::New(kNumArrays / kKeepEvery, Heap::kOld));
+  {
+    HANDLESCOPE(thread);
+    Array& element = Array::Handle();
+    for (intptr_t i = 0; i < kNumArrays; i++) {
+      element = Array::New(128, Heap::kOld);
+      element.SetAt(0, Smi::Handle(Smi::New(i)));
+      if ((i % kKeepEvery) == 0) {
+        survivors.SetAt(i / kKeepEvery, element);
+      }
+    }
+  }
+
+  GCTestHelper::CollectOldSpace();
+  const intptr_t released = old_space->released_in_bytes();
+  if (FLAG_concurrent_sweep) {
+    EXPECT_GT(released, 0);
+  }
+
+  // The blocks are still free, so the next sweep finds them still released
+  // and reports the same amount instead of adding to it.
+  GCTestHelper::CollectOldSpace();
+  EXPECT_EQ(released, old_space->released_in_bytes());
+
+  // The survivors are intact and the released memory can be reused.
+  Array& element = Array::Handle();
+  for (intptr_t i = 0; i < kNumArrays / kKeepEvery; i++) {
+    element ^= survivors.At(i);
+    EXPECT_EQ(Smi::New(i * kKeepEvery), element.At(0));
+  }
+  {
+    HANDLESCOPE(thread);
+    const Array& reused = Array::Handle(Array::New(kNumArrays, Heap::kOld));
+    for (intptr_t i = 0; i < kNumArrays; i++) {
+      element = Array::New(128, Heap::kOld);
+      element.SetAt(127, Smi::Handle(Smi::New(i)));
+      reused.SetAt(i, element);
+    }
+    GCTestHelper::CollectOldSpace();
+    for (intptr_t i = 0; i < kNumArrays; i++) {
+      element ^= reused.At(i);
+      EXPECT_EQ(Smi::New(i), element.At(127));
+    }
+  }
+}
+
+ISOLATE_UNIT_TEST_CASE(ConcurrentSweepLargePages) {
+  GCTestHelper::CollectAllGarbage();
+  Heap* heap = thread->heap();
+  PageSpace* old_space = heap->old_space();
+
+  // Many dead typed data buffers on large pages, and a live card-remembered
+  // array holding a new-space object.
+  const intptr_t kNumBuffers = 256;
+  const intptr_t kBufferLength = 256 * KB;
+  {
+    HANDLESCOPE(thread);
+    TypedData& buffer = TypedData::Handle();
+    for (intptr_t i = 0; i < kNumBuffers; i++) {
+      buffer = TypedData::New(kTypedDataUint8ArrayCid, kBufferLength,
+                              Heap::kOld);
+    }
+  }
+  const intptr_t length = Heap::kNewAllocatableSize / Array::kBytesPerElement;
+  const Array& array = Array::Handle(Array::New(length, Heap::kOld));
+  EXPECT(array.ptr()->untag()->IsCardRemembered());
+  array.SetAt(length - 1, String::Handle(String::New("new", Heap::kNew)));
+  const int64_t capacity_before = old_space->CapacityInWords();
+
+  heap->CollectGarbage(thread, GCType::kMarkSweep, GCReason::kDebugging);
+  // Sweep alongside the sweeper task, then scavenge while it may still be
+  // sweeping the buffers.
+  while (old_space->AssistSweep() > 0) {
+  }
+  GCTestHelper::CollectNewSpace();
+  GCTestHelper::WaitForGCTasks();
+  EXPECT_EQ(0, old_space->AssistSweep());
+
+  Object& element = Object::Handle(array.At(length - 1));
+  EXPECT(String::Cast(element).Equals("new"));
+  EXPECT_LE(old_space->CapacityInWords(),
+            capacity_before -
+                (kNumBuffers * kBufferLength / 2) / kWordSize);
+}
+
+ISOLATE_UNIT_TEST_CASE(GrowLargeArrayInPlace) {
+  GCTestHelper::CollectAllGarbage();
+  Heap* heap = thread->heap();
+
+  // Small arrays share pages and never grow in place.
+  const Array& small = Array::Handle(Array::New(16, Heap::kOld));
+  EXPECT(!small.TryGrowInPlace(32));
+  EXPECT_EQ(16, small.Length());
+
+  const intptr_t kOldLength = 64 * KB;
+  const intptr_t kNewLength = 4 * kOldLength;
+  const Array& array = Array::Handle(Array::New(kOldLength, Heap::kOld));
+  for (intptr_t i = 0; i < kOldLength; i++) {
+    array.SetAt(i, Smi::Handle(Smi::New(i)));
+  }
+
+  // Not while the concurrent marker may be visiting the array.
+  heap->WaitForSweeperTasks(thread);
+  heap->StartConcurrentMarking(thread, GCReason::kDebugging);
+  EXPECT(!array.TryGrowInPlace(kNewLength));
+  EXPECT_EQ(kOldLength, array.Length());
+  GCTestHelper::CollectAllGarbage();
+  heap->WaitForSweeperTasks(thread);
+
+  const ArrayPtr before = array.ptr();
+  const int64_t used_before = heap->UsedInWords(Heap::kOld);
+  // May fail if the address range after the page is taken.
+  if (array.TryGrowInPlace(kNewLength)) {
+    EXPECT(array.ptr() == before);
+    EXPECT_EQ(kNewLength, array.Length());
+    EXPECT_EQ(used_before + ((Array::InstanceSize(kNewLength) -
+                              Array::InstanceSize(kOldLength)) >>
+                             kWordSizeLog2),
+              heap->UsedInWords(Heap::kOld));
+  } else {
+    EXPECT_EQ(kOldLength, array.Length());
+  }
+
+  // New space objects stored into the added elements are found by scavenges,
+  // and the heap stays iterable.
+  const intptr_t length = array.Length();
+  for (intptr_t i = kOldLength; i < length; i += KB) {
+    array.SetAt(i, String::Handle(String::New("new", Heap::kNew)));
+  }
+  GCTestHelper::CollectNewSpace();
+  GCTestHelper::CollectAllGarbage();
+  for (intptr_t i = 0; i < kOldLength; i++) {
+    EXPECT_EQ(Smi::New(i), array.At(i));
+  }
+  Object& element = Object::Handle();
+  for (intptr_t i = kOldLength; i < length; i++) {
+    element = array.At(i);
+    if ((i % KB) == 0) {
+      EXPECT(String::Cast(element).Equals("new"));
+    } else {
+      EXPECT(element.IsNull());
+    }
+  }
+}
+
+ISOLATE_UNIT_TEST_CASE(CardMarkedLargeArrayPromotion) {
+  // The shortest array which gets a page of its own.
+  intptr_t length = (Heap::kAllocatablePageSize - Array::InstanceSize(0)) /
+                    kCompressedWordSize;
+  while (Heap::IsAllocatableViaFreeLists(Array::InstanceSize(length))) {
+    length++;
+  }
+  const intptr_t kLength = length;
+  SetFlagScope<bool> sfs(&FLAG_card_mark_promoted_large_arrays, true);
+  GCTestHelper::CollectAllGarbage();
+
+  const Array& array = Array::Handle(Array::New(kLength, Heap::kNew));
+  const Array& small = Array::Handle(Array::New(kLength - 1, Heap::kNew));
+  const Array& tiny = Array::Handle(Array::New(1024, Heap::kNew));
+  EXPECT(!Array::UseCardMarkingForAllocation(kLength));
+  GCTestHelper::CollectNewSpace();
+  EXPECT(array.IsNew());
+
+  // Young when the array is promoted, so its card is dirtied by the scavenger.
+  array.SetAt(1, String::Handle(String::New("young", Heap::kNew)));
+  small.SetAt(1, String::Handle(String::New("young", Heap::kNew)));
+  tiny.SetAt(1, String::Handle(String::New("young", Heap::kNew)));
+  GCTestHelper::CollectNewSpace();
+  EXPECT(array.IsOld());
+  EXPECT(array.ptr()->untag()->IsCardRemembered());
+  EXPECT(!array.ptr()->untag()->IsRemembered());
+  EXPECT_EQ(Page::Of(array.ptr())->object_start(),
+            UntaggedObject::ToAddr(array.ptr()));
+  // Too small for a page of their own.
+  EXPECT(small.IsOld());
+  EXPECT(!small.ptr()->untag()->IsCardRemembered());
+  EXPECT(tiny.IsOld());
+  EXPECT(!tiny.ptr()->untag()->IsCardRemembered());
+
+  // Stored by the mutator after promotion.
+  array.SetAt(kLength - 1, String::Handle(String::New("new", Heap::kNew)));
+  EXPECT(!array.ptr()->untag()->IsRemembered());
+
+  GCTestHelper::CollectNewSpace();
+  GCTestHelper::CollectNewSpace();
+  Object& element = Object::Handle(array.At(1));
+  EXPECT(String::Cast(element).Equals("young"));
+  element = small.At(1);
+  EXPECT(String::Cast(element).Equals("young"));
+  element = tiny.At(1);
+  EXPECT(String::Cast(element).Equals("young"));
+  element = array.At(kLength - 1);
+  EXPECT(String::Cast(element).Equals("new"));
+
+  GCTestHelper::CollectAllGarbage();
+  element = array.At(kLength - 1);
+  EXPECT(String::Cast(element).Equals("new"));
+}
+
+static constexpr intptr_t kMaxGCEvents = 8;
+static Dart_GCEvent gc_events[kMaxGCEvents];
+static intptr_t gc_event_count = 0;
+
+static void RecordGCEvent(Dart_GCEvent* event) {
+  if (gc_event_count < kMaxGCEvents) {
+    gc_events[gc_event_count] = *event;
+  }
+  gc_event_count++;
+}
+
+static void ExpectPhasesWithinPause(const Dart_GCEvent& event) {
+  const Dart_GCPhaseTime* phases[] = {&event.roots, &event.marking,
+                                      &event.weak, &event.sweeping,
+                                      &event.compaction};
+  int64_t total = 0;
+  for (intptr_t i = 0; i < ARRAY_SIZE(phases); i++) {
+    EXPECT_LE(0, phases[i]->wall);
+    EXPECT_LE(0, phases[i]->cpu);
+    total += phases[i]->wall;
+  }
+  EXPECT_LE(total, event.pause);
+  EXPECT_LE(0, event.time_to_safepoint);
+}
+
+ISOLATE_UNIT_TEST_CASE(GCEventCallbackPhases) {
+  Heap* heap = thread->isolate_group()->heap();
+  GCTestHelper::CollectAllGarbage();
+  Dart_SetGCEventCallback(&RecordGCEvent);
+
+  const intptr_t kLength = 100;
+  const Array& survivor = Array::Handle(Array::New(kLength));
+  for (intptr_t i = 0; i < 1000; i++) {
+    Array::New(kLength);
+  }
+  gc_event_count = 0;
+  heap->CollectGarbage(thread, GCType::kEvacuate, GCReason::kDebugging);
+  EXPECT_LE(1, gc_event_count);
+  {
+    const Dart_GCEvent& event = gc_events[0];
+    EXPECT_STREQ("Evacuate", event.type);
+    EXPECT_STREQ("debugging", event.reason);
+    ExpectPhasesWithinPause(event);
+    EXPECT_EQ(0, event.sweeping.wall);
+    EXPECT_EQ(0, event.compaction.wall);
+    // The survivor was promoted and the other arrays freed.
+    EXPECT(survivor.IsOld());
+    EXPECT_LE(Array::InstanceSize(kLength), event.promoted);
+    EXPECT_LE(999 * Array::InstanceSize(kLength), event.freed);
+  }
+
+  GCTestHelper::WaitForGCTasks();
+  gc_event_count = 0;
+  heap->CollectGarbage(thread, GCType::kMarkSweep, GCReason::kDebugging);
+  EXPECT_LE(1, gc_event_count);
+  {
+    const Dart_GCEvent& event = gc_events[0];
+    EXPECT_STREQ("MarkSweep", event.type);
+    ExpectPhasesWithinPause(event);
+    EXPECT_EQ(0, event.promoted);
+  }
+
+  Dart_SetGCEventCallback(nullptr);
+  GCTestHelper::WaitForGCTasks();
+}
+
 }  // namespace dart
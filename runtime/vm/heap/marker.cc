@@ -8,6 +8,7 @@
 #include "platform/atomic.h"
 #include "vm/allocation.h"
 #include "vm/dart_api_state.h"
+#include "vm/heap/evacuator.h"
 #include "vm/heap/gc_shared.h"
 #include "vm/heap/pages.h"
 #include "vm/heap/pointer_block.h"
@@ -25,6 +26,12 @@
 
 namespace dart {
 
+DEFINE_FLAG(bool,
+            marker_work_stealing,
+            true,
+            "Balance work between parallel marker tasks with per-task "
+            "work-stealing deques.");
+
 template <bool sync>
 class MarkingVisitorBase : public ObjectPointerVisitor {
  public:
@@ -43,6 +50,31 @@ class MarkingVisitorBase : public ObjectPointerVisitor {
   uintptr_t marked_bytes() const { return marked_bytes_; }
   int64_t marked_micros() const { return marked_micros_; }
   void AddMicros(int64_t micros) { marked_micros_ += micros; }
+  intptr_t stolen() const { return stolen_; }
+
+  // Keeps this visitor's work in deques[index] instead of the shared marking
+  // stack, and steals from the other deques when it runs out of work. Only
+  // used while all [num_deques] visitors mark in parallel.
+  void EnableWorkStealing(MarkingDeque* deques,
+                          intptr_t num_deques,
+                          intptr_t index) {
+    ASSERT(deque_ == nullptr);
+    ASSERT((index >= 0) && (index < num_deques));
+    deques_ = deques;
+    num_deques_ = num_deques;
+    deque_ = &deques[index];
+  }
+
+  void DisableWorkStealing() {
+    ASSERT((deque_ == nullptr) || deque_->IsEmpty());
+    deques_ = nullptr;
+    num_deques_ = 0;
+    deque_ = nullptr;
+  }
+
+  // Records the references to the evacuator's candidates found while marking.
+  // Only used by stop-the-world marking, as mutator stores are not recorded.
+  void set_evacuator(GCEvacuator* evacuator) { evacuator_ = evacuator; }
 
 #ifdef DEBUG
   constexpr static const char* const kName = "Marker";
@@ -107,9 +139,9 @@ class MarkingVisitorBase : public ObjectPointerVisitor {
   }
 
   bool ProcessMarkingStack(intptr_t remaining_budget) {
-    ObjectPtr raw_obj = work_list_.Pop();
+    ObjectPtr raw_obj = PopWork();
     if ((raw_obj == nullptr) && ProcessPendingWeakProperties()) {
-      raw_obj = work_list_.Pop();
+      raw_obj = PopWork();
     }
 
     if (raw_obj == nullptr) {
@@ -134,7 +166,7 @@ class MarkingVisitorBase : public ObjectPointerVisitor {
           if ((class_id == kArrayCid) || (class_id == kImmutableArrayCid)) {
             size = raw_obj->untag()->HeapSize();
             if (size > remaining_budget) {
-              work_list_.Push(raw_obj);
+              PushWork(raw_obj);
               return true;  // More to mark.
             }
           }
@@ -146,7 +178,7 @@ class MarkingVisitorBase : public ObjectPointerVisitor {
           return true;  // More to mark.
         }
 
-        raw_obj = work_list_.Pop();
+        raw_obj = PopWork();
       } while (raw_obj != nullptr);
 
       // Marking stack is empty.
@@ -154,7 +186,7 @@ class MarkingVisitorBase : public ObjectPointerVisitor {
 
       // Check whether any further work was pushed either by other markers or
       // by the handling of weak properties.
-      raw_obj = work_list_.Pop();
+      raw_obj = PopWork();
     } while (raw_obj != nullptr);
 
     return false;  // No more work.
@@ -181,7 +213,11 @@ class MarkingVisitorBase : public ObjectPointerVisitor {
 
   void VisitPointers(ObjectPtr* first, ObjectPtr* last) {
     for (ObjectPtr* current = first; current <= last; current++) {
-      MarkObject(LoadPointerIgnoreRace(current));
+      ObjectPtr raw_obj = LoadPointerIgnoreRace(current);
+      if (UNLIKELY(evacuator_ != nullptr) && evacuator_->IsCandidate(raw_obj)) {
+        evacuation_slots_.AddSlot(current);
+      }
+      MarkObject(raw_obj);
     }
   }
 
@@ -189,9 +225,24 @@ class MarkingVisitorBase : public ObjectPointerVisitor {
                                CompressedObjectPtr* first,
                                CompressedObjectPtr* last) {
     for (CompressedObjectPtr* current = first; current <= last; current++) {
-      MarkObject(
-          LoadCompressedPointerIgnoreRace(current).Decompress(heap_base));
+      ObjectPtr raw_obj =
+          LoadCompressedPointerIgnoreRace(current).Decompress(heap_base);
+      if (UNLIKELY(evacuator_ != nullptr) && evacuator_->IsCandidate(raw_obj)) {
+        evacuation_slots_.AddCompressedSlot(heap_base, current);
+      }
+      MarkObject(raw_obj);
+    }
+  }
+
+  void VisitTypedDataViewPointers(TypedDataViewPtr view,
+                                  CompressedObjectPtr* first,
+                                  CompressedObjectPtr* last) {
+    if (UNLIKELY(evacuator_ != nullptr) &&
+        evacuator_->IsCandidate(view->untag()->typed_data())) {
+      // The inner pointer must follow the backing store.
+      evacuation_slots_.AddObject(view);
     }
+    VisitCompressedPointers(view->heap_base(), first, last);
   }
 
   intptr_t ProcessWeakProperty(WeakPropertyPtr raw_weak) {
@@ -223,6 +274,9 @@ class MarkingVisitorBase : public ObjectPointerVisitor {
       ASSERT(IsMarked(raw_weak));
       delayed_.weak_references.Enqueue(raw_weak);
     }
+    if (UNLIKELY(evacuator_ != nullptr)) {
+      evacuation_slots_.AddObject(raw_weak);
+    }
     // Always visit the type argument.
     ObjectPtr raw_type_arguments =
         LoadCompressedPointerIgnoreRace(&raw_weak->untag()->type_arguments_)
@@ -233,12 +287,18 @@ class MarkingVisitorBase : public ObjectPointerVisitor {
 
   intptr_t ProcessWeakArray(WeakArrayPtr raw_weak) {
     delayed_.weak_arrays.Enqueue(raw_weak);
+    if (UNLIKELY(evacuator_ != nullptr)) {
+      evacuation_slots_.AddObject(raw_weak);
+    }
     return raw_weak->untag()->HeapSize();
   }
 
   intptr_t ProcessFinalizerEntry(FinalizerEntryPtr raw_entry) {
     ASSERT(IsMarked(raw_entry));
     delayed_.finalizer_entries.Enqueue(raw_entry);
+    if (UNLIKELY(evacuator_ != nullptr)) {
+      evacuation_slots_.AddObject(raw_entry);
+    }
     // Only visit token and next.
     MarkObject(LoadCompressedPointerIgnoreRace(&raw_entry->untag()->token_)
                    .Decompress(raw_entry->heap_base()));
@@ -289,6 +349,9 @@ class MarkingVisitorBase : public ObjectPointerVisitor {
     // thread local store buffer is empty after marking and all references
     // are processed.
     Thread::Current()->ReleaseStoreBuffer();
+    if (evacuator_ != nullptr) {
+      evacuator_->AddSlots(&evacuation_slots_);
+    }
   }
 
   void MournWeakProperties() {
@@ -354,7 +417,36 @@ class MarkingVisitorBase : public ObjectPointerVisitor {
   }
 
   bool WaitForWork(RelaxedAtomic<uintptr_t>* num_busy) {
-    return work_list_.WaitForWork(num_busy);
+    if (deque_ == nullptr) {
+      return work_list_.WaitForWork(num_busy);
+    }
+
+    // Spin looking for work to steal rather than blocking on the marking
+    // stack's monitor, which is only notified when blocks are pushed.
+    ASSERT(deque_->IsEmpty());
+    num_busy->fetch_sub(1u);
+    for (intptr_t attempt = 0;; attempt++) {
+      if (HasStealableWork()) {
+        // Become busy before taking any work, so that observing no busy
+        // markers implies no marker holds unprocessed work.
+        num_busy->fetch_add(1u);
+        ObjectPtr raw_obj = StealWork();
+        if (raw_obj == nullptr) {
+          raw_obj = work_list_.Pop();
+        }
+        if (raw_obj != nullptr) {
+          PushWork(raw_obj);
+          return true;
+        }
+        num_busy->fetch_sub(1u);
+      }
+      if (num_busy->load() == 0) {
+        return false;
+      }
+      if (attempt >= kSpinAttempts) {
+        OS::SleepMicros(kIdleSleepMicros);
+      }
+    }
   }
 
   void Flush(GCLinkedLists* global_list) {
@@ -383,13 +475,78 @@ class MarkingVisitorBase : public ObjectPointerVisitor {
   }
 
  private:
+  static constexpr intptr_t kSpinAttempts = 128;
+  static constexpr int64_t kIdleSleepMicros = 10;
+
   void PushMarked(ObjectPtr raw_obj) {
     ASSERT(raw_obj->IsHeapObject());
     ASSERT(raw_obj->IsOldObject());
 
     // Push the marked object on the marking stack.
     ASSERT(raw_obj->untag()->IsMarked());
-    work_list_.Push(raw_obj);
+    PushWork(raw_obj);
+  }
+
+  DART_FORCE_INLINE
+  void PushWork(ObjectPtr raw_obj) {
+    if (deque_ == nullptr) {
+      work_list_.Push(raw_obj);
+      return;
+    }
+    if (UNLIKELY(!deque_->Push(raw_obj))) {
+      OverflowDeque();
+      const bool pushed = deque_->Push(raw_obj);
+      ASSERT(pushed);
+    }
+  }
+
+  DART_FORCE_INLINE
+  ObjectPtr PopWork() {
+    if (deque_ != nullptr) {
+      ObjectPtr raw_obj = deque_->Pop();
+      if (raw_obj != nullptr) {
+        return raw_obj;
+      }
+    }
+    ObjectPtr raw_obj = work_list_.Pop();
+    if ((raw_obj == nullptr) && (deque_ != nullptr)) {
+      raw_obj = StealWork();
+    }
+    return raw_obj;
+  }
+
+  // Moves the older half of a full deque to the shared marking stack, where
+  // idle markers can pick it up a block at a time.
+  void OverflowDeque() {
+    for (intptr_t i = 0; i < MarkingDeque::kCapacity / 2; i++) {
+      ObjectPtr raw_obj = deque_->Steal();
+      if (raw_obj == nullptr) {
+        break;
+      }
+      work_list_.Push(raw_obj);
+    }
+    work_list_.Flush();
+  }
+
+  ObjectPtr StealWork() {
+    const intptr_t index = deque_ - deques_;
+    for (intptr_t i = 1; i < num_deques_; i++) {
+      ObjectPtr raw_obj = deques_[(index + i) % num_deques_].Steal();
+      if (raw_obj != nullptr) {
+        stolen_++;
+        return raw_obj;
+      }
+    }
+    return nullptr;
+  }
+
+  bool HasStealableWork() {
+    for (intptr_t i = 0; i < num_deques_; i++) {
+      if (!deques_[i].IsEmpty()) {
+        return true;
+      }
+    }
+    return !work_list_.IsEmpty();
   }
 
   static bool TryAcquireMarkBit(ObjectPtr raw_obj) {
@@ -452,6 +609,12 @@ class MarkingVisitorBase : public ObjectPointerVisitor {
   GCLinkedLists delayed_;
   uintptr_t marked_bytes_;
   int64_t marked_micros_;
+  MarkingDeque* deques_ = nullptr;
+  intptr_t num_deques_ = 0;
+  MarkingDeque* deque_ = nullptr;
+  intptr_t stolen_ = 0;
+  GCEvacuator* evacuator_ = nullptr;
+  EvacuationSlots evacuation_slots_;
 
   template <typename GCVisitorType>
   friend void MournFinalized(GCVisitorType* visitor);
@@ -478,11 +641,17 @@ class MarkingWeakVisitor : public HandleVisitor {
         reinterpret_cast<FinalizablePersistentHandle*>(addr);
     ObjectPtr raw_obj = handle->ptr();
     if (IsUnreachable(raw_obj)) {
-      handle->UpdateUnreachable(thread()->isolate_group());
+      unreachable_.Add(handle);
     }
   }
 
+  MallocGrowableArray<FinalizablePersistentHandle*>* unreachable() {
+    return &unreachable_;
+  }
+
  private:
+  MallocGrowableArray<FinalizablePersistentHandle*> unreachable_;
+
   DISALLOW_COPY_AND_ASSIGN(MarkingWeakVisitor);
 };
 
@@ -555,63 +724,85 @@ void GCMarker::IterateRoots(ObjectPointerVisitor* visitor) {
   }
 }
 
+// The remembered set and the object id ring are each processed as one slice.
+// The weak persistent handles and each weak table are divided into one part per
+// marker task, as services may hold very many finalizable handles or weak
+// table entries.
 enum WeakSlices {
-  kWeakHandles = 0,
-  kWeakTables,
+  kRememberedSet = 0,
   kObjectIdRing,
-  kRememberedSet,
-  kNumWeakSlices,
+  kNumFixedWeakSlices,
 };
 
 void GCMarker::IterateWeakRoots(Thread* thread) {
+  const intptr_t num_parts = Utils::Maximum<intptr_t>(num_tasks_, 1);
+  const intptr_t num_slices =
+      kNumFixedWeakSlices + num_parts * (1 + Heap::kNumWeakSelectors);
   for (;;) {
     intptr_t slice = weak_slices_started_.fetch_add(1);
-    if (slice >= kNumWeakSlices) {
+    if (slice >= num_slices) {
       return;  // No more slices.
     }
 
     switch (slice) {
-      case kWeakHandles:
-        ProcessWeakHandles(thread);
-        break;
-      case kWeakTables:
-        ProcessWeakTables(thread);
+      case kRememberedSet:
+        ProcessRememberedSet(thread);
         break;
       case kObjectIdRing:
         ProcessObjectIdTable(thread);
         break;
-      case kRememberedSet:
-        ProcessRememberedSet(thread);
-        break;
-      default:
-        UNREACHABLE();
+      default: {
+        const intptr_t part = (slice - kNumFixedWeakSlices) % num_parts;
+        const intptr_t table = (slice - kNumFixedWeakSlices) / num_parts;
+        if (table == 0) {
+          ProcessWeakHandles(thread, part, num_parts);
+        } else {
+          ProcessWeakTable(thread, static_cast<Heap::WeakSelector>(table - 1),
+                           part, num_parts);
+        }
+      }
     }
   }
 }
 
-void GCMarker::ProcessWeakHandles(Thread* thread) {
+void GCMarker::ProcessWeakHandles(Thread* thread,
+                                  intptr_t part,
+                                  intptr_t num_parts) {
   TIMELINE_FUNCTION_GC_DURATION(thread, "ProcessWeakHandles");
   MarkingWeakVisitor visitor(thread);
   ApiState* state = isolate_group_->api_state();
   ASSERT(state != NULL);
-  isolate_group_->VisitWeakPersistentHandles(&visitor);
+  isolate_group_->VisitWeakPersistentHandles(&visitor, part, num_parts);
+  unreachable_weak_handles_.AddAll(visitor.unreachable());
 }
 
-void GCMarker::ProcessWeakTables(Thread* thread) {
+void GCMarker::FinalizeWeakHandles(Thread* thread) {
+  TIMELINE_FUNCTION_GC_DURATION(thread, "FinalizeWeakHandles");
+  unreachable_weak_handles_.Finalize(isolate_group_);
+}
+
+void GCMarker::ProcessWeakTable(Thread* thread,
+                                Heap::WeakSelector sel,
+                                intptr_t part,
+                                intptr_t num_parts) {
   TIMELINE_FUNCTION_GC_DURATION(thread, "ProcessWeakTables");
-  for (int sel = 0; sel < Heap::kNumWeakSelectors; sel++) {
-    WeakTable* table =
-        heap_->GetWeakTable(Heap::kOld, static_cast<Heap::WeakSelector>(sel));
-    intptr_t size = table->size();
-    for (intptr_t i = 0; i < size; i++) {
-      if (table->IsValidEntryAtExclusive(i)) {
-        ObjectPtr raw_obj = table->ObjectAtExclusive(i);
-        if (raw_obj->IsHeapObject() && !raw_obj->untag()->IsMarked()) {
-          table->InvalidateAtExclusive(i);
-        }
+  WeakTable* table = heap_->GetWeakTable(Heap::kOld, sel);
+  intptr_t size = table->num_slots();
+  intptr_t start = size * part / num_parts;
+  intptr_t end = size * (part + 1) / num_parts;
+  intptr_t invalidated = 0;
+  for (intptr_t i = start; i < end; i++) {
+    if (table->IsValidEntryAtExclusive(i)) {
+      ObjectPtr raw_obj = table->ObjectAtExclusive(i);
+      if (raw_obj->IsHeapObject() && !raw_obj->untag()->IsMarked()) {
+        table->InvalidateAtUncounted(i);
+        invalidated++;
       }
     }
   }
+  if (invalidated != 0) {
+    table->RecordInvalidated(invalidated);
+  }
 }
 
 void GCMarker::ProcessRememberedSet(Thread* thread) {
@@ -682,13 +873,19 @@ class ParallelMarkTask : public ThreadPool::Task {
                    MarkingStack* marking_stack,
                    ThreadBarrier* barrier,
                    SyncMarkingVisitor* visitor,
-                   RelaxedAtomic<uintptr_t>* num_busy)
+                   RelaxedAtomic<uintptr_t>* num_busy,
+                   MarkingDeque* deques,
+                   intptr_t num_tasks,
+                   intptr_t task_index)
       : marker_(marker),
         isolate_group_(isolate_group),
         marking_stack_(marking_stack),
         barrier_(barrier),
         visitor_(visitor),
-        num_busy_(num_busy) {}
+        num_busy_(num_busy),
+        deques_(deques),
+        num_tasks_(num_tasks),
+        task_index_(task_index) {}
 
   virtual void Run() {
     if (!barrier_->TryEnter()) {
@@ -714,6 +911,10 @@ class ParallelMarkTask : public ThreadPool::Task {
       TIMELINE_FUNCTION_GC_DURATION(thread, "ParallelMark");
       int64_t start = OS::GetCurrentMonotonicMicros();
 
+      if (deques_ != nullptr) {
+        visitor_->EnableWorkStealing(deques_, num_tasks_, task_index_);
+      }
+
       // Phase 1: Iterate over roots and drain marking stack in tasks.
       num_busy_->fetch_add(1u);
       marker_->IterateRoots(visitor_);
@@ -759,6 +960,7 @@ class ParallelMarkTask : public ThreadPool::Task {
       // Phase 2: deferred marking.
       visitor_->ProcessDeferredMarking();
       barrier_->Sync();
+      visitor_->DisableWorkStealing();
 
       // Phase 3: Weak processing and statistics.
       visitor_->MournWeakProperties();
@@ -771,8 +973,10 @@ class ParallelMarkTask : public ThreadPool::Task {
       int64_t stop = OS::GetCurrentMonotonicMicros();
       visitor_->AddMicros(stop - start);
       if (FLAG_log_marker_tasks) {
-        THR_Print("Task marked %" Pd " bytes in %" Pd64 " micros.\n",
-                  visitor_->marked_bytes(), visitor_->marked_micros());
+        THR_Print("Task marked %" Pd " bytes in %" Pd64
+                  " micros, stole %" Pd " objects.\n",
+                  visitor_->marked_bytes(), visitor_->marked_micros(),
+                  visitor_->stolen());
       }
     }
   }
@@ -784,6 +988,9 @@ class ParallelMarkTask : public ThreadPool::Task {
   ThreadBarrier* barrier_;
   SyncMarkingVisitor* visitor_;
   RelaxedAtomic<uintptr_t>* num_busy_;
+  MarkingDeque* deques_;
+  intptr_t num_tasks_;
+  intptr_t task_index_;
 
   DISALLOW_COPY_AND_ASSIGN(ParallelMarkTask);
 };
@@ -858,24 +1065,31 @@ intptr_t GCMarker::MarkedWordsPerMicro() const {
   if (marked_words_per_job_micro == 0) {
     marked_words_per_job_micro = 1;  // Prevent division by zero.
   }
-  intptr_t jobs = FLAG_marker_tasks;
+  intptr_t jobs = num_tasks_;
   if (jobs == 0) {
     jobs = 1;  // Marking on main thread is still one job.
   }
   return marked_words_per_job_micro * jobs;
 }
 
+// With --adaptive_gc_tasks, roughly one marker task is used per this much
+// old-space data.
+static constexpr intptr_t kMarkWordsPerTask = 4 * MBInWords;
+
 GCMarker::GCMarker(IsolateGroup* isolate_group, Heap* heap)
     : isolate_group_(isolate_group),
       heap_(heap),
+      num_tasks_(ChooseGCTasks(FLAG_marker_tasks,
+                               heap->old_space()->UsedInWords(),
+                               kMarkWordsPerTask)),
       marking_stack_(),
       deferred_marking_stack_(),
       global_list_(),
       visitors_(),
       marked_bytes_(0),
       marked_micros_(0) {
-  visitors_ = new SyncMarkingVisitor*[FLAG_marker_tasks];
-  for (intptr_t i = 0; i < FLAG_marker_tasks; i++) {
+  visitors_ = new SyncMarkingVisitor*[num_tasks_];
+  for (intptr_t i = 0; i < num_tasks_; i++) {
     visitors_[i] = NULL;
   }
 }
@@ -885,7 +1099,7 @@ GCMarker::~GCMarker() {
   // marker and before finalizing.
   if (isolate_group_->marking_stack() != NULL) {
     isolate_group_->DisableIncrementalBarrier();
-    for (intptr_t i = 0; i < FLAG_marker_tasks; i++) {
+    for (intptr_t i = 0; i < num_tasks_; i++) {
       visitors_[i]->AbandonWork();
       delete visitors_[i];
     }
@@ -897,7 +1111,7 @@ void GCMarker::StartConcurrentMark(PageSpace* page_space) {
   isolate_group_->EnableIncrementalBarrier(&marking_stack_,
                                            &deferred_marking_stack_);
 
-  const intptr_t num_tasks = FLAG_marker_tasks;
+  const intptr_t num_tasks = num_tasks_;
 
   {
     // Bulk increase task count before starting any task, instead of
@@ -926,6 +1140,7 @@ void GCMarker::StartConcurrentMark(PageSpace* page_space) {
     } else {
       // For the last visitor, mark roots on the main thread.
       TIMELINE_FUNCTION_GC_DURATION(Thread::Current(), "ConcurrentMark");
+      GCPhaseScope phase(heap_, GCPhase::kRoots);
       int64_t start = OS::GetCurrentMonotonicMicros();
       IterateRoots(visitor);
       int64_t stop = OS::GetCurrentMonotonicMicros();
@@ -1043,7 +1258,7 @@ class VerifyAfterMarkingVisitor : public ObjectVisitor,
   }
 };
 
-void GCMarker::MarkObjects(PageSpace* page_space) {
+void GCMarker::MarkObjects(PageSpace* page_space, GCEvacuator* evacuator) {
   if (isolate_group_->marking_stack() != NULL) {
     isolate_group_->DisableIncrementalBarrier();
   }
@@ -1051,35 +1266,53 @@ void GCMarker::MarkObjects(PageSpace* page_space) {
   Prologue();
   {
     Thread* thread = Thread::Current();
-    const int num_tasks = FLAG_marker_tasks;
+    const intptr_t num_tasks = num_tasks_;
     if (num_tasks == 0) {
       TIMELINE_FUNCTION_GC_DURATION(thread, "Mark");
       int64_t start = OS::GetCurrentMonotonicMicros();
       // Mark everything on main thread.
       UnsyncMarkingVisitor visitor(isolate_group_, page_space, &marking_stack_,
                                    &deferred_marking_stack_);
+      visitor.set_evacuator(evacuator);
       ResetSlices();
-      IterateRoots(&visitor);
-      visitor.ProcessDeferredMarking();
-      visitor.DrainMarkingStack();
-      visitor.ProcessDeferredMarking();
-      visitor.FinalizeMarking();
-      visitor.MournWeakProperties();
-      visitor.MournWeakReferences();
-      visitor.MournWeakArrays();
-      MournFinalized(&visitor);
-      IterateWeakRoots(thread);
+      {
+        GCPhaseScope phase(heap_, GCPhase::kRoots);
+        IterateRoots(&visitor);
+      }
+      {
+        GCPhaseScope phase(heap_, GCPhase::kMarking);
+        visitor.ProcessDeferredMarking();
+        visitor.DrainMarkingStack();
+        visitor.ProcessDeferredMarking();
+        visitor.FinalizeMarking();
+      }
+      {
+        GCPhaseScope phase(heap_, GCPhase::kWeak);
+        visitor.MournWeakProperties();
+        visitor.MournWeakReferences();
+        visitor.MournWeakArrays();
+        MournFinalized(&visitor);
+        IterateWeakRoots(thread);
+      }
       // All marking done; detach code, etc.
       int64_t stop = OS::GetCurrentMonotonicMicros();
       visitor.AddMicros(stop - start);
       marked_bytes_ += visitor.marked_bytes();
       marked_micros_ += visitor.marked_micros();
     } else {
+      // The tasks visit the roots, mark and process weak objects in the same
+      // phase.
+      GCPhaseScope phase(heap_, GCPhase::kMarking);
       ThreadBarrier* barrier = new ThreadBarrier(num_tasks, 1);
 
       ResetSlices();
       // Used to coordinate draining among tasks; all start out as 'busy'.
       RelaxedAtomic<uintptr_t> num_busy = 0;
+      // Per-task work-stealing deques, shared by all tasks.
+      MarkingDeque* deques = nullptr;
+      if (FLAG_marker_work_stealing && (num_tasks > 1)) {
+        deques = new MarkingDeque[num_tasks];
+      }
       // Phase 1: Iterate over roots and drain marking stack in tasks.
 
       for (intptr_t i = 0; i < num_tasks; ++i) {
@@ -1091,7 +1324,11 @@ void GCMarker::MarkObjects(PageSpace* page_space) {
               new SyncMarkingVisitor(isolate_group_, page_space,
                                      &marking_stack_, &deferred_marking_stack_);
           visitors_[i] = visitor;
+        } else {
+          // Slots visited during concurrent marking were not recorded.
+          ASSERT(evacuator == nullptr);
         }
+        visitor->set_evacuator(evacuator);
 
         // Move all work from local blocks to the global list. Any given
         // visitor might not get to run if it fails to reach TryEnter soon
@@ -1104,13 +1341,13 @@ void GCMarker::MarkObjects(PageSpace* page_space) {
           // Begin marking on a helper thread.
           bool result = Dart::thread_pool()->Run<ParallelMarkTask>(
               this, isolate_group_, &marking_stack_, barrier, visitor,
-              &num_busy);
+              &num_busy, deques, num_tasks, i);
           ASSERT(result);
         } else {
           // Last worker is the main thread.
           visitor->Adopt(&global_list_);
           ParallelMarkTask task(this, isolate_group_, &marking_stack_, barrier,
-                                visitor, &num_busy);
+                                visitor, &num_busy, deques, num_tasks, i);
           task.RunEnteredIsolateGroup();
           barrier->Sync();
           barrier->Release();
@@ -1125,9 +1362,14 @@ void GCMarker::MarkObjects(PageSpace* page_space) {
         delete visitor;
         visitors_[i] = nullptr;
       }
+      // All tasks have passed the final barrier, so none can still be trying
+      // to steal from the deques.
+      delete[] deques;
 
       ASSERT(global_list_.IsEmpty());
     }
+    GCPhaseScope phase(heap_, GCPhase::kWeak);
+    FinalizeWeakHandles(thread);
   }
 
   // Separate from verify_after_gc because that verification interferes with
@@ -13,6 +13,7 @@
 namespace dart {
 
 // Forward declarations.
+class GCEvacuator;
 class HandleVisitor;
 class Heap;
 class IsolateGroup;
@@ -46,19 +47,29 @@ class GCMarker {
 
   // (Re)mark roots, drain the marking queue and finalize weak references.
   // Does not required StartConcurrentMark to have been previously called.
-  void MarkObjects(PageSpace* page_space);
+  // If [evacuator] is given, the references to its candidates are recorded;
+  // marking must then not have been started concurrently.
+  void MarkObjects(PageSpace* page_space, GCEvacuator* evacuator = nullptr);
 
   intptr_t marked_words() const { return marked_bytes_ >> kWordSizeLog2; }
   intptr_t MarkedWordsPerMicro() const;
 
+  // The number of marker tasks used for this marking cycle, chosen when
+  // marking starts. Zero means marking happens on the main thread only.
+  intptr_t num_tasks() const { return num_tasks_; }
+
  private:
   void Prologue();
   void Epilogue();
   void ResetSlices();
   void IterateRoots(ObjectPointerVisitor* visitor);
   void IterateWeakRoots(Thread* thread);
-  void ProcessWeakHandles(Thread* thread);
-  void ProcessWeakTables(Thread* thread);
+  void ProcessWeakHandles(Thread* thread, intptr_t part, intptr_t num_parts);
+  void FinalizeWeakHandles(Thread* thread);
+  void ProcessWeakTable(Thread* thread,
+                        Heap::WeakSelector sel,
+                        intptr_t part,
+                        intptr_t num_parts);
   void ProcessRememberedSet(Thread* thread);
   void ProcessObjectIdTable(Thread* thread);
 
@@ -68,6 +79,7 @@ class GCMarker {
 
   IsolateGroup* const isolate_group_;
   Heap* const heap_;
+  const intptr_t num_tasks_;
   MarkingStack marking_stack_;
   MarkingStack deferred_marking_stack_;
   GCLinkedLists global_list_;
@@ -79,6 +91,7 @@ class GCMarker {
   intptr_t root_slices_finished_;
   intptr_t root_slices_count_;
   RelaxedAtomic<intptr_t> weak_slices_started_;
+  UnreachableWeakHandles unreachable_weak_handles_;
 
   uintptr_t marked_bytes_;
   int64_t marked_micros_;
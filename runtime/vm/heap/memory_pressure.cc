@@ -0,0 +1,201 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/heap/memory_pressure.h"
+
+#include <stdio.h>   // NOLINT
+#include <stdlib.h>  // NOLINT
+#include <string.h>  // NOLINT
+
+#include "platform/utils.h"
+#include "vm/lockers.h"
+#include "vm/zone.h"
+
+namespace dart {
+
+DEFINE_FLAG(bool,
+            cgroup_aware_heap,
+            false,
+            "Limit old-space growth to the headroom of the process's cgroup "
+            "and collect early when the cgroup reports memory pressure.");
+DEFINE_FLAG(charp,
+            cgroup_memory_path,
+            "/sys/fs/cgroup",
+            "The cgroup v2 directory read by --cgroup_aware_heap.");
+DEFINE_FLAG(int,
+            memory_pressure_moderate,
+            10,
+            "Percentage of time stalled on memory (PSI some avg10) above which "
+            "old-space growth is halved.");
+DEFINE_FLAG(int,
+            memory_pressure_critical,
+            40,
+            "Percentage of time stalled on memory (PSI some avg10) above which "
+            "old space is collected early.");
+
+bool CgroupMemory::ReadFile(const char* name,
+                            char* buffer,
+                            intptr_t size) const {
+  char path[1024];
+  if (Utils::SNPrint(path, sizeof(path), "%s/%s", path_, name) >=
+      static_cast<intptr_t>(sizeof(path))) {
+    return false;
+  }
+  FILE* file = fopen(path, "r");
+  if (file == nullptr) {
+    return false;
+  }
+  const size_t length = fread(buffer, 1, size - 1, file);
+  fclose(file);
+  buffer[length] = '\0';
+  return length > 0;
+}
+
+int64_t CgroupMemory::ReadBytes(const char* name) const {
+  char buffer[64];
+  if (!ReadFile(name, buffer, sizeof(buffer))) {
+    return -1;
+  }
+  // An unlimited value is written as "max".
+  if (strncmp(buffer, "max", 3) == 0) {
+    return 0;
+  }
+  char* end = nullptr;
+  const int64_t value = strtoll(buffer, &end, 10);
+  if (end == buffer) {
+    return -1;
+  }
+  return value;
+}
+
+int64_t CgroupMemory::Limit() const {
+  const int64_t max = ReadBytes("memory.max");
+  const int64_t high = ReadBytes("memory.high");
+  if (max <= 0) {
+    return Utils::Maximum<int64_t>(high, 0);
+  }
+  if (high <= 0) {
+    return max;
+  }
+  return Utils::Minimum(max, high);
+}
+
+int64_t CgroupMemory::Usage() const {
+  return ReadBytes("memory.current");
+}
+
+double CgroupMemory::Pressure() const {
+  // some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+  // full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+  char buffer[256];
+  if (!ReadFile("memory.pressure", buffer, sizeof(buffer))) {
+    return -1.0;
+  }
+  double avg10;
+  if (sscanf(buffer, "some avg10=%lf", &avg10) != 1) {  // NOLINT
+    return -1.0;
+  }
+  return avg10;
+}
+
+MemoryPressure::MemoryPressure(const char* cgroup_path)
+    : cgroup_(cgroup_path) {}
+
+MemoryPressure* MemoryPressure::Global() {
+  // Never deleted, as it may be used by heaps being shut down concurrently
+  // with VM cleanup.
+  static MemoryPressure* global =
+      new MemoryPressure(FLAG_cgroup_memory_path);
+  return global;
+}
+
+MemoryPressure::Level MemoryPressure::LevelFor(double pressure) {
+  if (pressure >= FLAG_memory_pressure_critical) {
+    return kCritical;
+  }
+  if (pressure >= FLAG_memory_pressure_moderate) {
+    return kModerate;
+  }
+  return kNone;
+}
+
+MemoryPressure::Level MemoryPressure::Poll(int64_t now_micros) {
+  MutexLocker ml(&mutex_);
+  if ((last_poll_micros_ != 0) &&
+      ((now_micros - last_poll_micros_) < kPollIntervalMicros)) {
+    return level_;
+  }
+  last_poll_micros_ = now_micros;
+  if (!FLAG_cgroup_aware_heap) {
+    SetLevelLocked(kNone);
+    return level_;
+  }
+
+  limit_ = cgroup_.Limit();
+  usage_ = cgroup_.Usage();
+  Level level = LevelFor(cgroup_.Pressure());
+  // Reclaim may not have started stalling tasks yet when usage approaches the
+  // limit.
+  if ((limit_ > 0) && (usage_ >= 0) && (usage_ * 10 >= limit_ * 9)) {
+    level = Utils::Maximum(level, kModerate);
+  }
+  SetLevelLocked(level);
+  return level_;
+}
+
+void MemoryPressure::NotifyLowMemory(int64_t now_micros) {
+  MutexLocker ml(&mutex_);
+  last_poll_micros_ = now_micros;
+  // Even when already critical, the embedder is asking for memory now.
+  level_ = kCritical;
+  critical_epoch_.fetch_add(1);
+  ReleaseCaches();
+}
+
+void MemoryPressure::SetLevelLocked(Level level) {
+  ASSERT(mutex_.IsOwnedByCurrentThread());
+  const Level previous = level_;
+  level_ = level;
+  if (level <= previous) {
+    return;
+  }
+  ReleaseCaches();
+  if (level == kCritical) {
+    critical_epoch_.fetch_add(1);
+  }
+}
+
+void MemoryPressure::ReleaseCaches() {
+  Page::ClearCache();
+  Zone::ClearCache();
+}
+
+intptr_t MemoryPressure::LimitGrowth(intptr_t growth_in_pages,
+                                     int64_t now_micros) {
+  Poll(now_micros);
+  MutexLocker ml(&mutex_);
+  return LimitGrowth(growth_in_pages, level_, limit_, usage_);
+}
+
+intptr_t MemoryPressure::LimitGrowth(intptr_t growth_in_pages,
+                                     Level level,
+                                     int64_t limit,
+                                     int64_t usage) {
+  intptr_t limited = growth_in_pages;
+  if ((limit > 0) && (usage >= 0)) {
+    const int64_t headroom = Utils::Maximum<int64_t>(limit - usage, 0);
+    limited = Utils::Minimum(
+        limited, static_cast<intptr_t>((headroom / 2) / kPageSize));
+  }
+  if (level == kModerate) {
+    limited /= 2;
+  } else if (level == kCritical) {
+    limited = 0;
+  }
+  // Keep a minimum step so that the heap does not collect on every promotion.
+  limited = Utils::Maximum(limited, kMinGrowthInPages);
+  return Utils::Minimum(limited, growth_in_pages);
+}
+
+}  // namespace dart
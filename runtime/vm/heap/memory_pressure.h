@@ -0,0 +1,119 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef RUNTIME_VM_HEAP_MEMORY_PRESSURE_H_
+#define RUNTIME_VM_HEAP_MEMORY_PRESSURE_H_
+
+#include "platform/atomic.h"
+
+#include "vm/allocation.h"
+#include "vm/flags.h"
+#include "vm/globals.h"
+#include "vm/heap/page.h"
+#include "vm/os_thread.h"
+
+namespace dart {
+
+DECLARE_FLAG(bool, cgroup_aware_heap);
+
+// Reads the memory controller interface of a cgroup v2 directory, normally
+// /sys/fs/cgroup inside a container.
+class CgroupMemory : public ValueObject {
+ public:
+  explicit CgroupMemory(const char* path) : path_(path) {}
+
+  // The lower of memory.high and memory.max in bytes, or 0 if neither limits
+  // the cgroup.
+  int64_t Limit() const;
+
+  // memory.current in bytes, or -1 if unavailable.
+  int64_t Usage() const;
+
+  // The "some avg10" figure of memory.pressure: the percentage of the last ten
+  // seconds in which at least one task of the cgroup was stalled waiting for
+  // memory. -1 if unavailable.
+  double Pressure() const;
+
+ private:
+  bool ReadFile(const char* name, char* buffer, intptr_t size) const;
+  int64_t ReadBytes(const char* name) const;
+
+  const char* path_;
+};
+
+// Tracks the memory pressure on the process, as reported by its cgroup when
+// --cgroup_aware_heap is given and by the embedder through
+// Dart_NotifyLowMemory.
+//
+// Each heap consults the tracker after evaluating a collection, to keep its
+// growth within the cgroup's headroom, and after each scavenge, to start an
+// early mark-sweep when pressure has become critical since it last
+// collected.
+class MemoryPressure {
+ public:
+  enum Level {
+    kNone,
+    kModerate,
+    kCritical,
+  };
+
+  explicit MemoryPressure(const char* cgroup_path);
+  ~MemoryPressure() {}
+
+  // The tracker shared by all isolate groups of the process.
+  static MemoryPressure* Global();
+
+  // Rereads the cgroup if at least kPollIntervalMicros have passed since it was
+  // last read. Returns the current level.
+  Level Poll(int64_t now_micros);
+
+  // Treats the pressure as critical until the next interval. Releases the
+  // cached pages and zone segments, and requests an early collection from
+  // every heap.
+  void NotifyLowMemory(int64_t now_micros);
+
+  // Incremented every time the level rises to critical. A heap that has not
+  // collected old space since the value last changed should do so.
+  intptr_t critical_epoch() const { return critical_epoch_; }
+
+  Level level() const { return level_; }
+
+  // Polls, then reduces [growth_in_pages] according to the current level and
+  // headroom.
+  intptr_t LimitGrowth(intptr_t growth_in_pages, int64_t now_micros);
+
+  // Reduces [growth_in_pages] so that it takes at most half of the headroom
+  // between [usage] and [limit] (if [limit] is not 0), then halves it under
+  // moderate pressure or drops it to kMinGrowthInPages under critical
+  // pressure. Never increases it.
+  static intptr_t LimitGrowth(intptr_t growth_in_pages,
+                              Level level,
+                              int64_t limit,
+                              int64_t usage);
+
+  // The level indicated by a PSI figure.
+  static Level LevelFor(double pressure);
+
+  static constexpr int64_t kPollIntervalMicros = 1000 * 1000;
+  static constexpr intptr_t kMinGrowthInPages = (2 * MB) / kPageSize;
+
+ private:
+  void SetLevelLocked(Level level);
+  void ReleaseCaches();
+
+  CgroupMemory cgroup_;
+
+  Mutex mutex_;
+  int64_t last_poll_micros_ = 0;
+  int64_t limit_ = 0;
+  int64_t usage_ = -1;
+  RelaxedAtomic<Level> level_ = {kNone};
+  RelaxedAtomic<intptr_t> critical_epoch_ = {0};
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryPressure);
+};
+
+}  // namespace dart
+
+#endif  // RUNTIME_VM_HEAP_MEMORY_PRESSURE_H_
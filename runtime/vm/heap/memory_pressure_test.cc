@@ -0,0 +1,223 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "platform/globals.h"
+
+#if !defined(DART_HOST_OS_WINDOWS)
+#include <stdio.h>   // NOLINT
+#include <stdlib.h>  // NOLINT
+#include <unistd.h>  // NOLINT
+#endif
+
+#include "platform/assert.h"
+#include "vm/heap/heap.h"
+#include "vm/heap/memory_pressure.h"
+#include "vm/os.h"
+#include "vm/unit_test.h"
+
+namespace dart {
+
+VM_UNIT_TEST_CASE(MemoryPressure_LimitGrowth) {
+  const intptr_t kMin = MemoryPressure::kMinGrowthInPages;
+  const int64_t kNoLimit = 0;
+
+  // Without a limit or pressure, growth is unchanged.
+  EXPECT_EQ(100, MemoryPressure::LimitGrowth(100, MemoryPressure::kNone,
+                                             kNoLimit, -1));
+  // Never grows more than requested.
+  EXPECT_EQ(1, MemoryPressure::LimitGrowth(1, MemoryPressure::kCritical,
+                                           kNoLimit, -1));
+  EXPECT_EQ(0, MemoryPressure::LimitGrowth(0, MemoryPressure::kNone,
+                                           kNoLimit, -1));
+
+  // At most half of the headroom.
+  const int64_t limit = 1000 * kPageSize;
+  EXPECT_EQ(50, MemoryPressure::LimitGrowth(100, MemoryPressure::kNone, limit,
+                                            limit - 100 * kPageSize));
+  EXPECT_EQ(100, MemoryPressure::LimitGrowth(100, MemoryPressure::kNone,
+                                             limit, 0));
+  // A minimum step past the limit.
+  EXPECT_EQ(kMin, MemoryPressure::LimitGrowth(100, MemoryPressure::kNone,
+                                              limit, 2 * limit));
+
+  // Pressure.
+  EXPECT_EQ(50, MemoryPressure::LimitGrowth(100, MemoryPressure::kModerate,
+                                            kNoLimit, -1));
+  EXPECT_EQ(kMin, MemoryPressure::LimitGrowth(100, MemoryPressure::kCritical,
+                                              kNoLimit, -1));
+}
+
+#if !defined(DART_HOST_OS_WINDOWS)
+
+// A cgroup v2 directory whose memory controller files are written by the test.
+class FakeCgroup {
+ public:
+  FakeCgroup() {
+    const char* tmp = getenv("TMPDIR");
+    snprintf(path_, sizeof(path_), "%s/dart_cgroup_XXXXXX",
+             (tmp != nullptr) ? tmp : "/tmp");
+    EXPECT(mkdtemp(path_) != nullptr);
+  }
+
+  ~FakeCgroup() {
+    Remove("memory.max");
+    Remove("memory.high");
+    Remove("memory.current");
+    Remove("memory.pressure");
+    rmdir(path_);
+  }
+
+  const char* path() const { return path_; }
+
+  void Write(const char* name, const char* contents) {
+    char file_path[sizeof(path_) + 32];
+    snprintf(file_path, sizeof(file_path), "%s/%s", path_, name);
+    FILE* file = fopen(file_path, "w");
+    EXPECT(file != nullptr);
+    fputs(contents, file);
+    fclose(file);
+  }
+
+  void WritePressure(const char* some_avg10) {
+    char contents[256];
+    snprintf(contents, sizeof(contents),
+             "some avg10=%s avg60=0.00 avg300=0.00 total=0\n"
+             "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n",
+             some_avg10);
+    Write("memory.pressure", contents);
+  }
+
+ private:
+  void Remove(const char* name) {
+    char file_path[sizeof(path_) + 32];
+    snprintf(file_path, sizeof(file_path), "%s/%s", path_, name);
+    unlink(file_path);
+  }
+
+  char path_[1024];
+};
+
+VM_UNIT_TEST_CASE(CgroupMemory_ReadFiles) {
+  FakeCgroup cgroup;
+  CgroupMemory memory(cgroup.path());
+
+  // Missing files.
+  EXPECT_EQ(0, memory.Limit());
+  EXPECT_EQ(-1, memory.Usage());
+  EXPECT_EQ(-1.0, memory.Pressure());
+
+  cgroup.Write("memory.max", "max\n");
+  cgroup.Write("memory.high", "max\n");
+  EXPECT_EQ(0, memory.Limit());
+
+  cgroup.Write("memory.max", "536870912\n");
+  EXPECT_EQ(512 * MB, memory.Limit());
+
+  cgroup.Write("memory.high", "268435456\n");
+  EXPECT_EQ(256 * MB, memory.Limit());
+
+  cgroup.Write("memory.max", "max\n");
+  EXPECT_EQ(256 * MB, memory.Limit());
+
+  cgroup.Write("memory.current", "123456789\n");
+  EXPECT_EQ(123456789, memory.Usage());
+
+  cgroup.WritePressure("12.50");
+  EXPECT_EQ(12.5, memory.Pressure());
+}
+
+VM_UNIT_TEST_CASE(MemoryPressure_Poll) {
+  SetFlagScope<bool> sfs(&FLAG_cgroup_aware_heap, true);
+  FakeCgroup cgroup;
+  cgroup.Write("memory.max", "1073741824\n");
+  cgroup.Write("memory.current", "104857600\n");
+  cgroup.WritePressure("0.00");
+
+  MemoryPressure pressure(cgroup.path());
+  int64_t now = 1;
+  EXPECT_EQ(MemoryPressure::kNone, pressure.Poll(now));
+  EXPECT_EQ(100, pressure.LimitGrowth(100, now));
+  const intptr_t epoch = pressure.critical_epoch();
+
+  // Not reread within the interval.
+  cgroup.WritePressure("20.00");
+  now += MemoryPressure::kPollIntervalMicros / 2;
+  EXPECT_EQ(MemoryPressure::kNone, pressure.Poll(now));
+
+  now += MemoryPressure::kPollIntervalMicros;
+  EXPECT_EQ(MemoryPressure::kModerate, pressure.Poll(now));
+  EXPECT_EQ(50, pressure.LimitGrowth(100, now));
+  EXPECT_EQ(epoch, pressure.critical_epoch());
+
+  cgroup.WritePressure("45.00");
+  now += MemoryPressure::kPollIntervalMicros;
+  EXPECT_EQ(MemoryPressure::kCritical, pressure.Poll(now));
+  EXPECT_EQ(MemoryPressure::kMinGrowthInPages, pressure.LimitGrowth(100, now));
+  EXPECT_EQ(epoch + 1, pressure.critical_epoch());
+
+  // Staying critical does not request another collection.
+  now += MemoryPressure::kPollIntervalMicros;
+  EXPECT_EQ(MemoryPressure::kCritical, pressure.Poll(now));
+  EXPECT_EQ(epoch + 1, pressure.critical_epoch());
+
+  // Usage close to the limit is moderate pressure even without stalls.
+  cgroup.WritePressure("0.00");
+  cgroup.Write("memory.current", "1000000000\n");
+  now += MemoryPressure::kPollIntervalMicros;
+  EXPECT_EQ(MemoryPressure::kModerate, pressure.Poll(now));
+
+  cgroup.Write("memory.current", "104857600\n");
+  now += MemoryPressure::kPollIntervalMicros;
+  EXPECT_EQ(MemoryPressure::kNone, pressure.Poll(now));
+
+  // The embedder's notification holds until the next interval.
+  pressure.NotifyLowMemory(now);
+  EXPECT_EQ(MemoryPressure::kCritical, pressure.level());
+  EXPECT_EQ(epoch + 2, pressure.critical_epoch());
+  EXPECT_EQ(MemoryPressure::kCritical, pressure.Poll(now + 1));
+  now += MemoryPressure::kPollIntervalMicros;
+  EXPECT_EQ(MemoryPressure::kNone, pressure.Poll(now));
+}
+
+#endif  // !defined(DART_HOST_OS_WINDOWS)
+
+VM_UNIT_TEST_CASE(MemoryPressure_NotifyLowMemoryWithoutCgroup) {
+  SetFlagScope<bool> sfs(&FLAG_cgroup_aware_heap, false);
+  MemoryPressure pressure("/nonexistent");
+  int64_t now = 1;
+  pressure.NotifyLowMemory(now);
+  EXPECT_EQ(1, pressure.critical_epoch());
+  EXPECT_EQ(MemoryPressure::kMinGrowthInPages,
+            pressure.LimitGrowth(100, now + 1));
+
+  // Growing the heap ends the notification after the interval, although
+  // nothing polls the cgroup.
+  now += MemoryPressure::kPollIntervalMicros;
+  EXPECT_EQ(100, pressure.LimitGrowth(100, now));
+  EXPECT_EQ(MemoryPressure::kNone, pressure.level());
+  EXPECT_EQ(1, pressure.critical_epoch());
+}
+
+ISOLATE_UNIT_TEST_CASE(MemoryPressure_NotifyLowMemoryCollects) {
+  Heap* heap = thread->isolate_group()->heap();
+  GCTestHelper::CollectAllGarbage();
+  const intptr_t collections = heap->old_space()->collections();
+
+  // A scavenge without pressure leaves old space alone.
+  heap->CollectGarbage(thread, GCType::kScavenge, GCReason::kNewSpace);
+  GCTestHelper::WaitForGCTasks();
+  EXPECT_EQ(collections, heap->old_space()->collections());
+
+  MemoryPressure::Global()->NotifyLowMemory(OS::GetCurrentMonotonicMicros());
+  heap->CollectGarbage(thread, GCType::kScavenge, GCReason::kNewSpace);
+  GCTestHelper::WaitForGCTasks();
+  EXPECT_EQ(collections + 1, heap->old_space()->collections());
+
+  // Only once per notification.
+  heap->CollectGarbage(thread, GCType::kScavenge, GCReason::kNewSpace);
+  GCTestHelper::WaitForGCTasks();
+  EXPECT_EQ(collections + 1, heap->old_space()->collections());
+}
+
+}  // namespace dart
@@ -53,6 +53,33 @@ intptr_t Page::CachedSize() {
   return page_cache_size * kPageSize;
 }
 
+// Reserves a region aligned to and sized as a transparent huge page, asks the
+// OS to back it with a huge page, and carves it into regular pages. The first
+// page is returned and the rest are put into the page cache in address order,
+// so the following page allocations fill the same huge page.
+static VirtualMemory* AllocateFromHugePage(bool compressed, const char* name) {
+  COMPILE_ASSERT(Utils::IsAligned(VirtualMemory::kHugePageSize, kPageSize));
+  VirtualMemory* memory = VirtualMemory::AllocateAligned(
+      VirtualMemory::kHugePageSize, VirtualMemory::kHugePageSize,
+      /*is_executable=*/false, compressed, name);
+  if (memory == nullptr) {
+    return nullptr;
+  }
+  // Falls back to base pages when the request is rejected.
+  memory->AdviseHugePages();
+
+  MutexLocker ml(page_cache_mutex);
+  while (memory->size() > kPageSize) {
+    VirtualMemory* tail = memory->SplitTail(memory->size() - kPageSize);
+    if (page_cache_size < kPageCacheCapacity) {
+      page_cache[page_cache_size++] = tail;
+    } else {
+      delete tail;
+    }
+  }
+  return memory;
+}
+
 Page* Page::Allocate(intptr_t size, PageType type, bool can_use_cache) {
   const bool executable = type == kExecutable;
   const bool compressed = !executable;
@@ -73,9 +100,29 @@ Page* Page::Allocate(intptr_t size, PageType type, bool can_use_cache) {
       memory = page_cache[--page_cache_size];
     }
   }
+  // As for large pages, only old-space pages are backed by huge pages.
+  if ((memory == nullptr) && can_use_cache && (type != kNew) &&
+      VirtualMemory::HugePagesEnabled()) {
+    memory = AllocateFromHugePage(compressed, name);
+  }
   if (memory == nullptr) {
-    memory = VirtualMemory::AllocateAligned(size, kPageSize, executable,
+    // Large pages that span at least one huge page are aligned so that their
+    // interior can be backed by huge pages.
+    const bool use_huge_pages = (type != kNew) &&
+                                VirtualMemory::HugePagesEnabled() &&
+                                (size >= VirtualMemory::kHugePageSize);
+    const intptr_t alignment =
+        use_huge_pages ? VirtualMemory::kHugePageSize : kPageSize;
+    memory = VirtualMemory::AllocateAligned(size, alignment, executable,
                                             compressed, name);
+    if ((memory != nullptr) && use_huge_pages) {
+      memory->AdviseHugePages();
+    } else if ((memory != nullptr) && executable &&
+               VirtualMemory::HugePagesEnabled()) {
+      // Adjacent code pages usually end up in one mapping, so they can still
+      // be collapsed into huge pages in the background.
+      memory->AdviseHugePages();
+    }
   }
   if (memory == nullptr) {
     return nullptr;  // Out of memory.
@@ -104,7 +151,10 @@ Page* Page::Allocate(intptr_t size, PageType type, bool can_use_cache) {
   result->top_ = 0;
   result->end_ = 0;
   result->survivor_end_ = 0;
+  result->age_ = 0;
   result->resolved_top_ = 0;
+  result->live_bytes_ = -1;
+  result->ClearAllReleased();
 
   if (type == kNew) {
     uword top = result->object_start();
@@ -160,7 +210,9 @@ void Page::Deallocate(bool can_use_cache) {
 }
 
 void Page::VisitObjects(ObjectVisitor* visitor) const {
-  ASSERT(Thread::Current()->IsAtSafepoint());
+  ASSERT(Thread::Current()->IsAtSafepoint() ||
+         (Thread::Current()->task_kind() == Thread::kHeapSnapshotTask) ||
+         (Thread::Current()->task_kind() == Thread::kBecomeTask));
   NoSafepointScope no_safepoint;
   uword obj_addr = object_start();
   uword end_addr = object_end();
@@ -186,6 +238,18 @@ void Page::VisitObjectPointers(ObjectPointerVisitor* visitor) const {
   ASSERT(obj_addr == end_addr);
 }
 
+void Page::GrowCardTable(intptr_t old_card_table_size) {
+  if (card_table_ == nullptr) {
+    return;
+  }
+  const intptr_t new_card_table_size = card_table_size();
+  ASSERT(new_card_table_size >= old_card_table_size);
+  card_table_ = reinterpret_cast<uint8_t*>(
+      realloc(card_table_, new_card_table_size * sizeof(uint8_t)));
+  memset(card_table_ + old_card_table_size, 0,
+         new_card_table_size - old_card_table_size);
+}
+
 void Page::VisitRememberedCards(ObjectPointerVisitor* visitor) {
   ASSERT(Thread::Current()->IsAtSafepoint() ||
          (Thread::Current()->task_kind() == Thread::kScavengerTask));
@@ -249,6 +313,25 @@ void Page::ResetProgressBar() {
   progress_bar_ = 0;
 }
 
+void Page::ClearReleased(uword addr, intptr_t size) {
+  const intptr_t first = ReleasedBit(addr);
+  const intptr_t last = ReleasedBit(addr + size - 1);
+  for (intptr_t i = first / kBitsPerWord; i <= last / kBitsPerWord; i++) {
+    if (released_[i].load() == 0) {
+      continue;  // Usually nothing was released.
+    }
+    uword mask = ~static_cast<uword>(0);
+    if (i == first / kBitsPerWord) {
+      mask &= ~static_cast<uword>(0) << (first % kBitsPerWord);
+    }
+    if (i == last / kBitsPerWord) {
+      mask &= ~static_cast<uword>(0) >>
+              (kBitsPerWord - 1 - (last % kBitsPerWord));
+    }
+    released_[i].fetch_and(~mask);
+  }
+}
+
 ObjectPtr Page::FindObject(FindObjectVisitor* visitor) const {
   uword obj_addr = object_start();
   uword end_addr = object_end();
@@ -222,6 +222,8 @@ class Page {
   }
 #endif
   void VisitRememberedCards(ObjectPointerVisitor* visitor);
+  // Resizes an allocated card table after the page grew.
+  void GrowCardTable(intptr_t old_card_table_size);
   void ResetProgressBar();
 
   Thread* owner() const {
@@ -233,10 +235,12 @@ class Page {
     survivor_end_ = object_end();
   }
 
-  // Move survivor end to the end of the to_ space, making all surviving
-  // objects candidates for promotion next time.
-  void EarlyTenure() {
+  // Move survivor end to the end of the to_ space and raise the age to
+  // [tenure_age], making all surviving objects candidates for promotion next
+  // time.
+  void EarlyTenure(intptr_t tenure_age) {
     survivor_end_ = end_;
+    age_ = Utils::Maximum(age_, tenure_age);
   }
 
   uword promo_candidate_words() const {
@@ -283,14 +287,54 @@ class Page {
     top_ -= size;
   }
 
-  bool IsSurvivor(uword raw_addr) const {
-    return raw_addr < survivor_end_;
+  // The number of scavenges survived by the object at [raw_addr].
+  intptr_t AgeOf(uword raw_addr) const {
+    return (raw_addr < survivor_end_) ? age_ : 0;
   }
+  intptr_t age() const { return age_; }
+  void set_age(intptr_t age) { age_ = age; }
   bool IsResolved() const {
     return top_ == resolved_top_;
   }
 
+  // The bytes of marked objects found by the last sweep of this page, or -1 if
+  // the page has not been swept since it was allocated.
+  intptr_t live_bytes() const { return live_bytes_; }
+  void set_live_bytes(intptr_t live_bytes) { live_bytes_ = live_bytes; }
+
+  // Whether the OS page containing [addr] was returned to the OS by the
+  // sweeper and has stayed free since. Such pages are not released again.
+  bool IsReleased(uword addr) const {
+    const intptr_t bit = ReleasedBit(addr);
+    return (released_[bit / kBitsPerWord].load() &
+            (static_cast<uword>(1) << (bit % kBitsPerWord))) != 0;
+  }
+  void SetReleased(uword addr) {
+    const intptr_t bit = ReleasedBit(addr);
+    released_[bit / kBitsPerWord].fetch_or(static_cast<uword>(1)
+                                           << (bit % kBitsPerWord));
+  }
+  // Forgets the released OS pages overlapping [addr, addr + size), which are
+  // about to be written.
+  void ClearReleased(uword addr, intptr_t size);
+  void ClearAllReleased() {
+    for (intptr_t i = 0; i < kReleasedWords; i++) {
+      released_[i] = 0;
+    }
+  }
+
  private:
+  // OS pages are at least 4KB.
+  static constexpr intptr_t kReleasedWords =
+      kPageSize / (4 * KB) / kBitsPerWord;
+
+  intptr_t ReleasedBit(uword addr) const {
+    const intptr_t bit =
+        (addr - reinterpret_cast<uword>(this)) / VirtualMemory::PageSize();
+    ASSERT((bit >= 0) && (bit < kReleasedWords * kBitsPerWord));
+    return bit;
+  }
+
   void set_object_end(uword value) {
     ASSERT((value & kObjectAlignmentMask) == kOldObjectAlignmentOffset);
     top_ = value;
@@ -324,10 +368,20 @@ class Page {
   // Objects below this address have survived a scavenge.
   uword survivor_end_;
 
+  // The number of scavenges survived by the objects below survivor_end_. The
+  // scavenger copies objects of different ages to different pages.
+  intptr_t age_;
+
   // A pointer to the first unprocessed object. Resolution completes when this
   // value meets the allocation top. Called "SCAN" in the original Cheney paper.
   uword resolved_top_;
 
+  // Sweeper statistics used to find fragmented pages. See live_bytes().
+  intptr_t live_bytes_;
+
+  // One bit per OS page of this page. See IsReleased.
+  RelaxedAtomic<uword> released_[kReleasedWords];
+
   template <bool>
   friend class ScavengerVisitorBase;
   friend class SemiSpace;
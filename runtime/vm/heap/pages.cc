@@ -9,7 +9,10 @@
 #include "vm/dart.h"
 #include "vm/heap/become.h"
 #include "vm/heap/compactor.h"
+#include "vm/heap/evacuator.h"
+#include "vm/heap/gc_shared.h"
 #include "vm/heap/marker.h"
+#include "vm/heap/memory_pressure.h"
 #include "vm/heap/safepoint.h"
 #include "vm/heap/sweeper.h"
 #include "vm/lockers.h"
@@ -17,6 +20,7 @@
 #include "vm/object.h"
 #include "vm/object_set.h"
 #include "vm/os_thread.h"
+#include "vm/thread_registry.h"
 #include "vm/virtual_memory.h"
 
 namespace dart {
@@ -42,6 +46,20 @@ DEFINE_FLAG(bool,
             false,
             "Print free list statistics after a GC");
 DEFINE_FLAG(bool, log_growth, false, "Log PageSpace growth policy decisions.");
+DEFINE_FLAG(bool,
+            grow_large_objects_in_place,
+            true,
+            "Grow large arrays by extending their page instead of copying.");
+DEFINE_FLAG(int,
+            sweep_assist_pages,
+            16,
+            "Number of pages an old-space allocation sweeps itself between "
+            "retries while the concurrent sweeper is running, rather than "
+            "waiting for the sweeper to finish.");
+DEFINE_FLAG(bool,
+            old_gen_tlab,
+            false,
+            "Give mutators thread-local old-space allocation buffers.");
 
 // The initial estimate of how many words we can mark per microsecond (usage
 // before / mark-sweep time). This is a conservative value observed running
@@ -51,8 +69,14 @@ static const intptr_t kConservativeInitialMarkSpeed = 20;
 
 PageSpace::PageSpace(Heap* heap, intptr_t max_capacity_in_words)
     : heap_(heap),
-      num_freelists_(Utils::Maximum(FLAG_scavenger_tasks, 1) + 1),
+      num_freelists_(Utils::Maximum(MaxGCTasks(FLAG_scavenger_tasks),
+                                    static_cast<intptr_t>(1)) +
+                     Page::kData),
       freelists_(new FreeList[num_freelists_]),
+      num_swept_data_freelists_(
+          Utils::Minimum<intptr_t>(
+              Utils::Maximum<intptr_t>(FLAG_scavenger_tasks, 1),
+              num_freelists_ - Page::kData)),
       pages_lock_(),
       max_capacity_in_words_(max_capacity_in_words),
       usage_(),
@@ -256,6 +280,81 @@ void PageSpace::TruncateLargePage(Page* page,
   }
 }
 
+bool PageSpace::TryGrowLargeObject(ObjectPtr obj, intptr_t new_size) {
+  if (!FLAG_grow_large_objects_in_place || !obj->IsOldObject()) {
+    return false;
+  }
+  {
+    // The concurrent sweeper reads and truncates large pages without holding
+    // the pages lock. The concurrent marker may be visiting the object, and
+    // reads its size from the header only once.
+    MonitorLocker ml(tasks_lock());
+    if ((phase() == kMarking) || (phase() == kAwaitingFinalization) ||
+        (phase() == kSweepingLarge)) {
+      return false;
+    }
+  }
+  const uword start = UntaggedObject::ToAddr(obj);
+  Page* page = Page::Of(obj);
+
+  MutexLocker ml(&pages_lock_);
+  // Only dereference the page once it is known to be one of ours, as objects
+  // on image pages or in other heaps give bogus results.
+  bool found = false;
+  for (Page* large = large_pages_; large != nullptr; large = large->next()) {
+    if (large == page) {
+      found = true;
+      break;
+    }
+  }
+  if (!found || (page->object_start() != start)) {
+    return false;
+  }
+  const intptr_t old_size = obj->untag()->HeapSize();
+  ASSERT(new_size > old_size);
+  if (page->object_end() != (start + old_size)) {
+    return false;  // Followed by filler left by Array::Truncate.
+  }
+
+  const intptr_t growth_in_words = (new_size - old_size) >> kWordSizeLog2;
+  SpaceUsage after = usage_;
+  after.used_in_words += growth_in_words;
+  if (page_space_controller_.ReachedHardThreshold(after) ||
+      page_space_controller_.ReachedSoftThreshold(after)) {
+    return false;
+  }
+
+  VirtualMemory* memory = page->memory_;
+  const intptr_t old_page_size = memory->size();
+  const intptr_t new_page_size = LargePageSizeInWordsFor(new_size)
+                                 << kWordSizeLog2;
+  if (new_page_size > old_page_size) {
+    const intptr_t increase_in_words =
+        (new_page_size - old_page_size) >> kWordSizeLog2;
+    if (!CanIncreaseCapacityInWordsLocked(increase_in_words)) {
+      return false;
+    }
+    const intptr_t old_card_table_size = page->card_table_size();
+    if (!memory->TryExtendInPlace(new_page_size)) {
+      return false;
+    }
+    IncreaseCapacityInWordsLocked(increase_in_words);
+    page->GrowCardTable(old_card_table_size);
+  }
+  // The extension is fresh memory, but the rest of the old page may hold
+  // filler left behind by truncation.
+  const uword old_end = start + old_size;
+  const uword zero_end = Utils::Minimum(start + new_size,
+                                        static_cast<uword>(page->start() +
+                                                           old_page_size));
+  if (zero_end > old_end) {
+    memset(reinterpret_cast<void*>(old_end), 0, zero_end - old_end);
+  }
+  page->set_object_end(start + new_size);
+  usage_.used_in_words += growth_in_words;
+  return true;
+}
+
 void PageSpace::FreePage(Page* page, Page* previous_page) {
   bool is_exec = (page->type() == Page::kExecutable);
   {
@@ -366,6 +465,22 @@ uword PageSpace::TryAllocateInFreshLargePage(intptr_t size,
   return result;
 }
 
+uword PageSpace::TryAllocateFromOtherDataFreeLists(intptr_t size,
+                                                    FreeList* freelist,
+                                                    bool is_protected) {
+  for (intptr_t i = 0; i < num_data_freelists(); i++) {
+    FreeList* other = DataFreeList(i);
+    if (other == freelist) {
+      continue;
+    }
+    const uword result = other->TryAllocate(size, is_protected);
+    if (result != 0) {
+      return result;
+    }
+  }
+  return 0;
+}
+
 uword PageSpace::TryAllocateInternal(intptr_t size,
                                      FreeList* freelist,
                                      Page::PageType type,
@@ -380,6 +495,11 @@ uword PageSpace::TryAllocateInternal(intptr_t size,
       result = freelist->TryAllocateLocked(size, is_protected);
     } else {
       result = freelist->TryAllocate(size, is_protected);
+      if ((result == 0) && (type == Page::kData)) {
+        // Only one freelist is locked at a time.
+        result = TryAllocateFromOtherDataFreeLists(size, freelist,
+                                                   is_protected);
+      }
     }
     if (result == 0) {
       result = TryAllocateInFreshPage(size, freelist, type, growth_policy,
@@ -396,6 +516,45 @@ uword PageSpace::TryAllocateInternal(intptr_t size,
   return result;
 }
 
+uword PageSpace::TryAllocateDataTLABSlow(Thread* thread, intptr_t size) {
+  if (size > kMaxTLABObjectSize) {
+    return TryAllocate(size, Page::kData);
+  }
+  AbandonTLAB(thread);
+  // The whole buffer counts as used until it is abandoned.
+  uword block = TryAllocate(kTLABSize, Page::kData);
+  if (block == 0) {
+    // Let the caller decide whether to collect or grow.
+    return TryAllocate(size, Page::kData);
+  }
+  thread->set_old_top(block + size);
+  thread->set_old_end(block + kTLABSize);
+  FreeListElement::AsElement(block + size, kTLABSize - size);
+  return block;
+}
+
+void PageSpace::AbandonTLAB(Thread* thread) {
+  const uword top = thread->old_top();
+  const uword end = thread->old_end();
+  thread->set_old_top(0);
+  thread->set_old_end(0);
+  if (top < end) {
+    freelists_[Page::kData].Free(top, end - top);
+    usage_.used_in_words -= (end - top) >> kWordSizeLog2;
+  }
+}
+
+void PageSpace::ReleaseTLABs() {
+  if (heap_ == nullptr) return;  // Some unit tests.
+  heap_->isolate_group()->thread_registry()->ForEachThread([](Thread* thread) {
+    // Threads that bypass safepoints don't allocate in the Dart heap.
+    if (!thread->BypassSafepoints()) {
+      thread->set_old_top(0);
+      thread->set_old_end(0);
+    }
+  });
+}
+
 void PageSpace::AcquireLock(FreeList* freelist) {
   freelist->mutex()->Lock();
 }
@@ -630,7 +789,8 @@ void PageSpace::VisitRememberedCards(ObjectPointerVisitor* visitor) const {
   ASSERT(Thread::Current()->IsAtSafepoint() ||
          (Thread::Current()->task_kind() == Thread::kScavengerTask));
 
-  // Wait for the sweeper to finish mutating the large page list.
+  // Wait for the sweeper to put the pages of card-remembered arrays back on
+  // the large page list.
   {
     MonitorLocker ml(tasks_lock());
     while (phase() == kSweepingLarge) {
@@ -710,6 +870,7 @@ void PageSpace::PrintToJSONObject(JSONObject* object) const {
   space.AddProperty64("used", UsedInWords() * kWordSize);
   space.AddProperty64("capacity", CapacityInWords() * kWordSize);
   space.AddProperty64("external", ExternalInWords() * kWordSize);
+  space.AddProperty64("_released", released_in_bytes());
   space.AddProperty("time", MicrosecondsToSeconds(gc_time_micros()));
   if (collections() > 0) {
     int64_t run_time = isolate_group->UptimeMicros();
@@ -1023,7 +1184,19 @@ void PageSpace::CollectGarbageHelper(Thread* thread,
     return;
   }
 
-  marker_->MarkObjects(this);
+  // Allocation buffers may span memory the sweeper is about to reclaim.
+  ReleaseTLABs();
+
+  // Evacuation relies on the marker finding every reference to the candidate
+  // pages, so it is limited to marks done entirely within this pause.
+  GCEvacuator evacuator(thread, heap_);
+  const bool evacuate = FLAG_evacuate_fragmented_pages && !compact &&
+                        (phase() == kDone) &&
+                        evacuator.SelectCandidates(
+                            pages_, reinterpret_cast<uword>(oom_reservation_));
+
+  marker_->MarkObjects(this, evacuate ? &evacuator : nullptr);
+  heap_->stats_.num_tasks_ = marker_->num_tasks();
   usage_.used_in_words = marker_->marked_words() + allocated_black_in_words_;
   allocated_black_in_words_ = 0;
   mark_words_per_micro_ = marker_->MarkedWordsPerMicro();
@@ -1047,6 +1220,7 @@ void PageSpace::CollectGarbageHelper(Thread* thread,
     // Executable pages are always swept immediately to simplify
     // code protection.
     TIMELINE_FUNCTION_GC_DURATION(thread, "SweepExecutable");
+    GCPhaseScope phase(heap_, GCPhase::kSweeping);
     GCSweeper sweeper;
     Page* prev_page = NULL;
     Page* page = exec_pages_;
@@ -1067,13 +1241,30 @@ void PageSpace::CollectGarbageHelper(Thread* thread,
 
   bool has_reservation = MarkReservation();
 
+  if (evacuate) {
+    GCPhaseScope phase(heap_, GCPhase::kCompaction);
+    evacuator.Evacuate();
+  }
+
   {
-    // Move pages to sweeper work lists.
+    // Move pages to sweeper work lists. Pages of card-remembered arrays are
+    // kept apart, as scavenges must wait for them to be swept.
     MutexLocker ml(&pages_lock_);
     ASSERT(sweep_large_ == nullptr);
-    sweep_large_ = large_pages_;
+    ASSERT(sweep_large_cards_ == nullptr);
+    Page* page = large_pages_;
+    while (page != nullptr) {
+      Page* next = page->next();
+      ObjectPtr obj = UntaggedObject::FromAddr(page->object_start());
+      Page** list = obj->untag()->IsCardRemembered() ? &sweep_large_cards_
+                                                     : &sweep_large_;
+      page->set_next(*list);
+      *list = page;
+      page = next;
+    }
     large_pages_ = large_pages_tail_ = nullptr;
     ASSERT(sweep_regular_ == nullptr);
+    released_in_bytes_ = 0;
     if (!compact) {
       sweep_regular_ = pages_;
       pages_ = pages_tail_ = nullptr;
@@ -1082,14 +1273,21 @@ void PageSpace::CollectGarbageHelper(Thread* thread,
 
   bool can_verify;
   if (compact) {
-    SweepLarge();
-    Compact(thread);
+    {
+      GCPhaseScope phase(heap_, GCPhase::kSweeping);
+      SweepLarge();
+    }
+    {
+      GCPhaseScope phase(heap_, GCPhase::kCompaction);
+      Compact(thread);
+    }
     set_phase(kDone);
     can_verify = true;
   } else if (FLAG_concurrent_sweep && has_reservation) {
     ConcurrentSweep(isolate_group);
     can_verify = false;
   } else {
+    GCPhaseScope phase(heap_, GCPhase::kSweeping);
     SweepLarge();
     Sweep(/*exclusive*/ true);
     set_phase(kDone);
@@ -1128,13 +1326,24 @@ void PageSpace::CollectGarbageHelper(Thread* thread,
 
 void PageSpace::SweepLarge() {
   TIMELINE_FUNCTION_GC_DURATION(Thread::Current(), "SweepLarge");
+  SweepLargePages(&sweep_large_cards_, kIntptrMax);
+  SweepLargePages(&sweep_large_, kIntptrMax);
+}
 
+void PageSpace::SweepLargeCards() {
+  TIMELINE_FUNCTION_GC_DURATION(Thread::Current(), "SweepLargeCards");
+  SweepLargePages(&sweep_large_cards_, kIntptrMax);
+}
+
+intptr_t PageSpace::SweepLargePages(Page** list, intptr_t budget) {
   GCSweeper sweeper;
+  intptr_t swept = 0;
   MutexLocker ml(&pages_lock_);
-  while (sweep_large_ != nullptr) {
-    Page* page = sweep_large_;
-    sweep_large_ = page->next();
+  while ((*list != nullptr) && (swept < budget)) {
+    Page* page = *list;
+    *list = page->next();
     page->set_next(nullptr);
+    swept++;
     ASSERT(page->type() == Page::kData);
 
     ml.Unlock();
@@ -1151,27 +1360,30 @@ void PageSpace::SweepLarge() {
       AddLargePageLocked(page);
     }
   }
+  return swept;
 }
 
-void PageSpace::Sweep(bool exclusive) {
+intptr_t PageSpace::Sweep(bool exclusive, intptr_t budget) {
   TIMELINE_FUNCTION_GC_DURATION(Thread::Current(), "Sweep");
 
   GCSweeper sweeper;
 
   intptr_t shard = 0;
-  const intptr_t num_shards = Utils::Maximum(FLAG_scavenger_tasks, 1);
+  const intptr_t num_shards = num_swept_data_freelists();
   if (exclusive) {
     for (intptr_t i = 0; i < num_shards; i++) {
       DataFreeList(i)->mutex()->Lock();
     }
   }
 
+  intptr_t swept = 0;
   MutexLocker ml(&pages_lock_);
-  while (sweep_regular_ != nullptr) {
+  while ((sweep_regular_ != nullptr) && (swept < budget)) {
     Page* page = sweep_regular_;
     sweep_regular_ = page->next();
     page->set_next(nullptr);
     ASSERT(page->type() == Page::kData);
+    swept++;
 
     ml.Unlock();
     // Cycle through the shards round-robin so that free space is roughly
@@ -1198,6 +1410,25 @@ void PageSpace::Sweep(bool exclusive) {
       DataFreeList(i)->mutex()->Unlock();
     }
   }
+  released_in_bytes_.fetch_add(sweeper.released_in_bytes());
+  return swept;
+}
+
+intptr_t PageSpace::AssistSweep() {
+  {
+    MonitorLocker ml(tasks_lock());
+    if ((phase() != kSweepingLarge) && (phase() != kSweepingRegular)) {
+      return 0;
+    }
+  }
+  // Pages of card-remembered arrays are left to the sweeper task, which
+  // signals scavenges waiting for them.
+  const intptr_t budget = FLAG_sweep_assist_pages;
+  intptr_t swept = SweepLargePages(&sweep_large_, budget);
+  if (swept < budget) {
+    swept += Sweep(/*exclusive*/ false, budget - swept);
+  }
+  return swept;
 }
 
 void PageSpace::ConcurrentSweep(IsolateGroup* isolate_group) {
@@ -1206,6 +1437,10 @@ void PageSpace::ConcurrentSweep(IsolateGroup* isolate_group) {
 }
 
 void PageSpace::Compact(Thread* thread) {
+  // Objects slide over the pages the sweeper returned to the OS.
+  for (Page* page = pages_; page != nullptr; page = page->next()) {
+    page->ClearAllReleased();
+  }
   GCCompactor compactor(thread, heap_);
   compactor.Compact(pages_, &freelists_[Page::kData], &pages_lock_);
 
@@ -1290,6 +1525,11 @@ void PageSpace::SetupImagePage(void* pointer, uword size, bool is_executable) {
 
   VirtualMemory* memory = VirtualMemory::ForImagePage(pointer, size);
   ASSERT(memory != NULL);
+  if (VirtualMemory::HugePagesEnabled()) {
+    // The embedder owns the mapping, but AOT instructions in particular are
+    // hot enough that backing them with huge pages is worth asking for.
+    VirtualMemory::AdviseHugePages(pointer, size);
+  }
   Page* page = reinterpret_cast<Page*>(malloc(sizeof(Page)));
   page->type_ = is_executable ? Page::kExecutable : Page::kData;
   page->memory_ = memory;
@@ -1301,6 +1541,7 @@ void PageSpace::SetupImagePage(void* pointer, uword size, bool is_executable) {
   page->top_ = memory->end();
   page->end_ = memory->end();
   page->survivor_end_ = 0;
+  page->age_ = 0;
   page->resolved_top_ = 0;
 
   MutexLocker ml(&pages_lock_);
@@ -1465,6 +1706,11 @@ void PageSpaceController::EvaluateGarbageCollection(SpaceUsage before,
     grow_heap = Utils::Maximum(min_step, grow_heap);
   }
 
+  // Stay within the headroom left by the cgroup, and grow less while the
+  // system is reclaiming memory.
+  grow_heap = MemoryPressure::Global()->LimitGrowth(
+      grow_heap, OS::GetCurrentMonotonicMicros());
+
   RecordUpdate(before, after, grow_heap, "gc");
 }
 
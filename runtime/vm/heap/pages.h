@@ -147,6 +147,26 @@ class PageSpace {
                                is_protected, is_locked);
   }
 
+  // Allocates data from the thread's old-space allocation buffer (TLAB),
+  // refilling it from the data freelist when it is exhausted, so mutators only
+  // take the freelist lock once per buffer. The unused part of the buffer is
+  // kept walkable as a free list element.
+  uword TryAllocateDataTLAB(Thread* thread, intptr_t size) {
+    ASSERT(Utils::IsAligned(size, kObjectAlignment));
+    uword result = thread->old_top();
+    uword new_top = result + size;
+    if (LIKELY((result != 0) && (new_top <= thread->old_end()))) {
+      thread->set_old_top(new_top);
+      if (new_top < thread->old_end()) {
+        FreeListElement::AsElement(new_top, thread->old_end() - new_top);
+      }
+      return result;
+    }
+    return TryAllocateDataTLABSlow(thread, size);
+  }
+  // Returns the unused part of the thread's allocation buffer to the freelist.
+  void AbandonTLAB(Thread* thread);
+
   void TryReleaseReservation();
   bool MarkReservation();
   void TryReserveForOOM();
@@ -228,6 +248,11 @@ class PageSpace {
   void IncrementalMarkWithSizeBudget(intptr_t size);
   void IncrementalMarkWithTimeBudget(int64_t deadline);
   void AssistTasks(MonitorLocker* ml);
+  // While the concurrent sweeper is running, sweeps up to
+  // FLAG_sweep_assist_pages pages on the calling thread so that an allocation
+  // can be retried without waiting for the whole sweep. Returns the number of
+  // pages swept, which is 0 once no pages are left for mutators to sweep.
+  intptr_t AssistSweep();
 
   void AddGCTime(int64_t micros) { gc_time_micros_ += micros; }
 
@@ -237,12 +262,25 @@ class PageSpace {
 
   intptr_t collections() const { return collections_; }
 
+  // Bytes inside the free blocks found by the current or last sweep that are
+  // returned to the OS. Not a running total: blocks stay counted only while
+  // they are free.
+  intptr_t released_in_bytes() const { return released_in_bytes_; }
+
 #ifndef PRODUCT
   void PrintToJSONObject(JSONObject* object) const;
   void PrintHeapMapToJSONStream(IsolateGroup* isolate_group,
                                 JSONStream* stream) const;
 #endif  // PRODUCT
 
+  // Tries to grow [obj], the last object on a large page, to [new_size] bytes
+  // without moving it, extending the page in place when needed. The added
+  // bytes are zero. Fails if the page is being swept, cannot be extended, or
+  // the growth would reach a GC threshold, in which case the caller should
+  // allocate a new object instead. On success, the caller must update the
+  // object's size to match before the next safepoint.
+  bool TryGrowLargeObject(ObjectPtr obj, intptr_t new_size);
+
   void AllocateBlack(intptr_t size) {
     allocated_black_in_words_.fetch_add(size >> kWordSizeLog2);
   }
@@ -274,8 +312,21 @@ class PageSpace {
 
   // Bulk data allocation.
   FreeList* DataFreeList(intptr_t i = 0) {
+    ASSERT(i < num_data_freelists());
     return &freelists_[Page::kData + i];
   }
+  // One per scavenger task, so this bounds the number of scavenger tasks.
+  intptr_t num_data_freelists() const { return num_freelists_ - Page::kData; }
+  // The data freelists the sweeper fills: those of the tasks of the last
+  // scavenge, the first of which the mutator allocates from as well. With
+  // --adaptive_gc_tasks most scavenges use fewer than num_data_freelists().
+  intptr_t num_swept_data_freelists() const {
+    return num_swept_data_freelists_;
+  }
+  void set_num_scavenger_tasks(intptr_t num_tasks) {
+    ASSERT(num_tasks <= num_data_freelists());
+    num_swept_data_freelists_ = Utils::Maximum<intptr_t>(num_tasks, 1);
+  }
   void AcquireLock(FreeList* freelist);
   void ReleaseLock(FreeList* freelist);
 
@@ -316,6 +367,11 @@ class PageSpace {
     return TryAllocatePromoLockedSlow(freelist, size);
   }
   uword TryAllocatePromoLockedSlow(FreeList* freelist, intptr_t size);
+  // Promotes onto a page of its own, as for objects too large for the free
+  // lists, so that the object can be card-marked.
+  uword TryAllocatePromoLargeLocked(intptr_t size) {
+    return TryAllocateInFreshLargePage(size, Page::kData, kForceGrowth);
+  }
   ObjectPtr AllocateSnapshot(intptr_t size);
 
   void SetupImagePage(void* pointer, uword size, bool is_executable);
@@ -344,12 +400,27 @@ class PageSpace {
     kSweepLargePages = 5,
   };
 
+  // Size of a mutator's old-space allocation buffer. Larger objects are
+  // allocated directly from the freelist.
+  static constexpr intptr_t kTLABSize = 32 * KB;
+  static constexpr intptr_t kMaxTLABObjectSize = kTLABSize / 8;
+
+  uword TryAllocateDataTLABSlow(Thread* thread, intptr_t size);
+  // Forgets every thread's allocation buffer. The unused parts are free list
+  // elements without mark bits, so the following sweep reclaims them.
+  void ReleaseTLABs();
+
   uword TryAllocateInternal(intptr_t size,
                             FreeList* freelist,
                             Page::PageType type,
                             GrowthPolicy growth_policy,
                             bool is_protected,
                             bool is_locked);
+  // Allocates from the data freelists other than [freelist], which hold free
+  // space swept for scavenger tasks that later scavenges didn't use.
+  uword TryAllocateFromOtherDataFreeLists(intptr_t size,
+                                          FreeList* freelist,
+                                          bool is_protected);
   uword TryAllocateInFreshPage(intptr_t size,
                                FreeList* freelist,
                                Page::PageType type,
@@ -379,7 +450,10 @@ class PageSpace {
 
   void CollectGarbageHelper(Thread* thread, bool compact, bool finalize);
   void SweepLarge();
-  void Sweep(bool exclusive);
+  void SweepLargeCards();
+  // Sweeps at most [budget] pages, returning the number swept.
+  intptr_t SweepLargePages(Page** list, intptr_t budget);
+  intptr_t Sweep(bool exclusive, intptr_t budget = kIntptrMax);
   void ConcurrentSweep(IsolateGroup* isolate_group);
   void Compact(Thread* thread);
 
@@ -399,12 +473,13 @@ class PageSpace {
   Heap* const heap_;
 
   // One list for executable pages at freelists_[Page::kExecutable].
-  // FLAG_scavenger_tasks count of lists for data pages starting at
+  // MaxGCTasks(FLAG_scavenger_tasks) lists for data pages starting at
   // freelists_[Page::kData]. The sweeper inserts into the data page
   // freelists round-robin. The scavenger workers each use one of the data
   // page freelists without locking.
   const intptr_t num_freelists_;
   FreeList* freelists_;
+  RelaxedAtomic<intptr_t> num_swept_data_freelists_;
   static constexpr intptr_t kOOMReservationSize = 32 * KB;
   FreeListElement* oom_reservation_ = nullptr;
 
@@ -419,6 +494,7 @@ class PageSpace {
   Page* image_pages_ = nullptr;
   Page* sweep_regular_ = nullptr;
   Page* sweep_large_ = nullptr;
+  Page* sweep_large_cards_ = nullptr;
 
   // Various sizes being tracked for this generation.
   intptr_t max_capacity_in_words_;
@@ -442,10 +518,12 @@ class PageSpace {
 
   int64_t gc_time_micros_;
   intptr_t collections_;
+  RelaxedAtomic<intptr_t> released_in_bytes_ = {0};
   intptr_t mark_words_per_micro_;
 
   bool enable_concurrent_mark_;
 
+  friend class Become;
   friend class BasePageIterator;
   friend class ExclusivePageIterator;
   friend class ExclusiveCodePageIterator;
@@ -456,6 +534,7 @@ class PageSpace {
   friend class ConcurrentSweeperTask;
   friend class GCCompactor;
   friend class CompactorTask;
+  friend class GCEvacuator;
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(PageSpace);
 };
@@ -4,6 +4,10 @@
 
 #include "vm/heap/pages.h"
 #include "platform/assert.h"
+#include "vm/heap/heap.h"
+#include "vm/object.h"
+#include "vm/thread_pool.h"
+#include "vm/timer.h"
 #include "vm/unit_test.h"
 
 namespace dart {
@@ -31,4 +35,122 @@ TEST_CASE(Pages) {
   delete space;
 }
 
+DECLARE_FLAG(bool, old_gen_tlab);
+
+class CountFreeListElementsVisitor : public ObjectVisitor {
+ public:
+  void VisitObject(ObjectPtr obj) {
+    if (obj->GetClassId() == kFreeListElement) {
+      count_++;
+    }
+  }
+  intptr_t count() const { return count_; }
+
+ private:
+  intptr_t count_ = 0;
+};
+
+ISOLATE_UNIT_TEST_CASE(PageSpace_AllocateDataTLAB) {
+  SetFlagScope<bool> sfs(&FLAG_old_gen_tlab, true);
+  GCTestHelper::CollectOldSpace();
+
+  // Small objects are bump allocated from the same buffer.
+  const Array& first = Array::Handle(Array::New(4, Heap::kOld));
+  const Array& second = Array::Handle(Array::New(4, Heap::kOld));
+  const uword first_end =
+      UntaggedObject::ToAddr(first.ptr()) + first.ptr()->untag()->HeapSize();
+  EXPECT_EQ(first_end, UntaggedObject::ToAddr(second.ptr()));
+  EXPECT(thread->old_top() != 0);
+  EXPECT(thread->old_top() < thread->old_end());
+
+  // The unused part of the buffer stays walkable.
+  {
+    HeapIterationScope iteration(thread);
+    CountFreeListElementsVisitor visitor;
+    iteration.IterateOldObjects(&visitor);
+    EXPECT(visitor.count() > 0);
+  }
+
+  // A collection takes the buffer away from the thread.
+  GCTestHelper::CollectOldSpace();
+  EXPECT_EQ(0, thread->old_top());
+  EXPECT_EQ(0, thread->old_end());
+  EXPECT(first.IsOld());
+  EXPECT_EQ(4, second.Length());
+}
+
+class OldSpaceAllocationTask : public ThreadPool::Task {
+ public:
+  static constexpr intptr_t kAllocations = 200000;
+
+  OldSpaceAllocationTask(IsolateGroup* isolate_group,
+                         Monitor* monitor,
+                         intptr_t* done)
+      : isolate_group_(isolate_group), monitor_(monitor), done_(done) {}
+
+  virtual void Run() {
+    const bool kBypassSafepoint = false;
+    Thread::EnterIsolateGroupAsHelper(isolate_group_, Thread::kUnknownTask,
+                                      kBypassSafepoint);
+    {
+      Thread* thread = Thread::Current();
+      StackZone stack_zone(thread);
+      Array& array = Array::Handle();
+      for (intptr_t i = 0; i < kAllocations; i++) {
+        array = Array::New(8, Heap::kOld);
+        thread->CheckForSafepoint();
+      }
+    }
+    Thread::ExitIsolateGroupAsHelper(kBypassSafepoint);
+    MonitorLocker ml(monitor_);
+    (*done_)++;
+    ml.Notify();
+  }
+
+ private:
+  IsolateGroup* isolate_group_;
+  Monitor* monitor_;
+  intptr_t* done_;
+};
+
+static int64_t MeasureParallelOldSpaceAllocation(intptr_t num_tasks) {
+  Monitor monitor;
+  intptr_t done = 0;
+  Timer timer;
+  timer.Start();
+  for (intptr_t i = 0; i < num_tasks; i++) {
+    Dart::thread_pool()->Run<OldSpaceAllocationTask>(IsolateGroup::Current(),
+                                                     &monitor, &done);
+  }
+  {
+    MonitorLocker ml(&monitor);
+    while (done < num_tasks) {
+      ml.Wait();
+    }
+  }
+  timer.Stop();
+  return timer.TotalElapsedTime();
+}
+
+// Not a correctness test: compares old-space allocation throughput of several
+// threads sharing one isolate group with and without allocation buffers.
+TEST_CASE(PageSpace_ParallelOldSpaceAllocationBenchmark) {
+  const intptr_t kNumTasks = 4;
+  int64_t freelist_micros;
+  int64_t tlab_micros;
+  {
+    SetFlagScope<bool> sfs(&FLAG_old_gen_tlab, false);
+    freelist_micros = MeasureParallelOldSpaceAllocation(kNumTasks);
+  }
+  {
+    SetFlagScope<bool> sfs(&FLAG_old_gen_tlab, true);
+    tlab_micros = MeasureParallelOldSpaceAllocation(kNumTasks);
+  }
+  OS::PrintErr("%" Pd " threads x %" Pd
+               " old-space allocations: freelist %" Pd64 " us, TLAB %" Pd64
+               " us\n",
+               kNumTasks, OldSpaceAllocationTask::kAllocations,
+               freelist_micros, tlab_micros);
+}
+
 }  // namespace dart
@@ -5,6 +5,8 @@
 #ifndef RUNTIME_VM_HEAP_POINTER_BLOCK_H_
 #define RUNTIME_VM_HEAP_POINTER_BLOCK_H_
 
+#include <atomic>
+
 #include "platform/assert.h"
 #include "vm/globals.h"
 #include "vm/os_thread.h"
@@ -287,6 +289,100 @@ class MarkingStack : public BlockStack<kMarkingStackBlockSize> {
 typedef MarkingStack::Block MarkingStackBlock;
 typedef BlockWorkList<MarkingStack> MarkerWorkList;
 
+// A fixed-capacity Chase-Lev work-stealing deque of objects.
+//
+// The owning task pushes and pops at the bottom, and other tasks steal from
+// the top. Instead of growing, Push fails when the deque is full so that the
+// owner can overflow into a shared BlockStack.
+//
+// See "Correct and Efficient Work-Stealing for Weak Memory Models", Le et al.,
+// PPoPP 2013.
+template <intptr_t Capacity>
+class WorkStealingDeque : public MallocAllocated {
+ public:
+  static constexpr intptr_t kCapacity = Capacity;
+
+  WorkStealingDeque() : top_(0), bottom_(0) {
+    COMPILE_ASSERT(Utils::IsPowerOfTwo(kCapacity));
+  }
+  ~WorkStealingDeque() { ASSERT(IsEmpty()); }
+
+  // Returns false if the deque is full. Must only be called by the owner.
+  bool Push(ObjectPtr obj) {
+    const intptr_t b = bottom_.load(std::memory_order_relaxed);
+    const intptr_t t = top_.load(std::memory_order_acquire);
+    if ((b - t) >= kCapacity) {
+      return false;
+    }
+    buffer_[b & kMask].store(static_cast<uword>(obj),
+                             std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Returns nullptr if the deque is empty. Must only be called by the owner.
+  ObjectPtr Pop() {
+    const intptr_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    intptr_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    ObjectPtr result = static_cast<ObjectPtr>(
+        buffer_[b & kMask].load(std::memory_order_relaxed));
+    if (t == b) {
+      // Last element; race against thieves for it.
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        result = nullptr;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return result;
+  }
+
+  // Returns nullptr if the deque is empty or another task won the race for
+  // the oldest element. May be called by any task, including the owner.
+  ObjectPtr Steal() {
+    intptr_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const intptr_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return nullptr;
+    }
+    ObjectPtr result = static_cast<ObjectPtr>(
+        buffer_[t & kMask].load(std::memory_order_relaxed));
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return result;
+  }
+
+  // Only exact when no other task is operating on the deque.
+  intptr_t Size() const {
+    const intptr_t size = bottom_.load(std::memory_order_relaxed) -
+                          top_.load(std::memory_order_relaxed);
+    return size > 0 ? size : 0;
+  }
+  bool IsEmpty() const { return Size() == 0; }
+
+ private:
+  static constexpr intptr_t kMask = kCapacity - 1;
+
+  std::atomic<intptr_t> top_;
+  std::atomic<intptr_t> bottom_;
+  std::atomic<uword> buffer_[kCapacity];
+
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingDeque);
+};
+
+static const int kMarkingDequeCapacity = 4 * KB;
+typedef WorkStealingDeque<kMarkingDequeCapacity> MarkingDeque;
+
 static const int kPromotionStackBlockSize = 64;
 class PromotionStack : public BlockStack<kPromotionStackBlockSize> {
  public:
@@ -0,0 +1,91 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/heap/pretenuring.h"
+
+namespace dart {
+
+DEFINE_FLAG(bool,
+            pretenure_allocation_sites,
+            false,
+            "Allocate directly in old space for runtime allocation sites whose "
+            "objects usually survive a scavenge.");
+
+bool AllocationSiteTable::ShouldPretenure(uword site) {
+  MutexLocker ml(&mutex_);
+  auto* pair = site_map_.Lookup(site);
+  if (pair == nullptr) {
+    return false;
+  }
+  Site& entry = sites_[pair->value];
+  if (!entry.pretenured) {
+    return false;
+  }
+  if (++entry.unsampled < kPretenuredSampleInterval) {
+    return true;
+  }
+  entry.unsampled = 0;
+  return false;
+}
+
+void AllocationSiteTable::RecordAllocation(uword site, ObjectPtr obj) {
+  ASSERT(obj->IsNewObject());
+  MutexLocker ml(&mutex_);
+  if (samples_.length() >= kMaxSamplesPerScavenge) {
+    return;
+  }
+  const intptr_t index = LookupOrAddSiteLocked(site);
+  if (index < 0) {
+    return;
+  }
+  samples_.Add({obj, index});
+}
+
+intptr_t AllocationSiteTable::LookupOrAddSiteLocked(uword site) {
+  auto* pair = site_map_.Lookup(site);
+  if (pair != nullptr) {
+    return pair->value;
+  }
+  if (sites_.length() >= kMaxSites) {
+    return -1;
+  }
+  const intptr_t index = sites_.length();
+  sites_.Add({site, 0, 0, false, 0});
+  site_map_.Insert({static_cast<intptr_t>(site), index});
+  return index;
+}
+
+void AllocationSiteTable::UpdateDecisionsLocked() {
+  for (intptr_t i = 0; i < sites_.length(); i++) {
+    Site& site = sites_[i];
+    if (site.sampled < kMinSamples) {
+      continue;
+    }
+    const intptr_t survived_percent = (site.survived * 100) / site.sampled;
+    if (!site.pretenured && (survived_percent >= kSurvivalPercentThreshold)) {
+      site.pretenured = true;
+      site.unsampled = 0;
+    } else if (site.pretenured && (survived_percent < kDemoteSurvivalPercent)) {
+      site.pretenured = false;
+    }
+    if (site.sampled >= 2 * kMinSamples) {
+      // Age the counts so a change in behavior is noticed eventually.
+      site.sampled >>= 1;
+      site.survived >>= 1;
+    }
+  }
+}
+
+intptr_t AllocationSiteTable::NumPretenuredSites() {
+  MutexLocker ml(&mutex_);
+  intptr_t count = 0;
+  for (intptr_t i = 0; i < sites_.length(); i++) {
+    if (sites_[i].pretenured) {
+      count++;
+    }
+  }
+  return count;
+}
+
+}  // namespace dart
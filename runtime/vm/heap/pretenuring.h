@@ -0,0 +1,123 @@
+// Copyright (c) 2023, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef RUNTIME_VM_HEAP_PRETENURING_H_
+#define RUNTIME_VM_HEAP_PRETENURING_H_
+
+#include "vm/globals.h"
+
+#include "platform/assert.h"
+#include "vm/flags.h"
+#include "vm/growable_array.h"
+#include "vm/hash_map.h"
+#include "vm/lockers.h"
+#include "vm/raw_object.h"
+
+namespace dart {
+
+DECLARE_FLAG(bool, pretenure_allocation_sites);
+
+// Tracks how often objects allocated at a given allocation site survive their
+// first scavenge. An allocation site is identified by the return address in
+// the Dart frame that called into the runtime to allocate.
+//
+// Sites that have been sampled often enough and whose objects almost always
+// survive are pretenured: further allocations for them are made directly in
+// old space, sparing the scavenger from copying (and later promoting) them.
+//
+// Pretenured sites keep allocating one in kPretenuredSampleInterval objects in
+// new space, so their survival is still sampled. They go back to allocating in
+// new space only once survival drops below kDemoteSurvivalPercent, well below
+// the threshold for pretenuring, so that decisions don't flip back and forth.
+class AllocationSiteTable {
+ public:
+  AllocationSiteTable() {}
+  ~AllocationSiteTable() {}
+
+  // Whether the next allocation at [site] should be made in old space. False
+  // for the allocations of pretenured sites which are sampled.
+  bool ShouldPretenure(uword site);
+
+  // Records that [obj] was allocated in new space on behalf of [site], to be
+  // checked for survival by the next scavenge.
+  void RecordAllocation(uword site, ObjectPtr obj);
+
+  // Records that [size] bytes were allocated in old space on behalf of a
+  // pretenured site.
+  void RecordPretenured(intptr_t size) { pretenured_bytes_ += size; }
+
+  // Returns the bytes allocated for pretenured sites since the last call.
+  intptr_t TakePretenuredBytes() { return pretenured_bytes_.exchange(0); }
+
+  // Called by the scavenger after all surviving objects have been forwarded.
+  // [is_survivor] is given the sampled object and must return whether it was
+  // forwarded. Samples are consumed.
+  template <typename Predicate>
+  void UpdateSurvival(Predicate is_survivor) {
+    MutexLocker ml(&mutex_);
+    for (intptr_t i = 0; i < samples_.length(); i++) {
+      const Sample& sample = samples_[i];
+      Site& site = sites_[sample.site_index];
+      site.sampled++;
+      if (is_survivor(sample.object)) {
+        site.survived++;
+      }
+    }
+    samples_.Clear();
+    UpdateDecisionsLocked();
+  }
+
+  // Drops the samples taken since the last scavenge without counting them,
+  // e.g. because the scavenge was aborted and survival is unknown.
+  void DiscardSamples() {
+    MutexLocker ml(&mutex_);
+    samples_.Clear();
+  }
+
+  intptr_t NumPretenuredSites();
+
+  // Minimum number of samples before a site may be pretenured.
+  static constexpr intptr_t kMinSamples = 64;
+  // Minimum percentage of sampled objects that must survive their first
+  // scavenge before a site is pretenured.
+  static constexpr intptr_t kSurvivalPercentThreshold = 90;
+  // Percentage of surviving sampled objects below which a pretenured site
+  // allocates in new space again.
+  static constexpr intptr_t kDemoteSurvivalPercent = 50;
+  // One in this many allocations of a pretenured site is made in new space.
+  static constexpr intptr_t kPretenuredSampleInterval = 16;
+
+ private:
+  struct Site {
+    uword pc;
+    intptr_t sampled;
+    intptr_t survived;
+    bool pretenured;
+    // Allocations since the site was last sampled while pretenured.
+    intptr_t unsampled;
+  };
+  struct Sample {
+    ObjectPtr object;
+    intptr_t site_index;
+  };
+
+  // Upper bounds keeping the table cheap when many distinct sites allocate.
+  static constexpr intptr_t kMaxSites = 4 * KB;
+  static constexpr intptr_t kMaxSamplesPerScavenge = 16 * KB;
+
+  intptr_t LookupOrAddSiteLocked(uword site);
+  void UpdateDecisionsLocked();
+
+  Mutex mutex_;
+  MallocGrowableArray<Site> sites_;
+  MallocDirectChainedHashMap<IntKeyRawPointerValueTrait<intptr_t>> site_map_;
+  MallocGrowableArray<Sample> samples_;
+  RelaxedAtomic<intptr_t> pretenured_bytes_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(AllocationSiteTable);
+};
+
+}  // namespace dart
+
+#endif  // RUNTIME_VM_HEAP_PRETENURING_H_
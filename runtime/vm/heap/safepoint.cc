@@ -4,13 +4,86 @@
 
 #include "vm/heap/safepoint.h"
 
+#include "platform/utils.h"
 #include "vm/heap/heap.h"
+#include "vm/json_stream.h"
+#include "vm/object.h"
+#include "vm/stack_frame.h"
 #include "vm/thread.h"
 #include "vm/thread_registry.h"
+#include "vm/timeline.h"
 
 namespace dart {
 
 DEFINE_FLAG(bool, trace_safepoint, false, "Trace Safepoint logic.");
+DEFINE_FLAG(int,
+            slow_safepoint_micros,
+            1000,
+            "Safepoint operations waiting longer than this for the other "
+            "threads to check in are reported to the timeline.");
+DEFINE_FLAG(bool,
+            sample_slow_safepoints,
+            false,
+            "Record the top Dart frame of the thread that checked in last to "
+            "a slow safepoint operation.");
+
+intptr_t SafepointStats::BucketFor(int64_t micros) {
+  if (micros <= 0) {
+    return 0;
+  }
+  return Utils::Minimum<intptr_t>(Utils::BitLength(micros), kNumBuckets - 1);
+}
+
+void SafepointStats::Add(int64_t micros,
+                         const char* thread_name,
+                         const char* top_frame) {
+  MutexLocker ml(&mutex_);
+  count_++;
+  total_micros_ += micros;
+  buckets_[BucketFor(micros)]++;
+  if (micros < max_micros_) {
+    return;
+  }
+  max_micros_ = micros;
+  Utils::SNPrint(slowest_thread_, kMaxNameLength, "%s",
+                 thread_name != nullptr ? thread_name : "");
+  Utils::SNPrint(slowest_frame_, kMaxFrameLength, "%s",
+                 top_frame != nullptr ? top_frame : "");
+}
+
+#if !defined(PRODUCT)
+void SafepointStats::PrintJSON(JSONObject* jsobj) {
+  MutexLocker ml(&mutex_);
+  jsobj->AddProperty("count", count_);
+  jsobj->AddProperty64("totalMicros", total_micros_);
+  jsobj->AddProperty64("maxMicros", max_micros_);
+  {
+    JSONArray histogram(jsobj, "histogram");
+    for (intptr_t i = 0; i < kNumBuckets; i++) {
+      histogram.AddValue(buckets_[i]);
+    }
+  }
+  if (slowest_thread_[0] != '\0') {
+    jsobj->AddProperty("slowestThread", slowest_thread_);
+  }
+  if (slowest_frame_[0] != '\0') {
+    jsobj->AddProperty("slowestTopFrame", slowest_frame_);
+  }
+}
+
+void SafepointHandler::PrintJSON(JSONStream* stream) {
+  static const char* const kLevelNames[] = {"GC", "GCAndDeopt"};
+  COMPILE_ASSERT(ARRAY_SIZE(kLevelNames) == SafepointLevel::kNumLevels);
+  JSONObject jsobj(stream);
+  jsobj.AddProperty("type", "_SafepointStatistics");
+  JSONArray levels(&jsobj, "levels");
+  for (intptr_t level = 0; level < SafepointLevel::kNumLevels; ++level) {
+    JSONObject level_obj(&levels);
+    level_obj.AddProperty("level", kLevelNames[level]);
+    handlers_[level]->stats_.PrintJSON(&level_obj);
+  }
+}
+#endif  // !defined(PRODUCT)
 
 SafepointOperationScope::SafepointOperationScope(Thread* T,
                                                  SafepointLevel level)
@@ -79,6 +152,7 @@ void SafepointHandler::SafepointThreads(Thread* T, SafepointLevel level) {
   ASSERT(T->execution_state() == Thread::kThreadInVM);
   ASSERT(T->current_safepoint_level() >= level);
 
+  const int64_t start = OS::GetCurrentMonotonicMicros();
   {
     MonitorLocker tl(threads_lock());
 
@@ -114,10 +188,62 @@ void SafepointHandler::SafepointThreads(Thread* T, SafepointLevel level) {
 
   // Now wait for all threads that are not already at a safepoint to check-in.
   handlers_[level]->WaitUntilThreadsReachedSafepointLevel();
+  handlers_[level]->RecordTimeToSafepoint(T, start);
 
   AcquireLowerLevelSafepoints(T, level);
 }
 
+void SafepointHandler::LevelHandler::RecordTimeToSafepoint(Thread* T,
+                                                           int64_t start) {
+  const int64_t end = OS::GetCurrentMonotonicMicros();
+  const int64_t micros = end - start;
+  const char* thread_name = nullptr;
+  const char* top_frame = nullptr;
+  {
+    MonitorLocker sl(&parked_lock_);
+    if (last_parked_ != nullptr) {
+      thread_name = last_parked_name_;
+    }
+  }
+  const bool slow = micros >= FLAG_slow_safepoint_micros;
+  if (slow && (thread_name != nullptr) && FLAG_sample_slow_safepoints &&
+      (T->zone() != nullptr)) {
+    // The thread is parked until this operation ends, so its stack can be
+    // walked like the GC walks it.
+    DartFrameIterator frames(last_parked_,
+                             StackFrameIterator::kAllowCrossThreadIteration);
+    StackFrame* frame = frames.NextFrame();
+    if (frame != nullptr) {
+      const Function& function =
+          Function::Handle(T->zone(), frame->LookupDartFunction());
+      if (!function.IsNull()) {
+        top_frame = function.ToFullyQualifiedCString();
+      }
+    }
+  }
+  stats_.Add(micros, thread_name, top_frame);
+
+#if defined(SUPPORT_TIMELINE)
+  if (slow) {
+    TimelineStream* stream = Timeline::GetGCStream();
+    TimelineEvent* event = stream->enabled() ? stream->StartEvent() : nullptr;
+    if (event != nullptr) {
+      event->Duration("WaitForSafepoint", start, end);
+      event->SetNumArguments(3);
+      event->CopyArgument(0, "level",
+                          level_ == SafepointLevel::kGC ? "GC" : "GCAndDeopt");
+      event->CopyArgument(1, "lastThread",
+                          thread_name != nullptr ? thread_name : "");
+      event->CopyArgument(2, "topFrame", top_frame != nullptr ? top_frame : "");
+      event->Complete();
+    }
+  }
+#endif  // defined(SUPPORT_TIMELINE)
+
+  MonitorLocker sl(&parked_lock_);
+  last_parked_ = nullptr;
+}
+
 void SafepointHandler::AssertWeOwnLowerLevelSafepoints(Thread* T,
                                                        SafepointLevel level) {
   for (intptr_t lower_level = level - 1; lower_level >= 0; --lower_level) {
@@ -274,6 +400,10 @@ void SafepointHandler::LevelHandler::NotifyWeAreParked(Thread* T) {
   ASSERT(num_threads_not_parked_ > 0);
   num_threads_not_parked_ -= 1;
   if (num_threads_not_parked_ == 0) {
+    last_parked_ = T;
+    const char* name = T->os_thread()->name();
+    Utils::SNPrint(last_parked_name_, SafepointStats::kMaxNameLength, "%s",
+                   name != nullptr ? name : "");
     sl.Notify();
   }
 }
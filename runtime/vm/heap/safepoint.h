@@ -13,6 +13,54 @@
 
 namespace dart {
 
+DECLARE_FLAG(int, slow_safepoint_micros);
+DECLARE_FLAG(bool, sample_slow_safepoints);
+
+class JSONObject;
+class JSONStream;
+
+// Time-to-safepoint statistics of the operations at one safepoint level: how
+// long the initiating thread waited for the other threads to check in, and the
+// thread that checked in last during the slowest of them.
+class SafepointStats {
+ public:
+  // Bucket 0 counts waits under 1us, bucket i waits of [2^(i-1), 2^i) us.
+  // The last bucket also counts longer waits.
+  static constexpr intptr_t kNumBuckets = 24;
+  static constexpr intptr_t kMaxNameLength = 64;
+  static constexpr intptr_t kMaxFrameLength = 256;
+
+  SafepointStats() {}
+
+  static intptr_t BucketFor(int64_t micros);
+
+  // Records an operation that waited [micros]. [thread_name] is the thread
+  // that checked in last, or nullptr if no thread had to be waited for.
+  // [top_frame] is its top Dart frame, or nullptr if not sampled.
+  void Add(int64_t micros, const char* thread_name, const char* top_frame);
+
+  intptr_t count() const { return count_; }
+  int64_t max_micros() const { return max_micros_; }
+  intptr_t bucket(intptr_t i) const { return buckets_[i]; }
+  const char* slowest_thread() const { return slowest_thread_; }
+  const char* slowest_frame() const { return slowest_frame_; }
+
+#if !defined(PRODUCT)
+  void PrintJSON(JSONObject* jsobj);
+#endif
+
+ private:
+  Mutex mutex_;
+  intptr_t count_ = 0;
+  int64_t total_micros_ = 0;
+  int64_t max_micros_ = 0;
+  intptr_t buckets_[kNumBuckets] = {};
+  char slowest_thread_[kMaxNameLength] = {};
+  char slowest_frame_[kMaxFrameLength] = {};
+
+  DISALLOW_COPY_AND_ASSIGN(SafepointStats);
+};
+
 // A stack based scope that can be used to perform an operation after getting
 // all threads to a safepoint. At the end of the operation all the threads are
 // resumed.
@@ -94,6 +142,14 @@ class SafepointHandler {
     return false;
   }
 
+  SafepointStats* stats(SafepointLevel level) {
+    return &handlers_[level]->stats_;
+  }
+
+#if !defined(PRODUCT)
+  void PrintJSON(JSONStream* stream);
+#endif
+
  private:
   class LevelHandler {
    public:
@@ -130,6 +186,7 @@ class SafepointHandler {
     // Helper methods for [SafepointThreads]
     void NotifyThreadsToGetToSafepointLevel(Thread* T);
     void WaitUntilThreadsReachedSafepointLevel();
+    void RecordTimeToSafepoint(Thread* T, int64_t start);
 
     // Helper methods for [ResumeThreads]
     void NotifyThreadsToContinue(Thread* T);
@@ -151,6 +208,13 @@ class SafepointHandler {
     // Count the number of threads the currently in-progress safepoint operation
     // is waiting for to check-in.
     int32_t num_threads_not_parked_ = 0;
+
+    // The last thread to check in to the in-progress operation, if it had to
+    // be waited for. Only dereferenced while the operation holds it parked.
+    Thread* last_parked_ = nullptr;
+    char last_parked_name_[SafepointStats::kMaxNameLength] = {};
+
+    SafepointStats stats_;
   };
 
   void SafepointThreads(Thread* T, SafepointLevel level);
@@ -546,4 +546,77 @@ ISOLATE_UNIT_TEST_CASE_WITH_EXPECTATION(
   DeoptSafepointOperationScope safepoint_scope2(thread);
 }
 
+VM_UNIT_TEST_CASE(SafepointStats_Histogram) {
+  EXPECT_EQ(0, SafepointStats::BucketFor(0));
+  EXPECT_EQ(1, SafepointStats::BucketFor(1));
+  EXPECT_EQ(2, SafepointStats::BucketFor(2));
+  EXPECT_EQ(2, SafepointStats::BucketFor(3));
+  EXPECT_EQ(10, SafepointStats::BucketFor(1000));
+  EXPECT_EQ(SafepointStats::kNumBuckets - 1,
+            SafepointStats::BucketFor(kMaxInt64));
+
+  SafepointStats stats;
+  stats.Add(5, nullptr, nullptr);
+  stats.Add(3000, "slow", "main");
+  stats.Add(10, "fast", nullptr);
+  EXPECT_EQ(3, stats.count());
+  EXPECT_EQ(3000, stats.max_micros());
+  EXPECT_EQ(1, stats.bucket(3));
+  EXPECT_EQ(1, stats.bucket(4));
+  EXPECT_EQ(1, stats.bucket(12));
+  EXPECT_STREQ("slow", stats.slowest_thread());
+  EXPECT_STREQ("main", stats.slowest_frame());
+}
+
+class SlowCheckinTask : public StateMachineTask {
+ public:
+  enum State {
+    kStartLoop = StateMachineTask::kNext,
+  };
+
+  static constexpr intptr_t kDelayMicros = 20 * 1000;
+
+  explicit SlowCheckinTask(std::shared_ptr<Data> data)
+      : StateMachineTask(std::move(data)) {}
+
+ protected:
+  virtual void RunInternal() {
+    data_->WaitUntil(kStartLoop);
+    while (!data_->IsIn(kPleaseExit)) {
+      if (thread_->IsSafepointRequested()) {
+        // Keep the operation waiting, as a long loop without checks would.
+        OS::SleepMicros(kDelayMicros);
+        thread_->BlockForSafepoint();
+      }
+      OS::SleepMicros(100);
+    }
+  }
+};
+
+// Test that the time taken to reach a safepoint is recorded along with the
+// thread that checked in last.
+ISOLATE_UNIT_TEST_CASE(SafepointOperation_TimeToSafepoint) {
+  SafepointStats* stats =
+      thread->isolate_group()->safepoint_handler()->stats(SafepointLevel::kGC);
+  const intptr_t count = stats->count();
+
+  auto data = std::make_shared<StateMachineTask::Data>(thread->isolate_group());
+  {
+    // Will join outstanding threads on destruction.
+    ThreadPool pool;
+    pool.Run<SlowCheckinTask>(data);
+    data->WaitUntil(SlowCheckinTask::kEntered);
+    data->MarkAndNotify(SlowCheckinTask::kStartLoop);
+
+    { GcSafepointOperationScope safepoint_operation(thread); }
+
+    data->MarkAndNotify(SlowCheckinTask::kPleaseExit);
+    data->WaitUntil(SlowCheckinTask::kExited);
+  }
+
+  EXPECT_LT(count, stats->count());
+  EXPECT_LE(SlowCheckinTask::kDelayMicros, stats->max_micros());
+  EXPECT_STREQ("DartWorker", stats->slowest_thread());
+}
+
 }  // namespace dart
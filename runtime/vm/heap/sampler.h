@@ -45,6 +45,7 @@ class HeapProfileSampler {
   // sampling interval will be updated for each thread by the time this method
   // returns.
   static void SetSamplingInterval(intptr_t bytes_interval);
+  static intptr_t sampling_interval() { return sampling_interval_; }
 
   // Updates the callback that's invoked when a sample is collected.
   static void SetSamplingCallback(Dart_HeapSamplingCallback callback);
@@ -120,6 +121,9 @@ class HeapProfileSampler {
     return last_sample_size_ != kUninitialized;
   }
 
+  // The number of bytes of allocation the outstanding sample stands for.
+  intptr_t last_sample_size() const { return last_sample_size_; }
+
   void SampleNewSpaceAllocation(intptr_t allocation_size);
   void SampleOldSpaceAllocation(intptr_t allocation_size);
 
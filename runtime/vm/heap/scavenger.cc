@@ -46,6 +46,22 @@ DEFINE_FLAG(int,
             90,
             "Grow new gen when less than this percentage is garbage.");
 DEFINE_FLAG(int, new_gen_growth_factor, 2, "Grow new gen by this factor.");
+DEFINE_FLAG(int,
+            scavenger_tenure_age,
+            1,
+            "Number of scavenges an object must survive before it is promoted, "
+            "at most 4.");
+DEFINE_FLAG(bool,
+            adaptive_tenure_age,
+            false,
+            "Raise the tenure age when few promotion candidates survive and "
+            "lower it when most do.");
+DEFINE_FLAG(bool,
+            card_mark_promoted_large_arrays,
+            false,
+            "Promote arrays too large for the free lists onto pages of their "
+            "own and remember their new-space references with cards rather "
+            "than the store buffer, as for arrays allocated in old space.");
 
 // Scavenger uses the kCardRememberedBit to distinguish forwarded and
 // non-forwarded objects. We must choose a bit that is clear for all new-space
@@ -142,6 +158,10 @@ class ScavengerVisitorBase : public ObjectPointerVisitor {
         freelist_(freelist),
         bytes_promoted_(0),
         visiting_old_object_(nullptr),
+        card_marking_min_size_(FLAG_card_mark_promoted_large_arrays
+                                   ? Heap::kAllocatablePageSize
+                                   : kIntptrMax),
+        tenure_age_(scavenger->tenure_age_),
         promoted_list_(promotion_stack) {}
   ~ScavengerVisitorBase() { ASSERT(delayed_.IsEmpty()); }
 
@@ -240,8 +260,10 @@ class ScavengerVisitorBase : public ObjectPointerVisitor {
     ASSERT((obj == nullptr) || obj->IsOldObject());
     visiting_old_object_ = obj;
     if (obj != nullptr) {
-      // Card update happens in Page::VisitRememberedCards.
-      ASSERT(!obj->untag()->IsCardRemembered());
+      // Card update happens in Page::VisitRememberedCards, except for arrays
+      // visited right after being promoted onto a page of their own.
+      ASSERT(!obj->untag()->IsCardRemembered() ||
+             (UntaggedObject::FromAddr(Page::Of(obj)->object_start()) == obj));
     }
   }
 
@@ -291,8 +313,16 @@ class ScavengerVisitorBase : public ObjectPointerVisitor {
 
   bool HasWork() {
     if (scavenger_->abort_) return false;
-    return (scan_ != tail_) || (scan_ != nullptr && !scan_->IsResolved()) ||
-           !promoted_list_.IsEmpty();
+    if ((scan_ != tail_) || (scan_ != nullptr && !scan_->IsResolved()) ||
+        !promoted_list_.IsEmpty() || !retired_.is_empty()) {
+      return true;
+    }
+    for (intptr_t age = 1; age <= tenure_age_; age++) {
+      if ((copy_tails_[age] != nullptr) && !copy_tails_[age]->IsResolved()) {
+        return true;
+      }
+    }
+    return false;
   }
 
   bool WaitForWork(RelaxedAtomic<uintptr_t>* num_busy) {
@@ -331,18 +361,29 @@ class ScavengerVisitorBase : public ObjectPointerVisitor {
     return tail_;
   }
 
+  void AddSurvivedByAge(intptr_t* survived_by_age) const {
+    for (intptr_t age = 0; age <= Scavenger::kMaxTenureAge; age++) {
+      survived_by_age[age] += survived_by_age_[age];
+    }
+  }
+
   static bool ForwardOrSetNullIfCollected(uword heap_base,
                                           CompressedObjectPtr* ptr_address);
 
   void ProcessOldFinalizerEntry(FinalizerEntryPtr entry);
 
  private:
-  void UpdateStoreBuffer(ObjectPtr obj) {
+  template <typename T>
+  void UpdateStoreBuffer(T* p, ObjectPtr obj) {
     ASSERT(obj->IsHeapObject());
     // If the newly written object is not a new object, drop it immediately.
     if (!obj->IsNewObject()) {
       return;
     }
+    if (UNLIKELY(visiting_old_object_->untag()->IsCardRemembered())) {
+      Page::Of(visiting_old_object_)->RememberCard(p);
+      return;
+    }
     if (visiting_old_object_->untag()->TryAcquireRememberedBit()) {
       thread_->StoreBufferAddObjectGC(visiting_old_object_);
     }
@@ -364,7 +405,7 @@ class ScavengerVisitorBase : public ObjectPointerVisitor {
 
     // Update the store buffer as needed.
     if (visiting_old_object_ != nullptr) {
-      UpdateStoreBuffer(new_obj);
+      UpdateStoreBuffer(p, new_obj);
     }
   }
 
@@ -393,7 +434,7 @@ class ScavengerVisitorBase : public ObjectPointerVisitor {
 
     // Update the store buffer as needed.
     if (visiting_old_object_ != nullptr) {
-      UpdateStoreBuffer(new_obj);
+      UpdateStoreBuffer(p, new_obj);
     }
   }
 
@@ -411,26 +452,41 @@ class ScavengerVisitorBase : public ObjectPointerVisitor {
       new_obj = ForwardedObj(header);
     } else {
       intptr_t size = raw_obj->untag()->HeapSize(header);
+      const intptr_t age = Page::Of(raw_obj)->AgeOf(raw_addr);
+      ASSERT(age <= Scavenger::kMaxTenureAge);
+      survived_by_age_[age] += size >> kWordSizeLog2;
       uword new_addr = 0;
       // Check whether object should be promoted.
-      if (!Page::Of(raw_obj)->IsSurvivor(raw_addr)) {
-        // Not a survivor of a previous scavenge. Just copy the object into the
+      if (age < tenure_age_) {
+        // Has not survived enough scavenges yet. Just copy the object into the
         // to space.
-        new_addr = TryAllocateCopy(size);
+        new_addr = TryAllocateCopy(size, age + 1);
       }
+      bool card_remembered = false;
       if (new_addr == 0) {
-        // This object is a survivor of a previous scavenge. Attempt to promote
-        // the object. (Or, unlikely, to-space was exhausted by fragmentation.)
-        new_addr = page_space_->TryAllocatePromoLocked(freelist_, size);
+        // This object has survived enough scavenges. Attempt to promote the
+        // object. (Or, unlikely, to-space was exhausted by fragmentation.)
+        if (UNLIKELY(size >= card_marking_min_size_) &&
+            (UntaggedObject::ClassIdTag::decode(header) == kArrayCid)) {
+          new_addr = page_space_->TryAllocatePromoLargeLocked(size);
+          card_remembered = new_addr != 0;
+        }
+        if (LIKELY(new_addr == 0)) {
+          new_addr = page_space_->TryAllocatePromoLocked(freelist_, size);
+        }
         if (LIKELY(new_addr != 0)) {
           // If promotion succeeded then we need to remember it so that it can
-          // be traversed later.
-          promoted_list_.Push(UntaggedObject::FromAddr(new_addr));
+          // be traversed later. A card-marked copy is only pushed once it
+          // won, so that no card is remembered on the page of a losing copy.
+          if (LIKELY(!card_remembered)) {
+            promoted_list_.Push(UntaggedObject::FromAddr(new_addr));
+          }
           bytes_promoted_ += size;
         } else {
           // Promotion did not succeed. Copy into the to space instead.
           scavenger_->failed_to_promote_ = true;
-          new_addr = TryAllocateCopy(size);
+          new_addr =
+              TryAllocateCopy(size, Utils::Minimum(age + 1, tenure_age_));
           // To-space was exhausted by fragmentation and old-space could not
           // grow.
           if (UNLIKELY(new_addr == 0)) {
@@ -450,6 +506,7 @@ class ScavengerVisitorBase : public ObjectPointerVisitor {
         tags = UntaggedObject::OldBit::update(true, tags);
         tags = UntaggedObject::OldAndNotRememberedBit::update(true, tags);
         tags = UntaggedObject::NewBit::update(false, tags);
+        tags = UntaggedObject::CardRememberedBit::update(card_remembered, tags);
         // Setting the forwarding pointer below will make this tenured object
         // visible to the concurrent marker, but we haven't visited its slots
         // yet. We mark the object here to prevent the concurrent marker from
@@ -477,10 +534,13 @@ class ScavengerVisitorBase : public ObjectPointerVisitor {
           bytes_promoted_ -= size;
         } else {
           // Undo to-space allocation.
-          tail_->Unallocate(new_addr, size);
+          Page::Of(new_obj)->Unallocate(new_addr, size);
         }
+        survived_by_age_[age] -= size >> kWordSizeLog2;
         // Use the winner's forwarding target.
         new_obj = ForwardedObj(header);
+      } else if (UNLIKELY(card_remembered)) {
+        promoted_list_.Push(new_obj);
       }
     }
 
@@ -501,23 +561,29 @@ class ScavengerVisitorBase : public ObjectPointerVisitor {
     }
   }
 
+  // Allocates in to-space on a page holding objects that have survived [age]
+  // scavenges.
   DART_FORCE_INLINE
-  uword TryAllocateCopy(intptr_t size) {
+  uword TryAllocateCopy(intptr_t size, intptr_t age) {
     ASSERT(Utils::IsAligned(size, kObjectAlignment));
+    ASSERT((1 <= age) && (age <= tenure_age_));
     // TODO(rmacnak): Allocate one to start?
-    if (tail_ != nullptr) {
-      uword result = tail_->top_;
+    Page* page = copy_tails_[age];
+    if (page != nullptr) {
+      uword result = page->top_;
       ASSERT((result & kObjectAlignmentMask) == kNewObjectAlignmentOffset);
       uword new_top = result + size;
-      if (LIKELY(new_top <= tail_->end_)) {
-        tail_->top_ = new_top;
+      if (LIKELY(new_top <= page->end_)) {
+        page->top_ = new_top;
         return result;
       }
     }
-    return TryAllocateCopySlow(size);
+    return TryAllocateCopySlow(size, age);
   }
 
-  DART_NOINLINE uword TryAllocateCopySlow(intptr_t size);
+  DART_NOINLINE uword TryAllocateCopySlow(intptr_t size, intptr_t age);
+
+  void ResolvePage(Page* page);
 
   DART_NOINLINE DART_NORETURN void AbortScavenge() {
     if (FLAG_verbose_gc) {
@@ -550,12 +616,24 @@ class ScavengerVisitorBase : public ObjectPointerVisitor {
   FreeList* freelist_;
   intptr_t bytes_promoted_;
   ObjectPtr visiting_old_object_;
+  // The size from which promoted arrays are card-marked. Pages of their own
+  // are only allocated for objects too large for the free lists. Arrays
+  // larger than kNewAllocatableSize are card-marked when they are
+  // allocated in old space, so this only covers the sizes in between.
+  const intptr_t card_marking_min_size_;
+  const intptr_t tenure_age_;
   PromotionWorkList promoted_list_;
   GCLinkedLists delayed_;
 
   Page* head_ = nullptr;
-  Page* tail_ = nullptr;  // Allocating from here.
+  Page* tail_ = nullptr;  // Last page of the list.
   Page* scan_ = nullptr;  // Resolving from here.
+  // The page each age is being copied to, by the age the copies will have.
+  // Only the one that is tail_ is sure not to have been passed by scan_.
+  Page* copy_tails_[Scavenger::kMaxTenureAge + 1] = {};
+  // Former copy tails that scan_ may have passed before they were resolved.
+  MallocGrowableArray<Page*> retired_;
+  intptr_t survived_by_age_[Scavenger::kMaxTenureAge + 1] = {};
 
   template <typename GCVisitorType>
   friend void MournFinalized(GCVisitorType* visitor);
@@ -589,13 +667,19 @@ class ScavengerWeakVisitor : public HandleVisitor {
         reinterpret_cast<FinalizablePersistentHandle*>(addr);
     ObjectPtr* p = handle->ptr_addr();
     if (IsUnreachable(p)) {
-      handle->UpdateUnreachable(thread()->isolate_group());
+      unreachable_.Add(handle);
     } else {
       handle->UpdateRelocated(thread()->isolate_group());
     }
   }
 
+  MallocGrowableArray<FinalizablePersistentHandle*>* unreachable() {
+    return &unreachable_;
+  }
+
  private:
+  MallocGrowableArray<FinalizablePersistentHandle*> unreachable_;
+
   DISALLOW_COPY_AND_ASSIGN(ScavengerWeakVisitor);
 };
 
@@ -687,6 +771,53 @@ class ParallelScavengerTask : public ThreadPool::Task {
   DISALLOW_COPY_AND_ASSIGN(ParallelScavengerTask);
 };
 
+class ParallelMournWeakTask : public ThreadPool::Task {
+ public:
+  ParallelMournWeakTask(Scavenger* scavenger,
+                        IsolateGroup* isolate_group,
+                        ThreadBarrier* barrier,
+                        intptr_t num_parts,
+                        UnreachableWeakHandles* unreachable)
+      : scavenger_(scavenger),
+        isolate_group_(isolate_group),
+        barrier_(barrier),
+        num_parts_(num_parts),
+        unreachable_(unreachable) {}
+
+  virtual void Run() {
+    if (!barrier_->TryEnter()) {
+      barrier_->Release();
+      return;
+    }
+
+    bool result = Thread::EnterIsolateGroupAsHelper(
+        isolate_group_, Thread::kScavengerTask, /*bypass_safepoint=*/true);
+    ASSERT(result);
+
+    RunEnteredIsolateGroup();
+
+    Thread::ExitIsolateGroupAsHelper(/*bypass_safepoint=*/true);
+
+    barrier_->Sync();
+    barrier_->Release();
+  }
+
+  void RunEnteredIsolateGroup() {
+    Thread* thread = Thread::Current();
+    TIMELINE_FUNCTION_GC_DURATION(thread, "ParallelMournWeak");
+    scavenger_->IterateWeak(thread, num_parts_, unreachable_);
+  }
+
+ private:
+  Scavenger* scavenger_;
+  IsolateGroup* isolate_group_;
+  ThreadBarrier* barrier_;
+  intptr_t num_parts_;
+  UnreachableWeakHandles* unreachable_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelMournWeakTask);
+};
+
 SemiSpace::SemiSpace(intptr_t max_capacity_in_words)
     : max_capacity_in_words_(max_capacity_in_words), head_(nullptr) {}
 
@@ -755,6 +886,8 @@ Scavenger::Scavenger(Heap* heap, intptr_t max_semi_capacity_in_words)
     : heap_(heap),
       max_semi_capacity_in_words_(max_semi_capacity_in_words),
       scavenging_(false),
+      tenure_age_(NextTenureAge(1, 0.0)),
+      last_tenure_age_(tenure_age_),
       gc_time_micros_(0),
       collections_(0),
       scavenge_words_per_micro_(kConservativeInitialScavengeSpeed),
@@ -1012,6 +1145,12 @@ void Scavenger::Epilogue(SemiSpace* from) {
   }
 
   early_tenure_ = avg_frac >= (FLAG_early_tenuring_threshold / 100.0);
+  if (stats_history_.Get(0).promo_candidates_in_words() > 0) {
+    tenure_age_ = NextTenureAge(tenure_age_, avg_frac);
+  } else {
+    // Nothing was old enough to tell whether the age is right.
+    tenure_age_ = NextTenureAge(tenure_age_, -1.0);
+  }
 
   // Update estimate of scavenger speed. This statistic assumes survivorship
   // rates don't change much.
@@ -1203,30 +1342,109 @@ void Scavenger::IterateRoots(ScavengerVisitorBase<parallel>* visitor) {
   IterateRememberedCards(visitor);
 }
 
-void Scavenger::MournWeakHandles() {
+// The isolates' forwarding tables are mourned as one slice. The weak
+// persistent handles are divided into one part per scavenger task, and each
+// weak table is its own slice, since its survivors are rehashed into a single
+// replacement table.
+enum WeakSlices {
+  kForwardTables = 0,
+  kNumFixedWeakSlices,
+};
+
+void Scavenger::MournWeak(intptr_t num_tasks) {
   Thread* thread = Thread::Current();
+  UnreachableWeakHandles unreachable;
+  weak_slices_started_ = 0;
+  if (num_tasks == 0) {
+    IterateWeak(thread, 1, &unreachable);
+  } else {
+    ThreadBarrier* barrier = new ThreadBarrier(num_tasks, 1);
+    for (intptr_t i = 0; i < num_tasks; i++) {
+      if (i < (num_tasks - 1)) {
+        // Begin mourning on a helper thread.
+        bool result = Dart::thread_pool()->Run<ParallelMournWeakTask>(
+            this, heap_->isolate_group(), barrier, num_tasks, &unreachable);
+        ASSERT(result);
+      } else {
+        // Last worker is the main thread.
+        ParallelMournWeakTask task(this, heap_->isolate_group(), barrier,
+                                   num_tasks, &unreachable);
+        task.RunEnteredIsolateGroup();
+        barrier->Sync();
+        barrier->Release();
+      }
+    }
+  }
+
+  TIMELINE_FUNCTION_GC_DURATION(thread, "FinalizeWeakHandles");
+  unreachable.Finalize(heap_->isolate_group());
+}
+
+void Scavenger::IterateWeak(Thread* thread,
+                            intptr_t num_parts,
+                            UnreachableWeakHandles* unreachable) {
+  const intptr_t num_slices =
+      kNumFixedWeakSlices + num_parts + Heap::kNumWeakSelectors;
+  for (;;) {
+    intptr_t slice = weak_slices_started_.fetch_add(1);
+    if (slice >= num_slices) {
+      return;  // No more slices.
+    }
+
+    if (slice == kForwardTables) {
+      MournForwardTables(thread);
+    } else if (slice < (kNumFixedWeakSlices + num_parts)) {
+      MournWeakHandles(thread, slice - kNumFixedWeakSlices, num_parts,
+                       unreachable);
+    } else {
+      MournWeakTable(thread, slice - kNumFixedWeakSlices - num_parts);
+    }
+  }
+}
+
+void Scavenger::MournWeakHandles(Thread* thread,
+                                 intptr_t part,
+                                 intptr_t num_parts,
+                                 UnreachableWeakHandles* unreachable) {
   TIMELINE_FUNCTION_GC_DURATION(thread, "MournWeakHandles");
   ScavengerWeakVisitor weak_visitor(thread);
-  heap_->isolate_group()->VisitWeakPersistentHandles(&weak_visitor);
+  heap_->isolate_group()->VisitWeakPersistentHandles(&weak_visitor, part,
+                                                     num_parts);
+  unreachable->AddAll(weak_visitor.unreachable());
+}
+
+template <bool parallel>
+void ScavengerVisitorBase<parallel>::ResolvePage(Page* page) {
+  uword resolved_top = page->resolved_top_;
+  while (resolved_top < page->top_) {
+    ObjectPtr raw_obj = UntaggedObject::FromAddr(resolved_top);
+    resolved_top += ProcessCopied(raw_obj);
+  }
+  page->resolved_top_ = resolved_top;
 }
 
 template <bool parallel>
 void ScavengerVisitorBase<parallel>::ProcessToSpace() {
   while (scan_ != nullptr) {
-    uword resolved_top = scan_->resolved_top_;
-    while (resolved_top < scan_->top_) {
-      ObjectPtr raw_obj = UntaggedObject::FromAddr(resolved_top);
-      resolved_top += ProcessCopied(raw_obj);
-    }
-    scan_->resolved_top_ = resolved_top;
+    ResolvePage(scan_);
 
     Page* next = scan_->next();
     if (next == nullptr) {
       // Don't update scan_. More objects may yet be copied to this TLAB.
-      return;
+      break;
     }
     scan_ = next;
   }
+
+  // With more than one age, objects may be copied to pages scan_ has passed.
+  while (!retired_.is_empty()) {
+    ResolvePage(retired_.RemoveLast());
+  }
+  for (intptr_t age = 1; age <= tenure_age_; age++) {
+    if ((copy_tails_[age] != nullptr) && (copy_tails_[age] != scan_)) {
+      ResolvePage(copy_tails_[age]);
+    }
+  }
 }
 
 template <bool parallel>
@@ -1407,44 +1625,47 @@ void ScavengerVisitorBase<parallel>::ProcessOldFinalizerEntry(
   }
 }
 
-void Scavenger::MournWeakTables() {
-  TIMELINE_FUNCTION_GC_DURATION(Thread::Current(), "MournWeakTables");
-
-  auto rehash_weak_table = [](WeakTable* table, WeakTable* replacement_new,
-                              WeakTable* replacement_old) {
-    intptr_t size = table->size();
-    for (intptr_t i = 0; i < size; i++) {
-      if (table->IsValidEntryAtExclusive(i)) {
-        ObjectPtr raw_obj = table->ObjectAtExclusive(i);
-        ASSERT(raw_obj->IsHeapObject());
-        uword raw_addr = UntaggedObject::ToAddr(raw_obj);
-        uword header = *reinterpret_cast<uword*>(raw_addr);
-        if (IsForwarding(header)) {
-          // The object has survived.  Preserve its record.
-          raw_obj = ForwardedObj(header);
-          auto replacement =
-              raw_obj->IsNewObject() ? replacement_new : replacement_old;
-          replacement->SetValueExclusive(raw_obj, table->ValueAtExclusive(i));
-        }
+static void RehashWeakTable(WeakTable* table,
+                            WeakTable* replacement_new,
+                            WeakTable* replacement_old) {
+  intptr_t size = table->num_slots();
+  for (intptr_t i = 0; i < size; i++) {
+    if (table->IsValidEntryAtExclusive(i)) {
+      ObjectPtr raw_obj = table->ObjectAtExclusive(i);
+      ASSERT(raw_obj->IsHeapObject());
+      uword raw_addr = UntaggedObject::ToAddr(raw_obj);
+      uword header = *reinterpret_cast<uword*>(raw_addr);
+      if (IsForwarding(header)) {
+        // The object has survived.  Preserve its record.
+        raw_obj = ForwardedObj(header);
+        auto replacement =
+            raw_obj->IsNewObject() ? replacement_new : replacement_old;
+        replacement->SetValueExclusive(raw_obj, table->ValueAtExclusive(i));
       }
     }
-  };
+  }
+}
 
-  // Rehash the weak tables now that we know which objects survive this cycle.
-  for (int sel = 0; sel < Heap::kNumWeakSelectors; sel++) {
-    const auto selector = static_cast<Heap::WeakSelector>(sel);
-    auto table = heap_->GetWeakTable(Heap::kNew, selector);
-    auto table_old = heap_->GetWeakTable(Heap::kOld, selector);
+void Scavenger::MournWeakTable(Thread* thread, intptr_t sel) {
+  TIMELINE_FUNCTION_GC_DURATION(thread, "MournWeakTables");
+  const auto selector = static_cast<Heap::WeakSelector>(sel);
 
-    // Create a new weak table for the new-space.
-    auto table_new = WeakTable::NewFrom(table);
-    rehash_weak_table(table, table_new, table_old);
-    heap_->SetWeakTable(Heap::kNew, selector, table_new);
+  // Rehash the weak table now that we know which objects survive this cycle.
+  auto table = heap_->GetWeakTable(Heap::kNew, selector);
+  auto table_old = heap_->GetWeakTable(Heap::kOld, selector);
 
-    // Remove the old table as it has been replaced with the newly allocated
-    // table above.
-    delete table;
-  }
+  // Create a new weak table for the new-space.
+  auto table_new = WeakTable::NewFrom(table);
+  RehashWeakTable(table, table_new, table_old);
+  heap_->SetWeakTable(Heap::kNew, selector, table_new);
+
+  // Remove the old table as it has been replaced with the newly allocated
+  // table above.
+  delete table;
+}
+
+void Scavenger::MournForwardTables(Thread* thread) {
+  TIMELINE_FUNCTION_GC_DURATION(thread, "MournForwardTables");
 
   // Each isolate might have a weak table used for fast snapshot writing (i.e.
   // isolate communication). Rehash those tables if need be.
@@ -1453,7 +1674,7 @@ void Scavenger::MournWeakTables() {
         auto table = isolate->forward_table_new();
         if (table != nullptr) {
           auto replacement = WeakTable::NewFrom(table);
-          rehash_weak_table(table, replacement, isolate->forward_table_old());
+          RehashWeakTable(table, replacement, isolate->forward_table_old());
           isolate->set_forward_table_new(replacement);
         }
       },
@@ -1670,7 +1891,8 @@ void Scavenger::AbandonRemainingTLAB(Thread* thread) {
 }
 
 template <bool parallel>
-uword ScavengerVisitorBase<parallel>::TryAllocateCopySlow(intptr_t size) {
+uword ScavengerVisitorBase<parallel>::TryAllocateCopySlow(intptr_t size,
+                                                          intptr_t age) {
   Page* page;
   {
     MutexLocker ml(&scavenger_->space_lock_);
@@ -1679,6 +1901,14 @@ uword ScavengerVisitorBase<parallel>::TryAllocateCopySlow(intptr_t size) {
   if (page == nullptr) {
     return 0;
   }
+  page->set_age(age);
+
+  Page* previous = copy_tails_[age];
+  if ((previous != nullptr) && (previous != tail_) &&
+      !previous->IsResolved()) {
+    retired_.Add(previous);
+  }
+  copy_tails_[age] = page;
 
   if (head_ == nullptr) {
     head_ = scan_ = page;
@@ -1688,7 +1918,7 @@ uword ScavengerVisitorBase<parallel>::TryAllocateCopySlow(intptr_t size) {
   }
   tail_ = page;
 
-  return tail_->TryAllocateGC(size);
+  return page->TryAllocateGC(size);
 }
 
 void Scavenger::Scavenge(Thread* thread, GCType type, GCReason reason) {
@@ -1719,20 +1949,38 @@ void Scavenger::Scavenge(Thread* thread, GCType type, GCReason reason) {
   intptr_t abandoned_bytes = 0;  // TODO(rmacnak): Count fragmentation?
   SpaceUsage usage_before = GetCurrentUsage();
   intptr_t promo_candidate_words = 0;
+  last_tenure_age_ = tenure_age_;
+  for (intptr_t age = 0; age <= kMaxTenureAge; age++) {
+    words_by_age_[age] = 0;
+    survived_by_age_[age] = 0;
+  }
   for (Page* page = to_->head(); page != nullptr; page = page->next()) {
     page->Release();
     if (early_tenure_) {
-      page->EarlyTenure();
+      page->EarlyTenure(tenure_age_);
+    }
+    const intptr_t survivor_words = Utils::Minimum(
+        page->promo_candidate_words(),
+        (page->object_end() - page->object_start()) >> kWordSizeLog2);
+    words_by_age_[page->age()] += survivor_words;
+    words_by_age_[0] +=
+        ((page->object_end() - page->object_start()) >> kWordSizeLog2) -
+        survivor_words;
+    if (page->age() >= tenure_age_) {
+      promo_candidate_words += page->promo_candidate_words();
     }
-    promo_candidate_words += page->promo_candidate_words();
   }
   SemiSpace* from = Prologue(reason);
 
+  const intptr_t num_tasks = ChooseNumTasks(usage_before);
+  heap_->stats_.num_tasks_ = num_tasks;
+  // Later sweeps fill the freelists of as many tasks.
+  heap_->old_space()->set_num_scavenger_tasks(num_tasks);
   intptr_t bytes_promoted;
-  if (FLAG_scavenger_tasks == 0) {
+  if (num_tasks == 0) {
     bytes_promoted = SerialScavenge(from);
   } else {
-    bytes_promoted = ParallelScavenge(from);
+    bytes_promoted = ParallelScavenge(from, num_tasks);
   }
   if (abort_) {
     ReverseScavenge(&from);
@@ -1757,8 +2005,17 @@ void Scavenger::Scavenge(Thread* thread, GCType type, GCReason reason) {
     }
   }
   ASSERT(promotion_stack_.IsEmpty());
-  MournWeakHandles();
-  MournWeakTables();
+  {
+    GCPhaseScope phase(heap_, GCPhase::kWeak);
+    MournWeak(num_tasks);
+  }
+  if (abort_) {
+    allocation_sites_.DiscardSamples();
+  } else {
+    allocation_sites_.UpdateSurvival([](ObjectPtr obj) {
+      return IsForwarding(ReadHeaderRelaxed(obj));
+    });
+  }
   heap_->old_space()->ResetProgressBars();
 
   // Restore write-barrier assumptions.
@@ -1766,9 +2023,13 @@ void Scavenger::Scavenge(Thread* thread, GCType type, GCReason reason) {
 
   // Scavenge finished. Run accounting.
   int64_t end = OS::GetCurrentMonotonicMicros();
+  const intptr_t pretenured_words =
+      allocation_sites_.TakePretenuredBytes() >> kWordSizeLog2;
+  pretenured_in_words_ += pretenured_words;
   stats_history_.Add(ScavengeStats(
       start, end, usage_before, GetCurrentUsage(), promo_candidate_words,
-      bytes_promoted >> kWordSizeLog2, abandoned_bytes >> kWordSizeLog2));
+      bytes_promoted >> kWordSizeLog2, abandoned_bytes >> kWordSizeLog2,
+      pretenured_words, num_tasks));
   Epilogue(from);
 
   if (FLAG_verify_after_gc) {
@@ -1792,22 +2053,56 @@ intptr_t Scavenger::SerialScavenge(SemiSpace* from) {
   FreeList* freelist = heap_->old_space()->DataFreeList(0);
   SerialScavengerVisitor visitor(heap_->isolate_group(), this, from, freelist,
                                  &promotion_stack_);
-  visitor.ProcessRoots();
   {
-    TIMELINE_FUNCTION_GC_DURATION(Thread::Current(), "ProcessToSpace");
-    visitor.ProcessAll();
+    GCPhaseScope phase(heap_, GCPhase::kRoots);
+    visitor.ProcessRoots();
+  }
+  {
+    GCPhaseScope phase(heap_, GCPhase::kMarking);
+    {
+      TIMELINE_FUNCTION_GC_DURATION(Thread::Current(), "ProcessToSpace");
+      visitor.ProcessAll();
+    }
+    visitor.Finalize();
   }
-  visitor.Finalize();
 
   visitor.FinalizePromotion();
   to_->AddList(visitor.head(), visitor.tail());
+  visitor.AddSurvivedByAge(survived_by_age_);
   return visitor.bytes_promoted();
 }
 
-intptr_t Scavenger::ParallelScavenge(SemiSpace* from) {
+// With --adaptive_gc_tasks, roughly one scavenger task is used per this much
+// estimated work: surviving words plus a fixed cost per remembered object.
+static constexpr intptr_t kScavengeWordsPerTask = MBInWords / 2;
+static constexpr intptr_t kWordsPerRememberedObject = 8;
+
+intptr_t Scavenger::ChooseNumTasks(SpaceUsage usage_before) const {
+  // Estimate the survivors from how much of new space recent scavenges found
+  // to be garbage.
+  intptr_t live_in_words = usage_before.used_in_words;
+  if (stats_history_.Size() != 0) {
+    double garbage = stats_history_.Get(0).ExpectedGarbageFraction();
+    garbage = Utils::Minimum(Utils::Maximum(garbage, 0.0), 1.0);
+    live_in_words = static_cast<intptr_t>(live_in_words * (1.0 - garbage));
+  }
+  intptr_t remembered = 0;
+  for (StoreBufferBlock* block = blocks_; block != nullptr;
+       block = block->next()) {
+    remembered += block->Count();
+  }
+  return ChooseGCTasks(FLAG_scavenger_tasks,
+                       live_in_words + remembered * kWordsPerRememberedObject,
+                       kScavengeWordsPerTask,
+                       heap_->old_space()->num_data_freelists());
+}
+
+intptr_t Scavenger::ParallelScavenge(SemiSpace* from, intptr_t num_tasks) {
   intptr_t bytes_promoted = 0;
-  const intptr_t num_tasks = FLAG_scavenger_tasks;
   ASSERT(num_tasks > 0);
+  ASSERT(num_tasks <= heap_->old_space()->num_data_freelists());
+  // The tasks visit the roots and copy in the same phase.
+  GCPhaseScope phase(heap_, GCPhase::kMarking);
 
   ThreadBarrier* barrier = new ThreadBarrier(num_tasks, 1);
   RelaxedAtomic<uintptr_t> num_busy = 0;
@@ -1842,6 +2137,7 @@ intptr_t Scavenger::ParallelScavenge(SemiSpace* from) {
     }
     to_->AddList(visitor->head(), visitor->tail());
     bytes_promoted += visitor->bytes_promoted();
+    visitor->AddSurvivedByAge(survived_by_age_);
     delete visitor;
   }
 
@@ -1922,6 +2218,59 @@ void Scavenger::WriteProtect(bool read_only) {
   to_->WriteProtect(read_only);
 }
 
+intptr_t Scavenger::NextTenureAge(intptr_t tenure_age, double promo_success) {
+  const intptr_t configured = Utils::Minimum(
+      Utils::Maximum(static_cast<intptr_t>(FLAG_scavenger_tenure_age),
+                     static_cast<intptr_t>(1)),
+      kMaxTenureAge);
+  if (!FLAG_adaptive_tenure_age) {
+    return configured;
+  }
+  if (promo_success < 0.0) {
+    return tenure_age;
+  }
+  const double high = FLAG_early_tenuring_threshold / 100.0;
+  if (promo_success >= high) {
+    // Objects reaching the tenure age are long-lived. Stop copying them.
+    return Utils::Maximum(tenure_age - 1, static_cast<intptr_t>(1));
+  }
+  if (promo_success < high / 2) {
+    // Most objects reaching the tenure age still die. Those promoted are
+    // likely to die soon in old space.
+    return Utils::Minimum(tenure_age + 1, kMaxTenureAge);
+  }
+  return tenure_age;
+}
+
+void Scavenger::PrintAgesToTimeline(TimelineEventScope* event) const {
+#if defined(SUPPORT_TIMELINE)
+  if ((event == nullptr) || !event->enabled()) {
+    return;
+  }
+  static const char* const kBeforeNames[] = {
+      "Age0.Before (kB)", "Age1.Before (kB)", "Age2.Before (kB)",
+      "Age3.Before (kB)", "Age4.Before (kB)",
+  };
+  static const char* const kSurvivedNames[] = {
+      "Age0.Survived (kB)", "Age1.Survived (kB)", "Age2.Survived (kB)",
+      "Age3.Survived (kB)", "Age4.Survived (kB)",
+  };
+  COMPILE_ASSERT(ARRAY_SIZE(kBeforeNames) == kMaxTenureAge + 1);
+  COMPILE_ASSERT(ARRAY_SIZE(kSurvivedNames) == kMaxTenureAge + 1);
+  intptr_t arguments = event->GetNumArguments();
+  event->SetNumArguments(arguments + 2 + 2 * (kMaxTenureAge + 1));
+  event->FormatArgument(arguments++, "TenureAge", "%" Pd "", last_tenure_age_);
+  event->FormatArgument(arguments++, "Promoted (kB)", "%" Pd "",
+                        RoundWordsToKB(LastPromotedInWords()));
+  for (intptr_t age = 0; age <= kMaxTenureAge; age++) {
+    event->FormatArgument(arguments++, kBeforeNames[age], "%" Pd "",
+                          RoundWordsToKB(words_by_age_[age]));
+    event->FormatArgument(arguments++, kSurvivedNames[age], "%" Pd "",
+                          RoundWordsToKB(survived_by_age_[age]));
+  }
+#endif  // defined(SUPPORT_TIMELINE)
+}
+
 #ifndef PRODUCT
 void Scavenger::PrintToJSONObject(JSONObject* object) const {
   auto isolate_group = IsolateGroup::Current();
@@ -1945,6 +2294,7 @@ void Scavenger::PrintToJSONObject(JSONObject* object) const {
   space.AddProperty64("used", UsedInWords() * kWordSize);
   space.AddProperty64("capacity", CapacityInWords() * kWordSize);
   space.AddProperty64("external", ExternalInWords() * kWordSize);
+  space.AddProperty64("pretenured", pretenured_in_words() * kWordSize);
   space.AddProperty("time", MicrosecondsToSeconds(gc_time_micros()));
 }
 #endif  // !PRODUCT
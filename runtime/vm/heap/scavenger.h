@@ -12,6 +12,7 @@
 #include "vm/flags.h"
 #include "vm/globals.h"
 #include "vm/heap/page.h"
+#include "vm/heap/pretenuring.h"
 #include "vm/heap/spaces.h"
 #include "vm/isolate.h"
 #include "vm/lockers.h"
@@ -22,14 +23,21 @@
 
 namespace dart {
 
+DECLARE_FLAG(int, scavenger_tenure_age);
+DECLARE_FLAG(bool, adaptive_tenure_age);
+DECLARE_FLAG(bool, card_mark_promoted_large_arrays);
+
 // Forward declarations.
 class Heap;
 class Isolate;
 class JSONObject;
+class TimelineEventScope;
 class ObjectSet;
 template <bool parallel>
 class ScavengerVisitorBase;
 
+class UnreachableWeakHandles;
+
 class SemiSpace {
  public:
   explicit SemiSpace(intptr_t max_capacity_in_words);
@@ -75,14 +83,18 @@ class ScavengeStats {
                 SpaceUsage after,
                 intptr_t promo_candidates_in_words,
                 intptr_t promoted_in_words,
-                intptr_t abandoned_in_words)
+                intptr_t abandoned_in_words,
+                intptr_t pretenured_in_words,
+                intptr_t num_tasks)
       : start_micros_(start_micros),
         end_micros_(end_micros),
         before_(before),
         after_(after),
         promo_candidates_in_words_(promo_candidates_in_words),
         promoted_in_words_(promoted_in_words),
-        abandoned_in_words_(abandoned_in_words) {}
+        abandoned_in_words_(abandoned_in_words),
+        pretenured_in_words_(pretenured_in_words),
+        num_tasks_(num_tasks) {}
 
   // Of all data before scavenge, what fraction was found to be garbage?
   // If this scavenge included growth, assume the extra capacity would become
@@ -103,9 +115,21 @@ class ScavengeStats {
   }
 
   intptr_t UsedBeforeInWords() const { return before_.used_in_words; }
+  intptr_t promo_candidates_in_words() const {
+    return promo_candidates_in_words_;
+  }
+  intptr_t promoted_in_words() const { return promoted_in_words_; }
 
   int64_t DurationMicros() const { return end_micros_ - start_micros_; }
 
+  // Words allocated directly in old space by pretenured allocation sites since
+  // the previous scavenge, i.e. copying work this scavenge did not have to do.
+  intptr_t pretenured_in_words() const { return pretenured_in_words_; }
+
+  // The number of scavenger tasks used. Zero means the scavenge ran serially
+  // on the main thread.
+  intptr_t num_tasks() const { return num_tasks_; }
+
  private:
   int64_t start_micros_;
   int64_t end_micros_;
@@ -114,6 +138,8 @@ class ScavengeStats {
   intptr_t promo_candidates_in_words_;
   intptr_t promoted_in_words_;
   intptr_t abandoned_in_words_;
+  intptr_t pretenured_in_words_;
+  intptr_t num_tasks_;
 };
 
 class Scavenger {
@@ -181,10 +207,48 @@ class Scavenger {
 
   int64_t gc_time_micros() const { return gc_time_micros_; }
 
+  // Words promoted by the most recent scavenge, or 0 before the first.
+  intptr_t LastPromotedInWords() const {
+    return stats_history_.Size() != 0
+               ? stats_history_.Get(0).promoted_in_words()
+               : 0;
+  }
+
+  // The most scavenges an object can be made to survive before promotion.
+  static constexpr intptr_t kMaxTenureAge = 4;
+
+  // The number of scavenges an object must survive before the next scavenge
+  // promotes it.
+  intptr_t tenure_age() const { return tenure_age_; }
+
+  // The tenure age given by the flags, or with --adaptive_tenure_age, the age
+  // following [tenure_age] when [promo_success] of the promotion candidates of
+  // recent scavenges survived.
+  static intptr_t NextTenureAge(intptr_t tenure_age, double promo_success);
+
+  // Words of new space that had survived [age] scavenges when the most recent
+  // scavenge began, and how many of those it found alive.
+  intptr_t LastWordsOfAge(intptr_t age) const {
+    ASSERT((0 <= age) && (age <= kMaxTenureAge));
+    return words_by_age_[age];
+  }
+  intptr_t LastSurvivedOfAge(intptr_t age) const {
+    ASSERT((0 <= age) && (age <= kMaxTenureAge));
+    return survived_by_age_[age];
+  }
+
+  void PrintAgesToTimeline(TimelineEventScope* event) const;
+
   void IncrementCollections() { collections_++; }
 
   intptr_t collections() const { return collections_; }
 
+  AllocationSiteTable* allocation_sites() { return &allocation_sites_; }
+
+  // Total words allocated directly in old space by pretenured allocation
+  // sites, as reported by all scavenges so far.
+  intptr_t pretenured_in_words() const { return pretenured_in_words_; }
+
 #ifndef PRODUCT
   void PrintToJSONObject(JSONObject* object) const;
 #endif  // !PRODUCT
@@ -264,7 +328,8 @@ class Scavenger {
   void TryAllocateNewTLAB(Thread* thread, intptr_t size, bool can_safepoint);
 
   SemiSpace* Prologue(GCReason reason);
-  intptr_t ParallelScavenge(SemiSpace* from);
+  intptr_t ChooseNumTasks(SpaceUsage usage_before) const;
+  intptr_t ParallelScavenge(SemiSpace* from, intptr_t num_tasks);
   intptr_t SerialScavenge(SemiSpace* from);
   void ReverseScavenge(SemiSpace** from);
   void IterateIsolateRoots(ObjectPointerVisitor* visitor);
@@ -275,7 +340,16 @@ class Scavenger {
   void IterateObjectIdTable(ObjectPointerVisitor* visitor);
   template <bool parallel>
   void IterateRoots(ScavengerVisitorBase<parallel>* visitor);
-  void MournWeakHandles();
+  void MournWeak(intptr_t num_tasks);
+  void IterateWeak(Thread* thread,
+                   intptr_t num_parts,
+                   UnreachableWeakHandles* unreachable);
+  void MournWeakHandles(Thread* thread,
+                        intptr_t part,
+                        intptr_t num_parts,
+                        UnreachableWeakHandles* unreachable);
+  void MournWeakTable(Thread* thread, intptr_t sel);
+  void MournForwardTables(Thread* thread);
   void Epilogue(SemiSpace* from);
 
   void VerifyStoreBuffers();
@@ -283,8 +357,6 @@ class Scavenger {
   void UpdateMaxHeapCapacity();
   void UpdateMaxHeapUsage();
 
-  void MournWeakTables();
-
   intptr_t NewSizeInWords(intptr_t old_size_in_words, GCReason reason) const;
 
   Heap* heap_;
@@ -298,7 +370,12 @@ class Scavenger {
   // Keep track whether a scavenge is currently running.
   bool scavenging_;
   bool early_tenure_ = false;
+  intptr_t tenure_age_;
+  intptr_t last_tenure_age_;
+  intptr_t words_by_age_[kMaxTenureAge + 1] = {};
+  intptr_t survived_by_age_[kMaxTenureAge + 1] = {};
   RelaxedAtomic<intptr_t> root_slices_started_;
+  RelaxedAtomic<intptr_t> weak_slices_started_;
   StoreBufferBlock* blocks_ = nullptr;
 
   int64_t gc_time_micros_;
@@ -306,6 +383,9 @@ class Scavenger {
   static const int kStatsHistoryCapacity = 4;
   RingBuffer<ScavengeStats, kStatsHistoryCapacity> stats_history_;
 
+  AllocationSiteTable allocation_sites_;
+  intptr_t pretenured_in_words_ = 0;
+
   intptr_t scavenge_words_per_micro_;
   intptr_t idle_scavenge_threshold_in_words_;
 
@@ -320,6 +400,7 @@ class Scavenger {
 
   template <bool>
   friend class ScavengerVisitorBase;
+  friend class ParallelMournWeakTask;
   friend class ScavengerWeakVisitor;
   friend class ScavengerFinalizerVisitor;
 
@@ -49,6 +49,18 @@ enum class GCReason {
   kDestroyed,    // Dart_NotifyDestroyed
   kDebugging,    // service request, etc.
   kCatchUp,      // End of ForceGrowthScope or Dart_PerformanceMode_Latency.
+  kLowMemory,    // Dart_NotifyLowMemory or cgroup memory pressure.
+};
+
+// The parts of a stop-the-world pause that are timed separately. A scavenge
+// counts copying the survivors as marking.
+enum class GCPhase {
+  kRoots,       // Visiting the roots outside the heap.
+  kMarking,     // Transitive closure from the roots.
+  kWeak,        // Weak handles, weak tables and finalizers.
+  kSweeping,    // Sweeping during the pause.
+  kCompaction,  // Sliding compaction or evacuation.
+  kNumPhases,
 };
 
 }  // namespace dart
@@ -12,9 +12,16 @@
 #include "vm/lockers.h"
 #include "vm/thread_pool.h"
 #include "vm/timeline.h"
+#include "vm/virtual_memory.h"
 
 namespace dart {
 
+DEFINE_FLAG(bool,
+            release_free_interiors,
+            true,
+            "Return the memory inside large free blocks of old space to the OS "
+            "during concurrent sweeping.");
+
 bool GCSweeper::SweepPage(Page* page, FreeList* freelist, bool locked) {
   ASSERT(!page->is_image_page());
 
@@ -58,6 +65,12 @@ bool GCSweeper::SweepPage(Page* page, FreeList* freelist, bool locked) {
           *reinterpret_cast<uword*>(cursor) = kBreakInstructionFiller;
           cursor += kWordSize;
         }
+      } else if ((current != start) || (free_end != end)) {
+        // Only unlocked sweeps release memory, as they run on the concurrent
+        // sweeper task, off the mutator's critical path. The block must be
+        // released before it is visible to the allocator, as writes made
+        // concurrently with the madvise could be lost.
+        ReleaseFreeInterior(page, current, obj_size, /*discard=*/!locked);
       } else {
 #if defined(DEBUG)
         memset(reinterpret_cast<void*>(current), Heap::kZapByte, obj_size);
@@ -75,10 +88,63 @@ bool GCSweeper::SweepPage(Page* page, FreeList* freelist, bool locked) {
     current += obj_size;
   }
   ASSERT(current == end);
+  page->set_live_bytes(used_in_bytes);
 
   return used_in_bytes != 0;  // In use.
 }
 
+void GCSweeper::ReleaseFreeInterior(Page* page,
+                                    uword start,
+                                    intptr_t size,
+                                    bool discard) {
+  const intptr_t page_size = VirtualMemory::PageSize();
+  const uword block_end = start + size;
+  uword release_start = block_end;
+  uword release_end = block_end;
+  if (FLAG_release_free_interiors && (size >= kMinReleaseSize)) {
+    release_start = Utils::RoundUp(
+        start + FreeListElement::HeaderSizeFor(size), page_size);
+    release_end = Utils::RoundDown(block_end, page_size);
+    if (release_end <= release_start) {
+      release_start = release_end = block_end;
+    }
+  }
+#if defined(DEBUG)
+  memset(reinterpret_cast<void*>(start), Heap::kZapByte,
+         release_start - start);
+  memset(reinterpret_cast<void*>(release_end), Heap::kZapByte,
+         block_end - release_end);
+#endif  // DEBUG
+
+  // Pages released by an earlier sweep are still released: nothing has been
+  // allocated in them since. Only the runs of other pages are discarded.
+  uword run_start = release_start;
+  for (uword addr = release_start; addr <= release_end; addr += page_size) {
+    if (addr < release_end) {
+      if (!page->IsReleased(addr)) {
+        continue;
+      }
+      released_in_bytes_ += page_size;
+    }
+    if (run_start < addr) {
+      void* run = reinterpret_cast<void*>(run_start);
+      const intptr_t run_size = addr - run_start;
+      if (discard && VirtualMemory::Discard(run, run_size)) {
+        for (uword released = run_start; released < addr;
+             released += page_size) {
+          page->SetReleased(released);
+        }
+        released_in_bytes_ += run_size;
+      } else {
+#if defined(DEBUG)
+        memset(run, Heap::kZapByte, run_size);
+#endif  // DEBUG
+      }
+    }
+    run_start = addr + page_size;
+  }
+}
+
 intptr_t GCSweeper::SweepLargePage(Page* page) {
   ASSERT(!page->is_image_page());
 
@@ -127,7 +193,10 @@ class ConcurrentSweeperTask : public ThreadPool::Task {
       ASSERT(thread->BypassSafepoints());  // Or we should be checking in.
       TIMELINE_FUNCTION_GC_DURATION(thread, "ConcurrentSweep");
 
-      old_space->SweepLarge();
+      // Scavenges wait for the pages of card-remembered arrays to be back on
+      // the large page list. The remaining large pages, often many typed data
+      // buffers, are swept along with the regular pages.
+      old_space->SweepLargeCards();
 
       {
         MonitorLocker ml(old_space->tasks_lock());
@@ -136,6 +205,7 @@ class ConcurrentSweeperTask : public ThreadPool::Task {
         ml.NotifyAll();
       }
 
+      old_space->SweepLarge();
       old_space->Sweep(/*exclusive*/ false);
     }
     // Exit isolate cleanly *before* notifying it, to avoid shutdown race.
@@ -5,10 +5,13 @@
 #ifndef RUNTIME_VM_HEAP_SWEEPER_H_
 #define RUNTIME_VM_HEAP_SWEEPER_H_
 
+#include "vm/flags.h"
 #include "vm/globals.h"
 
 namespace dart {
 
+DECLARE_FLAG(bool, release_free_interiors);
+
 // Forward declarations.
 class FreeList;
 class Heap;
@@ -34,8 +37,27 @@ class GCSweeper {
   // last marked object.
   intptr_t SweepLargePage(Page* page);
 
+  // Bytes inside the free blocks found by this sweeper that are returned to
+  // the OS, whether by this sweeper or by an earlier one.
+  intptr_t released_in_bytes() const { return released_in_bytes_; }
+
   // Sweep the large and regular sized data pages.
   static void SweepConcurrent(IsolateGroup* isolate_group);
+
+  // Free blocks at least this large have their interior released.
+  static constexpr intptr_t kMinReleaseSize = 64 * KB;
+
+ private:
+  // Releases the OS pages inside a free block of at least kMinReleaseSize,
+  // keeping the first, which holds the free list element's header. Pages
+  // released by an earlier sweep are skipped, and only discard enables new
+  // releases. In DEBUG mode, zaps the rest of the block.
+  void ReleaseFreeInterior(Page* page,
+                           uword start,
+                           intptr_t size,
+                           bool discard);
+
+  intptr_t released_in_bytes_ = 0;
 };
 
 }  // namespace dart
@@ -29,22 +29,69 @@ intptr_t WeakTable::SizeFor(intptr_t count, intptr_t size) {
   return result;
 }
 
-void WeakTable::SetValueExclusive(ObjectPtr key, intptr_t val) {
-  const intptr_t mask = size() - 1;
+intptr_t* WeakTable::AllocateData(intptr_t size) {
+  intptr_t* data =
+      reinterpret_cast<intptr_t*>(malloc(size * kEntrySize * kWordSize));
+  for (intptr_t i = 0; i < size; i++) {
+    data[index(i) + kObjectOffset] = kNoEntry;
+    data[index(i) + kValueOffset] = kNoValue;
+  }
+  return data;
+}
+
+intptr_t WeakTable::FindExclusive(ObjectPtr key) const {
+  intptr_t mask = size_ - 1;
   intptr_t idx = Hash(key) & mask;
-  intptr_t empty_idx = -1;
-  ObjectPtr obj = ObjectAtExclusive(idx);
-
-  while (obj != static_cast<ObjectPtr>(kNoEntry)) {
-    if (obj == key) {
-      SetValueAt(idx, val);
-      return;
-    } else if ((empty_idx < 0) &&
-               (static_cast<intptr_t>(obj) == kDeletedEntry)) {
-      empty_idx = idx;  // Insert at this location if not found.
+  intptr_t obj = data_[ObjectIndex(idx)];
+  while (obj != kNoEntry) {
+    if (obj == static_cast<intptr_t>(key)) {
+      return idx;
     }
     idx = (idx + 1) & mask;
-    obj = ObjectAtExclusive(idx);
+    obj = data_[ObjectIndex(idx)];
+  }
+  ASSERT(data_[ValueIndex(idx)] == kNoValue);
+
+  if (rehash_data_ != nullptr) {
+    // The entries moved to data_ are deleted here, so probing continues past
+    // them.
+    mask = rehash_size_ - 1;
+    idx = Hash(key) & mask;
+    obj = rehash_data_[index(idx) + kObjectOffset];
+    while (obj != kNoEntry) {
+      if (obj == static_cast<intptr_t>(key)) {
+        return size_ + idx;
+      }
+      idx = (idx + 1) & mask;
+      obj = rehash_data_[index(idx) + kObjectOffset];
+    }
+  }
+  return -1;
+}
+
+void WeakTable::InsertExclusive(ObjectPtr key, intptr_t val) {
+  ASSERT(val != kNoValue);
+  const intptr_t mask = size_ - 1;
+  intptr_t idx = Hash(key) & mask;
+  intptr_t obj = data_[ObjectIndex(idx)];
+  while ((obj != kNoEntry) && (obj != kDeletedEntry)) {
+    ASSERT(obj != static_cast<intptr_t>(key));  // Duplicate entry.
+    idx = (idx + 1) & mask;
+    obj = data_[ObjectIndex(idx)];
+  }
+  if (obj == kNoEntry) {
+    // Not reusing a deleted slot.
+    set_used(used() + 1);
+  }
+  data_[ObjectIndex(idx)] = static_cast<intptr_t>(key);
+  data_[ValueIndex(idx)] = val;
+}
+
+void WeakTable::SetValueExclusive(ObjectPtr key, intptr_t val) {
+  const intptr_t i = FindExclusive(key);
+  if (i >= 0) {
+    SetValueAt(i, val);
+    return;
   }
 
   if (val == 0) {
@@ -54,64 +101,85 @@ void WeakTable::SetValueExclusive(ObjectPtr key, intptr_t val) {
     return;
   }
 
-  if (empty_idx >= 0) {
-    // We will be reusing a slot below.
-    set_used(used() - 1);
-    idx = empty_idx;
+  InsertExclusive(key, val);
+  set_count(count() + 1);
+  MaybeRehash();
+}
+
+bool WeakTable::MarkValueExclusive(ObjectPtr key, intptr_t val) {
+  if (FindExclusive(key) >= 0) {
+    return false;
   }
 
-  ASSERT(!IsValidEntryAtExclusive(idx));
-  // Set the key and value.
-  SetObjectAt(idx, key);
-  SetValueAt(idx, val);
-  // Update the counts.
-  set_used(used() + 1);
+  ASSERT(val != 0);
+  InsertExclusive(key, val);
   set_count(count() + 1);
+  MaybeRehash();
+  return true;
+}
 
-  // Rehash if needed to ensure that there are empty slots available.
+void WeakTable::MaybeRehash() {
+  if (rehash_data_ != nullptr) {
+    RehashSome(kRehashEntriesPerInsert);
+  }
+  // Ensure that there are empty slots available, counting the entries that
+  // have not moved yet as used.
+  if ((used_ + rehash_count_) < limit()) {
+    return;
+  }
+  FinishRehashExclusive();
   if (used_ >= limit()) {
-    Rehash();
+    StartRehash();
   }
 }
 
-bool WeakTable::MarkValueExclusive(ObjectPtr key, intptr_t val) {
-  const intptr_t mask = size() - 1;
-  intptr_t idx = Hash(key) & mask;
-  intptr_t empty_idx = -1;
-  ObjectPtr obj = ObjectAtExclusive(idx);
-
-  while (obj != static_cast<ObjectPtr>(kNoEntry)) {
-    if (obj == key) {
-      return false;
-    } else if ((empty_idx < 0) &&
-               (static_cast<intptr_t>(obj) == kDeletedEntry)) {
-      empty_idx = idx;  // Insert at this location if not found.
-    }
-    idx = (idx + 1) & mask;
-    obj = ObjectAtExclusive(idx);
-  }
+void WeakTable::StartRehash() {
+  ASSERT(rehash_data_ == nullptr);
+  const intptr_t new_size = SizeFor(count(), size());
+  ASSERT(Utils::IsPowerOfTwo(new_size));
 
-  ASSERT(val != 0);
+  rehash_data_ = data_;
+  rehash_size_ = size_;
+  rehash_index_ = 0;
+  rehash_count_ = count_;
 
-  if (empty_idx >= 0) {
-    // We will be reusing a slot below.
-    set_used(used() - 1);
-    idx = empty_idx;
-  }
+  data_ = AllocateData(new_size);
+  size_ = new_size;
+  used_ = 0;
+  ASSERT(count() < limit());
+}
 
-  ASSERT(!IsValidEntryAtExclusive(idx));
-  // Set the key and value.
-  SetObjectAt(idx, key);
-  SetValueAt(idx, val);
-  // Update the counts.
-  set_used(used() + 1);
-  set_count(count() + 1);
+void WeakTable::RehashSome(intptr_t num_entries) {
+  ASSERT(rehash_data_ != nullptr);
+  const intptr_t end =
+      Utils::Minimum(rehash_index_ + num_entries, rehash_size_);
+  for (intptr_t i = rehash_index_; i < end; i++) {
+    intptr_t* entry = &rehash_data_[index(i)];
+    if (entry[kValueOffset] != kNoValue) {
+      InsertExclusive(static_cast<ObjectPtr>(entry[kObjectOffset]),
+                      entry[kValueOffset]);
+      entry[kObjectOffset] = kDeletedEntry;
+      entry[kValueOffset] = kNoValue;
+      rehash_count_--;
+    }
+  }
+  rehash_index_ = end;
+
+  if (rehash_index_ == rehash_size_) {
+    free(rehash_data_);
+    rehash_data_ = nullptr;
+    rehash_size_ = 0;
+    rehash_index_ = 0;
+    rehash_count_ = 0;
+    // All valid entries are in data_ now.
+    ASSERT(count() <= used());
+  }
+}
 
-  // Rehash if needed to ensure that there are empty slots available.
-  if (used_ >= limit()) {
-    Rehash();
+void WeakTable::FinishRehashExclusive() {
+  if (rehash_data_ != nullptr) {
+    RehashSome(rehash_size_);
   }
-  return true;
 }
 
 void WeakTable::Reset() {
@@ -120,17 +188,20 @@ void WeakTable::Reset() {
   count_ = 0;
   size_ = kMinSize;
   free(old_data);
-  data_ = reinterpret_cast<intptr_t*>(malloc(size_ * kEntrySize * kWordSize));
-  for (intptr_t i = 0; i < size_; i++) {
-    data_[ObjectIndex(i)] = kNoEntry;
-    data_[ValueIndex(i)] = kNoValue;
-  }
+  data_ = AllocateData(size_);
+
+  free(rehash_data_);
+  rehash_data_ = nullptr;
+  rehash_size_ = 0;
+  rehash_index_ = 0;
+  rehash_count_ = 0;
 }
 
 void WeakTable::Forward(ObjectPointerVisitor* visitor) {
-  if (used_ == 0) return;
+  if ((used_ == 0) && (rehash_data_ == nullptr)) return;
 
-  for (intptr_t i = 0; i < size_; i++) {
+  const intptr_t num = num_slots();
+  for (intptr_t i = 0; i < num; i++) {
     if (IsValidEntryAtExclusive(i)) {
       visitor->VisitPointer(ObjectPointerAt(i));
     }
@@ -140,17 +211,14 @@ void WeakTable::Forward(ObjectPointerVisitor* visitor) {
 }
 
 void WeakTable::Rehash() {
+  FinishRehashExclusive();
+
   intptr_t old_size = size();
   intptr_t* old_data = data_;
 
   intptr_t new_size = SizeFor(count(), size());
   ASSERT(Utils::IsPowerOfTwo(new_size));
-  intptr_t* new_data =
-      reinterpret_cast<intptr_t*>(malloc(new_size * kEntrySize * kWordSize));
-  for (intptr_t i = 0; i < new_size; i++) {
-    new_data[ObjectIndex(i)] = kNoEntry;
-    new_data[ValueIndex(i)] = kNoValue;
-  }
+  intptr_t* new_data = AllocateData(new_size);
 
   intptr_t mask = new_size - 1;
   set_used(0);
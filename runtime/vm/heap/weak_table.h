@@ -33,14 +33,13 @@ class WeakTable {
     }
     size_ = size;
     ASSERT(Utils::IsPowerOfTwo(size_));
-    data_ = reinterpret_cast<intptr_t*>(malloc(size_ * kEntrySize * kWordSize));
-    for (intptr_t i = 0; i < size_; i++) {
-      data_[ObjectIndex(i)] = kNoEntry;
-      data_[ValueIndex(i)] = kNoValue;
-    }
+    data_ = AllocateData(size_);
   }
 
-  ~WeakTable() { free(data_); }
+  ~WeakTable() {
+    free(data_);
+    free(rehash_data_);
+  }
 
   static WeakTable* NewFrom(WeakTable* original) {
     return new WeakTable(SizeFor(original->count(), original->size()));
@@ -50,6 +49,13 @@ class WeakTable {
   intptr_t used() const { return used_; }
   intptr_t count() const { return count_; }
 
+  // The number of entries visited by the exclusive iterators below. While the
+  // table is being resized, the entries of the previous backing store that
+  // have not moved yet follow the size() entries of the current one.
+  intptr_t num_slots() const { return size_ + rehash_size_; }
+
+  bool is_rehashing() const { return rehash_data_ != nullptr; }
+
   // The following methods can be called concurrently and are guarded by a lock.
 
   intptr_t GetValue(ObjectPtr key) {
@@ -78,12 +84,13 @@ class WeakTable {
   // This is mostly limited to GC related code (e.g. scavenger, marker, ...)
 
   bool IsValidEntryAtExclusive(intptr_t i) const {
-    ASSERT((ValueAtExclusive(i) == 0 &&
-            (data_[ObjectIndex(i)] == kNoEntry ||
-             data_[ObjectIndex(i)] == kDeletedEntry)) ||
-           (ValueAtExclusive(i) != 0 && data_[ObjectIndex(i)] != kNoEntry &&
-            data_[ObjectIndex(i)] != kDeletedEntry));
-    return (data_[ValueIndex(i)] != 0);
+    const intptr_t* entry = EntryAt(i);
+    ASSERT((entry[kValueOffset] == 0 &&
+            (entry[kObjectOffset] == kNoEntry ||
+             entry[kObjectOffset] == kDeletedEntry)) ||
+           (entry[kValueOffset] != 0 && entry[kObjectOffset] != kNoEntry &&
+            entry[kObjectOffset] != kDeletedEntry));
+    return (entry[kValueOffset] != 0);
   }
 
   void InvalidateAtExclusive(intptr_t i) {
@@ -91,55 +98,54 @@ class WeakTable {
     SetValueAt(i, 0);
   }
 
+  // Like InvalidateAtExclusive, but leaves the count of valid entries alone so
+  // that GC tasks can invalidate disjoint ranges of the table at the same
+  // time. Each task then reports how many entries it invalidated with
+  // RecordInvalidated.
+  void InvalidateAtUncounted(intptr_t i) {
+    ASSERT(IsValidEntryAtExclusive(i));
+    intptr_t* entry = EntryAt(i);
+    entry[kObjectOffset] = kDeletedEntry;
+    entry[kValueOffset] = 0;
+  }
+
+  void RecordInvalidated(intptr_t num_invalidated) {
+    MutexLocker ml(&mutex_);
+    set_count(count() - num_invalidated);
+  }
+
   ObjectPtr ObjectAtExclusive(intptr_t i) const {
-    ASSERT(i >= 0);
-    ASSERT(i < size());
-    return static_cast<ObjectPtr>(data_[ObjectIndex(i)]);
+    return static_cast<ObjectPtr>(EntryAt(i)[kObjectOffset]);
   }
 
   intptr_t ValueAtExclusive(intptr_t i) const {
-    ASSERT(i >= 0);
-    ASSERT(i < size());
-    return data_[ValueIndex(i)];
+    return EntryAt(i)[kValueOffset];
   }
 
   void SetValueExclusive(ObjectPtr key, intptr_t val);
   bool MarkValueExclusive(ObjectPtr key, intptr_t val);
 
   intptr_t GetValueExclusive(ObjectPtr key) const {
-    intptr_t mask = size() - 1;
-    intptr_t idx = Hash(key) & mask;
-    ObjectPtr obj = ObjectAtExclusive(idx);
-    while (obj != static_cast<ObjectPtr>(kNoEntry)) {
-      if (obj == key) {
-        return ValueAtExclusive(idx);
-      }
-      idx = (idx + 1) & mask;
-      obj = ObjectAtExclusive(idx);
-    }
-    ASSERT(ValueAtExclusive(idx) == 0);
-    return kNoValue;
+    const intptr_t i = FindExclusive(key);
+    return i < 0 ? kNoValue : ValueAtExclusive(i);
   }
 
   // Removes and returns the value associated with |key|. Returns 0 if there is
   // no value associated with |key|.
   intptr_t RemoveValueExclusive(ObjectPtr key) {
-    intptr_t mask = size() - 1;
-    intptr_t idx = Hash(key) & mask;
-    ObjectPtr obj = ObjectAtExclusive(idx);
-    while (obj != static_cast<ObjectPtr>(kNoEntry)) {
-      if (obj == key) {
-        intptr_t result = ValueAtExclusive(idx);
-        InvalidateAtExclusive(idx);
-        return result;
-      }
-      idx = (idx + 1) & mask;
-      obj = ObjectAtExclusive(idx);
+    const intptr_t i = FindExclusive(key);
+    if (i < 0) {
+      return kNoValue;
     }
-    ASSERT(ValueAtExclusive(idx) == 0);
-    return kNoValue;
+    const intptr_t result = ValueAtExclusive(i);
+    InvalidateAtExclusive(i);
+    return result;
   }
 
+  // Moves the entries of the previous backing store to the current one at
+  // once, if the table is being resized.
+  void FinishRehashExclusive();
+
   void Forward(ObjectPointerVisitor* visitor);
 
   void Reset();
@@ -155,6 +161,13 @@ class WeakTable {
   static const intptr_t kDeletedEntry = 3;  // Not a valid OOP.
   static const intptr_t kMinSize = 8;
 
+  // The number of entries of the previous backing store moved by each insert
+  // while the table is being resized. A resize starts with the current
+  // backing store at most 3/8 full when growing and 1/2 full when shrinking,
+  // which leaves room for at least size/4 inserts before it reaches the
+  // limit, while the previous backing store has at most 2 * size entries.
+  static const intptr_t kRehashEntriesPerInsert = 16;
+
   static intptr_t SizeFor(intptr_t count, intptr_t size);
   static intptr_t LimitFor(intptr_t size) {
     // Maintain a maximum of 75% fill rate.
@@ -162,7 +175,9 @@ class WeakTable {
   }
   intptr_t limit() const { return LimitFor(size()); }
 
-  intptr_t index(intptr_t i) const { return i * kEntrySize; }
+  static intptr_t index(intptr_t i) { return i * kEntrySize; }
+
+  static intptr_t* AllocateData(intptr_t size);
 
   void set_used(intptr_t val) {
     ASSERT(val <= limit());
@@ -171,7 +186,7 @@ class WeakTable {
 
   void set_count(intptr_t val) {
     ASSERT(val <= limit());
-    ASSERT(val <= used());
+    ASSERT(val <= used() + rehash_count_);
     count_ = val;
   }
 
@@ -179,29 +194,53 @@ class WeakTable {
 
   intptr_t ValueIndex(intptr_t i) const { return index(i) + kValueOffset; }
 
-  ObjectPtr* ObjectPointerAt(intptr_t i) const {
+  // Entries [0, size_) are in data_ and entries [size_, num_slots()) are in
+  // rehash_data_.
+  intptr_t* EntryAt(intptr_t i) const {
     ASSERT(i >= 0);
-    ASSERT(i < size());
-    return reinterpret_cast<ObjectPtr*>(&data_[ObjectIndex(i)]);
+    ASSERT(i < num_slots());
+    if (i < size_) {
+      return &data_[index(i)];
+    }
+    return &rehash_data_[index(i - size_)];
+  }
+
+  ObjectPtr* ObjectPointerAt(intptr_t i) const {
+    return reinterpret_cast<ObjectPtr*>(&EntryAt(i)[kObjectOffset]);
   }
 
   void SetObjectAt(intptr_t i, ObjectPtr key) {
-    ASSERT(i >= 0);
-    ASSERT(i < size());
-    data_[ObjectIndex(i)] = static_cast<intptr_t>(key);
+    EntryAt(i)[kObjectOffset] = static_cast<intptr_t>(key);
   }
 
   void SetValueAt(intptr_t i, intptr_t val) {
-    ASSERT(i >= 0);
-    ASSERT(i < size());
+    intptr_t* entry = EntryAt(i);
     // Setting a value of 0 is equivalent to invalidating the entry.
     if (val == 0) {
-      data_[ObjectIndex(i)] = kDeletedEntry;
+      entry[kObjectOffset] = kDeletedEntry;
+      if (i >= size_) {
+        rehash_count_--;
+      }
       set_count(count() - 1);
     }
-    data_[ValueIndex(i)] = val;
+    entry[kValueOffset] = val;
   }
 
+  // Returns the entry of |key|, or -1.
+  intptr_t FindExclusive(ObjectPtr key) const;
+
+  // Inserts |key|, which is in neither backing store, into data_.
+  void InsertExclusive(ObjectPtr key, intptr_t val);
+
+  // Resizes the table once it reaches its fill limit.
+  void MaybeRehash();
+
+  // Starts moving the entries to a new backing store of the size for the
+  // current count. They move a few at a time with each insert.
+  void StartRehash();
+  void RehashSome(intptr_t num_entries);
+
+  // Moves all entries to a new backing store at once.
   void Rehash();
 
   static uword Hash(ObjectPtr key) {
@@ -213,12 +252,23 @@ class WeakTable {
   // data_ contains size_ tuples of key/value.
   intptr_t* data_;
   // size_ keeps the number of entries in data_. used_ maintains the number of
-  // non-NULL entries and will trigger rehashing if needed. count_ stores the
-  // number valid entries, and will determine the size_ after rehashing.
+  // non-NULL entries in data_ and will trigger rehashing if needed. count_
+  // stores the number valid entries in both backing stores, and will
+  // determine the size_ after rehashing.
   intptr_t size_;
   intptr_t used_;
   intptr_t count_;
 
+  // While the table is being resized, rehash_data_ contains the rehash_size_
+  // tuples of the previous backing store, of which those from rehash_index_
+  // on have not been moved to data_ yet. A key is in only one of them.
+  // rehash_count_ is an upper bound on the valid entries left in
+  // rehash_data_: the GC may invalidate some without updating it.
+  intptr_t* rehash_data_ = nullptr;
+  intptr_t rehash_size_ = 0;
+  intptr_t rehash_index_ = 0;
+  intptr_t rehash_count_ = 0;
+
   DISALLOW_COPY_AND_ASSIGN(WeakTable);
 };
 
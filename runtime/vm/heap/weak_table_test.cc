@@ -59,4 +59,53 @@ ISOLATE_UNIT_TEST_CASE(WeakTables) {
   EXPECT_EQ(kNoValue, heap->GetObjectId(imm_obj.ptr()));
 }
 
+static ObjectPtr FakeKey(intptr_t i) {
+  return static_cast<ObjectPtr>(kHeapObjectTag + i * kObjectAlignment);
+}
+
+static intptr_t CountValidEntries(WeakTable* table) {
+  intptr_t count = 0;
+  for (intptr_t i = 0; i < table->num_slots(); i++) {
+    if (table->IsValidEntryAtExclusive(i)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+VM_UNIT_TEST_CASE(WeakTable_IncrementalRehash) {
+  WeakTable table;
+  const intptr_t kNumKeys = 10000;
+  bool saw_rehashing = false;
+  for (intptr_t i = 0; i < kNumKeys; i++) {
+    table.SetValueExclusive(FakeKey(i), i + 1);
+    saw_rehashing = saw_rehashing || table.is_rehashing();
+    // Keys are found whichever backing store holds them.
+    EXPECT_EQ(i + 1, table.GetValueExclusive(FakeKey(i)));
+    EXPECT_EQ(i / 2 + 1, table.GetValueExclusive(FakeKey(i / 2)));
+  }
+  EXPECT(saw_rehashing);
+  EXPECT_EQ(kNumKeys, table.count());
+  EXPECT_EQ(kNumKeys, CountValidEntries(&table));
+
+  // Updates and removals reach the keys that have not moved yet.
+  for (intptr_t i = 0; i < kNumKeys; i += 2) {
+    EXPECT_EQ(i + 1, table.RemoveValueExclusive(FakeKey(i)));
+  }
+  for (intptr_t i = 1; i < kNumKeys; i += 2) {
+    table.SetValueExclusive(FakeKey(i), i + 2);
+  }
+  EXPECT_EQ(kNumKeys / 2, table.count());
+  EXPECT_EQ(kNumKeys / 2, CountValidEntries(&table));
+
+  table.FinishRehashExclusive();
+  EXPECT(!table.is_rehashing());
+  EXPECT_EQ(table.size(), table.num_slots());
+  for (intptr_t i = 0; i < kNumKeys; i++) {
+    const intptr_t expected = (i % 2) == 0 ? WeakTable::kNoValue : i + 2;
+    EXPECT_EQ(expected, table.GetValueExclusive(FakeKey(i)));
+  }
+  EXPECT_EQ(kNumKeys / 2, CountValidEntries(&table));
+}
+
 }  // namespace dart
@@ -649,6 +649,7 @@ void IsolateGroup::UnscheduleThreadLocked(MonitorLocker* ml,
                                           bool is_mutator,
                                           bool bypass_safepoint) {
   thread->heap()->new_space()->AbandonRemainingTLAB(thread);
+  thread->heap()->old_space()->AbandonTLAB(thread);
 
   // Clear since GC will not visit the thread once it is unscheduled. Do this
   // under the thread lock to prevent races with the GC visiting thread roots.
@@ -2615,6 +2616,10 @@ void Isolate::LowLevelCleanup(Isolate* isolate) {
       FinalizeWeakPersistentHandlesVisitor visitor(isolate_group);
       isolate_group->api_state()->VisitWeakHandlesUnlocked(&visitor);
 
+      // Run the finalizers deferred by collections while the embedder data
+      // they receive is still valid.
+      isolate_group->heap()->finalizer_batches()->Drain();
+
       Thread::ExitIsolateGroupAsHelper(/*bypass_safepoint=*/false);
     }
 
@@ -2943,6 +2948,12 @@ void IsolateGroup::VisitWeakPersistentHandles(HandleVisitor* visitor) {
   api_state()->VisitWeakHandlesUnlocked(visitor);
 }
 
+void IsolateGroup::VisitWeakPersistentHandles(HandleVisitor* visitor,
+                                              intptr_t slice,
+                                              intptr_t num_slices) {
+  api_state()->VisitWeakHandlesUnlocked(visitor, slice, num_slices);
+}
+
 void IsolateGroup::DeferredMarkLiveTemporaries() {
   ForEachIsolate(
       [&](Isolate* isolate) { isolate->DeferredMarkLiveTemporaries(); },
@@ -752,6 +752,11 @@ class IsolateGroup : public IntrusiveDListEntry<IsolateGroup> {
                           ValidationPolicy validate_frames);
   void VisitObjectIdRingPointers(ObjectPointerVisitor* visitor);
   void VisitWeakPersistentHandles(HandleVisitor* visitor);
+  // Visits one of [num_slices] disjoint subsets of the weak persistent
+  // handles, so that the handles can be divided between GC tasks.
+  void VisitWeakPersistentHandles(HandleVisitor* visitor,
+                                  intptr_t slice,
+                                  intptr_t num_slices);
 
   // In precompilation we finalize all regular classes before compiling.
   bool all_classes_finalized() const {
@@ -2850,6 +2850,8 @@ ObjectPtr Object::Allocate(intptr_t cls_id,
     // If type_name is still null, then we haven't finished initializing yet and
     // should drop the sample.
     if (type_name != nullptr) {
+      heap->heap_profile()->RecordSample(thread, raw_obj, size,
+                                         heap_sampler.last_sample_size());
       thread->IncrementNoCallbackScopeDepth();
       Object& obj = Object::Handle(raw_obj);
       auto weak_obj = FinalizablePersistentHandle::New(
@@ -3795,6 +3797,7 @@ FunctionPtr Class::GetInvocationDispatcher(const String& target_name,
   }
 
   // If we failed to find it and possibly need to create it, use a write lock.
+  NOT_IN_PRECOMPILED(CompilerState::WillChangeProgram(thread));
   SafepointWriteRwLocker ml(thread, thread->isolate_group()->program_lock());
 
   // Try to find it again & return if it was added in the meantime.
@@ -3951,6 +3954,7 @@ FunctionPtr Function::GetMethodExtractor(const String& getter_name) const {
   Function& result = Function::Handle(
       Resolver::ResolveDynamicFunction(thread->zone(), owner, getter_name));
   if (result.IsNull()) {
+    NOT_IN_PRECOMPILED(CompilerState::WillChangeProgram(thread));
     SafepointWriteRwLocker ml(thread, group->program_lock());
     result = owner.LookupDynamicFunctionUnsafe(getter_name);
     if (result.IsNull()) {
@@ -4007,6 +4011,7 @@ FunctionPtr Class::GetRecordFieldGetter(const String& getter_name) const {
   ASSERT(IsRecordClass());
   ASSERT(Field::IsGetterName(getter_name));
   Thread* thread = Thread::Current();
+  NOT_IN_PRECOMPILED(CompilerState::WillChangeProgram(thread));
   SafepointWriteRwLocker ml(thread, thread->isolate_group()->program_lock());
   Function& result = Function::Handle(thread->zone(),
                                       LookupDynamicFunctionUnsafe(getter_name));
@@ -4190,6 +4195,7 @@ FunctionPtr Function::GetDynamicInvocationForwarder(
   }
 
   // If we failed to find it and possibly need to create it, use a write lock.
+  NOT_IN_PRECOMPILED(CompilerState::WillChangeProgram(thread));
   SafepointWriteRwLocker ml(thread, thread->isolate_group()->program_lock());
 
   // Try to find it again & return if it was added in the mean time.
@@ -9907,6 +9913,7 @@ FunctionPtr Function::ImplicitClosureFunction() const {
 #else
   ASSERT(!IsClosureFunction());
   Thread* thread = Thread::Current();
+  CompilerState::WillChangeProgram(thread);
   SafepointWriteRwLocker ml(thread, thread->isolate_group()->program_lock());
 
   if (implicit_closure_function() != Function::null()) {
@@ -10175,6 +10182,7 @@ ClosurePtr Function::ImplicitStaticClosure() const {
   }
 
   auto thread = Thread::Current();
+  NOT_IN_PRECOMPILED(CompilerState::WillChangeProgram(thread));
   SafepointWriteRwLocker ml(thread, thread->isolate_group()->program_lock());
 
   if (implicit_static_closure() != Closure::null()) {
@@ -25464,6 +25472,31 @@ ArrayPtr Array::Grow(const Array& source,
   return result.ptr();
 }
 
+bool Array::TryGrowInPlace(intptr_t new_length) const {
+  ASSERT(!IsNull());
+  ASSERT(new_length > Length());
+  if (IsImmutable() || (new_length > kMaxElements)) {
+    return false;
+  }
+  Thread* thread = Thread::Current();
+  // The heap is not iterable between growing the page and updating the
+  // length.
+  NoSafepointScope no_safepoint(thread);
+  const intptr_t old_length = Length();
+  if (!thread->heap()->old_space()->TryGrowLargeObject(
+          ptr(), InstanceSize(new_length))) {
+    return false;
+  }
+  for (intptr_t i = old_length; i < new_length; i++) {
+    untag()->set_element(i, Object::null(), thread);
+  }
+  // Large arrays have no size in their header, so the length alone determines
+  // the size. A concurrent marker that reads the new length before seeing the
+  // nulls finds zeros, which it treats as Smis.
+  SetLengthRelease(new_length);
+  return true;
+}
+
 void Array::Truncate(intptr_t new_len) const {
   if (IsNull()) {
     return;
@@ -28569,6 +28602,7 @@ RecordShape RecordShape::Register(Thread* thread,
     }
   }
 
+  NOT_IN_PRECOMPILED(CompilerState::WillChangeProgram(thread));
   SafepointWriteRwLocker ml(thread, isolate_group->program_lock());
   RecordFieldNamesMap map(object_store->record_field_names_map());
   const intptr_t new_index = map.NumOccupied();
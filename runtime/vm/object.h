@@ -10755,6 +10755,12 @@ class Array : public Instance {
                        intptr_t new_length,
                        Heap::Space space = Heap::kNew);
 
+  // Grows the array to 'new_length' without moving it, filling the new
+  // elements with null, when it is alone on a large page that can be extended.
+  // Returns false, leaving the array unchanged, otherwise. 'new_length' must
+  // be greater than 'Length()'.
+  bool TryGrowInPlace(intptr_t new_length) const;
+
   // Truncates the array to a given length. 'new_length' must be less than
   // or equal to 'source.Length()'. The remaining unused part of the array is
   // marked as an Array object or a regular Object so that it can be traversed
@@ -4,9 +4,12 @@
 
 #include "vm/object_graph.h"
 
+#include "platform/atomic.h"
 #include "vm/dart.h"
 #include "vm/dart_api_state.h"
 #include "vm/growable_array.h"
+#include "vm/heap/gc_shared.h"
+#include "vm/heap/pages.h"
 #include "vm/isolate.h"
 #include "vm/native_symbol.h"
 #include "vm/object.h"
@@ -15,12 +18,30 @@
 #include "vm/raw_object.h"
 #include "vm/raw_object_fields.h"
 #include "vm/reusable_handles.h"
+#include "vm/thread_barrier.h"
+#include "vm/thread_pool.h"
+#include "vm/timeline.h"
 #include "vm/visitor.h"
 
+#if defined(DART_ENABLE_HEAP_SNAPSHOT_WRITER)
+#include "zlib/zlib.h"
+#endif
+
 namespace dart {
 
 #if defined(DART_ENABLE_HEAP_SNAPSHOT_WRITER)
 
+DEFINE_FLAG(int,
+            heap_snapshot_tasks,
+            2,
+            "The number of tasks counting and writing the objects on old-space "
+            "pages when writing a heap snapshot.");
+DEFINE_FLAG(int,
+            heap_snapshot_gzip_level,
+            0,
+            "Compress heap snapshots written to files with gzip at this level "
+            "(1-9). 0 writes them uncompressed.");
+
 static bool IsUserClass(intptr_t cid) {
   if (cid == kContextCid) return true;
   if (cid == kTypeArgumentsCid) return false;
@@ -741,6 +762,13 @@ class CountingBlock {
     count_bitvector_ |= static_cast<uword>(1) << bitvector_shift;
   }
 
+  // Adds [delta] to the ids of the objects in the block.
+  void Rebase(intptr_t delta) {
+    if (base_count_ != 0) {
+      base_count_ += delta;
+    }
+  }
+
  private:
   intptr_t base_count_;
   uword count_bitvector_;
@@ -761,6 +789,11 @@ class CountingPage {
   void Record(uword addr, intptr_t id) {
     return BlockFor(addr)->Record(addr, id);
   }
+  void Rebase(intptr_t delta) {
+    for (intptr_t i = 0; i < kBlocksPerPage; i++) {
+      blocks_[i].Rebase(delta);
+    }
+  }
 
   CountingBlock* BlockFor(uword addr) {
     intptr_t page_offset = addr & ~kPageMask;
@@ -777,19 +810,24 @@ class CountingPage {
   DISALLOW_IMPLICIT_CONSTRUCTORS(CountingPage);
 };
 
-void HeapSnapshotWriter::EnsureAvailable(intptr_t needed) {
-  intptr_t available = capacity_ - size_;
-  if (available >= needed) {
-    return;
+HeapSnapshotWriter::~HeapSnapshotWriter() {
+  if (deflater_ != nullptr) {
+    deflateEnd(deflater_);
+    delete deflater_;
   }
+  free(compressed_);
+}
 
+void HeapSnapshotWriter::Grow(intptr_t needed) {
   if (buffer_ != nullptr) {
     Flush();
   }
   ASSERT(buffer_ == nullptr);
 
   intptr_t chunk_size = kPreferredChunkSize;
-  const intptr_t reserved_prefix = writer_->ReserveChunkPrefixSize();
+  // Compressed chunks are given the prefix when they are passed on.
+  const intptr_t reserved_prefix =
+      (deflater_ != nullptr) ? 0 : writer_->ReserveChunkPrefixSize();
   if (chunk_size < (reserved_prefix + needed)) {
     chunk_size = reserved_prefix + needed;
   }
@@ -803,13 +841,53 @@ void HeapSnapshotWriter::Flush(bool last) {
     return;
   }
 
-  writer_->WriteChunk(buffer_, size_, last);
+  if (deflater_ != nullptr) {
+    snapshot_size_ += size_;
+    Deflate(last);
+    free(buffer_);
+  } else {
+    const intptr_t reserved_prefix =
+        (buffer_ != nullptr) ? writer_->ReserveChunkPrefixSize() : 0;
+    snapshot_size_ += size_ - reserved_prefix;
+    output_size_ += size_ - reserved_prefix;
+    writer_->WriteChunk(buffer_, size_, last);
+  }
 
   buffer_ = nullptr;
   size_ = 0;
   capacity_ = 0;
 }
 
+void HeapSnapshotWriter::Deflate(bool last) {
+  const intptr_t reserved_prefix = writer_->ReserveChunkPrefixSize();
+  deflater_->next_in = buffer_;
+  deflater_->avail_in = size_;
+  int result;
+  do {
+    if (compressed_ == nullptr) {
+      compressed_ = reinterpret_cast<uint8_t*>(malloc(kPreferredChunkSize));
+      compressed_size_ = reserved_prefix;
+    }
+    deflater_->next_out = compressed_ + compressed_size_;
+    deflater_->avail_out = kPreferredChunkSize - compressed_size_;
+    result = deflate(deflater_, last ? Z_FINISH : Z_NO_FLUSH);
+    ASSERT((result == Z_OK) || (result == Z_STREAM_END));
+    compressed_size_ = kPreferredChunkSize - deflater_->avail_out;
+    if ((deflater_->avail_out == 0) && (result != Z_STREAM_END)) {
+      output_size_ += compressed_size_ - reserved_prefix;
+      writer_->WriteChunk(compressed_, compressed_size_, /*last=*/false);
+      compressed_ = nullptr;
+    }
+  } while (last ? (result != Z_STREAM_END) : (deflater_->avail_in > 0));
+
+  if (last) {
+    output_size_ += compressed_size_ - reserved_prefix;
+    writer_->WriteChunk(compressed_, compressed_size_, /*last=*/true);
+    compressed_ = nullptr;
+    compressed_size_ = 0;
+  }
+}
+
 void HeapSnapshotWriter::SetupCountingPages() {
   for (intptr_t i = 0; i < kMaxImagePages; i++) {
     image_page_ranges_[i].base = 0;
@@ -836,13 +914,18 @@ void HeapSnapshotWriter::SetupCountingPages() {
     next_offset++;
   }
 
-  Page* page = isolate_group()->heap()->old_space()->pages_;
+  PageSpace* old_space = isolate_group()->heap()->old_space();
+  MutexLocker ml(&old_space->pages_lock_);
+  old_space->MakeIterable();
+  data_pages_.Clear();
+  Page* page = old_space->pages_;
   while (page != NULL) {
     page->forwarding_page();
     CountingPage* counting_page =
         reinterpret_cast<CountingPage*>(page->forwarding_page());
     ASSERT(counting_page != NULL);
     counting_page->Clear();
+    data_pages_.Add(page);
     page = page->next();
   }
 }
@@ -939,10 +1022,27 @@ class Pass1Visitor : public ObjectVisitor,
         writer_(writer),
         object_slots_(object_slots) {}
 
+  // Makes the visitor record the ids of the objects on a regular page in
+  // [counting_page], counting from 1, rather than assigning them through the
+  // writer, and collect the Smis it finds in [smis]. This lets tasks visit
+  // pages concurrently; the ids are rebased and the Smis added in page order
+  // afterwards.
+  void SetPage(CountingPage* counting_page, MallocGrowableArray<SmiPtr>* smis) {
+    counting_page_ = counting_page;
+    smis_ = smis;
+  }
+
+  intptr_t object_count() const { return object_count_; }
+  intptr_t reference_count() const { return reference_count_; }
+
   void VisitObject(ObjectPtr obj) {
     if (obj->IsPseudoObject()) return;
 
-    writer_->AssignObjectId(obj);
+    if (counting_page_ != nullptr) {
+      counting_page_->Record(UntaggedObject::ToAddr(obj), ++object_count_);
+    } else {
+      writer_->AssignObjectId(obj);
+    }
     const auto cid = obj->GetClassId();
 
     if (object_slots_->ContainsOnlyTaggedPointers(cid)) {
@@ -954,7 +1054,7 @@ class Pass1Visitor : public ObjectVisitor,
               UntaggedObject::ToAddr(obj->untag()) + slot.offset);
           VisitCompressedPointers(obj->heap_base(), target, target);
         } else {
-          writer_->CountReferences(1);
+          reference_count_++;
         }
       }
     }
@@ -964,9 +1064,9 @@ class Pass1Visitor : public ObjectVisitor,
     for (ObjectPtr* ptr = from; ptr <= to; ptr++) {
       ObjectPtr obj = *ptr;
       if (!obj->IsHeapObject()) {
-        writer_->AddSmi(static_cast<SmiPtr>(obj));
+        AddSmi(static_cast<SmiPtr>(obj));
       }
-      writer_->CountReferences(1);
+      reference_count_++;
     }
   }
 
@@ -976,9 +1076,9 @@ class Pass1Visitor : public ObjectVisitor,
     for (CompressedObjectPtr* ptr = from; ptr <= to; ptr++) {
       ObjectPtr obj = ptr->Decompress(heap_base);
       if (!obj->IsHeapObject()) {
-        writer_->AddSmi(static_cast<SmiPtr>(obj));
+        AddSmi(static_cast<SmiPtr>(obj));
       }
-      writer_->CountReferences(1);
+      reference_count_++;
     }
   }
 
@@ -993,8 +1093,20 @@ class Pass1Visitor : public ObjectVisitor,
   }
 
  private:
+  void AddSmi(SmiPtr smi) {
+    if (smis_ != nullptr) {
+      smis_->Add(smi);
+    } else {
+      writer_->AddSmi(smi);
+    }
+  }
+
   HeapSnapshotWriter* const writer_;
   ObjectSlots* object_slots_;
+  CountingPage* counting_page_ = nullptr;
+  MallocGrowableArray<SmiPtr>* smis_ = nullptr;
+  intptr_t object_count_ = 0;
+  intptr_t reference_count_ = 0;
 
   DISALLOW_COPY_AND_ASSIGN(Pass1Visitor);
 };
@@ -1066,133 +1178,136 @@ class Pass2Visitor : public ObjectVisitor,
                      public ObjectPointerVisitor,
                      public HandleVisitor {
  public:
-  explicit Pass2Visitor(HeapSnapshotWriter* writer, ObjectSlots* object_slots)
+  Pass2Visitor(HeapSnapshotWriter* writer,
+               HeapSnapshotStream* stream,
+               ObjectSlots* object_slots)
       : ObjectVisitor(),
         ObjectPointerVisitor(IsolateGroup::Current()),
         HandleVisitor(Thread::Current()),
         writer_(writer),
+        stream_(stream),
         object_slots_(object_slots) {}
 
   void VisitObject(ObjectPtr obj) {
     if (obj->IsPseudoObject()) return;
 
     intptr_t cid = obj->GetClassId();
-    writer_->WriteUnsigned(cid + kNumExtraCids);
-    writer_->WriteUnsigned(discount_sizes_ ? 0 : obj->untag()->HeapSize());
+    stream_->WriteUnsigned(cid + kNumExtraCids);
+    stream_->WriteUnsigned(discount_sizes_ ? 0 : obj->untag()->HeapSize());
 
     if (cid == kNullCid) {
-      writer_->WriteUnsigned(kNullData);
+      stream_->WriteUnsigned(kNullData);
     } else if (cid == kBoolCid) {
-      writer_->WriteUnsigned(kBoolData);
-      writer_->WriteUnsigned(
+      stream_->WriteUnsigned(kBoolData);
+      stream_->WriteUnsigned(
           static_cast<uintptr_t>(static_cast<BoolPtr>(obj)->untag()->value_));
     } else if (cid == kSentinelCid) {
       if (obj == Object::sentinel().ptr()) {
-        writer_->WriteUnsigned(kNameData);
-        writer_->WriteUtf8("uninitialized");
+        stream_->WriteUnsigned(kNameData);
+        stream_->WriteUtf8("uninitialized");
       } else if (obj == Object::transition_sentinel().ptr()) {
-        writer_->WriteUnsigned(kNameData);
-        writer_->WriteUtf8("initializing");
+        stream_->WriteUnsigned(kNameData);
+        stream_->WriteUtf8("initializing");
       } else {
-        writer_->WriteUnsigned(kNoData);
+        stream_->WriteUnsigned(kNoData);
       }
     } else if (cid == kSmiCid) {
       UNREACHABLE();
     } else if (cid == kMintCid) {
-      writer_->WriteUnsigned(kIntData);
-      writer_->WriteSigned(static_cast<MintPtr>(obj)->untag()->value_);
+      stream_->WriteUnsigned(kIntData);
+      stream_->WriteSigned(static_cast<MintPtr>(obj)->untag()->value_);
     } else if (cid == kDoubleCid) {
-      writer_->WriteUnsigned(kDoubleData);
-      writer_->WriteBytes(&(static_cast<DoublePtr>(obj)->untag()->value_),
+      stream_->WriteUnsigned(kDoubleData);
+      stream_->WriteBytes(&(static_cast<DoublePtr>(obj)->untag()->value_),
                           sizeof(double));
     } else if (cid == kOneByteStringCid) {
       OneByteStringPtr str = static_cast<OneByteStringPtr>(obj);
       intptr_t len = Smi::Value(str->untag()->length());
       intptr_t trunc_len = Utils::Minimum(len, kMaxStringElements);
-      writer_->WriteUnsigned(kLatin1Data);
-      writer_->WriteUnsigned(len);
-      writer_->WriteUnsigned(trunc_len);
-      writer_->WriteBytes(&str->untag()->data()[0], trunc_len);
+      stream_->WriteUnsigned(kLatin1Data);
+      stream_->WriteUnsigned(len);
+      stream_->WriteUnsigned(trunc_len);
+      stream_->WriteBytes(&str->untag()->data()[0], trunc_len);
     } else if (cid == kExternalOneByteStringCid) {
       ExternalOneByteStringPtr str = static_cast<ExternalOneByteStringPtr>(obj);
       intptr_t len = Smi::Value(str->untag()->length());
       intptr_t trunc_len = Utils::Minimum(len, kMaxStringElements);
-      writer_->WriteUnsigned(kLatin1Data);
-      writer_->WriteUnsigned(len);
-      writer_->WriteUnsigned(trunc_len);
-      writer_->WriteBytes(&str->untag()->external_data_[0], trunc_len);
+      stream_->WriteUnsigned(kLatin1Data);
+      stream_->WriteUnsigned(len);
+      stream_->WriteUnsigned(trunc_len);
+      stream_->WriteBytes(&str->untag()->external_data_[0], trunc_len);
     } else if (cid == kTwoByteStringCid) {
       TwoByteStringPtr str = static_cast<TwoByteStringPtr>(obj);
       intptr_t len = Smi::Value(str->untag()->length());
       intptr_t trunc_len = Utils::Minimum(len, kMaxStringElements);
-      writer_->WriteUnsigned(kUTF16Data);
-      writer_->WriteUnsigned(len);
-      writer_->WriteUnsigned(trunc_len);
-      writer_->WriteBytes(&str->untag()->data()[0], trunc_len * 2);
+      stream_->WriteUnsigned(kUTF16Data);
+      stream_->WriteUnsigned(len);
+      stream_->WriteUnsigned(trunc_len);
+      stream_->WriteBytes(&str->untag()->data()[0], trunc_len * 2);
     } else if (cid == kExternalTwoByteStringCid) {
       ExternalTwoByteStringPtr str = static_cast<ExternalTwoByteStringPtr>(obj);
       intptr_t len = Smi::Value(str->untag()->length());
       intptr_t trunc_len = Utils::Minimum(len, kMaxStringElements);
-      writer_->WriteUnsigned(kUTF16Data);
-      writer_->WriteUnsigned(len);
-      writer_->WriteUnsigned(trunc_len);
-      writer_->WriteBytes(&str->untag()->external_data_[0], trunc_len * 2);
+      stream_->WriteUnsigned(kUTF16Data);
+      stream_->WriteUnsigned(len);
+      stream_->WriteUnsigned(trunc_len);
+      stream_->WriteBytes(&str->untag()->external_data_[0], trunc_len * 2);
     } else if (cid == kArrayCid || cid == kImmutableArrayCid) {
-      writer_->WriteUnsigned(kLengthData);
-      writer_->WriteUnsigned(
+      stream_->WriteUnsigned(kLengthData);
+      stream_->WriteUnsigned(
           Smi::Value(static_cast<ArrayPtr>(obj)->untag()->length()));
     } else if (cid == kGrowableObjectArrayCid) {
-      writer_->WriteUnsigned(kLengthData);
-      writer_->WriteUnsigned(Smi::Value(
+      stream_->WriteUnsigned(kLengthData);
+      stream_->WriteUnsigned(Smi::Value(
           static_cast<GrowableObjectArrayPtr>(obj)->untag()->length()));
     } else if (cid == kMapCid || cid == kConstMapCid) {
-      writer_->WriteUnsigned(kLengthData);
-      writer_->WriteUnsigned(
+      stream_->WriteUnsigned(kLengthData);
+      stream_->WriteUnsigned(
           Smi::Value(static_cast<MapPtr>(obj)->untag()->used_data()));
     } else if (cid == kSetCid || cid == kConstSetCid) {
-      writer_->WriteUnsigned(kLengthData);
-      writer_->WriteUnsigned(
+      stream_->WriteUnsigned(kLengthData);
+      stream_->WriteUnsigned(
           Smi::Value(static_cast<SetPtr>(obj)->untag()->used_data()));
     } else if (cid == kObjectPoolCid) {
-      writer_->WriteUnsigned(kLengthData);
-      writer_->WriteUnsigned(static_cast<ObjectPoolPtr>(obj)->untag()->length_);
+      stream_->WriteUnsigned(kLengthData);
+      stream_->WriteUnsigned(static_cast<ObjectPoolPtr>(obj)->untag()->length_);
     } else if (IsTypedDataClassId(cid)) {
-      writer_->WriteUnsigned(kLengthData);
-      writer_->WriteUnsigned(
+      stream_->WriteUnsigned(kLengthData);
+      stream_->WriteUnsigned(
           Smi::Value(static_cast<TypedDataPtr>(obj)->untag()->length()));
     } else if (IsExternalTypedDataClassId(cid)) {
-      writer_->WriteUnsigned(kLengthData);
-      writer_->WriteUnsigned(Smi::Value(
+      stream_->WriteUnsigned(kLengthData);
+      stream_->WriteUnsigned(Smi::Value(
           static_cast<ExternalTypedDataPtr>(obj)->untag()->length()));
     } else if (cid == kFunctionCid) {
-      writer_->WriteUnsigned(kNameData);
+      stream_->WriteUnsigned(kNameData);
       ScrubAndWriteUtf8(static_cast<FunctionPtr>(obj)->untag()->name());
     } else if (cid == kCodeCid) {
       ObjectPtr owner = static_cast<CodePtr>(obj)->untag()->owner_;
       if (!owner->IsHeapObject()) {
         // Precompiler removed owner object from the snapshot,
         // only leaving Smi classId.
-        writer_->WriteUnsigned(kNoData);
+        stream_->WriteUnsigned(kNoData);
       } else if (owner->IsFunction()) {
-        writer_->WriteUnsigned(kNameData);
+        stream_->WriteUnsigned(kNameData);
         ScrubAndWriteUtf8(static_cast<FunctionPtr>(owner)->untag()->name());
       } else if (owner->IsClass()) {
-        writer_->WriteUnsigned(kNameData);
+        stream_->WriteUnsigned(kNameData);
         ScrubAndWriteUtf8(static_cast<ClassPtr>(owner)->untag()->name());
       } else {
-        writer_->WriteUnsigned(kNoData);
+        stream_->WriteUnsigned(kNoData);
       }
     } else if (cid == kFieldCid) {
-      writer_->WriteUnsigned(kNameData);
+      stream_->WriteUnsigned(kNameData);
       ScrubAndWriteUtf8(static_cast<FieldPtr>(obj)->untag()->name());
     } else if (cid == kClassCid) {
-      writer_->WriteUnsigned(kNameData);
+      stream_->WriteUnsigned(kNameData);
       ScrubAndWriteUtf8(static_cast<ClassPtr>(obj)->untag()->name());
     } else if (cid == kLibraryCid) {
-      writer_->WriteUnsigned(kNameData);
+      stream_->WriteUnsigned(kNameData);
       ScrubAndWriteUtf8(static_cast<LibraryPtr>(obj)->untag()->url());
     } else if (cid == kScriptCid) {
-      writer_->WriteUnsigned(kNameData);
+      stream_->WriteUnsigned(kNameData);
       ScrubAndWriteUtf8(static_cast<ScriptPtr>(obj)->untag()->url());
     } else if (cid == kTypeArgumentsCid) {
       // Handle scope so we do not change the root set.
@@ -1204,10 +1319,10 @@ class Pass2Visitor : public ObjectVisitor,
       TextBuffer buffer(128);
       args.PrintSubvectorName(0, args.Length(), TypeArguments::kScrubbedName,
                               &buffer);
-      writer_->WriteUnsigned(kNameData);
-      writer_->WriteUtf8(buffer.buffer());
+      stream_->WriteUnsigned(kNameData);
+      stream_->WriteUtf8(buffer.buffer());
     } else {
-      writer_->WriteUnsigned(kNoData);
+      stream_->WriteUnsigned(kNoData);
     }
 
     if (object_slots_->ContainsOnlyTaggedPointers(cid)) {
@@ -1226,7 +1341,7 @@ class Pass2Visitor : public ObjectVisitor,
               UntaggedObject::ToAddr(obj->untag()) + slot.offset);
           VisitCompressedPointers(obj->heap_base(), target, target);
         } else {
-          writer_->WriteUnsigned(0);
+          stream_->WriteUnsigned(0);
         }
         written_++;
         total_++;
@@ -1236,12 +1351,12 @@ class Pass2Visitor : public ObjectVisitor,
 
   void ScrubAndWriteUtf8(StringPtr str) {
     if (str == String::null()) {
-      writer_->WriteUtf8("null");
+      stream_->WriteUtf8("null");
     } else {
       String handle;
       handle = str;
       char* value = handle.ToMallocCString();
-      writer_->ScrubAndWriteUtf8(value);
+      stream_->ScrubAndWriteUtf8(value);
       free(value);
     }
   }
@@ -1255,7 +1370,7 @@ class Pass2Visitor : public ObjectVisitor,
   }
   void DoWrite() {
     writing_ = true;
-    writer_->WriteUnsigned(counted_);
+    stream_->WriteUnsigned(counted_);
   }
 
   void VisitPointers(ObjectPtr* from, ObjectPtr* to) {
@@ -1264,7 +1379,7 @@ class Pass2Visitor : public ObjectVisitor,
         ObjectPtr target = *ptr;
         written_++;
         total_++;
-        writer_->WriteUnsigned(writer_->GetObjectId(target));
+        stream_->WriteUnsigned(writer_->GetObjectId(target));
       }
     } else {
       intptr_t count = to - from + 1;
@@ -1281,7 +1396,7 @@ class Pass2Visitor : public ObjectVisitor,
         ObjectPtr target = ptr->Decompress(heap_base);
         written_++;
         total_++;
-        writer_->WriteUnsigned(writer_->GetObjectId(target));
+        stream_->WriteUnsigned(writer_->GetObjectId(target));
       }
     } else {
       intptr_t count = to - from + 1;
@@ -1297,12 +1412,12 @@ class Pass2Visitor : public ObjectVisitor,
       return;  // Free handle.
     }
 
-    writer_->WriteUnsigned(writer_->GetObjectId(weak_persistent_handle->ptr()));
-    writer_->WriteUnsigned(weak_persistent_handle->external_size());
+    stream_->WriteUnsigned(writer_->GetObjectId(weak_persistent_handle->ptr()));
+    stream_->WriteUnsigned(weak_persistent_handle->external_size());
     // Attempt to include a native symbol name.
     auto const name = NativeSymbolResolver::LookupSymbolName(
         reinterpret_cast<uword>(weak_persistent_handle->callback()), nullptr);
-    writer_->WriteUtf8((name == nullptr) ? "Unknown native function" : name);
+    stream_->WriteUtf8((name == nullptr) ? "Unknown native function" : name);
     if (name != nullptr) {
       NativeSymbolResolver::FreeSymbolName(name);
     }
@@ -1315,12 +1430,13 @@ class Pass2Visitor : public ObjectVisitor,
   void WriteExtraRef(intptr_t oid) {
     ASSERT(writing_);
     written_++;
-    writer_->WriteUnsigned(oid);
+    stream_->WriteUnsigned(oid);
   }
 
  private:
   IsolateGroup* isolate_group_;
   HeapSnapshotWriter* const writer_;
+  HeapSnapshotStream* const stream_;
   ObjectSlots* object_slots_;
   bool writing_ = false;
   intptr_t counted_ = 0;
@@ -1331,6 +1447,220 @@ class Pass2Visitor : public ObjectVisitor,
   DISALLOW_COPY_AND_ASSIGN(Pass2Visitor);
 };
 
+// Holds the objects written for one page until the pages before it have been
+// passed on.
+class HeapSnapshotPageStream : public HeapSnapshotStream {
+ public:
+  HeapSnapshotPageStream() {}
+  ~HeapSnapshotPageStream() { free(buffer_); }
+
+  const uint8_t* buffer() const { return buffer_; }
+  intptr_t size() const { return size_; }
+
+  void Release() {
+    free(buffer_);
+    buffer_ = nullptr;
+    size_ = 0;
+    capacity_ = 0;
+  }
+
+ private:
+  static const intptr_t kInitialCapacity = 4 * KB;
+
+  virtual void Grow(intptr_t needed) {
+    capacity_ = Utils::Maximum(Utils::Maximum(2 * capacity_, kInitialCapacity),
+                               size_ + needed);
+    buffer_ = reinterpret_cast<uint8_t*>(realloc(buffer_, capacity_));
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(HeapSnapshotPageStream);
+};
+
+// The results of visiting one regular old-space page.
+struct HeapSnapshotPage {
+  Page* page = nullptr;
+  intptr_t object_count = 0;
+  intptr_t reference_count = 0;
+  MallocGrowableArray<SmiPtr> smis;
+  HeapSnapshotPageStream stream;
+};
+
+class HeapSnapshotTask : public ThreadPool::Task {
+ public:
+  HeapSnapshotTask(IsolateGroup* isolate_group,
+                   HeapSnapshotWriter* writer,
+                   ObjectSlots* object_slots,
+                   ThreadBarrier* barrier,
+                   RelaxedAtomic<intptr_t>* next_page,
+                   intptr_t end,
+                   HeapSnapshotPage* pages,
+                   bool counting)
+      : isolate_group_(isolate_group),
+        writer_(writer),
+        object_slots_(object_slots),
+        barrier_(barrier),
+        next_page_(next_page),
+        end_(end),
+        pages_(pages),
+        counting_(counting) {}
+
+  void Run() {
+    if (!barrier_->TryEnter()) {
+      barrier_->Release();
+      return;
+    }
+
+    bool result = Thread::EnterIsolateGroupAsHelper(
+        isolate_group_, Thread::kHeapSnapshotTask, /*bypass_safepoint=*/true);
+    ASSERT(result);
+    {
+      // Writing the names of type arguments needs handles.
+      StackZone stack_zone(Thread::Current());
+      RunEnteredIsolateGroup();
+    }
+    Thread::ExitIsolateGroupAsHelper(/*bypass_safepoint=*/true);
+
+    // This task is done. Notify the original thread.
+    barrier_->Sync();
+    barrier_->Release();
+  }
+
+  void RunEnteredIsolateGroup() {
+    while (true) {
+      const intptr_t index = next_page_->fetch_add(1u);
+      if (index >= end_) break;
+
+      HeapSnapshotPage* work = &pages_[index];
+      if (counting_) {
+        Pass1Visitor visitor(writer_, object_slots_);
+        visitor.SetPage(
+            reinterpret_cast<CountingPage*>(work->page->forwarding_page()),
+            &work->smis);
+        work->page->VisitObjects(&visitor);
+        work->object_count = visitor.object_count();
+        work->reference_count = visitor.reference_count();
+      } else {
+        Pass2Visitor visitor(writer_, &work->stream, object_slots_);
+        work->page->VisitObjects(&visitor);
+      }
+    }
+  }
+
+ private:
+  IsolateGroup* isolate_group_;
+  HeapSnapshotWriter* writer_;
+  ObjectSlots* object_slots_;
+  ThreadBarrier* barrier_;
+  RelaxedAtomic<intptr_t>* next_page_;
+  intptr_t end_;
+  HeapSnapshotPage* pages_;
+  bool counting_;
+
+  DISALLOW_COPY_AND_ASSIGN(HeapSnapshotTask);
+};
+
+static constexpr intptr_t kHeapSnapshotWordsPerTask = 8 * MBInWords;
+
+// The number of pages written per task before their output is passed on,
+// which bounds the memory held for pages written out of order.
+static constexpr intptr_t kHeapSnapshotPagesPerBatch = 16;
+
+void HeapSnapshotWriter::VisitDataPages(ObjectSlots* object_slots,
+                                        HeapSnapshotPage* pages,
+                                        intptr_t begin,
+                                        intptr_t end,
+                                        bool counting) {
+  const intptr_t num_tasks = Utils::Minimum(tasks_, end - begin);
+  if (num_tasks <= 0) {
+    return;
+  }
+
+  ThreadBarrier* barrier = new ThreadBarrier(num_tasks, 1);
+  RelaxedAtomic<intptr_t> next_page = {begin};
+  for (intptr_t task_index = 0; task_index < num_tasks; task_index++) {
+    if (task_index < (num_tasks - 1)) {
+      Dart::thread_pool()->Run<HeapSnapshotTask>(isolate_group(), this,
+                                                 object_slots, barrier,
+                                                 &next_page, end, pages,
+                                                 counting);
+    } else {
+      // Last worker is the main thread.
+      HeapSnapshotTask task(isolate_group(), this, object_slots, barrier,
+                            &next_page, end, pages, counting);
+      task.RunEnteredIsolateGroup();
+      barrier->Sync();
+      barrier->Release();
+    }
+  }
+}
+
+void HeapSnapshotWriter::VisitOtherOldPages(ObjectVisitor* visitor) {
+  PageSpace* old_space = isolate_group()->heap()->old_space();
+  MutexLocker ml(&old_space->pages_lock_);
+  NoSafepointScope no_safepoint;
+  for (Page* page = old_space->exec_pages_; page != nullptr;
+       page = page->next()) {
+    page->VisitObjects(visitor);
+  }
+  for (Page* page = old_space->large_pages_; page != nullptr;
+       page = page->next()) {
+    page->VisitObjects(visitor);
+  }
+  for (Page* page = old_space->image_pages_; page != nullptr;
+       page = page->next()) {
+    page->VisitObjects(visitor);
+  }
+}
+
+// Visits the objects in the same order as HeapIterationScope::IterateObjects.
+void HeapSnapshotWriter::CountHeapObjects(Pass1Visitor* visitor,
+                                          ObjectSlots* object_slots) {
+  isolate_group()->heap()->new_space()->VisitObjects(visitor);
+
+  const intptr_t num_pages = data_pages_.length();
+  HeapSnapshotPage* pages = new HeapSnapshotPage[num_pages];
+  for (intptr_t i = 0; i < num_pages; i++) {
+    pages[i].page = data_pages_[i];
+  }
+  VisitDataPages(object_slots, pages, 0, num_pages, /*counting=*/true);
+  for (intptr_t i = 0; i < num_pages; i++) {
+    HeapSnapshotPage* work = &pages[i];
+    reinterpret_cast<CountingPage*>(work->page->forwarding_page())
+        ->Rebase(object_count_);
+    object_count_ += work->object_count;
+    reference_count_ += work->reference_count;
+    for (SmiPtr smi : work->smis) {
+      AddSmi(smi);
+    }
+  }
+  delete[] pages;
+
+  VisitOtherOldPages(visitor);
+}
+
+void HeapSnapshotWriter::WriteHeapObjects(Pass2Visitor* visitor,
+                                          ObjectSlots* object_slots) {
+  isolate_group()->heap()->new_space()->VisitObjects(visitor);
+
+  const intptr_t num_pages = data_pages_.length();
+  HeapSnapshotPage* pages = new HeapSnapshotPage[num_pages];
+  for (intptr_t i = 0; i < num_pages; i++) {
+    pages[i].page = data_pages_[i];
+  }
+  const intptr_t batch = tasks_ * kHeapSnapshotPagesPerBatch;
+  for (intptr_t begin = 0; begin < num_pages; begin += batch) {
+    const intptr_t end = Utils::Minimum(begin + batch, num_pages);
+    VisitDataPages(object_slots, pages, begin, end, /*counting=*/false);
+    for (intptr_t i = begin; i < end; i++) {
+      WriteBytes(pages[i].stream.buffer(), pages[i].stream.size());
+      pages[i].stream.Release();
+    }
+  }
+  delete[] pages;
+
+  VisitOtherOldPages(visitor);
+}
+
 class Pass3Visitor : public ObjectVisitor {
  public:
   explicit Pass3Visitor(HeapSnapshotWriter* writer)
@@ -1451,8 +1781,25 @@ void CallbackHeapSnapshotWriter::WriteChunk(uint8_t* buffer,
 }
 
 void HeapSnapshotWriter::Write() {
+#if defined(SUPPORT_TIMELINE)
+  TimelineBeginEndScope tbes(thread(), Timeline::GetIsolateStream(),
+                             "WriteHeapSnapshot");
+#endif
+  const int64_t start = OS::GetCurrentMonotonicMicros();
   HeapIterationScope iteration(thread());
 
+  snapshot_size_ = 0;
+  output_size_ = 0;
+  if (gzip_level_ > 0) {
+    ASSERT(deflater_ == nullptr);
+    deflater_ = new z_stream();
+    // Adding 16 to the window bits selects a gzip header and trailer.
+    const int result = deflateInit2(
+        deflater_, Utils::Minimum(gzip_level_, Z_BEST_COMPRESSION), Z_DEFLATED,
+        16 + MAX_WBITS, /*memLevel=*/8, Z_DEFAULT_STRATEGY);
+    RELEASE_ASSERT(result == Z_OK);
+  }
+
   WriteBytes("dartheap", 8);  // Magic value.
   WriteUnsigned(0);           // Flags.
   WriteUtf8(isolate()->name());
@@ -1574,6 +1921,10 @@ void HeapSnapshotWriter::Write() {
   }
 
   SetupCountingPages();
+  tasks_ = Utils::Maximum<intptr_t>(
+      1, ChooseGCTasks(FLAG_heap_snapshot_tasks,
+                       data_pages_.length() * kPageSizeInWords,
+                       kHeapSnapshotWordsPerTask));
 
   intptr_t num_isolates = 0;
   intptr_t num_image_objects = 0;
@@ -1609,10 +1960,11 @@ void HeapSnapshotWriter::Write() {
 
     // Heap objects.
     iteration.IterateVMIsolateObjects(&visitor);
-    iteration.IterateObjects(&visitor);
+    CountHeapObjects(&visitor, &object_slots);
 
     // External properties.
     isolate()->group()->VisitWeakPersistentHandles(&visitor);
+    CountReferences(visitor.reference_count());
 
     // Smis.
     for (SmiPtr smi : smis_) {
@@ -1621,7 +1973,7 @@ void HeapSnapshotWriter::Write() {
   }
 
   {
-    Pass2Visitor visitor(this, &object_slots);
+    Pass2Visitor visitor(this, this, &object_slots);
 
     WriteUnsigned(reference_count_);
     WriteUnsigned(object_count_);
@@ -1675,7 +2027,7 @@ void HeapSnapshotWriter::Write() {
     visitor.set_discount_sizes(true);
     iteration.IterateVMIsolateObjects(&visitor);
     visitor.set_discount_sizes(false);
-    iteration.IterateObjects(&visitor);
+    WriteHeapObjects(&visitor, &object_slots);
 
     // Smis.
     for (SmiPtr smi : smis_) {
@@ -1714,6 +2066,27 @@ void HeapSnapshotWriter::Write() {
 
   ClearObjectIds();
   Flush(true);
+  if (deflater_ != nullptr) {
+    deflateEnd(deflater_);
+    delete deflater_;
+    deflater_ = nullptr;
+  }
+  data_pages_.Clear();
+
+  pause_micros_ = OS::GetCurrentMonotonicMicros() - start;
+#if defined(SUPPORT_TIMELINE)
+  if (tbes.enabled()) {
+    tbes.SetNumArguments(6);
+    tbes.FormatArgument(0, "Objects", "%" Pd "", object_count_);
+    tbes.FormatArgument(1, "References", "%" Pd "", reference_count_);
+    tbes.FormatArgument(2, "Tasks", "%" Pd "", tasks_);
+    tbes.FormatArgument(3, "Pause (us)", "%" Pd64 "", pause_micros_);
+    tbes.FormatArgument(4, "Size (kB)", "%" Pd "",
+                        RoundWordsToKB(snapshot_size_ >> kWordSizeLog2));
+    tbes.FormatArgument(5, "Written (kB)", "%" Pd "",
+                        RoundWordsToKB(output_size_ >> kWordSizeLog2));
+  }
+#endif
 }
 
 uint32_t HeapSnapshotWriter::GetHeapSnapshotIdentityHash(Thread* thread,
@@ -1820,6 +2193,21 @@ void CountObjectsVisitor::VisitObject(ObjectPtr obj) {
     old_count_[cid] += 1;
     old_size_[cid] += size;
   }
+  if (cid == kFinalizerEntryCid) {
+    // Attribute the external size given to Finalizer.attach to the class of
+    // the attached object, as for weak persistent handles.
+    FinalizerEntryPtr entry = static_cast<FinalizerEntryPtr>(obj);
+    ObjectPtr value = entry->untag()->value();
+    const intptr_t external_size = entry->untag()->external_size();
+    if ((external_size == 0) || !value->IsHeapObject()) {
+      return;
+    }
+    if (value->IsNewObject()) {
+      new_external_size_[value->GetClassId()] += external_size;
+    } else {
+      old_external_size_[value->GetClassId()] += external_size;
+    }
+  }
 }
 
 void CountObjectsVisitor::VisitHandle(uword addr) {
@@ -9,16 +9,26 @@
 
 #include "vm/allocation.h"
 #include "vm/dart_api_state.h"
+#include "vm/flags.h"
 #include "vm/thread_stack_resource.h"
 
+struct z_stream_s;
+
 namespace dart {
 
 class Array;
 class Object;
 class CountingPage;
+class ObjectSlots;
+class Page;
+class Pass1Visitor;
+class Pass2Visitor;
+struct HeapSnapshotPage;
 
 #if defined(DART_ENABLE_HEAP_SNAPSHOT_WRITER)
 
+DECLARE_FLAG(int, heap_snapshot_gzip_level);
+
 // Utility to traverse the object graph in an ordered fashion.
 // Example uses:
 // - find a retaining path from the isolate roots to a particular object, or
@@ -164,12 +174,12 @@ class VmServiceHeapSnapshotChunkedWriter : public ChunkedWriter {
   static const intptr_t kMetadataReservation = 512;
 };
 
-// Generates a dump of the heap, whose format is described in
-// runtime/vm/service/heap_snapshot.md.
-class HeapSnapshotWriter : public ThreadStackResource {
+// Encodes the values of a heap snapshot, whose format is described in
+// runtime/vm/service/heap_snapshot.md, into a buffer.
+class HeapSnapshotStream {
  public:
-  HeapSnapshotWriter(Thread* thread, ChunkedWriter* writer)
-      : ThreadStackResource(thread), writer_(writer) {}
+  HeapSnapshotStream() {}
+  virtual ~HeapSnapshotStream() {}
 
   void WriteSigned(int64_t value) {
     EnsureAvailable((sizeof(value) * kBitsPerByte) / 7 + 1);
@@ -226,6 +236,41 @@ class HeapSnapshotWriter : public ThreadStackResource {
     WriteBytes(value, len);
   }
 
+ protected:
+  void EnsureAvailable(intptr_t needed) {
+    if ((capacity_ - size_) < needed) {
+      Grow(needed);
+    }
+  }
+
+  // Makes room for at least [needed] more bytes after [size_].
+  virtual void Grow(intptr_t needed) = 0;
+
+  uint8_t* buffer_ = nullptr;
+  intptr_t size_ = 0;
+  intptr_t capacity_ = 0;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(HeapSnapshotStream);
+};
+
+// Generates a dump of the heap, whose format is described in
+// runtime/vm/service/heap_snapshot.md.
+//
+// The objects on regular old-space pages, which make up most of a large heap,
+// are counted and written by FLAG_heap_snapshot_tasks tasks, one page at a
+// time. Each page is written to its own buffer and the buffers are passed on
+// in page order, so the snapshot does not depend on the number of tasks.
+//
+// If [gzip_level] is not 0, the chunks passed to [writer] hold the snapshot
+// compressed with gzip at that level.
+class HeapSnapshotWriter : public ThreadStackResource,
+                           public HeapSnapshotStream {
+ public:
+  HeapSnapshotWriter(Thread* thread, ChunkedWriter* writer, int gzip_level = 0)
+      : ThreadStackResource(thread), writer_(writer), gzip_level_(gzip_level) {}
+  ~HeapSnapshotWriter();
+
   void AssignObjectId(ObjectPtr obj);
   intptr_t GetObjectId(ObjectPtr obj) const;
   void ClearObjectIds();
@@ -235,6 +280,16 @@ class HeapSnapshotWriter : public ThreadStackResource {
 
   void Write();
 
+  // Statistics of the last call to Write, which are also reported as the
+  // arguments of its timeline event.
+  int64_t pause_micros() const { return pause_micros_; }
+  // The size of the snapshot before compression.
+  intptr_t snapshot_size() const { return snapshot_size_; }
+  // The number of bytes passed on to the ChunkedWriter, excluding the prefixes
+  // it reserved.
+  intptr_t output_size() const { return output_size_; }
+  intptr_t tasks() const { return tasks_; }
+
   static uint32_t GetHeapSnapshotIdentityHash(Thread* thread, ObjectPtr obj);
 
  private:
@@ -246,20 +301,35 @@ class HeapSnapshotWriter : public ThreadStackResource {
   bool OnImagePage(ObjectPtr obj) const;
   CountingPage* FindCountingPage(ObjectPtr obj) const;
 
-  void EnsureAvailable(intptr_t needed);
+  void CountHeapObjects(Pass1Visitor* visitor, ObjectSlots* object_slots);
+  void WriteHeapObjects(Pass2Visitor* visitor, ObjectSlots* object_slots);
+  void VisitDataPages(ObjectSlots* object_slots,
+                      HeapSnapshotPage* pages,
+                      intptr_t begin,
+                      intptr_t end,
+                      bool counting);
+  void VisitOtherOldPages(ObjectVisitor* visitor);
+
+  virtual void Grow(intptr_t needed);
   void Flush(bool last = false);
+  void Deflate(bool last);
 
   ChunkedWriter* writer_ = nullptr;
-
-  uint8_t* buffer_ = nullptr;
-  intptr_t size_ = 0;
-  intptr_t capacity_ = 0;
+  const int gzip_level_;
+  z_stream_s* deflater_ = nullptr;
+  uint8_t* compressed_ = nullptr;
+  intptr_t compressed_size_ = 0;
 
   intptr_t class_count_ = 0;
   intptr_t object_count_ = 0;
   intptr_t reference_count_ = 0;
   intptr_t external_property_count_ = 0;
 
+  intptr_t tasks_ = 1;
+  int64_t pause_micros_ = 0;
+  intptr_t snapshot_size_ = 0;
+  intptr_t output_size_ = 0;
+
   struct ImagePageRange {
     uword base;
     uword size;
@@ -269,6 +339,9 @@ class HeapSnapshotWriter : public ThreadStackResource {
   static const intptr_t kMaxImagePages = 4;
   ImagePageRange image_page_ranges_[kMaxImagePages];
 
+  // The regular old-space pages of the isolate group, in iteration order.
+  MallocGrowableArray<Page*> data_pages_;
+
   MallocGrowableArray<SmiPtr> smis_;
 
   DISALLOW_COPY_AND_ASSIGN(HeapSnapshotWriter);
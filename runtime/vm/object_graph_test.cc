@@ -4,8 +4,13 @@
 
 #include "vm/object_graph.h"
 #include "platform/assert.h"
+#include "vm/heap/gc_shared.h"
 #include "vm/unit_test.h"
 
+#if defined(DART_ENABLE_HEAP_SNAPSHOT_WRITER)
+#include "zlib/zlib.h"
+#endif
+
 namespace dart {
 
 #if !defined(PRODUCT)
@@ -190,6 +195,115 @@ ISOLATE_UNIT_TEST_CASE(RetainingPathGCRoot) {
   EXPECT_STREQ(result.gc_root_type, "local handle");
 }
 
+#if defined(DART_ENABLE_HEAP_SNAPSHOT_WRITER)
+
+DECLARE_FLAG(int, heap_snapshot_tasks);
+
+// Concatenates the chunks of a snapshot.
+class BufferHeapSnapshotWriter : public ChunkedWriter {
+ public:
+  explicit BufferHeapSnapshotWriter(Thread* thread) : ChunkedWriter(thread) {}
+  ~BufferHeapSnapshotWriter() { free(buffer_); }
+
+  virtual void WriteChunk(uint8_t* chunk, intptr_t size, bool last) {
+    EXPECT(!saw_last_chunk_);
+    buffer_ = reinterpret_cast<uint8_t*>(realloc(buffer_, size_ + size));
+    memmove(buffer_ + size_, chunk, size);
+    size_ += size;
+    saw_last_chunk_ = last;
+    free(chunk);
+  }
+
+  const uint8_t* buffer() const { return buffer_; }
+  intptr_t size() const { return size_; }
+  bool saw_last_chunk() const { return saw_last_chunk_; }
+
+ private:
+  uint8_t* buffer_ = nullptr;
+  intptr_t size_ = 0;
+  bool saw_last_chunk_ = false;
+};
+
+// Fills several old-space pages with arrays of distinct Smis.
+static void AllocateSnapshotGarbage(const Array& arrays) {
+  Array& array = Array::Handle();
+  for (intptr_t i = 0; i < arrays.Length(); i++) {
+    array = Array::New(100, Heap::kOld);
+    for (intptr_t j = 0; j < array.Length(); j++) {
+      array.SetAt(j, Smi::Handle(Smi::New(i * array.Length() + j)));
+    }
+    arrays.SetAt(i, array);
+  }
+}
+
+ISOLATE_UNIT_TEST_CASE(HeapSnapshotWriter_Parallel) {
+  SetFlagScope<bool> sfs_adaptive(&FLAG_adaptive_gc_tasks, false);
+  const Array& arrays = Array::Handle(Array::New(2000, Heap::kOld));
+  AllocateSnapshotGarbage(arrays);
+  GCTestHelper::CollectAllGarbage();
+
+  BufferHeapSnapshotWriter serial(thread);
+  {
+    SetFlagScope<int> sfs(&FLAG_heap_snapshot_tasks, 1);
+    HeapSnapshotWriter writer(thread, &serial);
+    writer.Write();
+    EXPECT_EQ(1, writer.tasks());
+    EXPECT_EQ(serial.size(), writer.snapshot_size());
+    EXPECT_EQ(serial.size(), writer.output_size());
+    EXPECT_LE(0, writer.pause_micros());
+  }
+  EXPECT(serial.saw_last_chunk());
+
+  // The pages are divided between tasks, but the snapshot is the same.
+  BufferHeapSnapshotWriter parallel(thread);
+  {
+    SetFlagScope<int> sfs(&FLAG_heap_snapshot_tasks, 4);
+    HeapSnapshotWriter writer(thread, &parallel);
+    writer.Write();
+    EXPECT_EQ(4, writer.tasks());
+  }
+  EXPECT(parallel.saw_last_chunk());
+  EXPECT_EQ(serial.size(), parallel.size());
+  EXPECT(memcmp(serial.buffer(), parallel.buffer(), serial.size()) == 0);
+}
+
+ISOLATE_UNIT_TEST_CASE(HeapSnapshotWriter_Gzip) {
+  const Array& arrays = Array::Handle(Array::New(200, Heap::kOld));
+  AllocateSnapshotGarbage(arrays);
+  GCTestHelper::CollectAllGarbage();
+
+  BufferHeapSnapshotWriter plain(thread);
+  {
+    HeapSnapshotWriter writer(thread, &plain);
+    writer.Write();
+  }
+
+  BufferHeapSnapshotWriter compressed(thread);
+  {
+    HeapSnapshotWriter writer(thread, &compressed, /*gzip_level=*/6);
+    writer.Write();
+    EXPECT_EQ(plain.size(), writer.snapshot_size());
+    EXPECT_EQ(compressed.size(), writer.output_size());
+  }
+  EXPECT(compressed.saw_last_chunk());
+  EXPECT_LT(compressed.size(), plain.size());
+
+  uint8_t* inflated = reinterpret_cast<uint8_t*>(malloc(plain.size()));
+  z_stream stream = {};
+  EXPECT_EQ(Z_OK, inflateInit2(&stream, 16 + MAX_WBITS));
+  stream.next_in = const_cast<uint8_t*>(compressed.buffer());
+  stream.avail_in = compressed.size();
+  stream.next_out = inflated;
+  stream.avail_out = plain.size();
+  EXPECT_EQ(Z_STREAM_END, inflate(&stream, Z_FINISH));
+  EXPECT_EQ(plain.size(), static_cast<intptr_t>(stream.total_out));
+  EXPECT(memcmp(plain.buffer(), inflated, plain.size()) == 0);
+  inflateEnd(&stream);
+  free(inflated);
+}
+
+#endif  // defined(DART_ENABLE_HEAP_SNAPSHOT_WRITER)
+
 #endif  // !defined(PRODUCT)
 
 }  // namespace dart
@@ -73,6 +73,11 @@ class OS {
   // Returns number of available processor cores.
   static int NumberOfAvailableProcessors();
 
+  // Returns the number of processor cores this process can run on, which on
+  // Linux is also limited by the affinity mask and the cgroup CPU quota.
+  // At least one.
+  static int NumberOfUsableProcessors();
+
   // Sleep the currently executing thread for millis ms.
   static void Sleep(int64_t millis);
 
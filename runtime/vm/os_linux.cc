@@ -9,8 +9,10 @@
 
 #include <errno.h>         // NOLINT
 #include <fcntl.h>         // NOLINT
+#include <inttypes.h>      // NOLINT
 #include <limits.h>        // NOLINT
 #include <malloc.h>        // NOLINT
+#include <sched.h>         // NOLINT
 #include <sys/mman.h>      // NOLINT
 #include <sys/resource.h>  // NOLINT
 #include <sys/stat.h>      // NOLINT
@@ -523,10 +525,67 @@ intptr_t OS::ActivationFrameAlignment() {
   return alignment;
 }
 
+// Returns the CPU bandwidth quota of the process's cgroup rounded up to whole
+// processors, or 0 if there is no quota. Assumes the process's cgroup is
+// mounted at /sys/fs/cgroup, as it is inside containers.
+static int CgroupProcessorQuota() {
+  int64_t quota = -1;
+  int64_t period = 0;
+  // cgroup v2: "<quota> <period>", where the quota may be "max".
+  FILE* file = fopen("/sys/fs/cgroup/cpu.max", "r");
+  if (file != nullptr) {
+    char quota_string[32];
+    if (fscanf(file, "%31s %" SCNd64, quota_string, &period) == 2 &&
+        strcmp(quota_string, "max") != 0) {
+      quota = strtoll(quota_string, nullptr, 10);
+    }
+    fclose(file);
+  } else {
+    // cgroup v1: a quota of -1 means no limit.
+    file = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r");
+    if (file != nullptr) {
+      if (fscanf(file, "%" SCNd64, &quota) != 1) {
+        quota = -1;
+      }
+      fclose(file);
+    }
+    file = fopen("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r");
+    if (file != nullptr) {
+      if (fscanf(file, "%" SCNd64, &period) != 1) {
+        period = 0;
+      }
+      fclose(file);
+    }
+  }
+  if ((quota <= 0) || (period <= 0)) {
+    return 0;
+  }
+  return static_cast<int>((quota + period - 1) / period);
+}
+
+static int ComputeUsableProcessors() {
+  int processors = OS::NumberOfAvailableProcessors();
+  cpu_set_t cpu_set;
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+    processors = Utils::Minimum(processors, CPU_COUNT(&cpu_set));
+  }
+  const int quota = CgroupProcessorQuota();
+  if (quota > 0) {
+    processors = Utils::Minimum(processors, quota);
+  }
+  return Utils::Maximum(processors, 1);
+}
+
 int OS::NumberOfAvailableProcessors() {
   return sysconf(_SC_NPROCESSORS_ONLN);
 }
 
+int OS::NumberOfUsableProcessors() {
+  // Respects the affinity mask and cgroup CPU quota the process started with.
+  static const int processors = ComputeUsableProcessors();
+  return processors;
+}
+
 void OS::Sleep(int64_t millis) {
   int64_t micros = millis * kMicrosecondsPerMillisecond;
   SleepMicros(micros);
@@ -30,6 +30,9 @@ VM_UNIT_TEST_CASE(OsFuncs) {
   EXPECT(Utils::IsPowerOfTwo(OS::ActivationFrameAlignment()));
   int procs = OS::NumberOfAvailableProcessors();
   EXPECT_LE(1, procs);
+  int usable = OS::NumberOfUsableProcessors();
+  EXPECT_LE(1, usable);
+  EXPECT_LE(usable, procs);
 }
 
 }  // namespace dart
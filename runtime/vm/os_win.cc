@@ -199,6 +199,10 @@ int OS::NumberOfAvailableProcessors() {
   return info.dwNumberOfProcessors;
 }
 
+int OS::NumberOfUsableProcessors() {
+  return NumberOfAvailableProcessors();
+}
+
 void OS::Sleep(int64_t millis) {
   ::Sleep(millis);
 }
@@ -334,6 +334,46 @@ static Heap::Space SpaceForRuntimeAllocation() {
   return FLAG_stress_write_barrier_elimination ? Heap::kOld : Heap::kNew;
 }
 
+// The allocation site of the Dart code that called the current runtime entry.
+// With --pretenure_allocation_sites, sites whose objects usually survive a
+// scavenge allocate directly in old space.
+class RuntimeAllocationSite : public ValueObject {
+ public:
+  explicit RuntimeAllocationSite(Thread* thread) {
+    if (!FLAG_pretenure_allocation_sites ||
+        FLAG_stress_write_barrier_elimination) {
+      return;
+    }
+    DartFrameIterator iterator(thread,
+                               StackFrameIterator::kNoCrossThreadIteration);
+    StackFrame* caller_frame = iterator.NextFrame();
+    ASSERT(caller_frame != nullptr);
+    sites_ = thread->heap()->new_space()->allocation_sites();
+    pc_ = caller_frame->pc();
+    pretenure_ = sites_->ShouldPretenure(pc_);
+  }
+
+  Heap::Space space() const {
+    return pretenure_ ? Heap::kOld : SpaceForRuntimeAllocation();
+  }
+
+  // Samples a new-space [result] for survival, or accounts for the copying
+  // avoided by allocating it in old space.
+  void Record(const Object& result) const {
+    if (sites_ == nullptr) return;
+    if (result.IsNew()) {
+      sites_->RecordAllocation(pc_, result.ptr());
+    } else if (pretenure_) {
+      sites_->RecordPretenured(result.ptr()->untag()->HeapSize());
+    }
+  }
+
+ private:
+  AllocationSiteTable* sites_ = nullptr;
+  uword pc_ = 0;
+  bool pretenure_ = false;
+};
+
 // Allocation of a fixed length array of given element type.
 // This runtime entry is never called for allocating a List of a generic type,
 // because a prior run time call instantiates the element type if necessary.
@@ -360,9 +400,10 @@ DEFINE_RUNTIME_ENTRY(AllocateArray, 2) {
     Exceptions::ThrowOOM();
   }
 
+  const RuntimeAllocationSite site(thread);
   const Array& array = Array::Handle(
-      zone,
-      Array::New(static_cast<intptr_t>(len), SpaceForRuntimeAllocation()));
+      zone, Array::New(static_cast<intptr_t>(len), site.space()));
+  site.Record(array);
   arguments.SetReturn(array);
   TypeArguments& element_type =
       TypeArguments::CheckedHandle(zone, arguments.ArgAt(1));
@@ -472,8 +513,10 @@ static void ThrowIfError(const Object& result) {
 DEFINE_RUNTIME_ENTRY(AllocateObject, 2) {
   const Class& cls = Class::CheckedHandle(zone, arguments.ArgAt(0));
   ASSERT(cls.is_allocate_finalized());
+  const RuntimeAllocationSite site(thread);
   const Instance& instance = Instance::Handle(
-      zone, Instance::NewAlreadyFinalized(cls, SpaceForRuntimeAllocation()));
+      zone, Instance::NewAlreadyFinalized(cls, site.space()));
+  site.Record(instance);
 
   arguments.SetReturn(instance);
   if (cls.NumTypeArguments() == 0) {
@@ -685,11 +728,13 @@ DEFINE_RUNTIME_ENTRY(SubtypeCheck, 5) {
 DEFINE_RUNTIME_ENTRY(AllocateClosure, 2) {
   const auto& function = Function::CheckedHandle(zone, arguments.ArgAt(0));
   const auto& context = Context::CheckedHandle(zone, arguments.ArgAt(1));
+  const RuntimeAllocationSite site(thread);
   const Closure& closure = Closure::Handle(
       zone,
       Closure::New(Object::null_type_arguments(), Object::null_type_arguments(),
                    Object::null_type_arguments(), function, context,
-                   SpaceForRuntimeAllocation()));
+                   site.space()));
+  site.Record(closure);
   arguments.SetReturn(closure);
 }
 
@@ -698,8 +743,10 @@ DEFINE_RUNTIME_ENTRY(AllocateClosure, 2) {
 // Return value: newly allocated context.
 DEFINE_RUNTIME_ENTRY(AllocateContext, 1) {
   const Smi& num_variables = Smi::CheckedHandle(zone, arguments.ArgAt(0));
+  const RuntimeAllocationSite site(thread);
   const Context& context = Context::Handle(
-      zone, Context::New(num_variables.Value(), SpaceForRuntimeAllocation()));
+      zone, Context::New(num_variables.Value(), site.space()));
+  site.Record(context);
   arguments.SetReturn(context);
 }
 
@@ -709,8 +756,10 @@ DEFINE_RUNTIME_ENTRY(AllocateContext, 1) {
 // Return value: newly allocated context.
 DEFINE_RUNTIME_ENTRY(CloneContext, 1) {
   const Context& ctx = Context::CheckedHandle(zone, arguments.ArgAt(0));
-  Context& cloned_ctx = Context::Handle(
-      zone, Context::New(ctx.num_variables(), SpaceForRuntimeAllocation()));
+  const RuntimeAllocationSite site(thread);
+  Context& cloned_ctx =
+      Context::Handle(zone, Context::New(ctx.num_variables(), site.space()));
+  site.Record(cloned_ctx);
   cloned_ctx.set_parent(Context::Handle(zone, ctx.parent()));
   Object& inst = Object::Handle(zone);
   for (int i = 0; i < ctx.num_variables(); i++) {
@@ -725,8 +774,9 @@ DEFINE_RUNTIME_ENTRY(CloneContext, 1) {
 // Return value: newly allocated record.
 DEFINE_RUNTIME_ENTRY(AllocateRecord, 1) {
   const RecordShape shape(Smi::RawCast(arguments.ArgAt(0)));
-  const Record& record =
-      Record::Handle(zone, Record::New(shape, SpaceForRuntimeAllocation()));
+  const RuntimeAllocationSite site(thread);
+  const Record& record = Record::Handle(zone, Record::New(shape, site.space()));
+  site.Record(record);
   arguments.SetReturn(record);
 }
 
@@ -739,8 +789,9 @@ DEFINE_RUNTIME_ENTRY(AllocateSmallRecord, 4) {
   const auto& value0 = Instance::CheckedHandle(zone, arguments.ArgAt(1));
   const auto& value1 = Instance::CheckedHandle(zone, arguments.ArgAt(2));
   const auto& value2 = Instance::CheckedHandle(zone, arguments.ArgAt(3));
-  const Record& record =
-      Record::Handle(zone, Record::New(shape, SpaceForRuntimeAllocation()));
+  const RuntimeAllocationSite site(thread);
+  const Record& record = Record::Handle(zone, Record::New(shape, site.space()));
+  site.Record(record);
   const intptr_t num_fields = shape.num_fields();
   ASSERT(num_fields == 2 || num_fields == 3);
   record.SetFieldAt(0, value0);
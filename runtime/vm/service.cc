@@ -1627,6 +1627,17 @@ static void GetIsolateGroupMemoryUsage(Thread* thread, JSONStream* js) {
   });
 }
 
+static const MethodParameter* const get_safepoint_statistics_params[] = {
+    ISOLATE_GROUP_PARAMETER,
+    NULL,
+};
+
+static void GetSafepointStatistics(Thread* thread, JSONStream* js) {
+  ActOnIsolateGroup(js, [&](IsolateGroup* isolate_group) {
+    isolate_group->safepoint_handler()->PrintJSON(js);
+  });
+}
+
 static const MethodParameter* const get_scripts_params[] = {
     RUNNABLE_ISOLATE_PARAMETER,
     NULL,
@@ -4591,6 +4602,21 @@ static void GetHeapMap(Thread* thread, JSONStream* js) {
   isolate_group->heap()->PrintHeapMapToJSONStream(isolate_group, js);
 }
 
+static const MethodParameter* const get_heap_profile_params[] = {
+    RUNNABLE_ISOLATE_PARAMETER,
+    NULL,
+};
+
+static void GetHeapProfile(Thread* thread, JSONStream* js) {
+  intptr_t length = 0;
+  uint8_t* profile = thread->heap()->heap_profile()->Write(thread, &length);
+  JSONObject jsobj(js);
+  jsobj.AddProperty("type", "_HeapProfile");
+  jsobj.AddProperty("format", "pprof");
+  jsobj.AddPropertyBase64("profile", profile, length);
+  free(profile);
+}
+
 static const MethodParameter* const request_heap_snapshot_params[] = {
     RUNNABLE_ISOLATE_PARAMETER,
     NULL,
@@ -5882,6 +5908,8 @@ static const ServiceMethodDescriptor service_methods_[] = {
     get_flag_list_params },
   { "_getHeapMap", GetHeapMap,
     get_heap_map_params },
+  { "_getHeapProfile", GetHeapProfile,
+    get_heap_profile_params },
   { "_getImplementationFields", GetImplementationFields,
     get_implementation_fields_params },
   { "getInboundReferences", GetInboundReferences,
@@ -5926,6 +5954,8 @@ static const ServiceMethodDescriptor service_methods_[] = {
     lookup_package_uris_params },
   { "getRetainingPath", GetRetainingPath,
     get_retaining_path_params },
+  { "_getSafepointStatistics", GetSafepointStatistics,
+    get_safepoint_statistics_params },
   { "getScripts", GetScripts,
     get_scripts_params },
   { "getSourceReport", GetSourceReport,
@@ -265,6 +265,10 @@ const char* Thread::TaskKindToCString(TaskKind kind) {
       return "kSweeperTask";
     case kMarkerTask:
       return "kMarkerTask";
+    case kHeapSnapshotTask:
+      return "kHeapSnapshotTask";
+    case kBecomeTask:
+      return "kBecomeTask";
     default:
       UNREACHABLE();
       return "";
@@ -343,6 +343,8 @@ class Thread : public ThreadState {
     kCompactorTask = 0x10,
     kScavengerTask = 0x20,
     kSampleBlockTask = 0x40,
+    kHeapSnapshotTask = 0x80,
+    kBecomeTask = 0x100,
   };
   // Converts a TaskKind to its corresponding C-String name.
   static const char* TaskKindToCString(TaskKind kind);
@@ -689,6 +691,13 @@ class Thread : public ThreadState {
   static intptr_t top_offset() { return OFFSET_OF(Thread, top_); }
   static intptr_t end_offset() { return OFFSET_OF(Thread, end_); }
 
+  // The old-space allocation buffer boundaries. Only used by the runtime; see
+  // PageSpace::TryAllocateDataTLAB.
+  uword old_top() const { return old_top_; }
+  uword old_end() const { return old_end_; }
+  void set_old_top(uword top) { old_top_ = top; }
+  void set_old_end(uword end) { old_end_ = end; }
+
   int32_t no_safepoint_scope_depth() const {
 #if defined(DEBUG)
     return no_safepoint_scope_depth_;
@@ -1249,6 +1258,8 @@ class Thread : public ThreadState {
 
   Heap* heap_ = nullptr;
   uword true_end_ = 0;
+  uword old_top_ = 0;
+  uword old_end_ = 0;
   TaskKind task_kind_;
   TimelineStream* dart_stream_;
   StreamInfo* service_extension_stream_;
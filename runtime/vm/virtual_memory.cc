@@ -9,6 +9,14 @@
 
 namespace dart {
 
+DEFINE_FLAG(bool,
+            use_huge_pages,
+            false,
+            "Back old-space and code with transparent huge pages where the OS "
+            "supports them.");
+
+bool VirtualMemory::huge_pages_supported_ = false;
+
 bool VirtualMemory::InSamePage(uword address0, uword address1) {
   return (Utils::RoundDown(address0, PageSize()) ==
           Utils::RoundDown(address1, PageSize()));
@@ -32,6 +40,23 @@ void VirtualMemory::Truncate(intptr_t new_size) {
   alias_.Subregion(alias_, 0, new_size);
 }
 
+VirtualMemory* VirtualMemory::SplitTail(intptr_t new_size) {
+  ASSERT(Utils::IsAligned(new_size, PageSize()));
+  ASSERT(new_size > 0 && new_size < size());
+  ASSERT(vm_owns_region());
+  ASSERT(AliasOffset() == 0);
+  ASSERT(reserved_.start() == region_.start());
+  ASSERT(reserved_.size() == region_.size());
+  MemoryRegion tail(reinterpret_cast<void*>(start() + new_size),
+                    size() - new_size);
+  region_.Subregion(region_, 0, new_size);
+  alias_.Subregion(alias_, 0, new_size);
+  reserved_.Subregion(reserved_, 0, new_size);
+  VirtualMemory* memory = new VirtualMemory(tail, tail);
+  memory->is_private_anonymous_ = is_private_anonymous_;
+  return memory;
+}
+
 VirtualMemory* VirtualMemory::ForImagePage(void* pointer, uword size) {
   // Memory for precompilated instructions was allocated by the embedder, so
   // create a VirtualMemory without allocating.
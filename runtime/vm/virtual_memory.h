@@ -12,6 +12,8 @@
 
 namespace dart {
 
+DECLARE_FLAG(bool, use_huge_pages);
+
 class VirtualMemory {
  public:
   enum Protection {
@@ -48,6 +50,28 @@ class VirtualMemory {
 
   static void DontNeed(void* address, intptr_t size);
 
+  // Tells the OS that the contents of the page-aligned range are no longer
+  // needed, so that its physical memory may be reclaimed when the system needs
+  // it. The range stays mapped and may be written again at any time. Until
+  // then, reads return either the old contents or zeros. Returns false if the
+  // memory could not be released.
+  static bool Discard(void* address, intptr_t size);
+
+  // The size of a transparent huge page on the platforms that support them.
+  static constexpr intptr_t kHugePageSize = 2 * MB;
+
+  // Returns true if --use_huge_pages is set and the OS supports transparent
+  // huge pages.
+  static bool HugePagesEnabled() {
+    return FLAG_use_huge_pages && huge_pages_supported_;
+  }
+
+  // Asks the OS to back the given range with transparent huge pages. Returns
+  // false if the request was rejected, in which case the range stays backed
+  // by base pages.
+  static bool AdviseHugePages(void* address, intptr_t size);
+  bool AdviseHugePages() { return AdviseHugePages(address(), size()); }
+
   // Reserves and commits a virtual memory segment with size. If a segment of
   // the requested size cannot be allocated, NULL is returned.
   static VirtualMemory* Allocate(intptr_t size,
@@ -74,6 +98,19 @@ class VirtualMemory {
   // Truncate this virtual memory segment.
   void Truncate(intptr_t new_size);
 
+  // Extends this read-write segment to new_size without moving it, by mapping
+  // fresh zeroed memory directly after its end. Returns false if the address
+  // range is taken, the OS does not support it, or the segment is not a plain
+  // private anonymous mapping: if it has an alias, is backed by a memfd, has
+  // a truncated reservation or belongs to the compressed heap.
+  bool TryExtendInPlace(intptr_t new_size);
+
+  // Truncate this virtual memory segment to new_size and return the remainder
+  // as a separate segment, which owns its part of the reservation. Only
+  // supported for segments without an alias whose reservation has not been
+  // truncated.
+  VirtualMemory* SplitTail(intptr_t new_size);
+
   // False for a part of a snapshot added directly to the Dart heap, which
   // belongs to the embedder and must not be deallocated or have its
   // protection status changed by the VM.
@@ -113,7 +150,12 @@ class VirtualMemory {
   // Its size might disagree with region_ due to Truncate.
   MemoryRegion reserved_;
 
+  // Whether region_ was mapped as private anonymous read-write memory, and
+  // so can be extended by mapping more of it next to it.
+  bool is_private_anonymous_ = false;
+
   static uword page_size_;
+  static bool huge_pages_supported_;
   static VirtualMemory* compressed_heap_;
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(VirtualMemory);
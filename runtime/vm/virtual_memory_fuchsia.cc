@@ -314,6 +314,20 @@ void VirtualMemory::DontNeed(void* address, intptr_t size) {
   }
 }
 
+bool VirtualMemory::TryExtendInPlace(intptr_t new_size) {
+  return false;
+}
+
+bool VirtualMemory::Discard(void* address, intptr_t size) {
+  // ZX_VMAR_OP_DONT_NEED is already a hint that leaves the range usable.
+  DontNeed(address, size);
+  return true;
+}
+
+bool VirtualMemory::AdviseHugePages(void* address, intptr_t size) {
+  return false;
+}
+
 }  // namespace dart
 
 #endif  // defined(DART_HOST_OS_FUCHSIA)
@@ -230,6 +230,22 @@ void VirtualMemory::Init() {
 #endif  // defined(DUAL_MAPPING_SUPPORTED)
 
 #if defined(DART_HOST_OS_LINUX) || defined(DART_HOST_OS_ANDROID)
+#if defined(MADV_HUGEPAGE)
+  // Transparent huge pages are available unless the kernel was built without
+  // them or they have been disabled system-wide.
+  FILE* thp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+  if (thp != nullptr) {
+    char mode[128];
+    if (fgets(mode, sizeof(mode), thp) != nullptr) {
+      huge_pages_supported_ = strstr(mode, "[never]") == nullptr;
+    }
+    fclose(thp);
+  }
+  if (FLAG_use_huge_pages && !huge_pages_supported_) {
+    LOG_INFO("Transparent huge pages not available; using base pages.\n");
+  }
+#endif  // defined(MADV_HUGEPAGE)
+
   FILE* fp = fopen("/proc/sys/vm/max_map_count", "r");
   if (fp != nullptr) {
     size_t max_map_count = 0;
@@ -406,7 +422,10 @@ VirtualMemory* VirtualMemory::AllocateAligned(intptr_t size,
   // Try to use memfd for single-mapped regions too, so they will have an
   // associated name for memory attribution. Skip if FLAG_dual_map_code is
   // false, which happens if we detected memfd wasn't working in Init above.
-  if (FLAG_dual_map_code) {
+  // Also skip for huge-page-backed data, which Page splits into separately
+  // released pages: a shared mapping only gives its memory back to the OS
+  // once every piece of it has been unmapped.
+  if (FLAG_dual_map_code && (is_executable || !HugePagesEnabled())) {
     int fd = memfd_create(name, MFD_CLOEXEC);
     if (fd == -1) {
       return nullptr;
@@ -453,7 +472,9 @@ VirtualMemory* VirtualMemory::AllocateAligned(intptr_t size,
 #endif
 
   MemoryRegion region(reinterpret_cast<void*>(address), size);
-  return new VirtualMemory(region, region);
+  VirtualMemory* memory = new VirtualMemory(region, region);
+  memory->is_private_anonymous_ = !is_executable;
+  return memory;
 }
 
 VirtualMemory* VirtualMemory::Reserve(intptr_t size, intptr_t alignment) {
@@ -517,6 +538,43 @@ VirtualMemory::~VirtualMemory() {
   }
 }
 
+bool VirtualMemory::TryExtendInPlace(intptr_t new_size) {
+  ASSERT(Utils::IsAligned(new_size, PageSize()));
+  ASSERT(new_size > size());
+  if (!vm_owns_region() || !is_private_anonymous_ || (AliasOffset() != 0) ||
+      (reserved_.start() != region_.start()) ||
+      (reserved_.size() != region_.size())) {
+    return false;
+  }
+#if defined(DART_COMPRESSED_POINTERS)
+  if (VirtualMemoryCompressedHeap::Contains(address())) {
+    return false;
+  }
+#endif  // defined(DART_COMPRESSED_POINTERS)
+  // Like mremap without MREMAP_MAYMOVE, but the tail is a separate anonymous
+  // mapping.
+  void* tail = reinterpret_cast<void*>(end());
+  const intptr_t tail_size = new_size - size();
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_FIXED_NOREPLACE)
+  flags |= MAP_FIXED_NOREPLACE;
+#endif
+  void* result = mmap(tail, tail_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (result == MAP_FAILED) {
+    return false;
+  }
+  if (result != tail) {
+    // The hint was not honored because the range is in use.
+    const uword start = reinterpret_cast<uword>(result);
+    Unmap(start, start + tail_size);
+    return false;
+  }
+  region_.set_size(new_size);
+  alias_.set_size(new_size);
+  reserved_.set_size(new_size);
+  return true;
+}
+
 bool VirtualMemory::FreeSubSegment(void* address, intptr_t size) {
 #if defined(DART_COMPRESSED_POINTERS)
   // Don't free the sub segment if it's managed by the compressed pointer heap.
@@ -585,6 +643,44 @@ void VirtualMemory::DontNeed(void* address, intptr_t size) {
   }
 }
 
+bool VirtualMemory::Discard(void* address, intptr_t size) {
+  ASSERT(Utils::IsAligned(reinterpret_cast<uword>(address), PageSize()));
+  ASSERT(Utils::IsAligned(size, PageSize()));
+#if defined(MADV_FREE)
+  // Lets the kernel reclaim the pages lazily, so reusing them soon after does
+  // not fault. Only for private mappings, and not before Linux 4.5.
+  if (madvise(address, size, MADV_FREE) == 0) {
+    return true;
+  }
+#endif
+#if defined(MADV_REMOVE)
+  // The memfd mappings made with --dual_map_code are shared. MADV_DONTNEED
+  // only unmaps their pages, which stay in the page cache, while
+  // MADV_REMOVE also frees the backing store. It fails with EINVAL for
+  // mappings which are not backed by shared memory.
+  if (madvise(address, size, MADV_REMOVE) == 0) {
+    return true;
+  }
+  if (errno != EINVAL) {
+    return false;
+  }
+#endif
+  // A private mapping, whose pages are freed right away.
+  return madvise(address, size, MADV_DONTNEED) == 0;
+}
+
+bool VirtualMemory::AdviseHugePages(void* address, intptr_t size) {
+#if defined(MADV_HUGEPAGE)
+  uword start_address = reinterpret_cast<uword>(address);
+  uword end_address = start_address + size;
+  uword page_address = Utils::RoundDown(start_address, PageSize());
+  return madvise(reinterpret_cast<void*>(page_address),
+                 end_address - page_address, MADV_HUGEPAGE) == 0;
+#else
+  return false;
+#endif
+}
+
 }  // namespace dart
 
 #endif  // defined(DART_HOST_OS_ANDROID) || defined(DART_HOST_OS_LINUX) ||     \
@@ -10,6 +10,8 @@
 
 namespace dart {
 
+DECLARE_FLAG(bool, dual_map_code);
+
 bool IsZero(char* begin, char* end) {
   for (char* current = begin; current < end; ++current) {
     if (*current != 0) {
@@ -89,4 +91,90 @@ VM_UNIT_TEST_CASE(FreeVirtualMemory) {
   }
 }
 
+#if defined(DART_HOST_OS_ANDROID) || defined(DART_HOST_OS_LINUX) ||            \
+    defined(DART_HOST_OS_MACOS)
+VM_UNIT_TEST_CASE(SplitVirtualMemory) {
+  const intptr_t kHugePageSize = VirtualMemory::kHugePageSize;
+  VirtualMemory* vm = VirtualMemory::AllocateAligned(
+      kHugePageSize, kHugePageSize, false, false, "test");
+  EXPECT(vm != NULL);
+  EXPECT(Utils::IsAligned(vm->start(), kHugePageSize));
+  // Advice may be rejected, but must not affect the mapping.
+  vm->AdviseHugePages();
+
+  const uword start = vm->start();
+  VirtualMemory* tail = vm->SplitTail(kPageSize);
+  EXPECT_EQ(start, vm->start());
+  EXPECT_EQ(kPageSize, vm->size());
+  EXPECT_EQ(start + kPageSize, tail->start());
+  EXPECT_EQ(kHugePageSize - kPageSize, tail->size());
+  EXPECT(!vm->Contains(tail->start()));
+
+  // Each part is usable and released independently.
+  char* head_buf = reinterpret_cast<char*>(vm->address());
+  char* tail_buf = reinterpret_cast<char*>(tail->address());
+  head_buf[0] = 'a';
+  tail_buf[tail->size() - 1] = 'b';
+  delete vm;
+  EXPECT_EQ('b', tail_buf[tail->size() - 1]);
+  delete tail;
+}
+#endif
+
+#if defined(DART_HOST_OS_ANDROID) || defined(DART_HOST_OS_LINUX)
+static void TestDiscard(bool dual_map_code) {
+  SetFlagScope<bool> sfs(&FLAG_dual_map_code, dual_map_code);
+  const intptr_t kVirtualMemoryBlockSize = 64 * KB;
+  VirtualMemory* vm =
+      VirtualMemory::Allocate(kVirtualMemoryBlockSize, false, false, "test");
+  EXPECT(vm != NULL);
+  char* buf = reinterpret_cast<char*>(vm->address());
+  memset(buf, 'a', vm->size());
+  // Private and memfd mappings are both released.
+  EXPECT(VirtualMemory::Discard(vm->address(), vm->size()));
+  EXPECT(buf[0] == 'a' || buf[0] == 0);
+  buf[0] = 'b';
+  EXPECT_EQ('b', buf[0]);
+  delete vm;
+}
+
+VM_UNIT_TEST_CASE(DiscardVirtualMemory) {
+  TestDiscard(/*dual_map_code=*/false);
+  // Only if memfd was found to work.
+  if (FLAG_dual_map_code) {
+    TestDiscard(/*dual_map_code=*/true);
+  }
+}
+
+VM_UNIT_TEST_CASE(ExtendVirtualMemoryInPlace) {
+  const intptr_t kVirtualMemoryBlockSize = 64 * KB;
+  {
+    SetFlagScope<bool> sfs(&FLAG_dual_map_code, false);
+    VirtualMemory* vm =
+        VirtualMemory::Allocate(kVirtualMemoryBlockSize, false, false, "test");
+    EXPECT(vm != NULL);
+    char* buf = reinterpret_cast<char*>(vm->address());
+    buf[0] = 'a';
+    // May fail if the address range after the segment is taken.
+    if (vm->TryExtendInPlace(2 * kVirtualMemoryBlockSize)) {
+      EXPECT_EQ(2 * kVirtualMemoryBlockSize, vm->size());
+      EXPECT_EQ('a', buf[0]);
+      EXPECT_EQ(0, buf[vm->size() - 1]);
+      buf[vm->size() - 1] = 'b';
+    }
+    delete vm;
+  }
+  // Only if memfd was found to work and is used for data.
+  if (FLAG_dual_map_code && !VirtualMemory::HugePagesEnabled()) {
+    // A private mapping next to a shared one would not be released with it.
+    VirtualMemory* vm =
+        VirtualMemory::Allocate(kVirtualMemoryBlockSize, false, false, "test");
+    EXPECT(vm != NULL);
+    EXPECT(!vm->TryExtendInPlace(2 * kVirtualMemoryBlockSize));
+    EXPECT_EQ(kVirtualMemoryBlockSize, vm->size());
+    delete vm;
+  }
+}
+#endif
+
 }  // namespace dart
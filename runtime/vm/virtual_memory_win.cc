@@ -243,6 +243,18 @@ void VirtualMemory::Protect(void* address, intptr_t size, Protection mode) {
 
 void VirtualMemory::DontNeed(void* address, intptr_t size) {}
 
+bool VirtualMemory::TryExtendInPlace(intptr_t new_size) {
+  return false;
+}
+
+bool VirtualMemory::Discard(void* address, intptr_t size) {
+  return false;
+}
+
+bool VirtualMemory::AdviseHugePages(void* address, intptr_t size) {
+  return false;
+}
+
 }  // namespace dart
 
 #endif  // defined(DART_HOST_OS_WINDOWS)
@@ -372,7 +372,18 @@ class _GrowableList<T> extends ListBase<T> {
   // Grow from 0 to 3, and then double + 1.
   int _nextCapacity(int old_capacity) => (old_capacity * 2) | 3;
 
+  // Backing arrays at least this long live alone on a large page, which the VM
+  // may be able to extend instead of copying the elements.
+  static const int _growInPlaceMinCapacity = 8 * 1024;
+
+  @pragma("vm:external-name", "GrowableList_tryGrowInPlace")
+  external bool _tryGrowInPlace(int new_capacity);
+
   void _grow(int new_capacity) {
+    if (new_capacity >= _growInPlaceMinCapacity &&
+        _tryGrowInPlace(_adjustedCapacity(new_capacity))) {
+      return;
+    }
     var newData = _allocateData(new_capacity);
     // This is a workaround for dartbug.com/30090: array-bound-check
     // generalization causes excessive deoptimizations because it